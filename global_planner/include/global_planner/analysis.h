@@ -144,8 +144,7 @@ void printPointStats(GlobalPlanner* global_planner, double x, double y,
     double prob = octomap::probability(node->getValue());
     double post_prob = posterior(global_planner->getAltPrior(cell), prob);
     ROS_INFO("prob: %2.2f \t post_prob: %2.2f", prob, post_prob);
-    if (global_planner->occupied_.find(cell) !=
-        global_planner->occupied_.end()) {
+    if (global_planner->occupied_.get(cell)) {
       ROS_INFO("Cell in occupied, posterior: %2.2f", post_prob);
     } else {
       ROS_INFO("Cell NOT in occupied, posterior: %2.2f",
@@ -2,11 +2,26 @@
 #define GLOBAL_PLANNER_BEZIER_H_
 
 #include <math.h>  // sqrt
+#include <algorithm>
+#include <vector>
+
+#include <nav_msgs/Path.h>
+
+#include "global_planner/cell.h"
+#include "global_planner/common.h"
 
 // This file consists functions for functions for Bezier curves
 
 namespace global_planner {
 
+// The risk along a curve
+struct CurveRisk {
+  double risk = 0.0;           // Risk of the cells times the length in them
+  double max_cell_risk = 0.0;  // The highest risk of a cell of the curve
+  double length = 0.0;         // Over which the risk is counted
+  int num_lookups = 0;         // Of the risk of a cell
+};
+
 // Returns the point on the quadratic Bezier curve at time t (0 <= t <= 1)
 template <typename T>
 T quadraticBezier(T p0, T p1, T p2, double t) {
@@ -19,18 +34,25 @@ T quadraticBezierAcc(T p0, T p1, T p2, double duration = 1.0) {
   return 2 * (p2 - 2 * p1 + p0) / duration * duration;
 }
 
+// Returns the point on the quadratic Bezier curve from p0 to p2 at time t
+template <typename P>
+P quadraticBezierPoint(const P& p0, const P& p1, const P& p2, double t) {
+  P point;
+  point.x = quadraticBezier(p0.x, p1.x, p2.x, t);
+  point.y = quadraticBezier(p0.y, p1.y, p2.y, t);
+  point.z = quadraticBezier(p0.z, p1.z, p2.z, t);
+  return point;
+}
+
 // Returns a quadratic Bezier-curve starting in p0 and and ending in p2
 template <typename P>
 std::vector<P> threePointBezier(const P& p0, const P& p1, const P& p2,
                                 int num_steps = 10) {
   std::vector<P> curve;
+  curve.reserve(num_steps + 1);
   for (int i = 0; i <= num_steps; ++i) {
     double t = ((double)i) / num_steps;
-    P new_point;
-    new_point.x = quadraticBezier(p0.x, p1.x, p2.x, t);
-    new_point.y = quadraticBezier(p0.y, p1.y, p2.y, t);
-    new_point.z = quadraticBezier(p0.z, p1.z, p2.z, t);
-    curve.push_back(new_point);
+    curve.push_back(quadraticBezierPoint(p0, p1, p2, t));
   }
   return curve;
 }
@@ -55,6 +77,65 @@ nav_msgs::Path threePointBezier(const Path& path, int num_steps = 10) {
   return new_path;
 }
 
+// Adds the risk of the quadratic Bezier curve from p0 to p2 to curve_risk,
+// cell_risk(cell) returns the risk of a Cell. The curve lies within the
+// bounding box of its control points, so it is split in halves until the box
+// of each piece is inside one cell. This cell is looked up once and counted
+// for the length of the control polygon, which is at least the length of the
+// piece. Pieces on the border of cells are split until they are shorter than a
+// quarter of a cell, then the highest risk of the cells in their box is used.
+// So the risk is never underestimated, and a curve through few cells needs few
+// lookups. Stops once a cell has a risk above max_risk, e.g. to only check if
+// a curve is blocked.
+template <typename P, typename CellRisk>
+void addBezierRisk(const P& p0, const P& p1, const P& p2,
+                   const CellRisk& cell_risk, CurveRisk& curve_risk,
+                   double max_risk = INFINITY) {
+  if (curve_risk.max_cell_risk > max_risk) {
+    return;
+  }
+  const Cell low(std::min({p0.x, p1.x, p2.x}), std::min({p0.y, p1.y, p2.y}),
+                 std::min({p0.z, p1.z, p2.z}));
+  const Cell high(std::max({p0.x, p1.x, p2.x}), std::max({p0.y, p1.y, p2.y}),
+                  std::max({p0.z, p1.z, p2.z}));
+  const double length = distance(p0, p1) + distance(p1, p2);
+  if (low != high && length > 0.25 * CELL_SCALE) {
+    // Split the curve at t = 0.5 (de Casteljau)
+    P ctrl_0 = middlePoint(p0, p1);
+    P ctrl_1 = middlePoint(p1, p2);
+    P middle = middlePoint(ctrl_0, ctrl_1);
+    addBezierRisk(p0, ctrl_0, middle, cell_risk, curve_risk, max_risk);
+    addBezierRisk(middle, ctrl_1, p2, cell_risk, curve_risk, max_risk);
+    return;
+  }
+
+  double risk = 0.0;
+  for (int x = low.xIndex(); x <= high.xIndex(); ++x) {
+    for (int y = low.yIndex(); y <= high.yIndex(); ++y) {
+      for (int z = low.zIndex(); z <= high.zIndex(); ++z) {
+        risk = std::max(risk, cell_risk(Cell(std::make_tuple(x, y, z))));
+        curve_risk.num_lookups++;
+      }
+    }
+  }
+  curve_risk.risk += risk * length;
+  curve_risk.length += length;
+  curve_risk.max_cell_risk = std::max(curve_risk.max_cell_risk, risk);
+}
+
+// Adds the risk of the curve through the poses to curve_risk. They are
+// consecutive quadratic Bezier curves, the poses with an odd index are the
+// control points.
+template <typename CellRisk>
+void addBezierRisk(const std::vector<geometry_msgs::PoseStamped>& poses,
+                   const CellRisk& cell_risk, CurveRisk& curve_risk,
+                   double max_risk = INFINITY) {
+  for (size_t i = 2; i < poses.size(); i += 2) {
+    addBezierRisk(poses[i - 2].pose.position, poses[i - 1].pose.position,
+                  poses[i].pose.position, cell_risk, curve_risk, max_risk);
+  }
+}
+
 template <typename P, typename BezierMsg>
 void fillBezierMsg(BezierMsg& msg, const P& p0, const P& p1, const P& p2,
                    double duration) {
@@ -1,7 +1,9 @@
 #ifndef GLOBAL_PLANNER_CELL
 #define GLOBAL_PLANNER_CELL
 
-#include <math.h>  // abs
+#include <math.h>  // abs ldexp
+#include <stdint.h>
+#include <array>
 #include <string>
 #include <tuple>
 
@@ -11,13 +13,17 @@
 
 namespace global_planner {
 
-double CELL_SCALE = 1.0;
+extern double CELL_SCALE;  // Defined in cell.cpp
 
+// A Cell of level l has the size CELL_SCALE * 2^l, the Cells of level 0 are the
+// full resolution. A Cell of a higher level covers 8 Cells of the level below,
+// like the nodes of an octree.
 class Cell {
  public:
   Cell();
-  Cell(std::tuple<int, int, int> new_tuple);
+  Cell(std::tuple<int, int, int> new_tuple, int level = 0);
   Cell(double x, double y, double z);
+  Cell(double x, double y, double z, int level);
   Cell(double x, double y);
   Cell(geometry_msgs::Point point);
   // Cell(Eigen::Vector3d point);
@@ -27,6 +33,12 @@ class Cell {
   int yIndex() const;
   int zIndex() const;
 
+  int level() const { return level_; }
+  double scale() const { return ldexp(CELL_SCALE, level_); }
+  // Returns the Cell of the given level which contains this Cell, or the
+  // Cell with the lowest indices inside this Cell if the level is lower
+  Cell atLevel(int level) const;
+
   // Get the coordinates of the center-point of the Cell
   double xPos() const;
   double yPos() const;
@@ -41,25 +53,59 @@ class Cell {
   double diagDistance3D(const Cell& b) const;
   double angle() const;
 
+  // The Cell of the same level whose indices differ by dx, dy and dz
+  Cell offset(int dx, int dy, int dz) const;
   Cell getNeighborFromYaw(double yaw) const;
-  std::vector<Cell> getFlowNeighbors() const;
-  std::vector<Cell> getDiagonalNeighbors() const;
-  std::vector<Cell> getNeighbors() const;
+  // Returned by value, so iterating over them does not allocate
+  std::array<Cell, 6> getFlowNeighbors() const;
+  std::array<Cell, 4> getDiagonalNeighbors() const;
+  std::array<Cell, 10> getNeighbors() const;
 
   std::string asString() const;
 
+  // Packs the level and the indices into a 64-bit key, 4 bits for the level
+  // and 20 bits per index
+  uint64_t key() const;
+
   // Member variables
   std::tuple<int, int, int> tpl_;
+  int level_ = 0;
 };
 
+inline uint64_t Cell::key() const {
+  const int offset = 1 << 19;  // Indices from -2^19 to 2^19 - 1 are unique
+  const uint64_t mask = (1 << 20) - 1;
+  return static_cast<uint64_t>(level_ & 15) << 60 |
+         ((std::get<0>(tpl_) + offset) & mask) << 40 |
+         ((std::get<1>(tpl_) + offset) & mask) << 20 |
+         ((std::get<2>(tpl_) + offset) & mask);
+}
+
+inline Cell Cell::atLevel(int level) const {
+  if (level >= level_) {
+    // The arithmetic shift rounds negative indices down
+    int shift = level - level_;
+    return Cell(std::tuple<int, int, int>(std::get<0>(tpl_) >> shift,
+                                          std::get<1>(tpl_) >> shift,
+                                          std::get<2>(tpl_) >> shift),
+                level);
+  }
+  int factor = 1 << (level_ - level);
+  return Cell(std::tuple<int, int, int>(std::get<0>(tpl_) * factor,
+                                        std::get<1>(tpl_) * factor,
+                                        std::get<2>(tpl_) * factor),
+              level);
+}
+
 inline bool operator==(const Cell& lhs, const Cell& rhs) {
-  return lhs.tpl_ == rhs.tpl_;
+  return lhs.tpl_ == rhs.tpl_ && lhs.level_ == rhs.level_;
 }
 inline bool operator!=(const Cell& lhs, const Cell& rhs) {
   return !operator==(lhs, rhs);
 }
 inline bool operator<(const Cell& lhs, const Cell& rhs) {
-  return lhs.tpl_ < rhs.tpl_;
+  return lhs.level_ < rhs.level_ ||
+         (lhs.level_ == rhs.level_ && lhs.tpl_ < rhs.tpl_);
 }
 inline bool operator>(const Cell& lhs, const Cell& rhs) {
   return operator<(rhs, lhs);
@@ -71,16 +117,19 @@ inline bool operator>=(const Cell& lhs, const Cell& rhs) {
   return !operator<(lhs, rhs);
 }
 
+// The indices are added, the result has the level of lhs
 inline Cell operator+(const Cell& lhs, const Cell& rhs) {
   Cell res(std::tuple<int, int, int>(lhs.xIndex() + rhs.xIndex(),
                                      lhs.yIndex() + rhs.yIndex(),
-                                     lhs.zIndex() + rhs.zIndex()));
+                                     lhs.zIndex() + rhs.zIndex()),
+           lhs.level());
   return res;
 }
 inline Cell operator-(const Cell& lhs, const Cell& rhs) {
   Cell res(std::tuple<int, int, int>(lhs.xIndex() - rhs.xIndex(),
                                      lhs.yIndex() - rhs.yIndex(),
-                                     lhs.zIndex() - rhs.zIndex()));
+                                     lhs.zIndex() - rhs.zIndex()),
+           lhs.level());
   return res;
 }
 
@@ -117,10 +166,8 @@ namespace std {
 template <>
 struct hash<global_planner::Cell> {
   std::size_t operator()(const global_planner::Cell& cell) const {
-    return (std::get<0>(cell.tpl_) << 20) ^ (std::get<1>(cell.tpl_) << 10) ^
-           std::get<2>(cell.tpl_);
-    // return (std::get<0>(cell.tpl_) * 18397) + (std::get<1>(cell.tpl_) *
-    // 20483) + (std::get<2>(cell.tpl_) * 29303);
+    // Fibonacci hashing spreads the packed indices over all bits
+    return cell.key() * 0x9E3779B97F4A7C15ull;
   }
 };
 
@@ -0,0 +1,201 @@
+#ifndef GLOBAL_PLANNER_CELL_GRID_H_
+#define GLOBAL_PLANNER_CELL_GRID_H_
+
+#include <stdint.h>
+#include <algorithm>  // std::fill std::nth_element
+#include <memory>
+#include <unordered_map>
+#include <utility>  // std::move
+#include <vector>
+
+#include "global_planner/cell.h"
+
+namespace global_planner {
+
+// Dense storage of one value per Cell, the Cells are grouped in blocks of
+// 16x16x16 and only the blocks which have been written to are allocated.
+// Cells which have not been set have the empty value (e.g. NaN for "not
+// computed"). Not thread safe, even for concurrent reads, but copies can be
+// used by different threads, and so can get() with a Cursor of each thread.
+template <typename T>
+class CellGrid {
+  struct Block;
+
+ public:
+  static const int BLOCK_BITS = 4;
+  static const int BLOCK_SIZE = 1 << BLOCK_BITS;
+  static const int BLOCK_VOLUME = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+  explicit CellGrid(const T& empty_value = T()) : empty_value_(empty_value) {}
+
+  // Copies all blocks, only reads the other grid
+  CellGrid(const CellGrid& other) : empty_value_(other.empty_value_) {
+    copyBlocks(other);
+  }
+
+  CellGrid(CellGrid&& other) { *this = std::move(other); }
+
+  CellGrid& operator=(const CellGrid& other) {
+    if (this != &other) {
+      clear();
+      empty_value_ = other.empty_value_;
+      copyBlocks(other);
+    }
+    return *this;
+  }
+
+  CellGrid& operator=(CellGrid&& other) {
+    if (this != &other) {
+      empty_value_ = other.empty_value_;
+      blocks_ = std::move(other.blocks_);
+      last_key_ = other.last_key_;
+      last_block_ = other.last_block_;
+      other.clear();
+    }
+    return *this;
+  }
+
+  // Returns the value of cell, or the empty value if it has not been set
+  const T& get(const Cell& cell) const {
+    const Block* block = findBlock(blockKey(cell));
+    return block ? block->values[localIndex(cell)] : empty_value_;
+  }
+
+  // The last block looked up by one of the threads which read the grid at the
+  // same time, valid while the grid is not changed
+  class Cursor {
+    friend class CellGrid;
+    uint64_t key_ = 0;
+    const Block* block_ = nullptr;
+  };
+
+  // Like get, but remembers the block in cursor instead of in the grid
+  const T& get(const Cell& cell, Cursor& cursor) const {
+    const uint64_t key = blockKey(cell);
+    if (!cursor.block_ || key != cursor.key_) {
+      auto it = blocks_.find(key);
+      if (it == blocks_.end()) {
+        return empty_value_;
+      }
+      cursor.key_ = key;
+      cursor.block_ = it->second.get();
+    }
+    return cursor.block_->values[localIndex(cell)];
+  }
+
+  // Returns a reference to the value of cell, allocates its block if needed
+  T& operator[](const Cell& cell) {
+    return getBlock(cell).values[localIndex(cell)];
+  }
+
+  void set(const Cell& cell, const T& value) { (*this)[cell] = value; }
+
+  // Resets cell to the empty value, does not free the block
+  void erase(const Cell& cell) {
+    Block* block = findBlock(blockKey(cell));
+    if (block) {
+      block->values[localIndex(cell)] = empty_value_;
+    }
+  }
+
+  // Resets all Cells to the empty value and frees the blocks
+  void clear() {
+    blocks_.clear();
+    last_key_ = 0;
+    last_block_ = nullptr;
+  }
+
+  size_t numBlocks() const { return blocks_.size(); }
+  size_t memoryUsage() const { return blocks_.size() * sizeof(Block); }
+
+  // Frees the blocks farthest from center until at most max_blocks are left,
+  // their Cells get the empty value. Returns the number of freed blocks.
+  size_t evictFarthestBlocks(const Cell& center, size_t max_blocks) {
+    if (blocks_.size() <= max_blocks) {
+      return 0;
+    }
+    std::vector<std::pair<double, uint64_t> > distance_keys;
+    distance_keys.reserve(blocks_.size());
+    for (const auto& key_block : blocks_) {
+      distance_keys.push_back(std::make_pair(
+          key_block.second->block_cell.distance3D(center), key_block.first));
+    }
+    std::nth_element(distance_keys.begin(), distance_keys.begin() + max_blocks,
+                     distance_keys.end());
+    for (size_t i = max_blocks; i < distance_keys.size(); ++i) {
+      blocks_.erase(distance_keys[i].second);
+    }
+    last_key_ = 0;
+    last_block_ = nullptr;
+    return distance_keys.size() - max_blocks;
+  }
+
+ private:
+  struct Block {
+    Block(const T& empty_value, const Cell& block_cell_)
+        : block_cell(block_cell_) {
+      std::fill(values, values + BLOCK_VOLUME, empty_value);
+    }
+    Cell block_cell;  // The Cell of the level BLOCK_BITS higher
+    T values[BLOCK_VOLUME];
+  };
+
+  // The Cell of the level BLOCK_BITS higher, so the Cells of different levels
+  // are in different blocks
+  static Cell blockCell(const Cell& cell) {
+    return cell.atLevel(cell.level() + BLOCK_BITS);
+  }
+  static uint64_t blockKey(const Cell& cell) { return blockCell(cell).key(); }
+
+  static int localIndex(const Cell& cell) {
+    const int mask = BLOCK_SIZE - 1;
+    return (cell.xIndex() & mask) |
+           ((cell.yIndex() & mask) << BLOCK_BITS) |
+           ((cell.zIndex() & mask) << (2 * BLOCK_BITS));
+  }
+
+  // Neighboring Cells are mostly in the same block, so the last block is
+  // remembered to skip the hash lookup
+  Block* findBlock(uint64_t key) const {
+    if (last_block_ && key == last_key_) {
+      return last_block_;
+    }
+    auto it = blocks_.find(key);
+    if (it == blocks_.end()) {
+      return nullptr;
+    }
+    last_key_ = key;
+    last_block_ = it->second.get();
+    return last_block_;
+  }
+
+  void copyBlocks(const CellGrid& other) {
+    blocks_.reserve(other.blocks_.size());
+    for (const auto& key_block : other.blocks_) {
+      blocks_[key_block.first].reset(new Block(*key_block.second));
+    }
+  }
+
+  Block& getBlock(const Cell& cell) {
+    const Cell block_cell = blockCell(cell);
+    const uint64_t key = block_cell.key();
+    Block* block = findBlock(key);
+    if (!block) {
+      std::unique_ptr<Block>& new_block = blocks_[key];
+      new_block.reset(new Block(empty_value_, block_cell));
+      last_key_ = key;
+      last_block_ = new_block.get();
+      block = last_block_;
+    }
+    return *block;
+  }
+
+  T empty_value_;
+  std::unordered_map<uint64_t, std::unique_ptr<Block> > blocks_;
+  mutable uint64_t last_key_ = 0;
+  mutable Block* last_block_ = nullptr;
+};
+
+}  // namespace global_planner
+
+#endif /* GLOBAL_PLANNER_CELL_GRID_H_ */
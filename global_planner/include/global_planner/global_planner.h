@@ -4,8 +4,10 @@
 #include <math.h>     // abs
 #include <algorithm>  // std::reverse
 #include <limits>     // numeric_limits
+#include <memory>
 #include <queue>      // std::priority_queue
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -20,18 +22,30 @@
 #include <octomap_msgs/conversions.h>
 
 #include <global_planner/GlobalPlannerNodeConfig.h>
+#include <global_planner/MemoryUsageMsg.h>
+#include <global_planner/OctomapDeltaMsg.h>
 #include <global_planner/PathWithRiskMsg.h>
 #include "global_planner/analysis.h"
 #include "global_planner/bezier.h"
 #include "global_planner/cell.h"
+#include "global_planner/cell_grid.h"
 #include "global_planner/common.h"
 #include "global_planner/common_ros.h"
+#include "global_planner/incremental_search.h"
 #include "global_planner/node.h"
+#include "global_planner/risk_field.h"
+#include "global_planner/run_length_path.h"
 #include "global_planner/search_tools.h"
 #include "global_planner/visitor.h"
 
 namespace global_planner {
 
+// How often a cache was asked and how often it had to compute the value
+struct CacheStats {
+  long lookups = 0;
+  long misses = 0;
+};
+
 class GlobalPlanner {
  public:
   octomap::OcTree* octree_ = NULL;
@@ -48,24 +62,17 @@ class GlobalPlanner {
   std::vector<double> accumulated_alt_prior_;  // accumulated_alt_prior_[i] =
                                                // sum(alt_prior_[0:i])
 
-  std::unordered_map<Cell, double> risk_cache_;  // Cache of getRisk(Cell)
-  std::unordered_map<Cell, double>
-      bubble_risk_cache_;  // Cache the risk of the safest path from Cell to t
-  std::unordered_map<Node, double> heuristic_cache_;  // Cache of
-                                                      // getHeuristic(Node) (and
-                                                      // later reverse search)
-  double bubble_cost_ = 0.0;  // Minimum risk for the safest path from a cell
-                              // outside of the bubble to t
-  double bubble_radius_ =
-      0.0;  // The maximum distance from a cell within the bubble to t
-
-  std::unordered_set<Cell>
+  CellGrid<double> risk_cache_{NAN};         // Cache of getRisk(Cell)
+  CellGrid<double> single_risk_cache_{NAN};  // Cache of getSingleCellRisk
+  CacheStats risk_cache_stats_;  // Read by CountersVisitor
+
+  CellGrid<bool>
       occupied_;  // Cells which have at some point contained an obstacle point
-  std::unordered_set<Cell>
+  CellGrid<bool>
       path_cells_;  // Cells that are on current path, and may not be blocked
 
   // TODO: rename and remove not needed
-  std::vector<Cell> path_back_;
+  RunLengthPath path_back_;
   geometry_msgs::Point curr_pos_;
   double curr_yaw_;
   geometry_msgs::Vector3 curr_vel_;
@@ -75,8 +82,26 @@ class GlobalPlanner {
   double overestimate_factor_ = max_overestimate_factor_;
   std::vector<Cell> curr_path_;
   PathInfo curr_path_info_;
-  SearchVisitor<std::unordered_set<Cell>, std::unordered_map<Cell, double> >
-      visitor_;
+  SearchVisitor<std::unordered_set<Cell>, CellGrid<double> > visitor_;
+  std::vector<Cell> edge_cells_;   // Scratch buffer of getRisk(Node)
+  std::vector<double> path_cost_;  // Scratch buffer of simplifyPath
+  IncrementalSearch<GlobalPlanner> incremental_search_;
+  RiskField<GlobalPlanner> risk_field_;  // The risk from the Cells to goal_pos_
+  // The distance to the goal through the coarse Cells that the searches may
+  // go through, NaN for the other Cells
+  CellGrid<double> corridor_{NAN};
+  int corridor_level_ = 0;  // The level of corridor_, 0 if there is none
+  // The planner whose map a search of findParallelPath reads, NULL for the
+  // planner which owns its map. The searches only read the map, so it is not
+  // copied for them.
+  const GlobalPlanner* map_owner_ = NULL;
+  // The blocks of the map last read by this search, so that the searches do
+  // not write the lookup caches of the map they share
+  struct MapCursors {
+    CellGrid<bool>::Cursor occupied;
+    CellGrid<double>::Cursor corridor;
+    RiskField<GlobalPlanner>::Cursors risk_field;
+  } map_cursors_;
 
   // Dynamic reconfigure parameters
   int min_altitude_ = 1;
@@ -102,6 +127,12 @@ class GlobalPlanner {
       true;  // The current orientation is factored into the smoothness
   bool use_risk_heuristics_ = true;
   bool use_speedup_heuristics_ = true;
+  bool use_incremental_search_ = false;  // D* Lite instead of ARA*
+  bool use_parallel_search_ = false;     // Run the ARA* searches in parallel
+  bool use_risk_field_ = false;  // The risk heuristic is the exact lowest risk
+  int coarse_levels_ = 0;    // Plan on Cells of this level first, 0 for none
+  int corridor_radius_ = 1;  // In coarse Cells around the coarse path
+  double max_cache_memory_ = 0.0;  // In MB, 0 for no limit
   std::string default_node_type_ = "SpeedNode";
 
   GlobalPlanner();
@@ -114,24 +145,42 @@ class GlobalPlanner {
   void setPath(const std::vector<Cell>& path);
 
   bool updateFullOctomap(const octomap_msgs::Octomap& msg);
+  bool updateOctomapDelta(const OctomapDeltaMsg& msg);
+  bool isCurrentPathOk();
+
+  int getOctreeSearchDepth(int level = 0) const;
+  void getCellsOfOctreeNode(const octomap::point3d& point, unsigned depth,
+                            std::vector<Cell>& cells);
+  void getChangedCells(const octomap::OcTree& tree,
+                       const octomap::OcTree& other_tree,
+                       std::vector<Cell>& changed_cells);
+  void invalidateRisk(const std::vector<Cell>& changed_cells);
 
   void getOpenNeighbors(const Cell& cell,
                         std::vector<CellDistancePair>& neighbors, bool is_3D);
   bool isNearWall(const Cell& cell);
 
   double getEdgeDist(const Cell& u, const Cell& v);
+  void setOccupied(const Cell& cell);
+  void setOccupied(const std::vector<Cell>& cells);
   double getSingleCellRisk(const Cell& cell);
+  double searchSingleCellRisk(const Cell& cell);
   double getAltPrior(const Cell& cell);
   bool isOccupied(const Cell& cell);
   bool isLegal(const Node& node);
   double getRisk(const Cell& cell);
   double getRisk(const Node& node);
   double getRiskOfCurve(const std::vector<geometry_msgs::PoseStamped>& msg);
-  double getTurnSmoothness(const Node& u, const Node& v);
-  double getEdgeCost(const Node& u, const Node& v);
+  // Templated on the node type as the rotation depends on it, instantiated
+  // for Node, NodeWithoutSmooth and SpeedNode in global_planner.cpp
+  template <typename NodeType>
+  double getTurnSmoothness(const NodeType& u, const NodeType& v);
+  template <typename NodeType>
+  double getEdgeCost(const NodeType& u, const NodeType& v);
+  template <typename NodeType>
+  double getEdgeCost(const NodeType& u, const NodeType& v, double risk_of_v);
 
   double riskHeuristic(const Cell& u, const Cell& goal);
-  double riskHeuristicReverseCache(const Cell& u, const Cell& goal);
   double smoothnessHeuristic(const Node& u, const Cell& goal);
   double altitudeHeuristic(const Cell& u, const Cell& goal);
   double getHeuristic(const Node& u, const Cell& goal);
@@ -140,11 +189,25 @@ class GlobalPlanner {
   nav_msgs::Path getPathMsg();
   nav_msgs::Path getPathMsg(const std::vector<Cell>& path);
   PathWithRiskMsg getPathWithRiskMsg();
+  PathWithRiskMsg getPathWithRiskMsg(const nav_msgs::Path& path_msg);
   PathInfo getPathInfo(const std::vector<Cell>& path);
 
-  NodePtr getStartNode(const Cell& start, const Cell& parent,
-                       const std::string& type);
   bool findPath(std::vector<Cell>& path);
+  bool findParallelPath(std::vector<Cell>& path, const Cell& s,
+                        const Cell& parent_of_s, const GoalCell& t,
+                        const SearchLimits& limits);
+  bool findCorridor(const Cell& s, const Cell& parent_of_s, const GoalCell& t,
+                    SearchLimits& limits);
+  std::unique_ptr<GlobalPlanner> makeSearchPlanner();
+  const GlobalPlanner& mapOwner() const {
+    return map_owner_ ? *map_owner_ : *this;
+  }
+  bool isSeenOccupied(const Cell& cell);
+  double corridorDistance(const Cell& cell);
+  double riskLowerBound(const Cell& cell);
+
+  size_t limitMemory();
+  MemoryUsageMsg getMemoryUsageMsg();
 
   bool getGlobalPath();
   void goBack();
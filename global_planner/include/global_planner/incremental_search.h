@@ -0,0 +1,268 @@
+#ifndef GLOBAL_PLANNER_INCREMENTAL_SEARCH_H_
+#define GLOBAL_PLANNER_INCREMENTAL_SEARCH_H_
+
+#include <math.h>  // INFINITY
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "global_planner/cell.h"
+#include "global_planner/cell_grid.h"
+#include "global_planner/node.h"
+#include "global_planner/search_tools.h"
+
+namespace global_planner {
+
+// D* Lite (the optimized version of Koenig and Likhachev) on the Cells, with
+// the edge costs of NodeWithoutSmooth. The search runs backwards from the
+// goal, so the graph stays valid when the start moves and only the Cells
+// around changed risks have to be repaired. The graph is kept until reset()
+// is called, e.g. because the goal or the cost parameters changed. The edge
+// costs come from the planner which is passed to findPath.
+template <typename GlobalPlanner>
+class IncrementalSearch {
+ public:
+  IncrementalSearch() : g_(INFINITY), rhs_(INFINITY) {}
+
+  // Forgets the search graph
+  void reset() {
+    g_.clear();
+    rhs_.clear();
+    open_ = OpenList();
+    changed_cells_.clear();
+    is_initialized_ = false;
+  }
+
+  // The risk of cell has changed, the edges touching it are repaired by the
+  // next call to findPath
+  void addChangedCell(const Cell& cell) {
+    if (is_initialized_) {
+      changed_cells_.push_back(cell);
+    }
+  }
+
+  size_t numChangedCells() const { return changed_cells_.size(); }
+  size_t memoryUsage() const {
+    return g_.memoryUsage() + rhs_.memoryUsage() +
+           open_.size() * sizeof(QueueEntry);
+  }
+
+  // Repairs the search for the start, fills path with [parent_of_start,
+  // start, ..., goal] iff a path was found within the limits. An interrupted
+  // search continues in the next call.
+  SearchInfo findPath(GlobalPlanner* global_planner, std::vector<Cell>& path,
+                      const Cell& start, const Cell& parent_of_start,
+                      const Cell& goal, const SearchLimits& limits) {
+    std::clock_t start_time = std::clock();
+    global_planner_ = global_planner;
+    if (!is_initialized_ || !(goal == goal_)) {
+      reset();
+      goal_ = goal;
+      last_start_ = start;
+      k_m_ = 0.0;
+      rhs_.set(goal_, 0.0);
+      open_.push(QueueEntry(calculateKey(goal_, start), goal_));
+      is_initialized_ = true;
+    }
+
+    // The keys of the queued Cells are relative to the start, instead of
+    // updating them the later keys are raised by how far the start moved
+    k_m_ += heuristic(last_start_, start);
+    last_start_ = start;
+    repairChangedCells(start);
+
+    int num_iter = 0;
+    bool is_complete = computeShortestPath(start, limits, num_iter);
+    double total_time = clocksToMicroSec(start_time, std::clock());
+    bool found_path = is_complete && !std::isinf(rhs_.get(start)) &&
+                      walkPath(path, start, parent_of_start);
+    return SearchInfo(found_path, num_iter, total_time);
+  }
+
+ private:
+  typedef std::pair<double, double> Key;
+
+  struct QueueEntry {
+    QueueEntry(const Key& key_, const Cell& cell_) : key(key_), cell(cell_) {}
+    Key key;
+    Cell cell;
+  };
+
+  struct CompareKey {
+    bool operator()(const QueueEntry& a, const QueueEntry& b) const {
+      return a.key > b.key;
+    }
+  };
+
+  // The open list has no decrease-key, outdated entries are skipped when they
+  // are popped
+  typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, CompareKey>
+      OpenList;
+
+  // A lower bound on the cost from a to b, consistent with getEdgeDist
+  double heuristic(const Cell& a, const Cell& b) const {
+    return global_planner_->getEdgeDist(a, b);
+  }
+
+  // The cost of going from u to its neighbor v
+  double cost(const Cell& u, const Cell& v) {
+    NodeWithoutSmooth v_node(v, u);
+    if (!global_planner_->isLegal(v_node)) {
+      return INFINITY;
+    }
+    return global_planner_->getEdgeCost(NodeWithoutSmooth(u, u), v_node);
+  }
+
+  Key calculateKey(const Cell& cell, const Cell& start) const {
+    double min_g = std::min(g_.get(cell), rhs_.get(cell));
+    return Key(min_g + heuristic(start, cell) + k_m_, min_g);
+  }
+
+  bool isConsistent(const Cell& cell) const {
+    return g_.get(cell) == rhs_.get(cell);
+  }
+
+  void updateVertex(const Cell& cell, const Cell& start) {
+    if (!isConsistent(cell)) {
+      open_.push(QueueEntry(calculateKey(cell, start), cell));
+    }
+  }
+
+  // Sets rhs to the cost through the best neighbor
+  void updateRhs(const Cell& cell, const Cell& start) {
+    if (cell == goal_) {
+      return;
+    }
+    double rhs = INFINITY;
+    for (const Cell& neighbor : cell.getNeighbors()) {
+      double g = g_.get(neighbor);
+      if (!std::isinf(g)) {
+        rhs = std::min(rhs, cost(cell, neighbor) + g);
+      }
+    }
+    rhs_.set(cell, rhs);
+    updateVertex(cell, start);
+  }
+
+  // The edges touching a changed Cell start in the Cell or in one of its
+  // neighbors, the changed Cells often share neighbors
+  void repairChangedCells(const Cell& start) {
+    std::vector<Cell> cells;
+    cells.reserve(11 * changed_cells_.size());
+    for (const Cell& changed : changed_cells_) {
+      cells.push_back(changed);
+      for (const Cell& neighbor : changed.getNeighbors()) {
+        cells.push_back(neighbor);
+      }
+    }
+    std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+      return a.key() < b.key();
+    });
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    for (const Cell& cell : cells) {
+      updateRhs(cell, start);
+    }
+    changed_cells_.clear();
+  }
+
+  // Removes the entries of Cells which are consistent by now
+  void popOutdated() {
+    while (!open_.empty() && isConsistent(open_.top().cell)) {
+      open_.pop();
+    }
+  }
+
+  // Returns false iff the limits were reached before the search was complete
+  bool computeShortestPath(const Cell& start, const SearchLimits& limits,
+                           int& num_iter) {
+    popOutdated();
+    while (!open_.empty() && (open_.top().key < calculateKey(start, start) ||
+                              rhs_.get(start) > g_.get(start))) {
+      if (num_iter >= limits.max_iterations ||
+          (num_iter % DEADLINE_CHECK_INTERVAL == 0 &&
+           limits.deadlinePassed())) {
+        return false;
+      }
+      QueueEntry entry = open_.top();
+      open_.pop();
+      const Cell& u = entry.cell;
+      Key new_key = calculateKey(u, start);
+      if (entry.key < new_key) {
+        open_.push(QueueEntry(new_key, u));
+      } else if (new_key < entry.key) {
+        // Outdated, u has also been queued with its current key
+      } else if (g_.get(u) > rhs_.get(u)) {
+        // Found a cheaper path from u to the goal
+        num_iter++;
+        double g_u = rhs_.get(u);
+        g_.set(u, g_u);
+        for (const Cell& pred : u.getNeighbors()) {
+          if (pred == goal_) {
+            continue;
+          }
+          double rhs = cost(pred, u) + g_u;
+          if (rhs < rhs_.get(pred)) {
+            rhs_.set(pred, rhs);
+            updateVertex(pred, start);
+          }
+        }
+      } else {
+        // The path from u got more expensive, its predecessors have to find
+        // their best neighbor again
+        num_iter++;
+        g_.set(u, INFINITY);
+        updateRhs(u, start);
+        for (const Cell& pred : u.getNeighbors()) {
+          updateRhs(pred, start);
+        }
+      }
+      popOutdated();
+    }
+    return true;
+  }
+
+  // Follows the best neighbors from start to the goal
+  bool walkPath(std::vector<Cell>& path, const Cell& start,
+                const Cell& parent_of_start) {
+    std::vector<Cell> new_path = {parent_of_start, start};
+    Cell u = start;
+    for (int steps = 0; !(u == goal_); ++steps) {
+      double best_cost = INFINITY;
+      Cell best_neighbor;
+      for (const Cell& neighbor : u.getNeighbors()) {
+        double g = g_.get(neighbor);
+        if (!std::isinf(g)) {
+          double neighbor_cost = cost(u, neighbor) + g;
+          if (neighbor_cost < best_cost) {
+            best_cost = neighbor_cost;
+            best_neighbor = neighbor;
+          }
+        }
+      }
+      if (std::isinf(best_cost) || steps > MAX_PATH_LENGTH) {
+        return false;
+      }
+      u = best_neighbor;
+      new_path.push_back(u);
+    }
+    path = new_path;
+    return true;
+  }
+
+  static const int MAX_PATH_LENGTH = 100000;  // Guards against loops
+
+  GlobalPlanner* global_planner_ = nullptr;  // Only used within findPath
+  CellGrid<double> g_;    // The cost from the Cell to the goal
+  CellGrid<double> rhs_;  // The cost through the best neighbor of the Cell
+  OpenList open_;
+  std::vector<Cell> changed_cells_;
+  Cell goal_;
+  Cell last_start_;
+  double k_m_ = 0.0;
+  bool is_initialized_ = false;
+};
+
+}  // namespace global_planner
+
+#endif /* GLOBAL_PLANNER_INCREMENTAL_SEARCH_H_ */
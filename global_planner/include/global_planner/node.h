@@ -2,51 +2,59 @@
 #define GLOBAL_PLANNER_NODE
 
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 #include "global_planner/cell.h"
 #include "global_planner/common.h"
 
 namespace global_planner {
 
+// The nodes are plain values, the search is templated on the node type so that
+// none of the functions below are virtual. A derived node type hides the
+// functions it changes.
 class Node {
  public:
   Node() = default;
   Node(const Cell& cell, const Cell& parent) : cell_(cell), parent_(parent) {}
-  virtual ~Node() = default;
-
-  virtual bool isEqual(const Node& other) const;
-  virtual bool isSmaller(const Node& other) const;
-  virtual std::size_t hash() const;
-  virtual std::shared_ptr<Node> nextNode(const Cell& nextCell) const;
-  virtual std::vector<std::shared_ptr<Node> > getNeighbors() const;
-  virtual std::unordered_set<Cell> getCells() const;
-
-  virtual double getLength() const;
-  virtual double getRotation(const Node& other) const;
-  virtual double getXYRotation(const Node& other) const;
+
+  bool isEqual(const Node& other) const;
+  bool isSmaller(const Node& other) const;
+  std::size_t hash() const;
+
+  // Fills cells with the Cells on the edge from parent_ to cell_, each Cell
+  // only once. Reusing cells avoids allocating for every edge.
+  void getCells(std::vector<Cell>& cells) const;
+
+  double getLength() const;
+  double getRotation(const Node& other) const;
+  double getXYRotation(const Node& other) const;
   std::string asString() const;
 
   Cell cell_;
   Cell parent_;
 };
 
-bool operator==(const Node& lhs, const Node& rhs) { return lhs.isEqual(rhs); }
-bool operator<(const Node& lhs, const Node& rhs) { return lhs.isSmaller(rhs); }
-bool operator!=(const Node& lhs, const Node& rhs) {
+inline bool operator==(const Node& lhs, const Node& rhs) {
+  return lhs.isEqual(rhs);
+}
+inline bool operator<(const Node& lhs, const Node& rhs) {
+  return lhs.isSmaller(rhs);
+}
+inline bool operator!=(const Node& lhs, const Node& rhs) {
   return !operator==(lhs, rhs);
 }
-bool operator>(const Node& lhs, const Node& rhs) { return operator<(rhs, lhs); }
-bool operator<=(const Node& lhs, const Node& rhs) {
+inline bool operator>(const Node& lhs, const Node& rhs) {
+  return operator<(rhs, lhs);
+}
+inline bool operator<=(const Node& lhs, const Node& rhs) {
   return !operator>(lhs, rhs);
 }
-bool operator>=(const Node& lhs, const Node& rhs) {
+inline bool operator>=(const Node& lhs, const Node& rhs) {
   return !operator<(lhs, rhs);
 }
 
-typedef std::shared_ptr<Node> NodePtr;
 typedef std::pair<Node, double> NodeDistancePair;
-typedef std::pair<NodePtr, double> PointerNodeDistancePair;
+typedef std::pair<int, double> IndexDistancePair;
 
 class CompareDist {
  public:
@@ -56,8 +64,7 @@ class CompareDist {
   bool operator()(const NodeDistancePair& n1, const NodeDistancePair& n2) {
     return n1.second > n2.second;
   }
-  bool operator()(const PointerNodeDistancePair& n1,
-                  const PointerNodeDistancePair& n2) {
+  bool operator()(const IndexDistancePair& n1, const IndexDistancePair& n2) {
     return n1.second > n2.second;
   }
 };
@@ -74,14 +81,15 @@ class NodeWithoutSmooth : public Node {
 
   std::size_t hash() const { return std::hash<global_planner::Cell>()(cell_); }
 
-  NodePtr nextNode(const Cell& nextCell) const {
-    return NodePtr(new NodeWithoutSmooth(nextCell, cell_));
-  }
-
   double getRotation(const Node& other) const { return 0.0; }
 };
 
-double SPEEDNODE_RADIUS = 5.0;
+inline bool operator==(const NodeWithoutSmooth& lhs,
+                       const NodeWithoutSmooth& rhs) {
+  return lhs.isEqual(rhs);
+}
+
+extern double SPEEDNODE_RADIUS;  // Defined in node.cpp
 // Node represents 3D position, orientation and speed
 // TODO: Needs to check the risk of Cells between cell and parent
 class SpeedNode : public Node {
@@ -89,37 +97,20 @@ class SpeedNode : public Node {
   SpeedNode() = default;
   SpeedNode(const Cell& cell, const Cell& parent) : Node(cell, parent) {}
   ~SpeedNode() = default;
-
-  NodePtr nextNode(const Cell& nextCell) const {
-    return NodePtr(new SpeedNode(nextCell, cell_));
-  }
-
-  std::vector<NodePtr> getNeighbors() const {
-    std::vector<NodePtr> neighbors;
-    Cell extrapolate_cell = (cell_ - parent_) + cell_;
-    neighbors.push_back(nextNode(extrapolate_cell));
-    for (const Cell& neighborCell : extrapolate_cell.getNeighbors()) {
-      double dist = cell_.distance3D(neighborCell);
-      if (dist > 0 && dist < SPEEDNODE_RADIUS) {
-        neighbors.push_back(nextNode(neighborCell));
-      }
-    }
-    return neighbors;
-  }
 };
 
-struct HashNodePtr {
-  std::size_t operator()(const std::shared_ptr<Node>& node_ptr) const {
-    return node_ptr->hash();
+// Fills neighbors with the nodes that can follow node. The capacity of
+// neighbors is kept, so the search can reuse it for every node.
+template <typename NodeType>
+void getNeighbors(const NodeType& node, std::vector<NodeType>& neighbors) {
+  neighbors.clear();
+  for (const Cell& neighbor_cell : node.cell_.getNeighbors()) {
+    neighbors.push_back(NodeType(neighbor_cell, node.cell_));
   }
-};
+}
 
-struct EqualsNodePtr {
-  std::size_t operator()(const std::shared_ptr<Node>& node_ptr1,
-                         const std::shared_ptr<Node>& node_ptr2) const {
-    return node_ptr1->isEqual(*node_ptr2);
-  }
-};
+// A SpeedNode keeps going in the same direction, or close to it
+void getNeighbors(const SpeedNode& node, std::vector<SpeedNode>& neighbors);
 
 }  // namespace global_planner
 
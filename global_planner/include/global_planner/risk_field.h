@@ -0,0 +1,237 @@
+#ifndef GLOBAL_PLANNER_RISK_FIELD_H_
+#define GLOBAL_PLANNER_RISK_FIELD_H_
+
+#include <math.h>  // INFINITY
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "global_planner/cell.h"
+#include "global_planner/cell_grid.h"
+#include "global_planner/node.h"
+#include "global_planner/search_tools.h"
+
+namespace global_planner {
+
+// The lowest cost of risk from the Cells to the goal, found by a Dijkstra
+// search backwards from the goal over the edges of NodeWithoutSmooth. Only the
+// risk is part of the edge costs, so the field is a consistent lower bound on
+// the risk of the paths of the forward search (for edges between neighboring
+// Cells). The field grows in every call to expand and is kept while the goal
+// stays the same, the Cells around changed risks are repaired as in D* Lite.
+template <typename GlobalPlanner>
+class RiskField {
+ public:
+  RiskField() : g_(INFINITY), rhs_(INFINITY) {}
+
+  // Forgets the field
+  void reset() {
+    g_.clear();
+    rhs_.clear();
+    open_ = OpenList();
+    changed_cells_.clear();
+    frontier_cost_ = 0.0;
+    is_initialized_ = false;
+  }
+
+  // The risk of cell has changed, the field around it is repaired by the next
+  // call to expand
+  void addChangedCell(const Cell& cell) {
+    if (is_initialized_) {
+      changed_cells_.push_back(cell);
+    }
+  }
+
+  bool hasGoal(const Cell& goal) const {
+    return is_initialized_ && goal == goal_;
+  }
+
+  // Repairs the field and settles more Cells until the limits are reached,
+  // starts over if the goal has changed. Returns the number of settled Cells.
+  int expand(GlobalPlanner* global_planner, const GoalCell& goal,
+             const SearchLimits& limits) {
+    global_planner_ = global_planner;
+    if (!hasGoal(goal) || goal.radius_ != goal_.radius_) {
+      reset();
+      goal_ = goal;
+      rhs_.set(goal_, 0.0);
+      open_.push(QueueEntry(0.0, goal_));
+      is_initialized_ = true;
+    }
+    repairChangedCells();
+
+    int num_iter = 0;
+    popOutdated();
+    while (!open_.empty() && num_iter < limits.max_iterations) {
+      if (num_iter % DEADLINE_CHECK_INTERVAL == 0 && limits.deadlinePassed()) {
+        break;
+      }
+      QueueEntry entry = open_.top();
+      open_.pop();
+      const Cell& u = entry.cell;
+      double key = calculateKey(u);
+      if (entry.key < key) {
+        open_.push(QueueEntry(key, u));
+      } else if (key < entry.key) {
+        // Outdated, u has also been queued with its current key
+      } else if (g_.get(u) > rhs_.get(u)) {
+        num_iter++;
+        double g_u = rhs_.get(u);
+        g_.set(u, g_u);
+        for (const Cell& pred : u.getNeighbors()) {
+          double rhs = isGoal(pred) ? 0.0 : cost(pred, u) + g_u;
+          if (rhs < rhs_.get(pred)) {
+            rhs_.set(pred, rhs);
+            updateVertex(pred);
+          }
+        }
+      } else {
+        // The risk to the goal has increased, the predecessors have to find
+        // their best neighbor again
+        num_iter++;
+        g_.set(u, INFINITY);
+        updateRhs(u);
+        for (const Cell& pred : u.getNeighbors()) {
+          updateRhs(pred);
+        }
+      }
+      popOutdated();
+    }
+    // The queue may hold entries with outdated low keys, which only makes the
+    // bound lower
+    frontier_cost_ = open_.empty() ? INFINITY : open_.top().key;
+    return num_iter;
+  }
+
+  // Returns the risk from cell to the goal if cell is settled, otherwise the
+  // risk of the next Cell to settle, which is a lower bound
+  double lowerBound(const Cell& cell) const {
+    double g = g_.get(cell);
+    if (g <= frontier_cost_ && g == rhs_.get(cell)) {
+      return g;
+    }
+    return frontier_cost_;
+  }
+
+  // The blocks last looked up by lowerBound, for threads which read the field
+  // at the same time
+  struct Cursors {
+    typename CellGrid<double>::Cursor g;
+    typename CellGrid<double>::Cursor rhs;
+  };
+
+  // Like lowerBound, but only reads the field
+  double lowerBound(const Cell& cell, Cursors& cursors) const {
+    double g = g_.get(cell, cursors.g);
+    if (g <= frontier_cost_ && g == rhs_.get(cell, cursors.rhs)) {
+      return g;
+    }
+    return frontier_cost_;
+  }
+
+  size_t memoryUsage() const {
+    return g_.memoryUsage() + rhs_.memoryUsage() +
+           open_.size() * sizeof(QueueEntry);
+  }
+
+ private:
+  struct QueueEntry {
+    QueueEntry(double key_, const Cell& cell_) : key(key_), cell(cell_) {}
+    double key;
+    Cell cell;
+  };
+
+  struct CompareKey {
+    bool operator()(const QueueEntry& a, const QueueEntry& b) const {
+      return a.key > b.key;
+    }
+  };
+
+  typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, CompareKey>
+      OpenList;
+
+  // The cost of risk of going from u to its neighbor v
+  double cost(const Cell& u, const Cell& v) {
+    NodeWithoutSmooth v_node(v, u);
+    if (!global_planner_->isLegal(v_node)) {
+      return INFINITY;
+    }
+    return global_planner_->risk_factor_ * global_planner_->getRisk(v_node);
+  }
+
+  // The forward search stops within the plan radius of the goal
+  bool isGoal(const Cell& cell) const {
+    return cell == goal_ || goal_.withinPlanRadius(cell);
+  }
+
+  double calculateKey(const Cell& cell) const {
+    return std::min(g_.get(cell), rhs_.get(cell));
+  }
+
+  bool isConsistent(const Cell& cell) const {
+    return g_.get(cell) == rhs_.get(cell);
+  }
+
+  void updateVertex(const Cell& cell) {
+    if (!isConsistent(cell)) {
+      open_.push(QueueEntry(calculateKey(cell), cell));
+    }
+  }
+
+  // Sets rhs to the risk through the best neighbor
+  void updateRhs(const Cell& cell) {
+    if (isGoal(cell)) {
+      return;
+    }
+    double rhs = INFINITY;
+    for (const Cell& neighbor : cell.getNeighbors()) {
+      double g = g_.get(neighbor);
+      if (!std::isinf(g)) {
+        rhs = std::min(rhs, cost(cell, neighbor) + g);
+      }
+    }
+    rhs_.set(cell, rhs);
+    updateVertex(cell);
+  }
+
+  // The edges whose risk depends on a changed Cell start in the Cell or in
+  // one of its neighbors
+  void repairChangedCells() {
+    std::vector<Cell> cells;
+    cells.reserve(11 * changed_cells_.size());
+    for (const Cell& changed : changed_cells_) {
+      cells.push_back(changed);
+      for (const Cell& neighbor : changed.getNeighbors()) {
+        cells.push_back(neighbor);
+      }
+    }
+    std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+      return a.key() < b.key();
+    });
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    for (const Cell& cell : cells) {
+      updateRhs(cell);
+    }
+    changed_cells_.clear();
+  }
+
+  // Removes the entries of Cells which are consistent by now
+  void popOutdated() {
+    while (!open_.empty() && isConsistent(open_.top().cell)) {
+      open_.pop();
+    }
+  }
+
+  GlobalPlanner* global_planner_ = nullptr;  // Only used within expand
+  CellGrid<double> g_;    // The risk from the Cell to the goal
+  CellGrid<double> rhs_;  // The risk through the best neighbor of the Cell
+  OpenList open_;
+  std::vector<Cell> changed_cells_;
+  GoalCell goal_ = GoalCell(Cell());
+  double frontier_cost_ = 0.0;  // No Cell is settled before the first expand
+  bool is_initialized_ = false;
+};
+
+}  // namespace global_planner
+
+#endif /* GLOBAL_PLANNER_RISK_FIELD_H_ */
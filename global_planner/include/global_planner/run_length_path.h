@@ -0,0 +1,102 @@
+#ifndef GLOBAL_PLANNER_RUN_LENGTH_PATH_H_
+#define GLOBAL_PLANNER_RUN_LENGTH_PATH_H_
+
+#include <stdint.h>
+#include <algorithm>  // std::min
+#include <limits>
+#include <vector>
+
+#include "global_planner/cell.h"
+
+namespace global_planner {
+
+// A sequence of Cells of level 0 stored as the first Cell and runs of equal
+// steps, e.g. the Cells which the vehicle has flown through. A straight flight
+// is a single run, and every run takes 8 bytes instead of the 16 of a Cell.
+// The steps between consecutive Cells have to be below 2^15 Cells.
+class RunLengthPath {
+ public:
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t numRuns() const { return runs_.size(); }
+  size_t memoryUsage() const { return runs_.capacity() * sizeof(Run); }
+  const Cell& back() const { return back_; }
+
+  void clear() {
+    runs_.clear();
+    size_ = 0;
+  }
+
+  void push_back(const Cell& cell) {
+    if (size_ == 0) {
+      front_ = cell;
+      back_ = cell;
+      size_ = 1;
+      return;
+    }
+    Run step = {static_cast<int16_t>(cell.xIndex() - back_.xIndex()),
+                static_cast<int16_t>(cell.yIndex() - back_.yIndex()),
+                static_cast<int16_t>(cell.zIndex() - back_.zIndex()), 1};
+    if (!runs_.empty() && runs_.back().hasStep(step) &&
+        runs_.back().count < std::numeric_limits<uint16_t>::max()) {
+      runs_.back().count++;
+    } else {
+      runs_.push_back(step);
+    }
+    back_ = cell;
+    size_++;
+  }
+
+  // Keeps the first new_size Cells, new_size must not be larger than size()
+  void resize(size_t new_size) {
+    if (new_size == 0) {
+      clear();
+      return;
+    }
+    while (size_ > new_size) {
+      Run& run = runs_.back();
+      int num_removed = std::min<size_t>(run.count, size_ - new_size);
+      back_ = back_.offset(-run.dx * num_removed, -run.dy * num_removed,
+                           -run.dz * num_removed);
+      run.count -= num_removed;
+      size_ -= num_removed;
+      if (run.count == 0) {
+        runs_.pop_back();
+      }
+    }
+  }
+
+  // Fills cells with all Cells of the path
+  void getCells(std::vector<Cell>& cells) const {
+    cells.clear();
+    if (size_ == 0) {
+      return;
+    }
+    cells.reserve(size_);
+    cells.push_back(front_);
+    for (const Run& run : runs_) {
+      for (int i = 0; i < run.count; ++i) {
+        cells.push_back(cells.back().offset(run.dx, run.dy, run.dz));
+      }
+    }
+  }
+
+ private:
+  struct Run {
+    int16_t dx, dy, dz;
+    uint16_t count;
+
+    bool hasStep(const Run& other) const {
+      return dx == other.dx && dy == other.dy && dz == other.dz;
+    }
+  };
+
+  std::vector<Run> runs_;
+  Cell front_;
+  Cell back_;
+  size_t size_ = 0;
+};
+
+}  // namespace global_planner
+
+#endif /* GLOBAL_PLANNER_RUN_LENGTH_PATH_H_ */
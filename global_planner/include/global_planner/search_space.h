@@ -0,0 +1,97 @@
+#ifndef GLOBAL_PLANNER_SEARCH_SPACE_H_
+#define GLOBAL_PLANNER_SEARCH_SPACE_H_
+
+#include <math.h>  // INFINITY
+#include <stdint.h>
+#include <algorithm>  // std::fill
+#include <vector>
+
+namespace global_planner {
+
+// The nodes seen by a search together with their distance, parent and whether
+// they are closed. The entries are stored by value in an arena and found
+// through a single open addressing table (linear probing, at most half full),
+// so a search only allocates when the arena or the table grows.
+template <typename NodeType>
+class SearchSpace {
+ public:
+  struct Entry {
+    NodeType node;
+    double distance;
+    int parent;  // Index of the parent entry, -1 if there is none
+    bool closed;
+  };
+
+  explicit SearchSpace(size_t capacity = 1024) { reserve(capacity); }
+
+  // Makes room for capacity entries without further allocation
+  void reserve(size_t capacity) {
+    entries_.reserve(capacity);
+    if (2 * capacity > table_.size()) {
+      rehash(2 * capacity);
+    }
+  }
+
+  // Removes all entries, but keeps the memory
+  void clear() {
+    entries_.clear();
+    std::fill(table_.begin(), table_.end(), -1);
+  }
+
+  // Returns the index of the entry of node, adds an open entry with infinite
+  // distance if node has not been seen. Indices stay valid, references to
+  // entries do not.
+  int findOrInsert(const NodeType& node) {
+    if (2 * (entries_.size() + 1) > table_.size()) {
+      rehash(2 * table_.size());
+    }
+    size_t i = slot(node.hash());
+    while (table_[i] >= 0) {
+      if (entries_[table_[i]].node.isEqual(node)) {
+        return table_[i];
+      }
+      i = (i + 1) & (table_.size() - 1);
+    }
+    table_[i] = entries_.size();
+    entries_.push_back(Entry{node, INFINITY, -1, false});
+    return table_[i];
+  }
+
+  Entry& operator[](int index) { return entries_[index]; }
+  const Entry& operator[](int index) const { return entries_[index]; }
+  size_t size() const { return entries_.size(); }
+
+ private:
+  // The node hashes are not mixed well in the low bits, so the slot is taken
+  // from the high bits of a multiplicative (Fibonacci) hash
+  size_t slot(size_t hash) const {
+    return (static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift_;
+  }
+
+  // Grows the table to a power of two of at least min_size and reinserts all
+  // entries
+  void rehash(size_t min_size) {
+    size_t size = 16;
+    shift_ = 60;
+    while (size < min_size) {
+      size *= 2;
+      shift_--;
+    }
+    table_.assign(size, -1);
+    for (int index = 0; index < entries_.size(); ++index) {
+      size_t i = slot(entries_[index].node.hash());
+      while (table_[i] >= 0) {
+        i = (i + 1) & (size - 1);
+      }
+      table_[i] = index;
+    }
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<int> table_;
+  int shift_ = 60;
+};
+
+}  // namespace global_planner
+
+#endif /* GLOBAL_PLANNER_SEARCH_SPACE_H_ */
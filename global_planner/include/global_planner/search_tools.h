@@ -1,11 +1,17 @@
 #ifndef GLOBAL_PLANNER_SEARCH_TOOLS_H_
 #define GLOBAL_PLANNER_SEARCH_TOOLS_H_
 
+#include <math.h>     // INFINITY
+#include <algorithm>  // std::push_heap, std::pop_heap
+#include <atomic>
+#include <chrono>
+#include <sstream>
 #include <string>
 
 #include "global_planner/bezier.h"
 #include "global_planner/cell.h"
 #include "global_planner/node.h"
+#include "global_planner/search_space.h"
 #include "global_planner/visitor.h"
 
 // This file consists of general search tools
@@ -31,207 +37,521 @@ struct SearchInfo {
   double search_time;  // in micro seconds
 };
 
-void printSearchInfo(SearchInfo info, std::string node_type = "Node",
-                     double overestimate_factor = 1.0) {
-  double avg_time = info.search_time / info.num_iter;
-  std::cout << std::setw(20) << std::left << node_type << std::setw(10)
+// Shared by searches which run in parallel: the cost (getPathInfo) of the
+// best path any of them has found, and whether they should all stop
+struct SearchIncumbent {
+  std::atomic<double> cost{INFINITY};
+  std::atomic<bool> is_cancelled{false};
+
+  // Lowers the cost if new_cost is cheaper
+  void offer(double new_cost) {
+    double curr_cost = cost.load();
+    while (new_cost < curr_cost &&
+           !cost.compare_exchange_weak(curr_cost, new_cost)) {
+    }
+  }
+};
+
+// The budget of a search, a number of iterations and a wall-clock deadline
+struct SearchLimits {
+  typedef std::chrono::steady_clock Clock;
+
+  explicit SearchLimits(int max_iterations_,
+                        Clock::time_point deadline_ = Clock::time_point::max())
+      : max_iterations(max_iterations_), deadline(deadline_) {}
+
+  // Limits with a deadline seconds from now, no deadline if seconds <= 0
+  static SearchLimits fromNow(int max_iterations, double seconds) {
+    if (seconds <= 0.0) {
+      return SearchLimits(max_iterations);
+    }
+    auto duration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+    return SearchLimits(max_iterations, Clock::now() + duration);
+  }
+
+  bool deadlinePassed() const { return Clock::now() >= deadline; }
+
+  bool shouldStop() const {
+    return deadlinePassed() || (incumbent && incumbent->is_cancelled);
+  }
+
+  // Nodes which cost at least this much can not lead to a better path
+  double costBound() const {
+    return incumbent ? incumbent->cost.load(std::memory_order_relaxed)
+                     : INFINITY;
+  }
+
+  int max_iterations;
+  Clock::time_point deadline;
+  SearchIncumbent* incumbent = nullptr;  // Set if searches run in parallel
+};
+
+// Reading the clock is cheap, but not free, so the searches only check the
+// deadline every DEADLINE_CHECK_INTERVAL iterations
+const int DEADLINE_CHECK_INTERVAL = 16;
+
+inline void printSearchInfo(SearchInfo info, std::string node_type = "Node",
+                            double overestimate_factor = 1.0,
+                            std::ostream& out = std::cout) {
+  // A repairing search may not need any iterations
+  double avg_time = info.num_iter > 0 ? info.search_time / info.num_iter : 0.0;
+  out << std::setw(20) << std::left << node_type << std::setw(10)
             << std::setprecision(3) << avg_time << std::setw(10)
             << std::setprecision(3) << overestimate_factor << std::setw(10)
             << info.num_iter << std::setw(10) << 0.0;
 }
 
-// Returns a path where corners are smoothed with quadratic Bezier-curves
-nav_msgs::Path smoothPath(const nav_msgs::Path& path) {
+// Writes the path with its corners smoothed by quadratic Bezier-curves of
+// num_steps + 1 points to smooth_path. The poses of smooth_path are resized and
+// overwritten, so the message of a previous path is reused without allocating.
+inline void smoothPath(const nav_msgs::Path& path, nav_msgs::Path& smooth_path,
+                       int num_steps = 10) {
+  smooth_path.header = path.header;
   if (path.poses.size() < 3) {
-    return path;
+    smooth_path.poses = path.poses;
+    return;
   }
 
-  nav_msgs::Path smooth_path;
-  smooth_path.header = path.header;
-
   // Repeat the first and last points to get the first half of the first edge
   // and the second half of the last edge
-  smooth_path.poses.push_back((path.poses.front()));
-  for (int i = 2; i < path.poses.size(); i++) {
-    geometry_msgs::Point p0 = path.poses[i - 2].pose.position;
-    geometry_msgs::Point p1 = path.poses[i - 1].pose.position;
-    geometry_msgs::Point p2 = path.poses[i].pose.position;
-    p0 = middlePoint(p0, p1);
-    p2 = middlePoint(p1, p2);
-
-    std::vector<geometry_msgs::Point> smooth_turn =
-        threePointBezier(p0, p1, p2);
-    for (const auto& point : smooth_turn) {
-      geometry_msgs::PoseStamped pose_msg =
-          path.poses.front();  // Copy the original header info
-      pose_msg.pose.position = point;
-      smooth_path.poses.push_back(pose_msg);
+  const geometry_msgs::PoseStamped& front = path.poses.front();
+  smooth_path.poses.resize((path.poses.size() - 2) * (num_steps + 1) + 2);
+  smooth_path.poses.front() = front;
+  size_t j = 1;
+  for (size_t i = 2; i < path.poses.size(); i++) {
+    const geometry_msgs::Point& p1 = path.poses[i - 1].pose.position;
+    geometry_msgs::Point p0 = middlePoint(path.poses[i - 2].pose.position, p1);
+    geometry_msgs::Point p2 = middlePoint(p1, path.poses[i].pose.position);
+    for (int k = 0; k <= num_steps; ++k) {
+      geometry_msgs::PoseStamped& pose_msg = smooth_path.poses[j++];
+      // Copy the original header info
+      pose_msg.header = front.header;
+      pose_msg.pose.orientation = front.pose.orientation;
+      pose_msg.pose.position =
+          quadraticBezierPoint(p0, p1, p2, static_cast<double>(k) / num_steps);
     }
   }
-  smooth_path.poses.push_back((path.poses.back()));
+  smooth_path.poses.back() = path.poses.back();
+}
+
+// Returns a path where corners are smoothed with quadratic Bezier-curves
+inline nav_msgs::Path smoothPath(const nav_msgs::Path& path) {
+  nav_msgs::Path smooth_path;
+  smoothPath(path, smooth_path);
   return smooth_path;
 }
 
-// Returns a simpler path without increasing the cost much. It iteratively
-// removes the vertices which can be removed without increasing the cost by more
-// than simplify_margin
+// Keeps path[last] and the vertices between path[first] and path[last] which
+// are needed to not increase the cost by more than simplify_margin. If the
+// edge from path[first] to path[last] costs too much, the range is split in
+// the middle. The kept vertices are written to path[num_kept], at most at the
+// index of the vertex, so the vertices which are still to be read don't
+// change. accumulated_cost holds the cost of the path up to each vertex and
+// parent is the kept vertex before path[first].
+template <typename GlobalPlanner>
+void simplifyPathBetween(GlobalPlanner* global_planner, std::vector<Cell>& path,
+                         const std::vector<double>& accumulated_cost,
+                         double simplify_margin, size_t first, size_t last,
+                         Cell& parent, size_t& num_kept) {
+  const Cell anchor = path[first];
+  if (last > first + 1) {
+    double replaced_cost = accumulated_cost[last] - accumulated_cost[first];
+    double new_cost = global_planner->getEdgeCost(Node(anchor, parent),
+                                                  Node(path[last], anchor));
+    if (new_cost > simplify_margin * replaced_cost) {
+      size_t middle = (first + last) / 2;
+      simplifyPathBetween(global_planner, path, accumulated_cost,
+                          simplify_margin, first, middle, parent, num_kept);
+      simplifyPathBetween(global_planner, path, accumulated_cost,
+                          simplify_margin, middle, last, parent, num_kept);
+      return;
+    }
+  }
+  parent = anchor;
+  path[num_kept++] = path[last];
+}
+
+// Simplifies the path in place without increasing the cost much. Like the
+// Douglas-Peucker algorithm, it replaces a part of the path by one edge if the
+// edge costs at most simplify_margin times the edges it replaces, and splits
+// the part otherwise. The cost of every edge of the path is computed once.
 template <typename GlobalPlanner>
-std::vector<Cell> simplifyPath(GlobalPlanner* global_planner,
-                               std::vector<Cell>& path,
-                               double simplify_margin = 1.01,
-                               double max_iter = 100,
-                               bool decelerate_at_end = true) {
+void simplifyPath(GlobalPlanner* global_planner, std::vector<Cell>& path,
+                  double simplify_margin = 1.01,
+                  bool decelerate_at_end = true) {
   if (path.size() < 3) {
     // Can not simplify a trivial path
-    return path;
+    return;
   }
 
-  // Start with the original path
-  std::vector<Cell> curr_path = path;
-  for (int j = 0; j < max_iter; ++j) {
-    // The first two vertices cannot be removed
-    std::vector<Cell> simple_path{curr_path[0], curr_path[1]};
-    int i = 3;
-    for (; i < curr_path.size(); i += 2) {
-      Node parent(curr_path[i - 2], curr_path[i - 3]);
-      Node u(curr_path[i - 1], curr_path[i - 2]);
-      Node v(curr_path[i], curr_path[i - 1]);
-      Node w(curr_path[i], curr_path[i - 2]);
-      // w is the new edge instead of u and v
-      double curr_cost = global_planner->getEdgeCost(parent, u) +
-                         global_planner->getEdgeCost(u, v);
-      double new_cost = global_planner->getEdgeCost(parent, w);
-      if (new_cost > simplify_margin * curr_cost) {
-        // The cost of w is too high, can't simplify this part of the path
-        simple_path.push_back(curr_path[i - 1]);
-      }
-      simple_path.push_back(curr_path[i]);
-    }
-
-    // Make sure to add the last vertex
-    if (i == curr_path.size()) {
-      simple_path.push_back(curr_path[i - 1]);
-    }
-
-    if (simple_path.size() == curr_path.size()) {
-      // Last iteration didn't remove any vertices, can't simplify more
-      break;
-    }
-    curr_path = simple_path;
+  std::vector<double>& accumulated_cost = global_planner->path_cost_;
+  accumulated_cost.resize(path.size());
+  accumulated_cost[1] = 0.0;
+  for (size_t i = 2; i < path.size(); ++i) {
+    accumulated_cost[i] =
+        accumulated_cost[i - 1] +
+        global_planner->getEdgeCost(Node(path[i - 1], path[i - 2]),
+                                    Node(path[i], path[i - 1]));
   }
 
+  // The first two vertices cannot be removed
+  Cell parent = path[0];
+  size_t num_kept = 2;
+  simplifyPathBetween(global_planner, path, accumulated_cost, simplify_margin,
+                      1, path.size() - 1, parent, num_kept);
+  path.resize(num_kept);
+
   if (decelerate_at_end) {
     // Doubling the last point gives a triplet which stops at the end
-    curr_path.push_back(curr_path.back());
+    path.push_back(path.back());
   }
-  return curr_path;
 }
 
-template <typename GlobalPlanner>
+template <typename GlobalPlanner, typename NodeType>
 SearchInfo findSmoothPath(GlobalPlanner* global_planner,
-                          std::vector<Cell>& path, const NodePtr& s,
+                          std::vector<Cell>& path, const NodeType& s,
                           const GoalCell& t, int max_iterations = 2000) {
   NullVisitor visitor;
   return findSmoothPath(global_planner, path, s, t, max_iterations, visitor);
 }
 
 // A* to find a path from start to t, true iff it found a path
-template <typename GlobalPlanner, typename Visitor>
+// The nodes are stored by value in a SearchSpace and the neighbors are written
+// into a reused buffer, so there are no allocations per expanded node
+template <typename GlobalPlanner, typename NodeType, typename Visitor>
 SearchInfo findSmoothPath(GlobalPlanner* global_planner,
-                          std::vector<Cell>& path, const NodePtr& s,
+                          std::vector<Cell>& path, const NodeType& s,
                           const GoalCell& t, int max_iterations,
                           Visitor& visitor) {
   // Initialize containers
-  NodePtr best_goal_node;
+  int best_goal_index = -1;
   visitor.init();
-
-  std::unordered_set<NodePtr, HashNodePtr, EqualsNodePtr> seen_nodes;
-  std::unordered_map<NodePtr, NodePtr, HashNodePtr, EqualsNodePtr> parent;
-  std::unordered_map<NodePtr, double, HashNodePtr, EqualsNodePtr> distance;
-  std::priority_queue<PointerNodeDistancePair,
-                      std::vector<PointerNodeDistancePair>, CompareDist>
-      pq;
-  pq.push(std::make_pair(s, 0.0));
-  distance[s] = 0.0;
+  visitor.startPhase(global_planner->overestimate_factor_);
+
+  // Every expanded node adds at most 10 neighbors, most are seen before
+  SearchSpace<NodeType> space(4 * max_iterations);
+  std::vector<NodeType> neighbors;
+  neighbors.reserve(10);
+  std::vector<IndexDistancePair> pq_storage;
+  pq_storage.reserve(4 * max_iterations);
+  std::priority_queue<IndexDistancePair, std::vector<IndexDistancePair>,
+                      CompareDist>
+      pq(CompareDist(), std::move(pq_storage));
+  int s_index = space.findOrInsert(s);
+  space[s_index].distance = 0.0;
+  pq.push(std::make_pair(s_index, 0.0));
   int num_iter = 0;
 
   std::clock_t start_time = std::clock();
   while (!pq.empty() && num_iter < max_iterations) {
-    PointerNodeDistancePair u_node_dist = pq.top();
+    int u_index = pq.top().first;
     pq.pop();
-    NodePtr u = u_node_dist.first;
-    if (seen_nodes.find(u) != seen_nodes.end()) {
+    if (space[u_index].closed) {
       continue;
     }
-    seen_nodes.insert(u);
+    space[u_index].closed = true;
+    // Copied, as inserting the neighbors may move the entries
+    const NodeType u = space[u_index].node;
+    const double u_dist = space[u_index].distance;
     visitor.popNode(u);
 
-    if (t.withinPlanRadius(u->cell_)) {
-      best_goal_node = u;
+    if (t.withinPlanRadius(u.cell_)) {
+      best_goal_index = u_index;
       break;  // Found a path
     }
     num_iter++;
 
-    for (const NodePtr& v : u->getNeighbors()) {
-      if (!global_planner->isLegal(*v)) {
+    getNeighbors(u, neighbors);
+    for (const NodeType& v : neighbors) {
+      if (!global_planner->isLegal(v)) {
         continue;
       }
-      double new_dist = distance[u] + global_planner->getEdgeCost(*u, *v);
-      double old_dist = getWithDefault(distance, v, INFINITY);
-      if (new_dist < old_dist) {
+      double new_dist = u_dist + global_planner->getEdgeCost(u, v);
+      int v_index = space.findOrInsert(v);
+      if (new_dist < space[v_index].distance) {
         // Found a better path to v, have to add v to the queue
-        parent[v] = u;
-        distance[v] = new_dist;
+        space[v_index].node = v;
+        space[v_index].parent = u_index;
+        space[v_index].distance = new_dist;
         // TODO: try Dynamic Weighting instead of a constant overestimate_factor
         double overestimated_heuristic =
-            new_dist + global_planner->getHeuristic(*v, t);
-        pq.push(PointerNodeDistancePair(v, overestimated_heuristic));
+            new_dist + global_planner->getHeuristic(v, t);
+        pq.push(IndexDistancePair(v_index, overestimated_heuristic));
         visitor.perNeighbor(u, v);
       }
     }
+    visitor.openListSize(pq.size());
   }
   double total_time = clocksToMicroSec(start_time, std::clock());
+  visitor.endPhase(best_goal_index >= 0);
   // printf("%2.2f" total_time);
   double average_iter_time = total_time / num_iter;
 
-  if (best_goal_node == nullptr || !t.withinPlanRadius(best_goal_node->cell_)) {
+  if (best_goal_index < 0) {
     return SearchInfo(false, num_iter, total_time);  // No path found
   }
 
   // Get the path by walking from t back to s (excluding s)
-  NodePtr walker = best_goal_node;
-  while (walker != s) {
-    path.push_back(walker->cell_);
-    walker = parent[walker];
+  for (int walker = best_goal_index; walker != s_index;
+       walker = space[walker].parent) {
+    path.push_back(space[walker].node.cell_);
   }
-  path.push_back(s->cell_);
-  path.push_back(s->parent_);
+  path.push_back(s.cell_);
+  path.push_back(s.parent_);
   std::reverse(path.begin(), path.end());
 
-  // printPathStats(this, path, s->parent_, s->cell_, t,
-  // distance[best_goal_node]); ROS_INFO("Found path with %d iterations,
-  // itDistSquared: %.3f", num_iter, num_iter / squared(path.size())); printf("
-  // %2.1f µs \t\t %d \t\t %2.2f \t", average_iter_time, num_iter,
-  // distance[best_goal_node]);
+  // printPathStats(this, path, s.parent_, s.cell_, t,
+  // space[best_goal_index].distance); ROS_INFO("Found path with %d
+  // iterations, itDistSquared: %.3f", num_iter, num_iter /
+  // squared(path.size())); printf(" %2.1f µs \t\t %d \t\t %2.2f \t",
+  // average_iter_time, num_iter, space[best_goal_index].distance);
   return SearchInfo(true, num_iter, total_time);
 }
 
+// Runs findSmoothPath with the node-type given by its name, from s with the
+// parent parent_of_s
+template <typename GlobalPlanner, typename Visitor>
+SearchInfo findSmoothPath(GlobalPlanner* global_planner,
+                          std::vector<Cell>& path, const Cell& s,
+                          const Cell& parent_of_s,
+                          const std::string& node_type, const GoalCell& t,
+                          int max_iterations, Visitor& visitor) {
+  if (node_type == "NodeWithoutSmooth") {
+    return findSmoothPath(global_planner, path,
+                          NodeWithoutSmooth(s, parent_of_s), t,
+                          max_iterations, visitor);
+  }
+  if (node_type == "SpeedNode") {
+    return findSmoothPath(global_planner, path, SpeedNode(s, parent_of_s), t,
+                          max_iterations, visitor);
+  }
+  return findSmoothPath(global_planner, path, Node(s, parent_of_s), t,
+                        max_iterations, visitor);
+}
+
+// ARA*: weighted A* searches with a decreasing overestimate_factor_, where
+// every search repairs the previous one instead of starting from scratch. The
+// search space and the open nodes are kept, together with the nodes whose
+// distance improved after they were expanded (the inconsistent nodes).
+template <typename GlobalPlanner, typename NodeType, typename Visitor>
+class AnytimeSearch {
+ public:
+  AnytimeSearch(GlobalPlanner* global_planner, const NodeType& s,
+                const GoalCell& t, Visitor& visitor)
+      : global_planner_(global_planner),
+        t_(t),
+        visitor_(visitor),
+        space_(4 * global_planner->max_iterations_) {
+    visitor_.init();
+    neighbors_.reserve(10);
+    s_index_ = space_.findOrInsert(s);
+    space_[s_index_].distance = 0.0;
+    open_.push_back(IndexDistancePair(s_index_, 0.0));
+  }
+
+  // Searches for a path with the current overestimate_factor_ of the planner,
+  // the search is interrupted without a path if the limits are reached
+  SearchInfo improvePath(std::vector<Cell>& path, const SearchLimits& limits) {
+    std::clock_t start_time = std::clock();
+    visitor_.startPhase(global_planner_->overestimate_factor_);
+    reopen();
+    CompareDist compare;
+    int goal_index = -1;
+    int num_iter = 0;
+    int num_pops = 0;
+    while (!open_.empty() && num_iter < limits.max_iterations) {
+      if (++num_pops % DEADLINE_CHECK_INTERVAL == 0 && limits.shouldStop()) {
+        break;
+      }
+      std::pop_heap(open_.begin(), open_.end(), compare);
+      int u_index = open_.back().first;
+      open_.pop_back();
+      if (space_[u_index].closed) {
+        continue;
+      }
+      // Copied, as inserting the neighbors may move the entries
+      const NodeType u = space_[u_index].node;
+      const double u_dist = space_[u_index].distance;
+      visitor_.popNode(u);
+
+      if (t_.withinPlanRadius(u.cell_)) {
+        // The goal is not expanded, the next search has to find it again
+        goal_index = u_index;
+        inconsistent_.push_back(u_index);
+        break;
+      }
+      space_[u_index].closed = true;
+      num_iter++;
+
+      getNeighbors(u, neighbors_);
+      const double cost_bound = limits.costBound();
+      for (const NodeType& v : neighbors_) {
+        if (!global_planner_->isLegal(v)) {
+          continue;
+        }
+        double new_dist = u_dist + global_planner_->getEdgeCost(u, v);
+        if (new_dist >= cost_bound) {
+          continue;  // A parallel search already has a cheaper path
+        }
+        int v_index = space_.findOrInsert(v);
+        if (new_dist < space_[v_index].distance) {
+          space_[v_index].node = v;
+          space_[v_index].parent = u_index;
+          space_[v_index].distance = new_dist;
+          if (space_[v_index].closed) {
+            // Not expanded again in this search, only in the next one
+            inconsistent_.push_back(v_index);
+            visitor_.reopenNode(v);
+          } else {
+            push(v_index);
+          }
+          visitor_.perNeighbor(u, v);
+        }
+      }
+      visitor_.openListSize(open_.size());
+    }
+    double total_time = clocksToMicroSec(start_time, std::clock());
+    visitor_.endPhase(goal_index >= 0);
+
+    if (goal_index < 0) {
+      return SearchInfo(false, num_iter, total_time);
+    }
+
+    // Get the path by walking from the goal back to s (excluding s)
+    for (int walker = goal_index; walker != s_index_;
+         walker = space_[walker].parent) {
+      path.push_back(space_[walker].node.cell_);
+    }
+    path.push_back(space_[s_index_].node.cell_);
+    path.push_back(space_[s_index_].node.parent_);
+    std::reverse(path.begin(), path.end());
+    return SearchInfo(true, num_iter, total_time);
+  }
+
+ private:
+  void push(int index) {
+    double overestimated_heuristic =
+        space_[index].distance +
+        global_planner_->getHeuristic(space_[index].node, t_);
+    open_.push_back(IndexDistancePair(index, overestimated_heuristic));
+    std::push_heap(open_.begin(), open_.end(), CompareDist());
+  }
+
+  // The keys of the open nodes depend on the overestimate, so the open and
+  // the inconsistent nodes are queued again and the closed nodes are opened
+  void reopen() {
+    queued_.assign(space_.size(), false);
+    std::vector<int>& reopened = inconsistent_;
+    for (const IndexDistancePair& index_dist : open_) {
+      if (!space_[index_dist.first].closed) {
+        reopened.push_back(index_dist.first);
+      }
+    }
+    for (int index = 0; index < space_.size(); ++index) {
+      space_[index].closed = false;
+    }
+    open_.clear();
+    for (int index : reopened) {
+      if (!queued_[index]) {
+        queued_[index] = true;
+        push(index);
+      }
+    }
+    inconsistent_.clear();
+  }
+
+  GlobalPlanner* global_planner_;
+  GoalCell t_;
+  Visitor& visitor_;
+  SearchSpace<NodeType> space_;
+  int s_index_;
+  std::vector<IndexDistancePair> open_;  // A heap, may hold outdated entries
+  std::vector<int> inconsistent_;
+  std::vector<NodeType> neighbors_;
+  std::vector<bool> queued_;
+};
+
+// Runs an AnytimeSearch while overestimate_factor_ of the planner is at least
+// min_overestimate, lowering overestimate_factor_ after every path. The used
+// iterations are subtracted from limits and the paths are offered to the
+// incumbent of limits. Returns true iff a path was found, path is then the
+// path of the lowest overestimate.
+template <typename GlobalPlanner, typename NodeType, typename Visitor>
+bool findAnytimePath(GlobalPlanner* global_planner, std::vector<Cell>& path,
+                     const NodeType& s, const GoalCell& t,
+                     const std::string& node_type, double min_overestimate,
+                     SearchLimits& limits, Visitor& visitor) {
+  AnytimeSearch<GlobalPlanner, NodeType, Visitor> search(global_planner, s, t,
+                                                         visitor);
+  bool found_path = false;
+  while (global_planner->overestimate_factor_ >= min_overestimate &&
+         limits.max_iterations > 0) {
+    std::vector<Cell> new_path;
+    SearchInfo search_info = search.improvePath(new_path, limits);
+    limits.max_iterations -= search_info.num_iter;
+    // Printed as a whole line, as other searches may print at the same time
+    std::ostringstream line;
+    printSearchInfo(search_info, node_type,
+                    global_planner->overestimate_factor_, line);
+    if (!search_info.found_path) {
+      // Out of iterations or time (or cancelled), keep the last path
+      printf("%s(no path) \n", line.str().c_str());
+      break;
+    }
+    PathInfo path_info = global_planner->getPathInfo(new_path);
+    printf("%s(cost: %2.2f, dist: %2.2f, risk: %2.2f, smooth: %2.2f) \n",
+           line.str().c_str(), path_info.cost, path_info.dist,
+           path_info.risk, path_info.smoothness);
+    if (limits.incumbent) {
+      limits.incumbent->offer(path_info.cost);
+    }
+    path = new_path;
+    found_path = true;
+    global_planner->overestimate_factor_ =
+        (global_planner->overestimate_factor_ - 1.0) / 4.0 + 1.0;
+  }
+  return found_path;
+}
+
+// Runs findAnytimePath with the node-type given by its name
+template <typename GlobalPlanner, typename Visitor>
+bool findAnytimePath(GlobalPlanner* global_planner, std::vector<Cell>& path,
+                     const Cell& s, const Cell& parent_of_s,
+                     const GoalCell& t, const std::string& node_type,
+                     double min_overestimate, SearchLimits& limits,
+                     Visitor& visitor) {
+  if (node_type == "NodeWithoutSmooth") {
+    return findAnytimePath(global_planner, path,
+                           NodeWithoutSmooth(s, parent_of_s), t, node_type,
+                           min_overestimate, limits, visitor);
+  }
+  if (node_type == "SpeedNode") {
+    return findAnytimePath(global_planner, path, SpeedNode(s, parent_of_s), t,
+                           node_type, min_overestimate, limits, visitor);
+  }
+  return findAnytimePath(global_planner, path, Node(s, parent_of_s), t,
+                         node_type, min_overestimate, limits, visitor);
+}
+
 // Searches for a path from s to t at max_altitude_, fills path if it finds one
 template <typename GlobalPlanner>
 bool find2DPath(GlobalPlanner* global_planner, std::vector<Cell>& path,
                 const Cell& s, const Cell& t, const Cell& start_parent,
-                double alt) {
+                double alt, const SearchLimits& limits) {
   std::vector<Cell> up_path;
   Cell above_s(Cell(s.xIndex(), s.yIndex(), alt));
   Cell above_t(Cell(t.xIndex(), t.yIndex(), alt));
   bool found_up_path =
-      findPathOld(global_planner, up_path, s, above_s, s, true);
+      findPathOld(global_planner, up_path, s, above_s, s, true, limits);
   std::vector<Cell> down_path;
   bool found_down_path =
-      findPathOld(global_planner, down_path, above_t, t, above_t, true);
+      findPathOld(global_planner, down_path, above_t, t, above_t, true,
+                  limits);
   std::vector<Cell> vert_path;
   bool found_vert_path =
-      findPathOld(global_planner, vert_path, above_s, above_t, above_s, false);
+      findPathOld(global_planner, vert_path, above_s, above_t, above_s,
+                  false, limits);
 
   if (found_up_path && found_vert_path && found_down_path) {
     path = up_path;
@@ -246,51 +566,11 @@ bool find2DPath(GlobalPlanner* global_planner, std::vector<Cell>& path,
   return false;
 }
 
-// TODO: Run search backwards to quickly find impossible scenarios and/or find
-// exact heuristics for nodes close to goal
-template <typename GlobalPlanner>
-bool reverseSearch(GlobalPlanner* global_planner, const Cell& t) {
-  std::map<Cell, double> cost;
-  std::priority_queue<CellDistancePair, std::vector<CellDistancePair>,
-                      CompareDist>
-      pq;
-  std::unordered_set<Cell> seen_cells;
-  int num_iter = 0;
-  cost[t] = global_planner->getRisk(t);
-  pq.push(std::make_pair(t, cost[t]));
-
-  while (!pq.empty() && num_iter++ < 100) {
-    CellDistancePair u_cell_dist = pq.top();
-    pq.pop();
-    Cell u = u_cell_dist.first;
-    if (seen_cells.find(u) != seen_cells.end()) {
-      continue;
-    }
-    seen_cells.insert(u);
-    global_planner->bubble_risk_cache_[u] = cost[u];
-    global_planner->bubble_cost_ = cost[u];
-    global_planner->bubble_radius_ =
-        std::max(global_planner->bubble_radius_, u.distance3D(t));
-
-    for (const Cell& v : u.getNeighbors()) {
-      double new_cost = cost[u] +
-                        u.distance3D(v) * global_planner->risk_factor_ *
-                            global_planner->getRisk(v);
-      double old_cost = getWithDefault(cost, v, INFINITY);
-      if (new_cost < old_cost) {
-        cost[v] = new_cost;
-        pq.push(std::make_pair(v, new_cost));
-      }
-    }
-  }
-  // TODO: return?
-}
-
 // A* to find a path from s to t, true iff it found a path
 template <typename GlobalPlanner>
 bool findPathOld(GlobalPlanner* global_planner, std::vector<Cell>& path,
                  const Cell& s, const Cell& t, const Cell& start_parent,
-                 bool is_3D) {
+                 bool is_3D, const SearchLimits& limits) {
   // Initialize containers
   // global_planner->seen_.clear();
   std::unordered_set<Cell> seen;
@@ -308,7 +588,10 @@ bool findPathOld(GlobalPlanner* global_planner, std::vector<Cell>& path,
   start_time = std::clock();
   // Search until all reachable cells have been found, it runs out of time or t
   // is found,
-  while (!pq.empty() && num_iter < global_planner->max_iterations_) {
+  while (!pq.empty() && num_iter < limits.max_iterations) {
+    if (num_iter % DEADLINE_CHECK_INTERVAL == 0 && limits.deadlinePassed()) {
+      break;
+    }
     CellDistancePair u_cell_dist = pq.top();
     pq.pop();
     Cell u = u_cell_dist.first;
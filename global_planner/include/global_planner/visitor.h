@@ -1,8 +1,24 @@
 #ifndef GLOBAL_PLANNER_VISITOR
 #define GLOBAL_PLANNER_VISITOR
 
+#include <stddef.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
 namespace global_planner {
 
+// The searches call the visitor when they:
+//   startPhase: start a search, or a repair with another overestimate factor
+//   popNode: take a node off the open list to expand it
+//   perNeighbor: lower the distance of a neighbor
+//   reopenNode: lower the distance of an expanded node, which is expanded
+//               again by the next repair
+//   openListSize: are done with a node, with the size of the open list
+//   endPhase: found a path or stopped
+// All calls are resolved at compile time, so the empty ones of NullVisitor
+// cost nothing.
+
 template <typename Set, typename Map>
 class SearchVisitor {
  public:
@@ -15,11 +31,19 @@ class SearchVisitor {
     seen_.clear();
     seen_count_.clear();
   }
-  void popNode(NodePtr u) {}
-  void perNeighbor(NodePtr u, NodePtr v) {
-    seen_count_[v->cell_] = 1.0 + getWithDefault(seen_count_, v->cell_, 0.0);
-    seen_.insert(v->cell_);
+  void startPhase(double overestimate_factor) {}
+  template <typename NodeType>
+  void popNode(const NodeType& u) {}
+
+  template <typename NodeType>
+  void perNeighbor(const NodeType& u, const NodeType& v) {
+    seen_count_[v.cell_] += 1.0;
+    seen_.insert(v.cell_);
   }
+  template <typename NodeType>
+  void reopenNode(const NodeType& v) {}
+  void openListSize(size_t size) {}
+  void endPhase(bool found_path) {}
 };
 
 class NullVisitor {
@@ -27,12 +51,167 @@ class NullVisitor {
   NullVisitor() {}
 
   void init() {}
+  void startPhase(double overestimate_factor) {}
+
+  template <typename NodeType>
+  void popNode(const NodeType& u) {}
+
+  template <typename NodeType>
+  void perNeighbor(const NodeType& u, const NodeType& v) {}
+
+  template <typename NodeType>
+  void reopenNode(const NodeType& v) {}
+  void openListSize(size_t size) {}
+  void endPhase(bool found_path) {}
+};
+
+// What one phase of a search did
+struct PhaseCounters {
+  double overestimate_factor = 1.0;
+  bool found_path = false;
+  int num_expanded = 0;
+  int num_generated = 0;  // Neighbors whose distance was lowered
+  int num_reopened = 0;
+  size_t max_open_size = 0;
+  long num_risk_lookups = 0;  // Of risk_cache_
+  long num_risk_misses = 0;
+  double time_ms = 0.0;
+
+  double riskCacheHitRate() const {
+    return num_risk_lookups > 0
+               ? 1.0 - static_cast<double>(num_risk_misses) / num_risk_lookups
+               : 1.0;
+  }
+};
+
+// Counts the work of every phase, reads the lookups of the risk cache from
+// the planner
+template <typename GlobalPlanner>
+class CountersVisitor {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<PhaseCounters> phases_;
+
+  explicit CountersVisitor(const GlobalPlanner* global_planner)
+      : global_planner_(global_planner) {}
+
+  void init() { phases_.clear(); }
+
+  void startPhase(double overestimate_factor) {
+    phases_.push_back(PhaseCounters());
+    phases_.back().overestimate_factor = overestimate_factor;
+    phase_start_time_ = Clock::now();
+    risk_lookups_at_start_ = global_planner_->risk_cache_stats_.lookups;
+    risk_misses_at_start_ = global_planner_->risk_cache_stats_.misses;
+  }
+
+  template <typename NodeType>
+  void popNode(const NodeType& u) {
+    phases_.back().num_expanded++;
+  }
+
+  template <typename NodeType>
+  void perNeighbor(const NodeType& u, const NodeType& v) {
+    phases_.back().num_generated++;
+  }
 
-  template <typename NodePtr>
-  void popNode(NodePtr u) {}
+  template <typename NodeType>
+  void reopenNode(const NodeType& v) {
+    phases_.back().num_reopened++;
+  }
+
+  void openListSize(size_t size) {
+    if (size > phases_.back().max_open_size) {
+      phases_.back().max_open_size = size;
+    }
+  }
+
+  void endPhase(bool found_path) {
+    PhaseCounters& phase = phases_.back();
+    phase.found_path = found_path;
+    phase.time_ms = millisecondsSince(phase_start_time_);
+    phase.num_risk_lookups =
+        global_planner_->risk_cache_stats_.lookups - risk_lookups_at_start_;
+    phase.num_risk_misses =
+        global_planner_->risk_cache_stats_.misses - risk_misses_at_start_;
+  }
+
+  // The sum over the phases
+  PhaseCounters total() const {
+    PhaseCounters sum;
+    for (const PhaseCounters& phase : phases_) {
+      sum.overestimate_factor = phase.overestimate_factor;
+      sum.found_path = phase.found_path;
+      sum.num_expanded += phase.num_expanded;
+      sum.num_generated += phase.num_generated;
+      sum.num_reopened += phase.num_reopened;
+      sum.max_open_size = std::max(sum.max_open_size, phase.max_open_size);
+      sum.num_risk_lookups += phase.num_risk_lookups;
+      sum.num_risk_misses += phase.num_risk_misses;
+      sum.time_ms += phase.time_ms;
+    }
+    return sum;
+  }
+
+ protected:
+  double millisecondsSince(Clock::time_point start) const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  }
+
+  const GlobalPlanner* global_planner_;
+  Clock::time_point phase_start_time_;
+  long risk_lookups_at_start_ = 0;
+  long risk_misses_at_start_ = 0;
+};
+
+// The state of a search after some expansions
+struct TraceSample {
+  int phase;
+  int num_expanded;  // Within the phase
+  size_t open_size;
+  double risk_cache_hit_rate;  // Since the start of the phase
+  double time_ms;              // Since the start of the phase
+};
+
+// Counts like CountersVisitor and samples the search every sample_interval
+// expansions, e.g. to see how the open list grows
+template <typename GlobalPlanner>
+class TraceVisitor : public CountersVisitor<GlobalPlanner> {
+ public:
+  std::vector<TraceSample> samples_;
+
+  TraceVisitor(const GlobalPlanner* global_planner, int sample_interval)
+      : CountersVisitor<GlobalPlanner>(global_planner),
+        sample_interval_(sample_interval) {}
+
+  void init() {
+    CountersVisitor<GlobalPlanner>::init();
+    samples_.clear();
+  }
+
+  void openListSize(size_t size) {
+    CountersVisitor<GlobalPlanner>::openListSize(size);
+    const PhaseCounters& phase = this->phases_.back();
+    if (phase.num_expanded % sample_interval_ == 0) {
+      long lookups = this->global_planner_->risk_cache_stats_.lookups -
+                     this->risk_lookups_at_start_;
+      long misses = this->global_planner_->risk_cache_stats_.misses -
+                    this->risk_misses_at_start_;
+      TraceSample sample;
+      sample.phase = this->phases_.size() - 1;
+      sample.num_expanded = phase.num_expanded;
+      sample.open_size = size;
+      sample.risk_cache_hit_rate =
+          lookups > 0 ? 1.0 - static_cast<double>(misses) / lookups : 1.0;
+      sample.time_ms = this->millisecondsSince(this->phase_start_time_);
+      samples_.push_back(sample);
+    }
+  }
 
-  template <typename NodePtr>
-  void perNeighbor(NodePtr u, NodePtr v) {}
+ private:
+  int sample_interval_;
 };
 
 }  // namespace global_planner
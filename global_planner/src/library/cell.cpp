@@ -2,11 +2,19 @@
 
 namespace global_planner {
 
+double CELL_SCALE = 1.0;
+
 Cell::Cell() = default;
-Cell::Cell(std::tuple<int, int, int> new_tuple) : tpl_(new_tuple) {}
+Cell::Cell(std::tuple<int, int, int> new_tuple, int level)
+    : tpl_(new_tuple), level_(level) {}
 Cell::Cell(double x, double y, double z)
     : tpl_(floor(x / CELL_SCALE), floor(y / CELL_SCALE),
            floor(z / CELL_SCALE)) {}
+Cell::Cell(double x, double y, double z, int level)
+    : tpl_(floor(x / ldexp(CELL_SCALE, level)),
+           floor(y / ldexp(CELL_SCALE, level)),
+           floor(z / ldexp(CELL_SCALE, level))),
+      level_(level) {}
 Cell::Cell(double x, double y) : Cell(x, y, 0.0) {}
 Cell::Cell(geometry_msgs::Point point) : Cell(point.x, point.y, point.z) {}
 
@@ -14,9 +22,15 @@ int Cell::xIndex() const { return std::get<0>(tpl_); }
 int Cell::yIndex() const { return std::get<1>(tpl_); }
 int Cell::zIndex() const { return std::get<2>(tpl_); }
 
-double Cell::xPos() const { return CELL_SCALE * (xIndex() + 0.5); }
-double Cell::yPos() const { return CELL_SCALE * (yIndex() + 0.5); }
-double Cell::zPos() const { return CELL_SCALE * (zIndex() + 0.5); }
+double Cell::xPos() const { return scale() * (xIndex() + 0.5); }
+double Cell::yPos() const { return scale() * (yIndex() + 0.5); }
+double Cell::zPos() const { return scale() * (zIndex() + 0.5); }
+
+Cell Cell::offset(int dx, int dy, int dz) const {
+  return Cell(std::tuple<int, int, int>(xIndex() + dx, yIndex() + dy,
+                                        zIndex() + dz),
+              level_);
+}
 
 geometry_msgs::Point Cell::toPoint() const {
   geometry_msgs::Point point;
@@ -64,50 +78,40 @@ double Cell::angle() const { return atan2(yIndex(), xIndex()); }
 // Returns the neighboring cell in the yaw direction
 // E.g. if yaw == PI/4, then it returns Cell(x+1, y+1, z)
 Cell Cell::getNeighborFromYaw(double yaw) const {
-  int dx = 2 * CELL_SCALE * std::cos(yaw);
-  int dy = 2 * CELL_SCALE * std::sin(yaw);
-  return Cell(xPos() + dx, yPos() + dy, zPos());
+  int dx = 2 * scale() * std::cos(yaw);
+  int dy = 2 * scale() * std::sin(yaw);
+  return Cell(xPos() + dx, yPos() + dy, zPos(), level_);
 }
 
 // Returns the neighbors of the Cell whose risk influences the Cell
-std::vector<Cell> Cell::getFlowNeighbors() const {
-  return std::vector<Cell>{
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex(), zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex(), zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex() - 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex(), zIndex() + 1)),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex(), zIndex() - 1))};
+std::array<Cell, 6> Cell::getFlowNeighbors() const {
+  return std::array<Cell, 6>{{offset(1, 0, 0), offset(-1, 0, 0),
+                              offset(0, 1, 0), offset(0, -1, 0),
+                              offset(0, 0, 1), offset(0, 0, -1)}};
 }
 
 // Returns the neighbors of the Cell that are diagonal to the cell in the
 // XY-plane
-std::vector<Cell> Cell::getDiagonalNeighbors() const {
-  return std::vector<Cell>{
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex() - 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex() - 1, zIndex()))};
+std::array<Cell, 4> Cell::getDiagonalNeighbors() const {
+  return std::array<Cell, 4>{{offset(1, 1, 0), offset(-1, 1, 0),
+                              offset(1, -1, 0), offset(-1, -1, 0)}};
 }
 
-std::vector<Cell> Cell::getNeighbors() const {
-  return std::vector<Cell>{
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex(), zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex(), zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex() - 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex(), zIndex() + 1)),
-      Cell(std::tuple<int, int, int>(xIndex(), yIndex(), zIndex() - 1)),
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex() + 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() + 1, yIndex() - 1, zIndex())),
-      Cell(std::tuple<int, int, int>(xIndex() - 1, yIndex() - 1, zIndex()))};
+std::array<Cell, 10> Cell::getNeighbors() const {
+  return std::array<Cell, 10>{{offset(1, 0, 0), offset(-1, 0, 0),
+                               offset(0, 1, 0), offset(0, -1, 0),
+                               offset(0, 0, 1), offset(0, 0, -1),
+                               offset(1, 1, 0), offset(-1, 1, 0),
+                               offset(1, -1, 0), offset(-1, -1, 0)}};
 }
 
 std::string Cell::asString() const {
   std::string s = "(" + std::to_string(xIndex()) + "," +
                   std::to_string(yIndex()) + "," + std::to_string(zIndex()) +
                   ")";
+  if (level_ > 0) {
+    s += "@" + std::to_string(level_);
+  }
   return s;
 }
 
@@ -2,6 +2,10 @@
 
 namespace global_planner {
 
+// Paths with fewer edges are evaluated by getPathInfo on a single thread
+const size_t PARALLEL_PATH_INFO_EDGES = 4096;
+const unsigned MAX_PATH_INFO_THREADS = 4;
+
 // Returns the XY-angle between u and v, or if v is directly above/below u, it
 // returns last_yaw
 double nextYaw(Cell u, Cell v, double last_yaw) {
@@ -43,8 +47,6 @@ void GlobalPlanner::setGoal(const GoalCell& goal) {
   goal_pos_ = goal;
   going_back_ = false;
   goal_is_blocked_ = false;
-  heuristic_cache_.clear();
-  bubble_risk_cache_.clear();
 }
 
 // Sets path to be the current path
@@ -54,25 +56,69 @@ void GlobalPlanner::setPath(const std::vector<Cell>& path) {
 
   path_cells_.clear();
   for (int i = 2; i < path.size(); ++i) {
-    Node node(path[i], path[i - 1]);
-    for (const Cell& cell : node.getCells()) {
-      path_cells_.insert(cell);
+    Node(path[i], path[i - 1]).getCells(edge_cells_);
+    for (const Cell& cell : edge_cells_) {
+      path_cells_.set(cell, true);
     }
   }
 }
 
 // Returns false iff current path has an obstacle
-// Going through the octomap can take more than 50 ms for 100m x 100m explored
-// map
+// Deserializing the octomap can take more than 50 ms for 100m x 100m explored
+// map, but only the risk of the cells that changed is recomputed
 bool GlobalPlanner::updateFullOctomap(const octomap_msgs::Octomap& msg) {
-  risk_cache_.clear();
   octomap::AbstractOcTree* tree = octomap_msgs::msgToMap(msg);
+  octomap::OcTree* new_octree = dynamic_cast<octomap::OcTree*>(tree);
+  if (octree_ && new_octree &&
+      octree_->getResolution() == new_octree->getResolution()) {
+    // Compare both ways to also find the nodes that only one of them has
+    std::vector<Cell> changed_cells;
+    getChangedCells(*new_octree, *octree_, changed_cells);
+    getChangedCells(*octree_, *new_octree, changed_cells);
+    invalidateRisk(changed_cells);
+  } else {
+    risk_cache_.clear();
+    single_risk_cache_.clear();
+    incremental_search_.reset();
+    risk_field_.reset();
+  }
   if (octree_) {
     delete octree_;
   }
-  octree_ = dynamic_cast<octomap::OcTree*>(tree);
+  octree_ = new_octree;
+  return isCurrentPathOk();
+}
+
+// Applies the changed leaves of the octomap, returns false iff current path
+// has an obstacle
+bool GlobalPlanner::updateOctomapDelta(const OctomapDeltaMsg& msg) {
+  if (msg.points.size() != msg.log_odds.size()) {
+    ROS_WARN("OctomapDeltaMsg error: log_odds must be the same size as points");
+    return true;
+  }
+  if (!octree_ || octree_->getResolution() != msg.resolution) {
+    delete octree_;
+    octree_ = new octomap::OcTree(msg.resolution);
+    risk_cache_.clear();
+    single_risk_cache_.clear();
+    incremental_search_.reset();
+    risk_field_.reset();
+  }
 
-  // Check if the risk of the current path has increased
+  std::vector<Cell> changed_cells;
+  int depth = getOctreeSearchDepth();
+  for (int i = 0; i < msg.points.size(); ++i) {
+    octomap::point3d point(msg.points[i].x, msg.points[i].y, msg.points[i].z);
+    octree_->setNodeValue(point, msg.log_odds[i], true);
+    getCellsOfOctreeNode(point, depth, changed_cells);
+  }
+  octree_->updateInnerOccupancy();
+  invalidateRisk(changed_cells);
+  return isCurrentPathOk();
+}
+
+// Returns false iff the risk of the current path has increased too much
+bool GlobalPlanner::isCurrentPathOk() {
   if (!curr_path_.empty()) {
     PathInfo new_info = getPathInfo(curr_path_);
     if (new_info.is_blocked || new_info.risk > curr_path_info_.risk + 10) {
@@ -83,6 +129,82 @@ bool GlobalPlanner::updateFullOctomap(const octomap_msgs::Octomap& msg) {
   return true;
 }
 
+// The depth of the octree nodes which give the risk of a Cell of the level,
+// the nodes of each level above have twice the size
+int GlobalPlanner::getOctreeSearchDepth(int level) const {
+  return std::max(1, std::min(16, 17 - int(CELL_SCALE + 0.1)) - level);
+}
+
+// Adds the Cells whose center is inside the octree node of the given depth
+// containing point, i.e. the Cells whose single risk is read from that node
+void GlobalPlanner::getCellsOfOctreeNode(const octomap::point3d& point,
+                                         unsigned depth,
+                                         std::vector<Cell>& cells) {
+  octomap::point3d center =
+      octree_->keyToCoord(octree_->coordToKey(point, depth), depth);
+  double half_size = octree_->getNodeSize(depth) / 2.0;
+  int min_index[3], max_index[3];
+  for (int i = 0; i < 3; ++i) {
+    // Cell k has its center at CELL_SCALE * (k + 0.5)
+    min_index[i] = std::ceil((center(i) - half_size) / CELL_SCALE - 0.5);
+    max_index[i] = std::ceil((center(i) + half_size) / CELL_SCALE - 0.5) - 1;
+  }
+  for (int x = min_index[0]; x <= max_index[0]; ++x) {
+    for (int y = min_index[1]; y <= max_index[1]; ++y) {
+      for (int z = min_index[2]; z <= max_index[2]; ++z) {
+        cells.push_back(Cell(std::tuple<int, int, int>(x, y, z)));
+      }
+    }
+  }
+}
+
+// Adds the Cells whose octree node differs between the two trees, looking at
+// every leaf of tree. Calling it with the trees swapped finds the rest.
+void GlobalPlanner::getChangedCells(const octomap::OcTree& tree,
+                                    const octomap::OcTree& other_tree,
+                                    std::vector<Cell>& changed_cells) {
+  unsigned search_depth = getOctreeSearchDepth();
+  for (auto it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+    octomap::point3d point = it.getCoordinate();
+    unsigned depth = std::min(it.getDepth(), search_depth);
+    octomap::OcTreeNode* node = tree.search(point, depth);
+    octomap::OcTreeNode* other_node = other_tree.search(point, depth);
+    bool changed = !other_node || other_node->getValue() != node->getValue();
+    if (it.getDepth() < search_depth && other_node) {
+      // A pruned leaf covers several search nodes, they are only the same if
+      // the other node has the same value and is also pruned
+      changed |= other_tree.nodeHasChildren(other_node);
+    }
+    if (changed) {
+      getCellsOfOctreeNode(point, depth, changed_cells);
+    }
+  }
+}
+
+// Removes the cached risk of the changed Cells and of the Cells whose risk
+// flows from them, also of the coarse Cells containing them
+void GlobalPlanner::invalidateRisk(const std::vector<Cell>& changed_cells) {
+  for (const Cell& cell : changed_cells) {
+    for (int level = 1; level <= coarse_levels_; ++level) {
+      Cell coarse_cell = cell.atLevel(level);
+      single_risk_cache_.erase(coarse_cell);
+      risk_cache_.erase(coarse_cell);
+      for (const Cell& neighbor : coarse_cell.getFlowNeighbors()) {
+        risk_cache_.erase(neighbor);
+      }
+    }
+    single_risk_cache_.erase(cell);
+    risk_cache_.erase(cell);
+    incremental_search_.addChangedCell(cell);
+    risk_field_.addChangedCell(cell);
+    for (const Cell& neighbor : cell.getFlowNeighbors()) {
+      risk_cache_.erase(neighbor);
+      incremental_search_.addChangedCell(neighbor);
+      risk_field_.addChangedCell(neighbor);
+    }
+  }
+}
+
 // TODO: simplify and return neighbors
 // Fills neighbors with the 8 horizontal and 2 vertical non-occupied neigbors
 void GlobalPlanner::getOpenNeighbors(const Cell& cell,
@@ -139,16 +261,50 @@ double GlobalPlanner::getEdgeDist(const Cell& u, const Cell& v) {
   return xy_diff + up_diff + down_diff;
 }
 
-// Risk without looking at the neighbors
+// Marks cell as known space, an obstacle has been seen in it
+void GlobalPlanner::setOccupied(const Cell& cell) {
+  setOccupied(std::vector<Cell>(1, cell));
+}
+
+// Marks all cells as known space, cells sorted by key are inserted block by
+// block. The risk of the newly occupied cells is invalidated like for a
+// change of the octomap
+void GlobalPlanner::setOccupied(const std::vector<Cell>& cells) {
+  std::vector<Cell> changed_cells;
+  for (const Cell& cell : cells) {
+    if (!occupied_.get(cell)) {
+      occupied_.set(cell, true);
+      changed_cells.push_back(cell);
+    }
+  }
+  invalidateRisk(changed_cells);
+}
+
+// Risk without looking at the neighbors, every Cell is looked up in the octree
+// only once until its octree node changes
 double GlobalPlanner::getSingleCellRisk(const Cell& cell) {
-  if (cell.zIndex() < 1 || !octree_) {
+  double cached_risk = single_risk_cache_.get(cell);
+  if (!std::isnan(cached_risk)) {
+    return cached_risk;
+  }
+  double risk = searchSingleCellRisk(cell);
+  single_risk_cache_.set(cell, risk);
+  return risk;
+}
+
+// A coarse Cell gets the risk of the octree node of its size, whose value is
+// the highest of the nodes it contains
+double GlobalPlanner::searchSingleCellRisk(const Cell& cell) {
+  // The index of the highest Cell of full resolution inside cell
+  int top_index = (cell.zIndex() + 1) * (1 << cell.level()) - 1;
+  if (top_index < 1 || !octree_) {
     return 1.0;  // Octomap does not keep track of the ground
   }
   // octomap::OcTreeNode* node = octree_->search(cell.xPos(), cell.yPos(),
   // cell.zPos());
-  int octree_depth = std::min(16, 17 - int(CELL_SCALE + 0.1));
   octomap::OcTreeNode* node =
-      octree_->search(cell.xPos(), cell.yPos(), cell.zPos(), octree_depth);
+      octree_->search(cell.xPos(), cell.yPos(), cell.zPos(),
+                      getOctreeSearchDepth(cell.level()));
   if (node) {
     // TODO: posterior in log-space
     double log_odds = node->getValue();
@@ -157,7 +313,7 @@ double GlobalPlanner::getSingleCellRisk(const Cell& cell) {
         posterior(getAltPrior(cell), octomap::probability(log_odds));
     // double post_prob = posterior(0.06, octomap::probability(log_odds));
     // // If the cell has been seen
-    if (occupied_.find(cell) != occupied_.end()) {
+    if (isSeenOccupied(cell)) {
       // If an obstacle has at some point been spotted it is 'known space'
       return post_prob;
     } else if (log_odds > 0) {
@@ -172,6 +328,29 @@ double GlobalPlanner::getSingleCellRisk(const Cell& cell) {
   return expore_penalty_ * getAltPrior(cell);  // Risk for unexplored cells
 }
 
+// The map lookups of a search, which read the shared map through the cursors
+// of the search
+bool GlobalPlanner::isSeenOccupied(const Cell& cell) {
+  if (map_owner_) {
+    return map_owner_->occupied_.get(cell, map_cursors_.occupied);
+  }
+  return occupied_.get(cell);
+}
+
+double GlobalPlanner::corridorDistance(const Cell& cell) {
+  if (map_owner_) {
+    return map_owner_->corridor_.get(cell, map_cursors_.corridor);
+  }
+  return corridor_.get(cell);
+}
+
+double GlobalPlanner::riskLowerBound(const Cell& cell) {
+  if (map_owner_) {
+    return map_owner_->risk_field_.lowerBound(cell, map_cursors_.risk_field);
+  }
+  return risk_field_.lowerBound(cell);
+}
+
 double GlobalPlanner::getAltPrior(const Cell& cell) {
   // return alt_prior_[cell.zIndex()];
   return alt_prior_[std::round(cell.zPos())];
@@ -182,69 +361,80 @@ bool GlobalPlanner::isOccupied(const Cell& cell) {
 }
 
 bool GlobalPlanner::isLegal(const Node& node) {
+  const int level = mapOwner().corridor_level_;
+  if (level > 0 && std::isnan(corridorDistance(node.cell_.atLevel(level)))) {
+    return false;  // Outside of the corridor around the coarse path
+  }
   return node.cell_.zPos() < max_altitude_ && getRisk(node) < max_cell_risk_;
 }
 
 double GlobalPlanner::getRisk(const Cell& cell) {
-  if (risk_cache_.find(cell) != risk_cache_.end()) {
-    return risk_cache_[cell];
+  risk_cache_stats_.lookups++;
+  double cached_risk = risk_cache_.get(cell);
+  if (!std::isnan(cached_risk)) {
+    return cached_risk;
   }
+  risk_cache_stats_.misses++;
 
   double risk = getSingleCellRisk(cell);
   for (const Cell& neighbor : cell.getFlowNeighbors()) {
     risk += neighbor_risk_flow_ * getSingleCellRisk(neighbor);
   }
 
-  risk_cache_[cell] = risk;
+  risk_cache_.set(cell, risk);
   return risk;
 }
 
 double GlobalPlanner::getRisk(const Node& node) {
   double risk = 0.0;
-  std::unordered_set<Cell> nodeCells = node.getCells();
-  for (const Cell& cell : nodeCells) {
+  node.getCells(edge_cells_);
+  for (const Cell& cell : edge_cells_) {
     risk += getRisk(cell);
   }
-  return risk / nodeCells.size() * node.getLength();
+  return risk / edge_cells_.size() * node.getLength();
 }
 
-// Returns the risk of the quadratic Bezier curve defined by poses
-// TODO: think about this
+// Returns the risk of the curve through the poses, consecutive quadratic Bezier
+// curves whose control points are the poses with an odd index. Like the risk of
+// an edge, it is the risk of the cells times the length of the curve in them.
 double GlobalPlanner::getRiskOfCurve(
     const std::vector<geometry_msgs::PoseStamped>& msg) {
-  if (msg.size() != 3) {
-    ROS_INFO("Bezier msg must have 3 points");
+  if (msg.size() < 3 || msg.size() % 2 == 0) {
+    ROS_INFO("Bezier msg must have an odd number of points, at least 3");
     return -1;
   }
 
-  // Estimate the length of the curve, TODO: check if this makes sense
-  double length = distance(msg[0], msg[1]) + distance(msg[1], msg[2]);
-  int num_steps = std::ceil(length / CELL_SCALE);
-  // Calculate points on the curve, around one point per cell
-  auto points = threePointBezier(msg[0].pose.position, msg[1].pose.position,
-                                 msg[2].pose.position, 4 * num_steps);
-
-  double risk = 0.0;
   visitor_.seen_.clear();
-  for (auto point : points) {
-    risk += getRisk(Cell(point));
-    visitor_.seen_.insert(Cell(point));
-  }
-  return risk;
+  auto cell_risk = [this](const Cell& cell) {
+    visitor_.seen_.insert(cell);
+    return getRisk(cell);
+  };
+  CurveRisk curve_risk;
+  addBezierRisk(msg, cell_risk, curve_risk);
+  return curve_risk.risk;
 }
 
 // Returns the amount of rotation needed to go from u to v
-double GlobalPlanner::getTurnSmoothness(const Node& u, const Node& v) {
+template <typename NodeType>
+double GlobalPlanner::getTurnSmoothness(const NodeType& u, const NodeType& v) {
   double turn = u.getRotation(v);
   return turn * turn;  // Squaring makes large turns more costly
 }
 
 // Returns the total cost of the edge from u to v
-double GlobalPlanner::getEdgeCost(const Node& u, const Node& v) {
+template <typename NodeType>
+double GlobalPlanner::getEdgeCost(const NodeType& u, const NodeType& v) {
+  return getEdgeCost(u, v, getRisk(v));
+}
+
+// Returns the total cost of the edge from u to v, given getRisk(v)
+template <typename NodeType>
+double GlobalPlanner::getEdgeCost(const NodeType& u, const NodeType& v,
+                                  double risk_of_v) {
   double dist_cost = getEdgeDist(u.cell_, v.cell_);
   // double risk_cost = u.cell_.distance3D(v.cell_) * risk_factor_ *
   // getRisk(v.cell_);
-  double risk_cost = risk_factor_ * getRisk(v);
+  double risk_cost = risk_factor_ * risk_of_v;
   double smooth_cost = smooth_factor_ * getTurnSmoothness(u, v);
   if (u.cell_.distance3D(Cell(curr_pos_)) < 3 && norm(curr_vel_) > 1) {
     smooth_cost *= 2;  // Penalty for a early turn when the velocity is high
@@ -252,11 +442,28 @@ double GlobalPlanner::getEdgeCost(const Node& u, const Node& v) {
   return dist_cost + risk_cost + smooth_cost;
 }
 
+template double GlobalPlanner::getTurnSmoothness(const Node& u, const Node& v);
+template double GlobalPlanner::getTurnSmoothness(const NodeWithoutSmooth& u,
+                                                 const NodeWithoutSmooth& v);
+template double GlobalPlanner::getTurnSmoothness(const SpeedNode& u,
+                                                 const SpeedNode& v);
+template double GlobalPlanner::getEdgeCost(const Node& u, const Node& v);
+template double GlobalPlanner::getEdgeCost(const NodeWithoutSmooth& u,
+                                           const NodeWithoutSmooth& v);
+template double GlobalPlanner::getEdgeCost(const SpeedNode& u,
+                                           const SpeedNode& v);
+template double GlobalPlanner::getEdgeCost(const Node& u, const Node& v,
+                                           double risk_of_v);
+template double GlobalPlanner::getEdgeCost(const NodeWithoutSmooth& u,
+                                           const NodeWithoutSmooth& v,
+                                           double risk_of_v);
+template double GlobalPlanner::getEdgeCost(const SpeedNode& u,
+                                           const SpeedNode& v,
+                                           double risk_of_v);
+
 // Returns a heuristic for the cost of risk for going from u to goal
 // The heuristic is the cost of risk through unknown environment
 double GlobalPlanner::riskHeuristic(const Cell& u, const Cell& goal) {
-  // return riskHeuristicReverseCache(u, goal);  // REVERSE_SEARCH
-
   if (u == goal) {
     return 0.0;
   }
@@ -274,24 +481,6 @@ double GlobalPlanner::riskHeuristic(const Cell& u, const Cell& goal) {
   return xy_risk + z_risk + goal_risk;
 }
 
-double GlobalPlanner::riskHeuristicReverseCache(const Cell& u,
-                                                const Cell& goal) {
-  if (bubble_risk_cache_.find(u) != bubble_risk_cache_.end()) {
-    return bubble_risk_cache_[u];
-  }
-  if (u == goal) {
-    return 0.0;
-  }
-  double dist_to_bubble =
-      std::max(0.0, u.diagDistance3D(goal) - bubble_radius_);
-  double unexplored_risk =
-      (1.0 + 6.0 * neighbor_risk_flow_) * expore_penalty_ * risk_factor_;
-  double heuristic =
-      bubble_cost_ + dist_to_bubble * unexplored_risk * getAltPrior(u);
-  // bubble_risk_cache_[u] = heuristic;
-  return heuristic;
-}
-
 // Returns a heuristic for the cost of turning for going from u to goal
 double GlobalPlanner::smoothnessHeuristic(const Node& u, const Cell& goal) {
   if (u.cell_.xIndex() == goal.xIndex() && u.cell_.yIndex() == goal.yIndex()) {
@@ -331,25 +520,29 @@ double GlobalPlanner::altitudeHeuristic(const Cell& u, const Cell& goal) {
 
 // Returns a heuristic of going from u to goal
 double GlobalPlanner::getHeuristic(const Node& u, const Cell& goal) {
-  if (heuristic_cache_.find(u) != heuristic_cache_.end()) {
-    // return heuristic_cache_[u];    // TODO: Needs to account for different
-    // overestimating factors
+  const int level = mapOwner().corridor_level_;
+  double dist = u.cell_.diagDistance2D(goal);
+  if (level > 0) {
+    // The straight line may be blocked, the corridor goes around obstacles
+    dist = std::max(dist, corridorDistance(u.cell_.atLevel(level)));
   }
-
   // Only overestimate the distance
-  double heuristic = overestimate_factor_ * u.cell_.diagDistance2D(goal);
+  double heuristic = overestimate_factor_ * dist;
   heuristic += altitudeHeuristic(
       u.cell_, goal);  // Lower bound cost due to altitude change
   heuristic += smoothnessHeuristic(u, goal);  // Lower bound cost due to turning
-  if (use_risk_heuristics_) {
+  if (use_risk_heuristics_ && use_risk_field_ &&
+      mapOwner().risk_field_.hasGoal(goal)) {
+    // Lower bound cost of risk
+    heuristic += riskLowerBound(u.cell_);
+  } else if (use_risk_heuristics_) {
     heuristic += riskHeuristic(
         u.cell_,
         goal);  // Risk through a straight-line path of unexplored space
   }
   if (use_speedup_heuristics_) {
-    heuristic += visitor_.seen_count_[u.cell_];
+    heuristic += visitor_.seen_count_.get(u.cell_);
   }
-  heuristic_cache_[u] = heuristic;
   return heuristic;
 }
 
@@ -371,6 +564,7 @@ nav_msgs::Path GlobalPlanner::getPathMsg(const std::vector<Cell>& path) {
   if (path.size() == 0) {
     return path_msg;
   }
+  path_msg.poses.reserve(path.size());
 
   // Use actual position instead of the center of the cell
   double last_yaw = curr_yaw_;
@@ -391,11 +585,18 @@ nav_msgs::Path GlobalPlanner::getPathMsg(const std::vector<Cell>& path) {
 }
 
 PathWithRiskMsg GlobalPlanner::getPathWithRiskMsg() {
-  nav_msgs::Path path_msg = getPathMsg();
+  return getPathWithRiskMsg(getPathMsg());
+}
+
+// The poses of path_msg with their risk, for a path message which is already
+// built
+PathWithRiskMsg GlobalPlanner::getPathWithRiskMsg(
+    const nav_msgs::Path& path_msg) {
   PathWithRiskMsg risk_msg;
   risk_msg.header = path_msg.header;
   risk_msg.poses = path_msg.poses;
 
+  risk_msg.risks.reserve(path_msg.poses.size());
   for (const auto& pose : path_msg.poses) {
     double risk = getRisk(Cell(pose.pose.position));
     risk_msg.risks.push_back(risk);
@@ -404,34 +605,83 @@ PathWithRiskMsg GlobalPlanner::getPathWithRiskMsg() {
 }
 
 // Returns details of the cost of the path
+// Evaluates the edges of path in one batch: the Cells of all edges are
+// gathered first and the risk of every Cell is looked up once, in the order of
+// their keys. The edges of long paths are then summed up on several threads.
 PathInfo GlobalPlanner::getPathInfo(const std::vector<Cell>& path) {
   PathInfo path_info = {};
-  for (int i = 2; i < path.size(); ++i) {
-    Node curr_node = Node(path[i], path[i - 1]);
-    Node last_node = Node(path[i - 1], path[i - 2]);
-    double cell_risk = getRisk(curr_node);
-    path_info.dist += getEdgeDist(last_node.cell_, curr_node.cell_);
-    path_info.risk += risk_factor_ * cell_risk;
-    path_info.cost += getEdgeCost(last_node, curr_node);
-    path_info.is_blocked |= cell_risk > max_cell_risk_;
-    path_info.smoothness +=
-        smooth_factor_ * getTurnSmoothness(last_node, curr_node);
+  if (path.size() < 3) {
+    return path_info;
+  }
+  const size_t num_edges = path.size() - 2;
+  std::vector<Cell> cells;  // The Cells of edge i are cells[edge_begin[i]:]
+  std::vector<size_t> edge_begin(num_edges + 1);
+  for (size_t i = 0; i < num_edges; ++i) {
+    edge_begin[i] = cells.size();
+    Node(path[i + 2], path[i + 1]).getCells(edge_cells_);
+    cells.insert(cells.end(), edge_cells_.begin(), edge_cells_.end());
+  }
+  edge_begin[num_edges] = cells.size();
+
+  auto compare_keys = [](const Cell& a, const Cell& b) {
+    return a.key() < b.key();
+  };
+  std::vector<Cell> unique_cells = cells;
+  std::sort(unique_cells.begin(), unique_cells.end(), compare_keys);
+  unique_cells.erase(std::unique(unique_cells.begin(), unique_cells.end()),
+                     unique_cells.end());
+  std::vector<double> unique_risks(unique_cells.size());
+  for (size_t j = 0; j < unique_cells.size(); ++j) {
+    unique_risks[j] = getRisk(unique_cells[j]);
   }
-  return path_info;
-}
 
-// Chooses the node-type of the search
-NodePtr GlobalPlanner::getStartNode(const Cell& start, const Cell& parent,
-                                    const std::string& type) {
-  if (type == "Node") {
-    return NodePtr(new Node(start, parent));
+  // Only reads the risks, so the edges can be summed up in parallel
+  auto add_edges = [&](size_t begin, size_t end, PathInfo& info) {
+    for (size_t i = begin; i < end; ++i) {
+      Node curr_node = Node(path[i + 2], path[i + 1]);
+      Node last_node = Node(path[i + 1], path[i]);
+      double cell_risk = 0.0;
+      for (size_t k = edge_begin[i]; k < edge_begin[i + 1]; ++k) {
+        cell_risk += unique_risks[std::lower_bound(unique_cells.begin(),
+                                                   unique_cells.end(),
+                                                   cells[k], compare_keys) -
+                                  unique_cells.begin()];
+      }
+      cell_risk = cell_risk / (edge_begin[i + 1] - edge_begin[i]) *
+                  curr_node.getLength();
+      info.dist += getEdgeDist(last_node.cell_, curr_node.cell_);
+      info.risk += risk_factor_ * cell_risk;
+      info.cost += getEdgeCost(last_node, curr_node, cell_risk);
+      info.is_blocked |= cell_risk > max_cell_risk_;
+      info.smoothness +=
+          smooth_factor_ * getTurnSmoothness(last_node, curr_node);
+    }
+  };
+
+  size_t num_threads = 1;
+  if (num_edges >= PARALLEL_PATH_INFO_EDGES) {
+    num_threads = std::max(1u, std::min(MAX_PATH_INFO_THREADS,
+                                        std::thread::hardware_concurrency()));
+  }
+  std::vector<PathInfo> partial_infos(num_threads, PathInfo());
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < num_threads; ++t) {
+    threads.emplace_back(add_edges, t * num_edges / num_threads,
+                         (t + 1) * num_edges / num_threads,
+                         std::ref(partial_infos[t]));
   }
-  if (type == "NodeWithoutSmooth") {
-    return NodePtr(new NodeWithoutSmooth(start, parent));
+  add_edges(0, num_edges / num_threads, partial_infos[0]);
+  for (std::thread& thread : threads) {
+    thread.join();
   }
-  if (type == "SpeedNode") {
-    return NodePtr(new SpeedNode(start, parent));
+  for (const PathInfo& info : partial_infos) {
+    path_info.dist += info.dist;
+    path_info.risk += info.risk;
+    path_info.cost += info.cost;
+    path_info.is_blocked |= info.is_blocked;
+    path_info.smoothness += info.smoothness;
   }
+  return path_info;
 }
 
 // Calls different search functions to find a path
@@ -453,61 +703,311 @@ bool GlobalPlanner::findPath(std::vector<Cell>& path) {
   ROS_INFO("curr_pos_: %2.2f,%2.2f,%2.2f\t s: %2.2f,%2.2f,%2.2f", curr_pos_.x,
            curr_pos_.y, curr_pos_.z, s.xPos(), s.yPos(), s.zPos());
 
-  bool found_path = false;
-  double best_path_cost = INFINITY;
-  overestimate_factor_ = max_overestimate_factor_;
-  int iter_left = max_iterations_;
-  int last_iter = 0;
-
-  // reverseSearch(t); // REVERSE_SEARCH
+  // The search starts where the vehicle is after search_time_, so the path
+  // has to be ready by then. When the deadline passes, the path of the lowest
+  // overestimate that was reached is used.
+  SearchLimits limits = SearchLimits::fromNow(max_iterations_, search_time_);
 
-  printf("Search              iter_time overest   num_iter  path_cost \n");
-  while (overestimate_factor_ >= min_overestimate_factor_ &&
-         iter_left > last_iter) {
-    std::vector<Cell> new_path;
-    SearchInfo search_info;
-    std::string node_type = default_node_type_;
-    if (overestimate_factor_ > 1.5) {
-      // Use a cheap search for higher overestimate
-      // found_new_path = findPathOld(new_path, s, t, parent_of_s, true);  // No
-      // need to search with smoothness
-      node_type = "NodeWithoutSmooth";
+  if (use_incremental_search_) {
+    // Repairs the search of the last call, falls back to ARA* if there is no
+    // path or the search did not finish in time
+    SearchInfo search_info =
+        incremental_search_.findPath(this, path, s, parent_of_s, t, limits);
+    printSearchInfo(search_info, "IncrementalSearch");
+    printf("\n");
+    if (search_info.found_path) {
+      overestimate_factor_ = 1.0;  // The path is optimal
+      return true;
     }
+    path.clear();
+  }
 
-    NodePtr start_node = getStartNode(s, parent_of_s, node_type);
-    search_info =
-        findSmoothPath(this, new_path, start_node, t, iter_left, visitor_);
-    printSearchInfo(search_info, node_type, overestimate_factor_);
+  if (use_risk_field_) {
+    // Grows the field a bit in every replan, while the goal stays the same
+    SearchLimits field_limits(max_iterations_, limits.deadline);
+    int num_settled = risk_field_.expand(this, t, field_limits);
+    printf("Risk field: %d cells settled \n", num_settled);
+  }
 
-    if (search_info.found_path) {
-      PathInfo path_info = getPathInfo(new_path);
-      printf("(cost: %2.2f, dist: %2.2f, risk: %2.2f, smooth: %2.2f) \n",
-             path_info.cost, path_info.dist, path_info.risk,
-             path_info.smoothness);
-      if (true || path_info.cost <= best_path_cost) {
-        // TODO: always use the newest path?
-        best_path_cost = path_info.cost;
+  printf("Search              iter_time overest   num_iter  path_cost \n");
+  auto find_anytime_path = [&]() {
+    overestimate_factor_ = max_overestimate_factor_;
+    bool found_path = false;
+    if (use_parallel_search_) {
+      found_path = findParallelPath(path, s, parent_of_s, t, limits);
+    } else if (overestimate_factor_ > 1.5) {
+      // Use a cheap search for higher overestimate, no need to search with
+      // smoothness
+      found_path = findAnytimePath(this, path, s, parent_of_s, t,
+                                   "NodeWithoutSmooth", 1.5, limits, visitor_);
+    }
+    if (!use_parallel_search_ && overestimate_factor_ <= 1.5) {
+      std::vector<Cell> new_path;
+      if (findAnytimePath(this, new_path, s, parent_of_s, t,
+                          default_node_type_, min_overestimate_factor_, limits,
+                          visitor_)) {
         path = new_path;
         found_path = true;
       }
-    } else {
-      break;
     }
-    last_iter = search_info.num_iter;
-    iter_left -= last_iter;
-    overestimate_factor_ = (overestimate_factor_ - 1.0) / 4.0 + 1.0;
+    return found_path;
+  };
+
+  // Plan on coarse Cells first, the full resolution searches then only expand
+  // the Cells in a corridor around the coarse path
+  bool found_path = false;
+  if (coarse_levels_ > 0 && findCorridor(s, parent_of_s, t, limits)) {
+    found_path = find_anytime_path();
+    corridor_.clear();
+    corridor_level_ = 0;
+    if (!found_path && !limits.deadlinePassed()) {
+      printf("No path in the corridor, search the full map \n");
+      path.clear();
+      found_path = find_anytime_path();
+    }
+  } else {
+    found_path = find_anytime_path();
   }
 
-  // Last resort, try 2d search at max_altitude_
-  if (!found_path) {
+  // Last resort, try 2d search at max_altitude_ with a larger iteration budget
+  if (!found_path && !limits.deadlinePassed()) {
     printf("No path found, search in 2D \n");
-    max_iterations_ = 5000;
-    found_path = find2DPath(this, path, s, t, parent_of_s, max_altitude_);
+    SearchLimits limits_2D(5000, limits.deadline);
+    found_path =
+        find2DPath(this, path, s, t, parent_of_s, max_altitude_, limits_2D);
   }
 
   return found_path;
 }
 
+// Returns a planner for one of the searches of findParallelPath. It has the
+// parameters and its own copies of the risk caches, which are not thread safe,
+// and reads the map of this planner through its own map_cursors_. The state
+// that the searches only read is moved out while the planner is copied, so
+// that it is not copied. The visitor is moved out too, findSmoothPath clears it
+// when a search starts.
+std::unique_ptr<GlobalPlanner> GlobalPlanner::makeSearchPlanner() {
+  CellGrid<bool> occupied = std::move(occupied_);
+  CellGrid<bool> path_cells = std::move(path_cells_);
+  CellGrid<double> corridor = std::move(corridor_);
+  RunLengthPath path_back = std::move(path_back_);
+  SearchVisitor<std::unordered_set<Cell>, CellGrid<double> > visitor =
+      std::move(visitor_);
+  IncrementalSearch<GlobalPlanner> incremental_search =
+      std::move(incremental_search_);
+  RiskField<GlobalPlanner> risk_field = std::move(risk_field_);
+
+  std::unique_ptr<GlobalPlanner> planner(new GlobalPlanner(*this));
+  planner->map_owner_ = this;
+
+  occupied_ = std::move(occupied);
+  path_cells_ = std::move(path_cells);
+  corridor_ = std::move(corridor);
+  path_back_ = std::move(path_back);
+  visitor_ = std::move(visitor);
+  incremental_search_ = std::move(incremental_search);
+  risk_field_ = std::move(risk_field);
+  return planner;
+}
+
+// Runs the searches of findPath at the same time, each on its own planner
+// from makeSearchPlanner. The searches prune the nodes that
+// cost more than the best path found so far, and all of them stop once a
+// search has reached min_overestimate_factor_. Returns true iff a path was
+// found, path is then the one with the lowest cost.
+bool GlobalPlanner::findParallelPath(std::vector<Cell>& path, const Cell& s,
+                                     const Cell& parent_of_s,
+                                     const GoalCell& t,
+                                     const SearchLimits& limits) {
+  struct Hypothesis {
+    std::string node_type;
+    double overestimate_factor;
+    double min_overestimate_factor;
+    std::unique_ptr<GlobalPlanner> planner;
+    std::vector<Cell> path;
+    bool found_path;
+  };
+  std::vector<Hypothesis> hypotheses;
+  double smooth_overestimate = std::min(1.5, max_overestimate_factor_);
+  if (max_overestimate_factor_ > 1.5) {
+    hypotheses.push_back({"NodeWithoutSmooth", max_overestimate_factor_, 1.5});
+  }
+  hypotheses.push_back({default_node_type_, smooth_overestimate,
+                        min_overestimate_factor_});
+  if (min_overestimate_factor_ < smooth_overestimate) {
+    hypotheses.push_back({default_node_type_, min_overestimate_factor_,
+                          min_overestimate_factor_});
+  }
+
+  for (Hypothesis& hypothesis : hypotheses) {
+    hypothesis.planner = makeSearchPlanner();
+  }
+
+  SearchIncumbent incumbent;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < hypotheses.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      Hypothesis& hypothesis = hypotheses[i];
+      GlobalPlanner& planner = *hypothesis.planner;
+      planner.overestimate_factor_ = hypothesis.overestimate_factor;
+      SearchLimits hypothesis_limits = limits;  // The iterations are per search
+      hypothesis_limits.incumbent = &incumbent;
+      hypothesis.found_path = findAnytimePath(
+          &planner, hypothesis.path, s, parent_of_s, t, hypothesis.node_type,
+          hypothesis.min_overestimate_factor, hypothesis_limits,
+          planner.visitor_);
+      if (hypothesis.found_path &&
+          planner.overestimate_factor_ < min_overestimate_factor_) {
+        incumbent.is_cancelled = true;  // Good enough
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // The planners started with the counts of this one
+  const CacheStats stats = risk_cache_stats_;
+  for (const Hypothesis& hypothesis : hypotheses) {
+    const CacheStats& search_stats = hypothesis.planner->risk_cache_stats_;
+    risk_cache_stats_.lookups += search_stats.lookups - stats.lookups;
+    risk_cache_stats_.misses += search_stats.misses - stats.misses;
+  }
+
+  Hypothesis* best = nullptr;
+  double best_cost = INFINITY;
+  for (Hypothesis& hypothesis : hypotheses) {
+    if (hypothesis.found_path) {
+      double cost = hypothesis.planner->getPathInfo(hypothesis.path).cost;
+      if (cost < best_cost) {
+        best = &hypothesis;
+        best_cost = cost;
+      }
+    }
+  }
+  if (!best) {
+    return false;
+  }
+  path = best->path;
+  overestimate_factor_ = best->planner->overestimate_factor_;
+  // The map has not changed, so the risks of the copy are still valid
+  risk_cache_ = std::move(best->planner->risk_cache_);
+  single_risk_cache_ = std::move(best->planner->single_risk_cache_);
+  return true;
+}
+
+// Searches a path on the Cells of level coarse_levels_, without smoothness, and
+// fills corridor_ with the coarse Cells within corridor_radius_ of its edges.
+// A coarse Cell is blocked if an obstacle is anywhere inside it, so there may
+// be no coarse path through narrow gaps, then it returns false.
+bool GlobalPlanner::findCorridor(const Cell& s, const Cell& parent_of_s,
+                                 const GoalCell& t, SearchLimits& limits) {
+  corridor_.clear();
+  corridor_level_ = 0;  // The coarse search is not restricted
+  const int level = coarse_levels_;
+  // The coarse Cell of the goal may be blocked, e.g. by the risk of the ground
+  // below it, so the coarse path may also end in a neighbor of it
+  const Cell coarse_goal = t.atLevel(level);
+  const GoalCell coarse_t(coarse_goal, t.radius_ + 2.0 * coarse_goal.scale());
+  overestimate_factor_ = min_overestimate_factor_;
+
+  std::vector<Cell> coarse_path;
+  NullVisitor visitor;
+  if (!findAnytimePath(
+          this, coarse_path,
+          NodeWithoutSmooth(s.atLevel(level), parent_of_s.atLevel(level)),
+          coarse_t, "Coarse", min_overestimate_factor_, limits, visitor)) {
+    return false;
+  }
+
+  // Every Cell of the corridor is first marked with an infinite distance
+  for (int i = 1; i < coarse_path.size(); ++i) {
+    Node(coarse_path[i], coarse_path[i - 1]).getCells(edge_cells_);
+    for (const Cell& cell : edge_cells_) {
+      for (int dx = -corridor_radius_; dx <= corridor_radius_; ++dx) {
+        for (int dy = -corridor_radius_; dy <= corridor_radius_; ++dy) {
+          for (int dz = -corridor_radius_; dz <= corridor_radius_; ++dz) {
+            corridor_.set(cell.offset(dx, dy, dz), INFINITY);
+          }
+        }
+      }
+    }
+  }
+
+  // Dijkstra from the goal gives the horizontal distance through the corridor
+  std::priority_queue<CellDistancePair, std::vector<CellDistancePair>,
+                      CompareDist>
+      pq;
+  corridor_.set(coarse_path.back(), 0.0);
+  pq.push(std::make_pair(coarse_path.back(), 0.0));
+  while (!pq.empty()) {
+    CellDistancePair cell_dist = pq.top();
+    pq.pop();
+    if (cell_dist.second > corridor_.get(cell_dist.first)) {
+      continue;  // Already settled with a lower distance
+    }
+    for (const Cell& neighbor : cell_dist.first.getNeighbors()) {
+      double new_dist =
+          cell_dist.second + cell_dist.first.distance2D(neighbor);
+      if (new_dist < corridor_.get(neighbor)) {  // False outside, it is NaN
+        corridor_.set(neighbor, new_dist);
+        pq.push(std::make_pair(neighbor, new_dist));
+      }
+    }
+  }
+  corridor_level_ = level;
+  return true;
+}
+
+// Frees the cached risks farthest from the current position if the caches
+// take more than max_cache_memory_, until they take 3/4 of it so that not
+// every search has to evict. The searches are forgotten if they alone are
+// above the limit. Returns the number of freed bytes.
+size_t GlobalPlanner::limitMemory() {
+  const size_t limit = max_cache_memory_ * 1000000.0;
+  const size_t search_memory =
+      incremental_search_.memoryUsage() + risk_field_.memoryUsage();
+  const size_t cache_memory =
+      risk_cache_.memoryUsage() + single_risk_cache_.memoryUsage();
+  if (limit == 0 || search_memory + cache_memory <= limit) {
+    return 0;
+  }
+  size_t freed = 0;
+  if (search_memory > limit) {
+    incremental_search_.reset();
+    risk_field_.reset();
+    freed += search_memory;
+  }
+  // Each cache keeps the same share of its blocks
+  const double keep_share = std::min(
+      1.0, 0.75 * (limit - std::min(limit, search_memory - freed)) /
+               std::max<size_t>(cache_memory, 1));
+  const Cell center(curr_pos_);
+  for (CellGrid<double>* cache : {&risk_cache_, &single_risk_cache_}) {
+    size_t before = cache->memoryUsage();
+    cache->evictFarthestBlocks(center, keep_share * cache->numBlocks());
+    freed += before - cache->memoryUsage();
+  }
+  ROS_INFO("Freed %2.3f MB of the planner caches", freed / 1000000.0);
+  return freed;
+}
+
+// The memory of the octomap and of the containers that grow during a mission
+MemoryUsageMsg GlobalPlanner::getMemoryUsageMsg() {
+  MemoryUsageMsg msg;
+  msg.header.stamp = ros::Time::now();
+  msg.octomap = octree_ ? octree_->memoryUsage() : 0;
+  msg.risk_caches = risk_cache_.memoryUsage() +
+                    single_risk_cache_.memoryUsage() + corridor_.memoryUsage();
+  msg.known_cells = occupied_.memoryUsage() + path_cells_.memoryUsage();
+  msg.path_back = path_back_.memoryUsage();
+  msg.searches = incremental_search_.memoryUsage() + risk_field_.memoryUsage();
+  msg.total = msg.octomap + msg.risk_caches + msg.known_cells + msg.path_back +
+              msg.searches;
+  msg.limit = max_cache_memory_ * 1000000.0;
+  return msg;
+}
+
 // Returns true iff a path needs to be published, either a new path or a path
 // back The path is then stored in this.pathMsg
 bool GlobalPlanner::getGlobalPath() {
@@ -529,6 +1029,7 @@ bool GlobalPlanner::getGlobalPath() {
   } else {
     // Both current position and goal are free, try to find a path
     std::vector<Cell> path;
+    limitMemory();
     if (!findPath(path)) {
       double goal_risk = getRisk(t);
       ROS_INFO("  Failed to find a path, risk of t: %3.2f", goal_risk);
@@ -545,7 +1046,8 @@ bool GlobalPlanner::getGlobalPath() {
 void GlobalPlanner::goBack() {
   ROS_INFO("  GO BACK ");
   going_back_ = true;
-  std::vector<Cell> new_path = path_back_;
+  std::vector<Cell> new_path;
+  path_back_.getCells(new_path);
   std::reverse(new_path.begin(), new_path.end());
 
   // Follow the path back until the risk is low
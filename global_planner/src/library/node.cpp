@@ -1,7 +1,11 @@
 #include "global_planner/node.h"
 
+#include <algorithm>
+
 namespace global_planner {
 
+double SPEEDNODE_RADIUS = 5.0;
+
 bool Node::isSmaller(const Node& other) const {
   return cell_ < other.cell_ ||
          (cell_ == other.cell_ && parent_ < other.parent_);
@@ -15,21 +19,8 @@ std::size_t Node::hash() const {
          std::hash<global_planner::Cell>()(parent_);
 }
 
-NodePtr Node::nextNode(const Cell& nextCell) const {
-  return NodePtr(new Node(nextCell, cell_));
-}
-
-std::vector<NodePtr> Node::getNeighbors() const {
-  std::vector<NodePtr> neighbors;
-  neighbors.reserve(10);
-  for (const Cell& neighborCell : cell_.getNeighbors()) {
-    neighbors.push_back(nextNode(neighborCell));
-  }
-  return neighbors;
-}
-
-std::unordered_set<Cell> Node::getCells() const {
-  std::unordered_set<Cell> cells;
+void Node::getCells(std::vector<Cell>& cells) const {
+  cells.clear();
   int dx = cell_.xIndex() - parent_.xIndex();
   int dy = cell_.yIndex() - parent_.yIndex();
   int dz = cell_.zIndex() - parent_.zIndex();
@@ -39,17 +30,24 @@ std::unordered_set<Cell> Node::getCells() const {
   double x_step = (cell_.xPos() - parent_.xPos()) / steps;
   double y_step = (cell_.yPos() - parent_.yPos()) / steps;
   double z_step = (cell_.zPos() - parent_.zPos()) / steps;
+  const int level = cell_.level();
 
   for (int i = 1; i <= steps; ++i) {
     double new_x = parent_.xPos() + x_step * i;
     double new_y = parent_.yPos() + y_step * i;
     double new_z = parent_.zPos() + z_step * i;
-    cells.insert(Cell(new_x + 0.1, new_y + 0.1, new_z));
-    cells.insert(Cell(new_x + 0.1, new_y - 0.1, new_z));
-    cells.insert(Cell(new_x - 0.1, new_y + 0.1, new_z));
-    cells.insert(Cell(new_x - 0.1, new_y - 0.1, new_z));
+    cells.push_back(Cell(new_x + 0.1, new_y + 0.1, new_z, level));
+    cells.push_back(Cell(new_x + 0.1, new_y - 0.1, new_z, level));
+    cells.push_back(Cell(new_x - 0.1, new_y + 0.1, new_z, level));
+    cells.push_back(Cell(new_x - 0.1, new_y - 0.1, new_z, level));
   }
-  return cells;
+
+  // Consecutive steps mostly hit the same Cells, sorting the few Cells is
+  // cheaper than a set
+  std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+    return a.key() < b.key();
+  });
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
 }
 
 double Node::getLength() const { return parent_.distance3D(cell_); }
@@ -89,4 +87,16 @@ std::string Node::asString() const {
   return s;
 }
 
+void getNeighbors(const SpeedNode& node, std::vector<SpeedNode>& neighbors) {
+  neighbors.clear();
+  Cell extrapolate_cell = (node.cell_ - node.parent_) + node.cell_;
+  neighbors.push_back(SpeedNode(extrapolate_cell, node.cell_));
+  for (const Cell& neighbor_cell : extrapolate_cell.getNeighbors()) {
+    double dist = node.cell_.distance3D(neighbor_cell);
+    if (dist > 0 && dist < SPEEDNODE_RADIUS) {
+      neighbors.push_back(SpeedNode(neighbor_cell, node.cell_));
+    }
+  }
+}
+
 }  // namespace global_planner
@@ -0,0 +1,422 @@
+// Offline benchmark of the global planner search. Runs the searches of
+// GlobalPlanner::findPath without a ROS master and reports, for every node
+// type and overestimate factor of the anytime search, the iterations, the
+// iterations per second, the time until the path was found, the cost of the
+// path and the peak memory of the process. The JSON also has the counters of
+// CountersVisitor. Every leg is also planned once with findPath itself, and
+// with --coarse-levels once more with findPath planning on coarse Cells first.
+//
+// The map is either an octomap (.bt file) or the walls of
+// MockDataNode::createWall, inserted into an empty octomap as octomap_server
+// would insert the points of the mock data node. The legs go from the start to
+// the first goal and from each goal to the next one.
+//
+// usage:
+//   global_planner_bench [--octomap map.bt] [--wall dist width height]
+//                        [--goals resource/random_goals] [--start x y z]
+//                        [--max-iterations n] [--coarse-levels n]
+//                        [--json results.json]
+//
+// The goals file has the format of the waypoints of global_planner_node, one
+// "x y z" per line. Without --octomap and --wall the wall of the mock data
+// node is used, without goals its clicked point at the default altitude of
+// clicked goals. With --json the results are also written as JSON, so that
+// runs of different versions can be compared.
+
+#include "global_planner/global_planner.h"
+#include "global_planner/search_tools.h"
+
+#include <ros/console.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace global_planner;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Scenario {
+  std::string name;
+  std::shared_ptr<octomap::OcTree> octree;
+  std::vector<Cell> occupied;  // The cells seen by the depth camera
+};
+
+struct BenchResult {
+  std::string scenario;
+  int leg;
+  std::string search;  // AnytimeSearch or findPath
+  std::string node_type;
+  double overestimate_factor;
+  bool found_path;
+  int num_iter;  // -1 if not known, as the other counters
+  PhaseCounters counters;
+  double search_ms;
+  double time_to_path_ms;  // Since the start of the anytime search
+  PathInfo path_info;
+  long peak_rss_kb;
+};
+
+const char* const node_types[] = {"NodeWithoutSmooth", "Node", "SpeedNode"};
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// NAN if the iterations are not known
+double iterationsPerSecond(const BenchResult& result) {
+  if (result.num_iter < 0 || result.search_ms <= 0.0) {
+    return NAN;
+  }
+  return result.num_iter * 1000.0 / result.search_ms;
+}
+
+// The largest resident set size of the process so far
+long peakRssKb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// The overestimate factors findPath goes through, followed by the optimal
+// search as reference for the cost
+std::vector<double> getOverestimateFactors(const GlobalPlanner& planner) {
+  std::vector<double> factors;
+  for (double factor = planner.max_overestimate_factor_;
+       factor >= planner.min_overestimate_factor_;
+       factor = (factor - 1.0) / 4.0 + 1.0) {
+    factors.push_back(factor);
+  }
+  factors.push_back(1.0);
+  return factors;
+}
+
+bool readGoals(const std::string& path, std::vector<GoalCell>& goals) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  double x, y, z;
+  while (file >> x >> y >> z) {
+    goals.push_back(GoalCell(x, y, z));
+  }
+  return true;
+}
+
+bool readOctomap(const std::string& path, Scenario& scenario) {
+  scenario.name = path;
+  scenario.octree = std::make_shared<octomap::OcTree>(1.0);
+  return scenario.octree->readBinary(path);
+}
+
+// The wall of MockDataNode::createWall, seen from origin
+Scenario createWall(int dist, int width, int height, const Cell& origin) {
+  Scenario scenario;
+  scenario.name = "wall_" + std::to_string(dist) + "_" +
+                  std::to_string(width) + "_" + std::to_string(height);
+  scenario.octree = std::make_shared<octomap::OcTree>(1.0);
+  octomap::Pointcloud cloud;
+  for (int i = -width; i <= width; ++i) {
+    for (int j = 0; j <= height; ++j) {
+      cloud.push_back(dist + 0.5, i + 0.5, j + 0.5);
+      scenario.occupied.push_back(Cell(dist + 0.5, i + 0.5, j + 0.5));
+    }
+  }
+  octomap::point3d sensor_origin(origin.xPos(), origin.yPos(), origin.zPos());
+  scenario.octree->insertPointCloud(cloud, sensor_origin);
+  return scenario;
+}
+
+void initPlanner(GlobalPlanner& planner, const Scenario& scenario,
+                 int max_iterations) {
+  planner.octree_ = scenario.octree.get();
+  planner.max_iterations_ = max_iterations;
+  planner.setOccupied(scenario.occupied);
+}
+
+// Lowers the overestimate factor of one anytime search after every path, as
+// findPath does
+template <typename NodeType>
+void runAnytimeSearch(const Scenario& scenario, int leg, const Cell& start,
+                      const GoalCell& goal, const std::string& node_type,
+                      int max_iterations, std::vector<BenchResult>& results) {
+  GlobalPlanner planner;
+  initPlanner(planner, scenario, max_iterations);
+  CountersVisitor<GlobalPlanner> visitor(&planner);
+  AnytimeSearch<GlobalPlanner, NodeType, CountersVisitor<GlobalPlanner>> search(
+      &planner, NodeType(start, start), goal, visitor);
+  SearchLimits limits(max_iterations);
+
+  Clock::time_point start_time = Clock::now();
+  for (double factor : getOverestimateFactors(planner)) {
+    planner.overestimate_factor_ = factor;
+    Clock::time_point search_start_time = Clock::now();
+    std::vector<Cell> path;
+    SearchInfo search_info = search.improvePath(path, limits);
+    double search_ms = millisecondsSince(search_start_time);
+    limits.max_iterations -= search_info.num_iter;
+
+    BenchResult result;
+    result.scenario = scenario.name;
+    result.leg = leg;
+    result.search = "AnytimeSearch";
+    result.node_type = node_type;
+    result.overestimate_factor = factor;
+    result.found_path = search_info.found_path;
+    result.num_iter = search_info.num_iter;
+    result.counters = visitor.phases_.back();
+    result.search_ms = search_ms;
+    result.time_to_path_ms = millisecondsSince(start_time);
+    result.path_info = {true, INFINITY, INFINITY, INFINITY, INFINITY};
+    if (search_info.found_path) {
+      result.path_info = planner.getPathInfo(path);
+    }
+    result.peak_rss_kb = peakRssKb();
+    results.push_back(result);
+    if (!search_info.found_path) {
+      break;  // Out of iterations
+    }
+  }
+}
+
+void runAnytimeSearch(const Scenario& scenario, int leg, const Cell& start,
+                      const GoalCell& goal, const std::string& node_type,
+                      int max_iterations, std::vector<BenchResult>& results) {
+  if (node_type == "NodeWithoutSmooth") {
+    runAnytimeSearch<NodeWithoutSmooth>(scenario, leg, start, goal, node_type,
+                                        max_iterations, results);
+  } else if (node_type == "SpeedNode") {
+    runAnytimeSearch<SpeedNode>(scenario, leg, start, goal, node_type,
+                                max_iterations, results);
+  } else {
+    runAnytimeSearch<Node>(scenario, leg, start, goal, node_type,
+                           max_iterations, results);
+  }
+}
+
+// Plans the leg as the node does, with the time limit of search_time_
+void runFindPath(const Scenario& scenario, int leg, const Cell& start,
+                 const GoalCell& goal, int max_iterations, int coarse_levels,
+                 std::vector<BenchResult>& results) {
+  GlobalPlanner planner;
+  initPlanner(planner, scenario, max_iterations);
+  planner.coarse_levels_ = coarse_levels;
+  geometry_msgs::PoseStamped pose;
+  pose.pose.position = start.toPoint();
+  pose.pose.orientation.w = 1.0;
+  planner.setPose(pose);
+  planner.setGoal(goal);
+
+  Clock::time_point start_time = Clock::now();
+  std::vector<Cell> path;
+  bool found_path = planner.findPath(path);
+  double search_ms = millisecondsSince(start_time);
+
+  BenchResult result;
+  result.scenario = scenario.name;
+  result.leg = leg;
+  result.search = coarse_levels > 0 ? "findPathCoarse" : "findPath";
+  result.node_type = planner.default_node_type_;
+  result.overestimate_factor = planner.overestimate_factor_;
+  result.found_path = found_path;
+  result.num_iter = -1;
+  result.search_ms = search_ms;
+  result.time_to_path_ms = search_ms;
+  result.path_info = {true, INFINITY, INFINITY, INFINITY, INFINITY};
+  if (found_path) {
+    result.path_info = planner.getPathInfo(path);
+  }
+  result.peak_rss_kb = peakRssKb();
+  results.push_back(result);
+}
+
+// JSON has no infinity, numbers which are not finite are written as null
+std::string jsonNumber(double value) {
+  if (!std::isfinite(value)) {
+    return "null";
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+  return buffer;
+}
+
+bool writeJson(const std::string& path, int max_iterations,
+               const std::vector<BenchResult>& results) {
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  std::fprintf(file, "{\n  \"max_iterations\": %d,\n  \"results\": [",
+               max_iterations);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    std::fprintf(file, "%s\n    {", i == 0 ? "" : ",");
+    std::fprintf(file, "\"scenario\": \"%s\", \"leg\": %d, ",
+                 r.scenario.c_str(), r.leg);
+    std::fprintf(file, "\"search\": \"%s\", \"node_type\": \"%s\", ",
+                 r.search.c_str(), r.node_type.c_str());
+    std::fprintf(file, "\"overestimate_factor\": %s, \"found_path\": %s, ",
+                 jsonNumber(r.overestimate_factor).c_str(),
+                 r.found_path ? "true" : "false");
+    if (r.num_iter < 0) {
+      std::fprintf(file,
+                   "\"iterations\": null, \"nodes_generated\": null, "
+                   "\"nodes_reopened\": null, \"max_open_size\": null, "
+                   "\"risk_cache_hit_rate\": null, ");
+    } else {
+      std::fprintf(file, "\"iterations\": %d, \"nodes_generated\": %d, ",
+                   r.num_iter, r.counters.num_generated);
+      std::fprintf(file, "\"nodes_reopened\": %d, \"max_open_size\": %zu, ",
+                   r.counters.num_reopened, r.counters.max_open_size);
+      std::fprintf(file, "\"risk_cache_hit_rate\": %s, ",
+                   jsonNumber(r.counters.riskCacheHitRate()).c_str());
+    }
+    std::fprintf(file, "\"iterations_per_s\": %s, \"search_ms\": %s, ",
+                 jsonNumber(iterationsPerSecond(r)).c_str(),
+                 jsonNumber(r.search_ms).c_str());
+    std::fprintf(file, "\"time_to_path_ms\": %s, \"cost\": %s, ",
+                 jsonNumber(r.time_to_path_ms).c_str(),
+                 jsonNumber(r.path_info.cost).c_str());
+    std::fprintf(file, "\"dist\": %s, \"risk\": %s, \"smoothness\": %s, ",
+                 jsonNumber(r.path_info.dist).c_str(),
+                 jsonNumber(r.path_info.risk).c_str(),
+                 jsonNumber(r.path_info.smoothness).c_str());
+    std::fprintf(file, "\"peak_rss_kb\": %ld}", r.peak_rss_kb);
+  }
+  std::fprintf(file, "\n  ]\n}\n");
+  return std::fclose(file) == 0;
+}
+
+void printResults(const std::vector<BenchResult>& results) {
+  std::printf("\n%-16s %3s %-14s %-18s %7s %8s %10s %10s %9s %8s\n",
+              "scenario", "leg", "search", "node type", "overest", "iter",
+              "iter/s", "path [ms]", "cost", "rss [MB]");
+  for (const BenchResult& r : results) {
+    std::string num_iter = "-";
+    std::string iter_per_s = "-";
+    if (r.num_iter >= 0) {
+      num_iter = std::to_string(r.num_iter);
+    }
+    if (!std::isnan(iterationsPerSecond(r))) {
+      iter_per_s = std::to_string(std::lround(iterationsPerSecond(r)));
+    }
+    std::printf("%-16s %3d %-14s %-18s %7.4g %8s %10s %10.3f %9.2f %8.1f\n",
+                r.scenario.c_str(), r.leg, r.search.c_str(),
+                r.node_type.c_str(), r.overestimate_factor, num_iter.c_str(),
+                iter_per_s.c_str(), r.time_to_path_ms, r.path_info.cost,
+                r.peak_rss_kb / 1024.0);
+  }
+}
+
+void printUsage() {
+  std::fprintf(stderr,
+               "usage: global_planner_bench [--octomap <bt>] "
+               "[--wall dist width height] [--goals <file>] [--start x y z] "
+               "[--max-iterations n] [--coarse-levels n] [--json <file>]\n");
+}
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> octomap_paths;
+  std::vector<std::vector<int>> walls;
+  std::string goals_path;
+  std::string json_path;
+  Cell start(0.5, 0.5, 3.5);  // The default start of global_planner_node
+  int max_iterations = 100000;
+  int coarse_levels = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--octomap" && i + 1 < argc) {
+      octomap_paths.push_back(argv[++i]);
+    } else if (arg == "--wall" && i + 3 < argc) {
+      std::vector<int> wall;
+      for (int j = 0; j < 3; j++) {
+        wall.push_back(std::atoi(argv[++i]));
+      }
+      walls.push_back(wall);
+    } else if (arg == "--goals" && i + 1 < argc) {
+      goals_path = argv[++i];
+    } else if (arg == "--start" && i + 3 < argc) {
+      double x = std::atof(argv[++i]);
+      double y = std::atof(argv[++i]);
+      double z = std::atof(argv[++i]);
+      start = Cell(x, y, z);
+    } else if (arg == "--max-iterations" && i + 1 < argc) {
+      max_iterations = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--coarse-levels" && i + 1 < argc) {
+      coarse_levels = std::max(0, std::atoi(argv[++i]));
+    } else if (arg == "--json" && i + 1 < argc) {
+      json_path = argv[++i];
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (octomap_paths.empty() && walls.empty()) {
+    walls.push_back({5, 5, 6});  // The wall of the mock data node
+  }
+
+  std::vector<GoalCell> goals;
+  if (!goals_path.empty() && !readGoals(goals_path, goals)) {
+    std::fprintf(stderr, "Could not read goals %s\n", goals_path.c_str());
+    return 1;
+  }
+  if (goals.empty()) {
+    // The clicked point of the mock data node, at the default altitude of
+    // clicked goals
+    goals.push_back(GoalCell(8.5, 4.5, 3.5));
+  }
+
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
+                                     ros::console::levels::Warn)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+
+  std::vector<Scenario> scenarios;
+  for (const std::string& path : octomap_paths) {
+    Scenario scenario;
+    if (!readOctomap(path, scenario)) {
+      std::fprintf(stderr, "Could not read octomap %s\n", path.c_str());
+      return 1;
+    }
+    scenarios.push_back(scenario);
+  }
+  for (const std::vector<int>& wall : walls) {
+    scenarios.push_back(createWall(wall[0], wall[1], wall[2], start));
+  }
+
+  std::vector<BenchResult> results;
+  for (const Scenario& scenario : scenarios) {
+    Cell leg_start = start;
+    for (int leg = 0; leg < goals.size(); ++leg) {
+      for (const char* node_type : node_types) {
+        runAnytimeSearch(scenario, leg, leg_start, goals[leg], node_type,
+                         max_iterations, results);
+      }
+      runFindPath(scenario, leg, leg_start, goals[leg], max_iterations, 0,
+                  results);
+      if (coarse_levels > 0) {
+        runFindPath(scenario, leg, leg_start, goals[leg], max_iterations,
+                    coarse_levels, results);
+      }
+      leg_start = goals[leg];
+    }
+  }
+
+  printResults(results);
+  if (!json_path.empty() && !writeJson(json_path, max_iterations, results)) {
+    std::fprintf(stderr, "Could not write %s\n", json_path.c_str());
+    return 1;
+  }
+  return 0;
+}
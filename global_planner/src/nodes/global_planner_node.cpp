@@ -2,9 +2,8 @@
 
 namespace global_planner {
 
-GlobalPlannerNode::GlobalPlannerNode() {
-  nh_ = ros::NodeHandle("~");
-
+GlobalPlannerNode::GlobalPlannerNode(const ros::NodeHandle& nh)
+    : nh_(nh), server_(nh_) {
   // Set up Dynamic Reconfigure Server
   dynamic_reconfigure::Server<
       global_planner::GlobalPlannerNodeConfig>::CallbackType f;
@@ -17,6 +16,9 @@ GlobalPlannerNode::GlobalPlannerNode() {
   // Subscribers
   octomap_full_sub_ = nh_.subscribe(
       "/octomap_full", 1, &GlobalPlannerNode::octomapFullCallback, this);
+  // Every delta is needed to keep the map up to date
+  octomap_delta_sub_ = nh_.subscribe(
+      "/octomap_delta", 100, &GlobalPlannerNode::octomapDeltaCallback, this);
   ground_truth_sub_ = nh_.subscribe("/mavros/local_position/pose", 1,
                                     &GlobalPlannerNode::positionCallback, this);
   velocity_sub_ = nh_.subscribe("/mavros/local_position/velocity", 1,
@@ -30,8 +32,13 @@ GlobalPlannerNode::GlobalPlannerNode() {
                     &GlobalPlannerNode::moveBaseSimpleCallback, this);
   laser_sensor_sub_ =
       nh_.subscribe("/scan", 1, &GlobalPlannerNode::laserSensorCallback, this);
-  depth_camera_sub_ = nh_.subscribe(
-      "/camera/depth/points", 1, &GlobalPlannerNode::depthCameraCallback, this);
+  depth_camera_sub_.subscribe(nh_, "/camera/depth/points", 1);
+  depth_camera_filter_.reset(new tf::MessageFilter<sensor_msgs::PointCloud2>(
+      depth_camera_sub_, listener_, "/world", 1));
+  depth_camera_filter_->registerCallback(
+      boost::bind(&GlobalPlannerNode::depthCameraCallback, this, _1));
+  depth_camera_thread_ =
+      std::thread(&GlobalPlannerNode::depthCameraThread, this);
 
   // Publishers
   three_points_pub_ = nh_.advertise<nav_msgs::Path>("/three_points", 10);
@@ -50,13 +57,23 @@ GlobalPlannerNode::GlobalPlannerNode() {
       nh_.advertise<geometry_msgs::PointStamped>("/global_temp_goal", 10);
   explored_cells_pub_ =
       nh_.advertise<visualization_msgs::MarkerArray>("/explored_cells", 10);
+  memory_usage_pub_ =
+      nh_.advertise<MemoryUsageMsg>("/global_planner_memory", 10);
 
   actual_path_.header.frame_id = "/world";
   listener_.waitForTransform("/fcu", "/world", ros::Time(0),
                              ros::Duration(3.0));
 }
 
-GlobalPlannerNode::~GlobalPlannerNode() {}
+GlobalPlannerNode::~GlobalPlannerNode() {
+  {
+    std::lock_guard<std::mutex> lock(depth_camera_mutex_);
+    is_shutting_down_ = true;
+  }
+  depth_camera_cv_.notify_one();
+  depth_camera_thread_.join();
+  depth_camera_filter_.reset();  // Disconnects from listener_
+}
 
 // Read Ros parameters
 void GlobalPlannerNode::readParams() {
@@ -65,6 +82,25 @@ void GlobalPlannerNode::readParams() {
   nh_.param<double>("start_pos_y", y, 0.5);
   nh_.param<double>("start_pos_z", z, 3.5);
   global_planner_.goal_pos_ = GoalCell(x, y, z);
+  // Only every n-th full octomap is processed, 1 for all of them
+  nh_.param<int>("octomap_full_interval", octomap_full_interval_, 10);
+  octomap_full_interval_ = std::max(1, octomap_full_interval_);
+}
+
+// Appends the waypoints in the file, given as "x y z" per line
+bool GlobalPlannerNode::readWaypointFile(const std::string& file_name) {
+  ROS_INFO("    ARGS: %s", file_name.c_str());
+  std::ifstream wp_file(file_name.c_str());
+  if (!wp_file.is_open()) {
+    ROS_ERROR_STREAM("Unable to open goal file: " << file_name);
+    return false;
+  }
+  double x, y, z;
+  while (wp_file >> x >> y >> z) {
+    waypoints_.push_back(Cell(x, y, z));
+  }
+  ROS_INFO("  Read %d waypoints.", static_cast<int>(waypoints_.size()));
+  return true;
 }
 
 // Sets a new goal, plans a path to it and publishes some info
@@ -93,12 +129,14 @@ void GlobalPlannerNode::popNextGoal() {
 // Plans a new path and publishes it
 void GlobalPlannerNode::planPath() {
   std::clock_t start_time = std::clock();
+  insertOccupiedCells();
   if (global_planner_.octree_) {
     ROS_INFO("OctoMap memory usage: %2.3f MB",
              global_planner_.octree_->memoryUsage() / 1000000.0);
   }
 
   bool found_path = global_planner_.getGlobalPath();
+  memory_usage_pub_.publish(global_planner_.getMemoryUsageMsg());
 
   // Publish even though no path is found
   publishExploredCells();
@@ -116,6 +154,18 @@ void GlobalPlannerNode::planPath() {
          (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
 }
 
+// Plans a new path if a map update made the current path bad
+void GlobalPlannerNode::replanIfPathIsBad(bool current_path_is_ok) {
+  if (!current_path_is_ok) {
+    ROS_INFO("  Path is bad, planning a new path \n");
+    if (global_planner_.goal_pos_.is_temporary_) {
+      popNextGoal();  // Throw away temporary goal
+    } else {
+      planPath();  // Plan a whole new path
+    }
+  }
+}
+
 // Sets a temporary goal on the path to the current goal
 void GlobalPlannerNode::setIntermediateGoal() {
   int curr_path_length = global_planner_.curr_path_.size();
@@ -148,16 +198,30 @@ void GlobalPlannerNode::dynamicReconfigureCallback(
   global_planner_.use_current_yaw_ = config.use_current_yaw_;
   global_planner_.use_risk_heuristics_ = config.use_risk_heuristics_;
   global_planner_.use_speedup_heuristics_ = config.use_speedup_heuristics_;
+  global_planner_.use_incremental_search_ = config.use_incremental_search_;
+  global_planner_.use_parallel_search_ = config.use_parallel_search_;
+  global_planner_.use_risk_field_ = config.use_risk_field_;
+  global_planner_.coarse_levels_ = config.coarse_levels_;
+  global_planner_.corridor_radius_ = config.corridor_radius_;
+  global_planner_.max_cache_memory_ = config.max_cache_memory_;
+  // The costs of the incremental search and of the risk field may have changed
+  global_planner_.incremental_search_.reset();
+  global_planner_.risk_field_.reset();
 
   // global_planner_node
   clicked_goal_alt_ = config.clicked_goal_alt_;
   clicked_goal_radius_ = config.clicked_goal_radius_;
-  simplify_iterations_ = config.simplify_iterations_;
   simplify_margin_ = config.simplify_margin_;
+  path_msg_.reset();  // The simplified path may change
 
   // cell
   if (level == 2) {
+    // The worker thread turns clouds into Cells, it gets the new scale from
+    // here and its Cells of the old scale are dropped
+    std::lock_guard<std::mutex> lock(depth_camera_mutex_);
     CELL_SCALE = config.CELL_SCALE;
+    cell_scale_ = CELL_SCALE;
+    occupied_cells_.clear();
   }
 
   // node
@@ -247,8 +311,8 @@ void GlobalPlannerNode::threePointCallback(const nav_msgs::Path& msg) {
     Cell s = Cell(interpolate(msg.poses[0].pose.position,
                               msg.poses[1].pose.position, 0.25));
     Cell t = GoalCell(Cell(msg.poses[2].pose.position), 5.0);
-    auto start_node = global_planner_.getStartNode(s, parent, "SpeedNode");
-    auto search_res = findSmoothPath(&global_planner_, new_path, start_node, t);
+    auto search_res =
+        findSmoothPath(&global_planner_, new_path, SpeedNode(s, parent), t);
     new_msg = global_planner_.getPathMsg(new_path);
   }
   three_points_revised_pub_.publish(smoothPath(new_msg));
@@ -282,51 +346,110 @@ void GlobalPlannerNode::laserSensorCallback(const sensor_msgs::LaserScan& msg) {
   }
 }
 
-// Check if the current path is blocked
-void GlobalPlannerNode::octomapFullCallback(const octomap_msgs::Octomap& msg) {
-  if (num_octomap_msg_++ % 10 > 0) {
-    return;  // We get too many of those messages. Only process 1/10 of them
+// Check if the current path is blocked. The maps are taken as shared messages,
+// which are not copied from an octomap server in the same process
+void GlobalPlannerNode::octomapFullCallback(
+    const octomap_msgs::Octomap::ConstPtr& msg) {
+  if (num_octomap_delta_msg_ > 0) {
+    return;  // The map is kept up to date by the deltas
+  }
+  if (num_octomap_msg_++ % octomap_full_interval_ > 0) {
+    return;  // Only process every octomap_full_interval_-th map
   }
 
-  bool current_path_is_ok = global_planner_.updateFullOctomap(msg);
-  if (!current_path_is_ok) {
-    ROS_INFO("  Path is bad, planning a new path \n");
-    if (global_planner_.goal_pos_.is_temporary_) {
-      popNextGoal();  // Throw away temporary goal
-    } else {
-      planPath();  // Plan a whole new path
+  path_msg_.reset();  // The simplified path depends on the map
+  replanIfPathIsBad(global_planner_.updateFullOctomap(*msg));
+}
+
+// Apply the changed leaves and check if the current path is blocked
+void GlobalPlannerNode::octomapDeltaCallback(
+    const OctomapDeltaMsg::ConstPtr& msg) {
+  num_octomap_delta_msg_++;
+  path_msg_.reset();  // The simplified path depends on the map
+  replanIfPathIsBad(global_planner_.updateOctomapDelta(*msg));
+}
+
+// Hands the cloud to the worker thread, a cloud which is still waiting is
+// dropped
+void GlobalPlannerNode::depthCameraCallback(
+    const sensor_msgs::PointCloud2::ConstPtr& msg) {
+  {
+    std::lock_guard<std::mutex> lock(depth_camera_mutex_);
+    pending_cloud_ = msg;
+  }
+  depth_camera_cv_.notify_one();
+  insertOccupiedCells();
+}
+
+// Turns the pending clouds into Cells until the node shuts down
+void GlobalPlannerNode::depthCameraThread() {
+  std::unique_lock<std::mutex> lock(depth_camera_mutex_);
+  while (true) {
+    depth_camera_cv_.wait(
+        lock, [this] { return is_shutting_down_ || pending_cloud_; });
+    if (is_shutting_down_) {
+      return;
+    }
+    sensor_msgs::PointCloud2::ConstPtr msg = pending_cloud_;
+    pending_cloud_.reset();
+    const double cell_scale = cell_scale_;
+    lock.unlock();
+    std::vector<Cell> cells = getOccupiedCells(*msg, cell_scale);
+    lock.lock();
+    if (cell_scale == cell_scale_) {
+      occupied_cells_.insert(occupied_cells_.end(), cells.begin(),
+                             cells.end());
     }
   }
 }
 
-// Go through obstacle points and store them
-void GlobalPlannerNode::depthCameraCallback(
-    const sensor_msgs::PointCloud2& msg) {
+// Returns the Cells of size cell_scale which contain a point of msg, each Cell
+// only once. It runs on the worker thread, which does not read CELL_SCALE.
+std::vector<Cell> GlobalPlannerNode::getOccupiedCells(
+    const sensor_msgs::PointCloud2& msg, double cell_scale) {
+  std::vector<Cell> cells;
   try {
-    // Transform msg from camera frame to world frame
-    ros::Time now = ros::Time::now();
-    listener_.waitForTransform("/world", "/camera_link", now,
-                               ros::Duration(5.0));
-    tf::StampedTransform transform;
-    listener_.lookupTransform("/world", "/camera_link", now, transform);
+    // The message filter has waited until the transform at the stamp of msg
+    // is available
     sensor_msgs::PointCloud2 transformed_msg;
-    pcl_ros::transformPointCloud("/world", transform, msg, transformed_msg);
+    pcl_ros::transformPointCloud("/world", msg, transformed_msg, listener_);
     pcl::PointCloud<pcl::PointXYZ>
         cloud;  // Easier to loop through pcl::PointCloud
     pcl::fromROSMsg(transformed_msg, cloud);
 
-    // Store the obstacle points
+    cells.reserve(cloud.size());
     for (const auto& p : cloud) {
       if (!std::isnan(p.x)) {
-        // TODO: Not all points end up here
-        Cell occupied_cell(p.x, p.y, p.z);
-        global_planner_.occupied_.insert(occupied_cell);
+        cells.push_back(Cell(std::tuple<int, int, int>(
+            std::floor(p.x / cell_scale), std::floor(p.y / cell_scale),
+            std::floor(p.z / cell_scale))));
       }
     }
   } catch (tf::TransformException const& ex) {
     ROS_DEBUG("%s", ex.what());
-    ROS_WARN("Transformation not available (/world to /camera_link");
+    ROS_WARN("Transformation not available (/world to %s)",
+             msg.header.frame_id.c_str());
+  }
+
+  // Most points of a cloud share their Cell with the points around them
+  std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+    return a.key() < b.key();
+  });
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+  return cells;
+}
+
+// Stores the obstacle Cells found by the worker thread
+void GlobalPlannerNode::insertOccupiedCells() {
+  std::vector<Cell> cells;
+  {
+    std::lock_guard<std::mutex> lock(depth_camera_mutex_);
+    cells.swap(occupied_cells_);
+  }
+  if (!cells.empty()) {
+    path_msg_.reset();  // The simplified path depends on the map
   }
+  global_planner_.setOccupied(cells);
 }
 
 // Publish the position of goal
@@ -342,41 +465,65 @@ void GlobalPlannerNode::publishGoal(const GoalCell& goal) {
   }
 }
 
+// Builds the messages of the current path, unless they are up to date
+void GlobalPlannerNode::updatePathMsgs() {
+  if (path_msg_ && path_of_msgs_ == global_planner_.curr_path_) {
+    return;
+  }
+  path_of_msgs_ = global_planner_.curr_path_;
+  path_msg_.reset(new nav_msgs::Path(global_planner_.getPathMsg()));
+  smoothPath(*path_msg_, reusablePathMsg(smooth_path_msg_));
+
+  simple_path_ = global_planner_.curr_path_;
+  simplifyPath(&global_planner_, simple_path_, simplify_margin_);
+  simple_path_msg_.reset(
+      new nav_msgs::Path(global_planner_.getPathMsg(simple_path_)));
+  smoothPath(*simple_path_msg_, reusablePathMsg(simple_smooth_path_msg_));
+}
+
+// Returns the message to write a new path to. A published message is reused
+// when no subscriber holds it anymore, then its poses are not allocated again
+nav_msgs::Path& GlobalPlannerNode::reusablePathMsg(nav_msgs::Path::Ptr& msg) {
+  if (!msg || msg.use_count() > 1) {
+    msg.reset(new nav_msgs::Path);
+  }
+  return *msg;
+}
+
 // Publish the current path
 void GlobalPlannerNode::publishPath() {
-  auto path_msg = global_planner_.getPathMsg();
-  PathWithRiskMsg risk_msg = global_planner_.getPathWithRiskMsg();
+  updatePathMsgs();
   // Always publish as temporary to remove any obsolete temporary path
-  global_temp_path_pub_.publish(path_msg);
+  global_temp_path_pub_.publish(path_msg_);
   if (!global_planner_.goal_pos_.is_temporary_) {
-    global_path_pub_.publish(path_msg);
+    global_path_pub_.publish(path_msg_);
   }
-  smooth_path_pub_.publish(smoothPath(path_msg));
-
-  auto simple_path = simplifyPath(&global_planner_, global_planner_.curr_path_,
-                                  simplify_iterations_, simplify_margin_);
-  auto simple_path_msg = global_planner_.getPathMsg(simple_path);
-  global_temp_path_pub_.publish(simple_path_msg);
-  smooth_path_pub_.publish(smoothPath(simple_path_msg));
+  smooth_path_pub_.publish(smooth_path_msg_);
+  global_temp_path_pub_.publish(simple_path_msg_);
+  smooth_path_pub_.publish(simple_smooth_path_msg_);
 }
 
-// Publish the cells that were explored in the last search
+// Publish the cells that were explored in the last search, as one cube list
 // Can be tweeked to publish other info (path_cells)
 void GlobalPlannerNode::publishExploredCells() {
+  if (explored_cells_pub_.getNumSubscribers() == 0) {
+    return;  // Saves looking up every explored cell again
+  }
   visualization_msgs::MarkerArray msg;
 
   // The first marker deletes the ones from previous search
-  int id = 0;
   visualization_msgs::Marker marker;
-  marker.id = id;
+  marker.id = 0;
   marker.action = 3;  // same as visualization_msgs::Marker::DELETEALL
   msg.markers.push_back(marker);
 
-  id = 1;
+  visualization_msgs::Marker cells =
+      createMarker(1, geometry_msgs::Point(), std_msgs::ColorRGBA());
+  cells.type = visualization_msgs::Marker::CUBE_LIST;
+  cells.pose.orientation.w = 1.0;
+  cells.points.reserve(global_planner_.visitor_.seen_.size());
+  cells.colors.reserve(global_planner_.visitor_.seen_.size());
   for (const auto& cell : global_planner_.visitor_.seen_) {
-    // for (auto const& x : global_planner_.bubble_risk_cache_) {
-    // Cell cell = x.first;
-
     // double hue = (cell.zPos()-1.0) / 7.0;                // height from 1 to
     // 8 meters double hue = 0.5;                                    // single
     // color (green) double hue = global_planner_.getHeuristic(Node(cell, cell),
@@ -389,12 +536,10 @@ void GlobalPlannerNode::publishExploredCells() {
       // Unknown space
       color.r = color.g = color.b = 0.2;  // Dark gray
     }
-    visualization_msgs::Marker marker =
-        createMarker(id++, cell.toPoint(), color);
-
-    // risk from 0% to 100%, sqrt is used to increase difference in low risk
-    msg.markers.push_back(marker);
+    cells.points.push_back(cell.toPoint());
+    cells.colors.push_back(color);
   }
+  msg.markers.push_back(cells);
   explored_cells_pub_.publish(msg);
 }
 
@@ -406,34 +551,3 @@ void GlobalPlannerNode::printPointInfo(double x, double y, double z) {
 }
 
 }  // namespace global_planner
-
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "global_planner_node");
-  global_planner::GlobalPlannerNode global_planner_node;
-
-  // Read waypoints from file, if any
-  ros::V_string args;
-  ros::removeROSArgs(argc, argv, args);
-
-  if (args.size() > 1) {
-    ROS_INFO("    ARGS: %s", args.at(1).c_str());
-    std::ifstream wp_file(args.at(1).c_str());
-    if (wp_file.is_open()) {
-      double x, y, z;
-      while (wp_file >> x >> y >> z) {
-        global_planner_node.waypoints_.push_back(global_planner::Cell(x, y, z));
-      }
-      wp_file.close();
-      ROS_INFO("  Read %d waypoints.",
-               static_cast<int>(global_planner_node.waypoints_.size()));
-    } else {
-      ROS_ERROR_STREAM("Unable to open goal file: " << args.at(1));
-      return -1;
-    }
-  } else {
-    ROS_INFO("  No goal file given.");
-  }
-
-  ros::spin();
-  return 0;
-}
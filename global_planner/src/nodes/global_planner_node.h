@@ -3,12 +3,20 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <geometry_msgs/PointStamped.h>
 #include <geometry_msgs/PoseStamped.h>
+#include <message_filters/subscriber.h>
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
 #include <pcl_conversions/pcl_conversions.h>
@@ -17,6 +25,7 @@
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include <std_msgs/ColorRGBA.h>
+#include <tf/message_filter.h>
 #include <tf/transform_listener.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -26,6 +35,7 @@
 #include <octomap_msgs/Octomap.h>
 #include <octomap_msgs/conversions.h>
 
+#include "global_planner/OctomapDeltaMsg.h"
 #include "global_planner/PathWithRiskMsg.h"
 #include "global_planner/analysis.h"
 #include "global_planner/cell.h"
@@ -43,9 +53,12 @@ class GlobalPlannerNode {
   GlobalPlanner global_planner_;
   std::vector<GoalCell> waypoints_;  // Intermediate goals, from file, mavros
                                      // mission or intermediate goals
-  GlobalPlannerNode();
+  // nh is the private node handle, the nodelet passes its own
+  explicit GlobalPlannerNode(const ros::NodeHandle& nh = ros::NodeHandle("~"));
   ~GlobalPlannerNode();
 
+  bool readWaypointFile(const std::string& file_name);
+
  private:
   ros::NodeHandle nh_;
   dynamic_reconfigure::Server<global_planner::GlobalPlannerNodeConfig> server_;
@@ -53,25 +66,29 @@ class GlobalPlannerNode {
   nav_msgs::Path actual_path_;
 
   int num_octomap_msg_ = 0;
+  int octomap_full_interval_ = 10;
+  int num_octomap_delta_msg_ = 0;
   int num_pos_msg_ = 0;
   std::vector<geometry_msgs::PoseStamped> last_clicked_points;
 
   // Dynamic Reconfiguration
   double clicked_goal_alt_;
   double clicked_goal_radius_;
-  int simplify_iterations_;
   double simplify_margin_;
 
   // Subscribers
   ros::Subscriber octomap_sub_;
   ros::Subscriber octomap_full_sub_;
+  ros::Subscriber octomap_delta_sub_;
   ros::Subscriber ground_truth_sub_;
   ros::Subscriber velocity_sub_;
   ros::Subscriber clicked_point_sub_;
   ros::Subscriber three_point_sub_;
   ros::Subscriber move_base_simple_sub_;
   ros::Subscriber laser_sensor_sub_;
-  ros::Subscriber depth_camera_sub_;
+  message_filters::Subscriber<sensor_msgs::PointCloud2> depth_camera_sub_;
+  std::unique_ptr<tf::MessageFilter<sensor_msgs::PointCloud2>>
+      depth_camera_filter_;  // Holds the clouds until tf can transform them
 
   // Publishers
   ros::Publisher three_points_pub_;
@@ -84,14 +101,37 @@ class GlobalPlannerNode {
   ros::Publisher explored_cells_pub_;
   ros::Publisher global_goal_pub_;
   ros::Publisher global_temp_goal_pub_;
+  ros::Publisher memory_usage_pub_;
 
   tf::TransformListener listener_;
 
+  // The messages of the current path, built again when the path or the map
+  // changes. They are published as shared pointers, so subscribers in the same
+  // process get them without a copy, and are only changed once no subscriber
+  // holds them.
+  std::vector<Cell> path_of_msgs_;
+  std::vector<Cell> simple_path_;
+  nav_msgs::Path::Ptr path_msg_;
+  nav_msgs::Path::Ptr smooth_path_msg_;
+  nav_msgs::Path::Ptr simple_path_msg_;
+  nav_msgs::Path::Ptr simple_smooth_path_msg_;
+
+  // The depth clouds are transformed and reduced to Cells on a worker thread,
+  // only the latest cloud waits for it
+  std::thread depth_camera_thread_;
+  std::mutex depth_camera_mutex_;
+  std::condition_variable depth_camera_cv_;
+  sensor_msgs::PointCloud2::ConstPtr pending_cloud_;
+  std::vector<Cell> occupied_cells_;  // Found by the worker, not yet inserted
+  double cell_scale_ = CELL_SCALE;    // The CELL_SCALE of the worker
+  bool is_shutting_down_ = false;
+
   void readParams();
 
   void setNewGoal(const GoalCell& goal);
   void popNextGoal();
   void planPath();
+  void replanIfPathIsBad(bool current_path_is_ok);
   void setIntermediateGoal();
 
   void dynamicReconfigureCallback(
@@ -102,10 +142,17 @@ class GlobalPlannerNode {
   void threePointCallback(const nav_msgs::Path& msg);
   void moveBaseSimpleCallback(const geometry_msgs::PoseStamped& msg);
   void laserSensorCallback(const sensor_msgs::LaserScan& msg);
-  void octomapFullCallback(const octomap_msgs::Octomap& msg);
-  void depthCameraCallback(const sensor_msgs::PointCloud2& msg);
+  void octomapFullCallback(const octomap_msgs::Octomap::ConstPtr& msg);
+  void octomapDeltaCallback(const OctomapDeltaMsg::ConstPtr& msg);
+  void depthCameraCallback(const sensor_msgs::PointCloud2::ConstPtr& msg);
+  void depthCameraThread();
+  std::vector<Cell> getOccupiedCells(const sensor_msgs::PointCloud2& msg,
+                                     double cell_scale);
+  void insertOccupiedCells();
 
   void publishGoal(const GoalCell& goal);
+  void updatePathMsgs();
+  nav_msgs::Path& reusablePathMsg(nav_msgs::Path::Ptr& msg);
   void publishPath();
   void publishExploredCells();
 
@@ -0,0 +1,21 @@
+#include "global_planner_node.h"
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "global_planner_node");
+  global_planner::GlobalPlannerNode global_planner_node;
+
+  // Read waypoints from file, if any
+  ros::V_string args;
+  ros::removeROSArgs(argc, argv, args);
+
+  if (args.size() > 1) {
+    if (!global_planner_node.readWaypointFile(args.at(1))) {
+      return -1;
+    }
+  } else {
+    ROS_INFO("  No goal file given.");
+  }
+
+  ros::spin();
+  return 0;
+}
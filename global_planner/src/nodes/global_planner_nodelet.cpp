@@ -0,0 +1,33 @@
+#include "global_planner_node.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace global_planner {
+
+// Runs the GlobalPlannerNode in a nodelet manager, the octomaps, clouds and
+// paths of nodelets in the same manager are then passed by pointer instead of
+// being serialized. The callbacks run one at a time on the queue of the
+// nodelet. The waypoint file can be given as the first argument.
+class GlobalPlannerNodelet : public nodelet::Nodelet {
+ private:
+  std::unique_ptr<GlobalPlannerNode> node_;
+
+  void onInit() override {
+    node_.reset(new GlobalPlannerNode(getPrivateNodeHandle()));
+    const std::vector<std::string>& args = getMyArgv();
+    if (!args.empty()) {
+      node_->readWaypointFile(args.front());
+    } else {
+      ROS_INFO("  No goal file given.");
+    }
+  }
+};
+
+}  // namespace global_planner
+
+PLUGINLIB_EXPORT_CLASS(global_planner::GlobalPlannerNodelet, nodelet::Nodelet)
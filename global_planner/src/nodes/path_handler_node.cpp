@@ -2,9 +2,8 @@
 
 namespace global_planner {
 
-PathHandlerNode::PathHandlerNode() {
-  nh_ = ros::NodeHandle("~");
-
+PathHandlerNode::PathHandlerNode(const ros::NodeHandle& nh)
+    : nh_(nh), server_(nh_) {
   // Set up Dynamic Reconfigure Server
   dynamic_reconfigure::Server<
       global_planner::PathHandlerNodeConfig>::CallbackType f;
@@ -19,8 +18,8 @@ PathHandlerNode::PathHandlerNode() {
                                    &PathHandlerNode::receiveDirectGoal, this);
   path_sub_ = nh_.subscribe("/global_temp_path", 1,
                             &PathHandlerNode::receivePath, this);
-  path_with_risk_sub_ =
-      nh_.subscribe("/path_with_risk", 1, &PathHandlerNode::receivePath, this);
+  path_with_risk_sub_ = nh_.subscribe(
+      "/path_with_risk", 1, &PathHandlerNode::receivePathWithRisk, this);
   ground_truth_sub_ = nh_.subscribe("/mavros/local_position/pose", 1,
                                     &PathHandlerNode::positionCallback, this);
 
@@ -45,17 +44,9 @@ PathHandlerNode::PathHandlerNode() {
 
   listener_.waitForTransform("/local_origin", "/world", ros::Time(0),
                              ros::Duration(3.0));
-  ros::Rate rate(10);
-  while (ros::ok()) {
-    rate.sleep();
-    ros::spinOnce();
-
-    if (shouldPublishThreePoints()) {
-      publishThreePointMsg();
-    } else {
-      publishSetpoint();
-    }
-  }
+  setpoint_timer_ = nh_.createTimer(ros::Duration(0.1),
+                                    &PathHandlerNode::setpointTimerCallback,
+                                    this);
 }
 
 PathHandlerNode::~PathHandlerNode() {}
@@ -81,16 +72,23 @@ bool PathHandlerNode::isCloseToGoal() {
   return distance(current_goal_, last_pos_) < 1.5;
 }
 
+// Returns the risk of the Bezier curve through the poses, from the risks of
+// the cells of the last PathWithRiskMsg. Cells which are not on that path have
+// no risk. The ThreePointMsg gets the sum of the risks at the poses, so this is
+// the mean risk along the curve times the number of poses, not the risk
+// integral of GlobalPlanner::getRiskOfCurve.
 double PathHandlerNode::getRiskOfCurve(
     const std::vector<geometry_msgs::PoseStamped>& poses) {
-  double risk = 0.0;
-  for (const auto& pose_msg : poses) {
-    tf::Vector3 point = toTfVector3(pose_msg.pose.position);
-    if (path_risk_.find(point) != path_risk_.end()) {
-      risk += path_risk_[point];
-    }
+  auto cell_risk = [this](const Cell& cell) {
+    auto it = path_risk_.find(toTfVector3(cell.toPoint()));
+    return it != path_risk_.end() ? it->second : 0.0;
+  };
+  CurveRisk curve_risk;
+  addBezierRisk(poses, cell_risk, curve_risk);
+  if (curve_risk.length <= 0.0) {
+    return poses.size() * curve_risk.max_cell_risk;  // All poses at one point
   }
-  return risk;
+  return poses.size() * curve_risk.risk / curve_risk.length;
 }
 
 void PathHandlerNode::setCurrentPath(
@@ -135,9 +133,11 @@ void PathHandlerNode::receiveDirectGoal(
   setCurrentPath(path_with_direct_goal);
 }
 
-void PathHandlerNode::receivePath(const nav_msgs::Path& msg) {
+// Takes the shared message, which is not copied from a publisher in the same
+// process
+void PathHandlerNode::receivePath(const nav_msgs::Path::ConstPtr& msg) {
   if (!ignore_path_messages_) {
-    setCurrentPath(msg.poses);
+    setCurrentPath(msg->poses);
   }
 }
 
@@ -191,6 +191,15 @@ void PathHandlerNode::positionCallback(
   }
 }
 
+// Sends the next setpoint at 10 Hz
+void PathHandlerNode::setpointTimerCallback(const ros::TimerEvent& event) {
+  if (shouldPublishThreePoints()) {
+    publishThreePointMsg();
+  } else {
+    publishSetpoint();
+  }
+}
+
 void PathHandlerNode::publishSetpoint() {
   // Vector pointing from current position to the current goal
   tf::Vector3 vec = toTfVector3(
@@ -259,10 +268,3 @@ void PathHandlerNode::publishThreePointMsg() {
 }
 
 }  // namespace global_planner
-
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "path_handler_node");
-  global_planner::PathHandlerNode path_handler_node;
-  ros::spin();
-  return 0;
-}
@@ -15,6 +15,8 @@
 
 #include <global_planner/PathHandlerNodeConfig.h>
 #include <global_planner/PathWithRiskMsg.h>
+#include "global_planner/bezier.h"
+#include "global_planner/cell.h"
 #include "global_planner/common.h"
 #include "global_planner/common_ros.h"
 
@@ -24,7 +26,8 @@ namespace global_planner {
 
 class PathHandlerNode {
  public:
-  PathHandlerNode();
+  // nh is the private node handle, the nodelet passes its own
+  explicit PathHandlerNode(const ros::NodeHandle& nh = ros::NodeHandle("~"));
   ~PathHandlerNode();
 
  private:
@@ -61,6 +64,8 @@ class PathHandlerNode {
   ros::Publisher three_point_msg_publisher_;
   ros::Publisher avoidance_triplet_msg_publisher_;
 
+  ros::Timer setpoint_timer_;
+
   tf::TransformListener listener_;
 
   // Methods
@@ -73,9 +78,10 @@ class PathHandlerNode {
   void dynamicReconfigureCallback(global_planner::PathHandlerNodeConfig& config,
                                   uint32_t level);
   void receiveDirectGoal(const geometry_msgs::PoseWithCovarianceStamped& msg);
-  void receivePath(const nav_msgs::Path& msg);
+  void receivePath(const nav_msgs::Path::ConstPtr& msg);
   void receivePathWithRisk(const PathWithRiskMsg& msg);
   void positionCallback(const geometry_msgs::PoseStamped& pose_msg);
+  void setpointTimerCallback(const ros::TimerEvent& event);
   // Publishers
   void publishSetpoint();
   void publishThreePointMsg();
@@ -0,0 +1,8 @@
+#include "path_handler_node.h"
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "path_handler_node");
+  global_planner::PathHandlerNode path_handler_node;
+  ros::spin();
+  return 0;
+}
@@ -0,0 +1,23 @@
+#include "path_handler_node.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+
+namespace global_planner {
+
+// Runs the PathHandlerNode in a nodelet manager, usually the one of the
+// GlobalPlannerNodelet, such that the paths are passed by pointer
+class PathHandlerNodelet : public nodelet::Nodelet {
+ private:
+  std::unique_ptr<PathHandlerNode> node_;
+
+  void onInit() override {
+    node_.reset(new PathHandlerNode(getPrivateNodeHandle()));
+  }
+};
+
+}  // namespace global_planner
+
+PLUGINLIB_EXPORT_CLASS(global_planner::PathHandlerNodelet, nodelet::Nodelet)
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "global_planner/cell_grid.h"
+
+using namespace global_planner;
+
+TEST(CellGrid, storesValuesAroundTheOrigin) {
+  // GIVEN: a grid where NaN means not computed
+  CellGrid<double> grid(NAN);
+
+  // WHEN: values are set in Cells with positive and negative indices in
+  // different blocks
+  std::vector<Cell> cells;
+  for (int x = -20; x <= 20; x += 5) {
+    for (int y = -20; y <= 20; y += 7) {
+      for (int z = -3; z <= 3; z += 3) {
+        cells.push_back(Cell(std::tuple<int, int, int>(x, y, z)));
+      }
+    }
+  }
+  for (size_t i = 0; i < cells.size(); ++i) {
+    grid.set(cells[i], static_cast<double>(i));
+  }
+
+  // THEN: every Cell has its own value and the other Cells are empty
+  for (size_t i = 0; i < cells.size(); ++i) {
+    EXPECT_DOUBLE_EQ(static_cast<double>(i), grid.get(cells[i]));
+  }
+  EXPECT_TRUE(std::isnan(grid.get(Cell(std::tuple<int, int, int>(1, 1, 1)))));
+  EXPECT_TRUE(
+      std::isnan(grid.get(Cell(std::tuple<int, int, int>(-100, 0, 0)))));
+
+  // WHEN: a Cell is erased and then the grid is cleared
+  grid.erase(cells[0]);
+
+  // THEN: the Cells are empty again
+  EXPECT_TRUE(std::isnan(grid.get(cells[0])));
+  EXPECT_DOUBLE_EQ(1.0, grid.get(cells[1]));
+  grid.clear();
+  EXPECT_EQ(0, grid.numBlocks());
+  EXPECT_TRUE(std::isnan(grid.get(cells[1])));
+}
+
+TEST(CellGrid, cursorsReadTheSameValues) {
+  // GIVEN: a grid with values in different blocks and two cursors
+  CellGrid<double> grid(NAN);
+  std::vector<Cell> cells;
+  for (int x = -20; x <= 20; x += 10) {
+    cells.push_back(Cell(std::tuple<int, int, int>(x, x / 2, 0)));
+  }
+  for (size_t i = 0; i < cells.size(); ++i) {
+    grid.set(cells[i], static_cast<double>(i));
+  }
+  CellGrid<double>::Cursor cursor_a, cursor_b;
+
+  // WHEN: the cursors read the Cells in opposite orders
+  // THEN: they read the values of get, and the empty value outside the blocks
+  const CellGrid<double>& const_grid = grid;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    const Cell& cell_b = cells[cells.size() - 1 - i];
+    EXPECT_DOUBLE_EQ(grid.get(cells[i]), const_grid.get(cells[i], cursor_a));
+    EXPECT_DOUBLE_EQ(grid.get(cell_b), const_grid.get(cell_b, cursor_b));
+    EXPECT_TRUE(std::isnan(const_grid.get(
+        Cell(std::tuple<int, int, int>(100, 0, 0)), cursor_a)));
+  }
+}
+
+TEST(CellGrid, keysAreUnique) {
+  // GIVEN: Cells which collided with the old shift/xor hash
+  Cell a(std::tuple<int, int, int>(-1, 0, 0));
+  Cell b(std::tuple<int, int, int>(0, -1, -1));
+  Cell c(std::tuple<int, int, int>(1, -1024, 0));
+
+  // THEN: their keys differ
+  EXPECT_NE(a.key(), b.key());
+  EXPECT_NE(a.key(), c.key());
+  EXPECT_NE(b.key(), c.key());
+}
+
+TEST(CellGrid, evictsTheBlocksFarthestFromTheCenter) {
+  // GIVEN: a grid with a value in each of 10 blocks along the x axis
+  CellGrid<double> grid(NAN);
+  std::vector<Cell> cells;
+  for (int i = 0; i < 10; ++i) {
+    cells.push_back(Cell(std::tuple<int, int, int>(16 * i, 0, 0)));
+    grid.set(cells.back(), static_cast<double>(i));
+  }
+  EXPECT_EQ(10, grid.numBlocks());
+
+  // WHEN: a read has cached the last block and the grid keeps the 3 blocks
+  // closest to the Cell of the middle block
+  EXPECT_DOUBLE_EQ(9.0, grid.get(cells[9]));
+  size_t num_evicted = grid.evictFarthestBlocks(cells[5], 3);
+
+  // THEN: only the blocks 4, 5 and 6 are left
+  EXPECT_EQ(7, num_evicted);
+  EXPECT_EQ(3, grid.numBlocks());
+  for (int i = 0; i < 10; ++i) {
+    if (4 <= i && i <= 6) {
+      EXPECT_DOUBLE_EQ(static_cast<double>(i), grid.get(cells[i]));
+    } else {
+      EXPECT_TRUE(std::isnan(grid.get(cells[i])));
+    }
+  }
+
+  // THEN: a grid below the limit is not changed
+  EXPECT_EQ(0, grid.evictFarthestBlocks(cells[0], 3));
+  EXPECT_EQ(3, grid.numBlocks());
+}
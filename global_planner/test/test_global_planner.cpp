@@ -0,0 +1,717 @@
+#include <gtest/gtest.h>
+
+#include "global_planner/global_planner.h"
+
+using namespace global_planner;
+
+namespace {
+// octree with an occupied wall at x = 5 in front of free space
+octomap::OcTree* wallOctree() {
+  octomap::OcTree* octree = new octomap::OcTree(1.0);
+  for (int x = -5; x < 10; ++x) {
+    for (int y = -5; y < 5; ++y) {
+      for (int z = 1; z < 6; ++z) {
+        float log_odds = x == 5 ? 2.f : -1.f;
+        octree->setNodeValue(x + 0.5, y + 0.5, z + 0.5, log_odds);
+      }
+    }
+  }
+  return octree;
+}
+
+// octree of an explored space split by a wall at x = 21, higher than the
+// maximal altitude, with a gap at 0 <= y < 12. The gap is as wide as three
+// Cells of level 2, so the middle one is free.
+octomap::OcTree* gapWallOctree() {
+  octomap::OcTree* octree = new octomap::OcTree(1.0);
+  for (int x = -4; x < 44; ++x) {
+    for (int y = -40; y < 40; ++y) {
+      for (int z = 1; z < 12; ++z) {
+        bool is_wall = x == 21 && (y < 0 || y >= 12);
+        octree->setNodeValue(x + 0.5, y + 0.5, z + 0.5, is_wall ? 2.f : -1.f);
+      }
+    }
+  }
+  return octree;
+}
+}
+
+TEST(GlobalPlanner, octomapDeltaOnlyInvalidatesChangedRisk) {
+  // GIVEN: a planner which has cached the risk of some free cells
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell changed_cell(1.5, 0.5, 2.5);
+  const Cell neighbor_cell(2.5, 0.5, 2.5);
+  const Cell far_cell(-3.5, -3.5, 2.5);
+  double changed_risk = planner.getRisk(changed_cell);
+  double neighbor_risk = planner.getRisk(neighbor_cell);
+  planner.getRisk(far_cell);
+
+  // WHEN: an obstacle appears in one of the cells
+  OctomapDeltaMsg msg;
+  msg.resolution = 1.0;
+  msg.points.push_back(changed_cell.toPoint());
+  msg.log_odds.push_back(2.f);
+  planner.updateOctomapDelta(msg);
+
+  // THEN: the risk of the cell and of its neighbors has increased, while the
+  // cached risk of the other cells has been kept
+  EXPECT_GT(planner.getRisk(changed_cell), changed_risk + 0.1);
+  EXPECT_GT(planner.getRisk(neighbor_cell), neighbor_risk + 0.1);
+  EXPECT_FALSE(std::isnan(planner.risk_cache_.get(far_cell)));
+}
+
+TEST(GlobalPlanner, singleCellRiskIsCachedUntilItsCellChanges) {
+  // GIVEN: a planner which has looked up the risk of two free cells
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell changed_cell(1.5, 0.5, 2.5);
+  const Cell occupied_cell(2.5, 0.5, 2.5);
+  double changed_risk = planner.getSingleCellRisk(changed_cell);
+  double occupied_risk = planner.getSingleCellRisk(occupied_cell);
+  EXPECT_DOUBLE_EQ(changed_risk, planner.single_risk_cache_.get(changed_cell));
+
+  // WHEN: an obstacle appears in one cell and the other cell becomes known
+  // space
+  OctomapDeltaMsg msg;
+  msg.resolution = 1.0;
+  msg.points.push_back(changed_cell.toPoint());
+  msg.log_odds.push_back(2.f);
+  planner.updateOctomapDelta(msg);
+  planner.setOccupied(occupied_cell);
+
+  // THEN: the risk of both cells is looked up again
+  EXPECT_GT(planner.getSingleCellRisk(changed_cell), changed_risk + 0.1);
+  EXPECT_GT(planner.getSingleCellRisk(occupied_cell), occupied_risk);
+}
+
+TEST(GlobalPlanner, riskIsRecomputedAroundNewlyOccupiedCells) {
+  // GIVEN: a planner which has cached the risk of a free cell and its
+  // neighbor
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell occupied_cell(2.5, 0.5, 2.5);
+  const Cell neighbor(1.5, 0.5, 2.5);
+  double occupied_risk = planner.getRisk(occupied_cell);
+  double neighbor_risk = planner.getRisk(neighbor);
+  EXPECT_DOUBLE_EQ(neighbor_risk, planner.risk_cache_.get(neighbor));
+
+  // WHEN: the cell becomes known space
+  planner.setOccupied(std::vector<Cell>(1, occupied_cell));
+
+  // THEN: the cached risk of the cell and of its neighbor is dropped, and the
+  // risk of the cell is higher
+  EXPECT_TRUE(std::isnan(planner.risk_cache_.get(occupied_cell)));
+  EXPECT_TRUE(std::isnan(planner.risk_cache_.get(neighbor)));
+  EXPECT_GT(planner.getRisk(occupied_cell), occupied_risk);
+  EXPECT_GE(planner.getRisk(neighbor), neighbor_risk);
+}
+
+TEST(GlobalPlanner, occupiedCellsAreInsertedInBulk) {
+  // GIVEN: a planner and the cells of a depth cloud
+  GlobalPlanner planner;
+  const std::vector<Cell> cells = {Cell(0.5, 0.5, 2.5), Cell(9.5, 0.5, 2.5),
+                                   Cell(-20.5, 3.5, 1.5)};
+
+  // WHEN: the cells are marked as occupied at once
+  planner.setOccupied(cells);
+
+  // THEN: every cell, and only these, is occupied
+  for (const Cell& cell : cells) {
+    EXPECT_TRUE(planner.occupied_.get(cell));
+  }
+  EXPECT_FALSE(planner.occupied_.get(Cell(1.5, 0.5, 2.5)));
+}
+
+TEST(GlobalPlanner, fullOctomapOnlyInvalidatesChangedRisk) {
+  // GIVEN: a planner with a map and the risk of some cells
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell wall_cell(5.5, 0.5, 2.5);
+  const Cell far_cell(-3.5, -3.5, 2.5);
+  double wall_risk = planner.getRisk(wall_cell);
+  double far_risk = planner.getRisk(far_cell);
+
+  // WHEN: a new full map arrives where part of the wall has disappeared
+  octomap::OcTree* new_octree = wallOctree();
+  new_octree->setNodeValue(wall_cell.xPos(), wall_cell.yPos(),
+                           wall_cell.zPos(), -1.f);
+  octomap_msgs::Octomap msg;
+  octomap_msgs::fullMapToMsg(*new_octree, msg);
+  delete new_octree;
+  planner.updateFullOctomap(msg);
+
+  // THEN: only the risk around the changed cell is recomputed
+  EXPECT_TRUE(std::isnan(planner.risk_cache_.get(wall_cell)));
+  EXPECT_FALSE(std::isnan(planner.risk_cache_.get(far_cell)));
+  EXPECT_LT(planner.getRisk(wall_cell), wall_risk - 0.1);
+  EXPECT_DOUBLE_EQ(far_risk, planner.getRisk(far_cell));
+}
+
+TEST(GlobalPlanner, findSmoothPathAroundWallWithEveryNodeType) {
+  // GIVEN: a planner with a wall between the start and the goal
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell start(0.5, 0.5, 2.5);
+  const Cell parent_of_start(-0.5, 0.5, 2.5);
+  const GoalCell goal(8.5, 0.5, 2.5);
+  const std::vector<std::string> node_types = {"Node", "NodeWithoutSmooth",
+                                               "SpeedNode"};
+
+  for (const std::string& node_type : node_types) {
+    // WHEN: searching with the node type
+    std::vector<Cell> path;
+    SearchInfo info =
+        findSmoothPath(&planner, path, start, parent_of_start, node_type, goal,
+                       5000, planner.visitor_);
+
+    // THEN: the path starts behind the start and ends at the goal without
+    // going through the wall
+    ASSERT_TRUE(info.found_path) << node_type;
+    ASSERT_GE(path.size(), 3) << node_type;
+    EXPECT_EQ(parent_of_start, path[0]) << node_type;
+    EXPECT_EQ(start, path[1]) << node_type;
+    EXPECT_TRUE(goal.withinPlanRadius(path.back())) << node_type;
+    for (const Cell& cell : path) {
+      EXPECT_LT(planner.getRisk(cell), planner.max_cell_risk_) << node_type;
+    }
+  }
+}
+
+TEST(GlobalPlanner, countersVisitorDoesNotChangeTheSearch) {
+  // GIVEN: a planner with a wall between the start and the goal
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  planner.use_speedup_heuristics_ = false;
+  const Cell start(0.5, 0.5, 2.5);
+  const Cell parent_of_start(-0.5, 0.5, 2.5);
+  const GoalCell goal(8.5, 0.5, 2.5);
+  NullVisitor null_visitor;
+  std::vector<Cell> reference_path;
+  SearchInfo reference_info =
+      findSmoothPath(&planner, reference_path, start, parent_of_start, "Node",
+                     goal, 5000, null_visitor);
+
+  // WHEN: searching again with a trace of every 10th expansion
+  TraceVisitor<GlobalPlanner> visitor(&planner, 10);
+  std::vector<Cell> path;
+  SearchInfo info = findSmoothPath(&planner, path, start, parent_of_start,
+                                   "Node", goal, 5000, visitor);
+
+  // THEN: the search finds the same path and the counters describe it, the
+  // risk was cached by the first search
+  ASSERT_TRUE(info.found_path);
+  EXPECT_EQ(reference_path, path);
+  ASSERT_EQ(1, visitor.phases_.size());
+  const PhaseCounters& counters = visitor.phases_[0];
+  EXPECT_TRUE(counters.found_path);
+  EXPECT_EQ(info.num_iter + 1, counters.num_expanded);  // And the goal
+  EXPECT_GT(counters.num_generated, info.num_iter);
+  EXPECT_GT(counters.max_open_size, 0);
+  EXPECT_GT(counters.num_risk_lookups, 0);
+  EXPECT_DOUBLE_EQ(1.0, counters.riskCacheHitRate());
+  EXPECT_EQ(info.num_iter / 10, visitor.samples_.size());
+}
+
+TEST(GlobalPlanner, anytimeSearchImprovesThePathWithLowerOverestimate) {
+  // GIVEN: an anytime search around a wall with a high overestimate
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Node start(Cell(0.5, 0.5, 2.5), Cell(-0.5, 0.5, 2.5));
+  const GoalCell goal(8.5, 0.5, 2.5);
+  NullVisitor visitor;
+  AnytimeSearch<GlobalPlanner, Node, NullVisitor> search(&planner, start, goal,
+                                                          visitor);
+  SearchLimits limits(5000);
+  planner.overestimate_factor_ = 2.0;
+  std::vector<Cell> first_path;
+  SearchInfo first_info = search.improvePath(first_path, limits);
+
+  // WHEN: the search continues without overestimate
+  planner.overestimate_factor_ = 1.0;
+  std::vector<Cell> second_path;
+  SearchInfo second_info = search.improvePath(second_path, limits);
+
+  // THEN: both searches reach the goal and the second path is not worse
+  ASSERT_TRUE(first_info.found_path);
+  ASSERT_TRUE(second_info.found_path);
+  EXPECT_TRUE(goal.withinPlanRadius(first_path.back()));
+  EXPECT_TRUE(goal.withinPlanRadius(second_path.back()));
+  EXPECT_LE(planner.getPathInfo(second_path).cost,
+            planner.getPathInfo(first_path).cost + 1e-9);
+}
+
+TEST(GlobalPlanner, anytimeSearchStopsAtTheDeadline) {
+  // GIVEN: an anytime search whose deadline has already passed
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Node start(Cell(0.5, 0.5, 2.5), Cell(-0.5, 0.5, 2.5));
+  const GoalCell goal(8.5, 0.5, 2.5);
+  NullVisitor visitor;
+  AnytimeSearch<GlobalPlanner, Node, NullVisitor> search(&planner, start, goal,
+                                                          visitor);
+  SearchLimits limits(5000, SearchLimits::Clock::now());
+
+  // WHEN: searching for a path
+  std::vector<Cell> path;
+  SearchInfo info = search.improvePath(path, limits);
+
+  // THEN: the search gives up within the first check of the clock
+  EXPECT_FALSE(info.found_path);
+  EXPECT_TRUE(path.empty());
+  EXPECT_LT(info.num_iter, DEADLINE_CHECK_INTERVAL);
+}
+
+TEST(GlobalPlanner, incrementalSearchOnlyRepairsAroundChanges) {
+  // GIVEN: an incremental search which has found a path around a wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  IncrementalSearch<GlobalPlanner>& search = planner.incremental_search_;
+  const Cell start(0.5, 0.5, 2.5);
+  const Cell parent_of_start(-0.5, 0.5, 2.5);
+  const Cell goal(8.5, 0.5, 2.5);
+  SearchLimits limits(100000);
+  std::vector<Cell> first_path;
+  SearchInfo first_info =
+      search.findPath(&planner, first_path, start, parent_of_start, goal,
+                      limits);
+  ASSERT_TRUE(first_info.found_path);
+  EXPECT_EQ(parent_of_start, first_path[0]);
+  EXPECT_EQ(start, first_path[1]);
+  EXPECT_EQ(goal, first_path.back());
+
+  // WHEN: nothing changes
+  std::vector<Cell> same_path;
+  SearchInfo same_info =
+      search.findPath(&planner, same_path, start, parent_of_start, goal,
+                      limits);
+
+  // THEN: the same path is found without any search
+  ASSERT_TRUE(same_info.found_path);
+  EXPECT_EQ(0, same_info.num_iter);
+  EXPECT_EQ(first_path, same_path);
+
+  // WHEN: an obstacle appears on the path
+  const Cell blocked_cell = first_path[first_path.size() / 2];
+  OctomapDeltaMsg msg;
+  msg.resolution = 1.0;
+  msg.points.push_back(blocked_cell.toPoint());
+  msg.log_odds.push_back(2.f);
+  planner.updateOctomapDelta(msg);
+  std::vector<Cell> new_path;
+  SearchInfo new_info =
+      search.findPath(&planner, new_path, start, parent_of_start, goal,
+                      limits);
+
+  // THEN: the repaired path avoids the obstacle and needs fewer iterations
+  // than the first search
+  ASSERT_TRUE(new_info.found_path);
+  EXPECT_EQ(goal, new_path.back());
+  EXPECT_EQ(new_path.end(),
+            std::find(new_path.begin(), new_path.end(), blocked_cell));
+  EXPECT_LT(new_info.num_iter, first_info.num_iter);
+
+  // THEN: it is as cheap as the path of a new search
+  IncrementalSearch<GlobalPlanner> new_search;
+  std::vector<Cell> reference_path;
+  ASSERT_TRUE(new_search
+                  .findPath(&planner, reference_path, start, parent_of_start,
+                            goal, limits)
+                  .found_path);
+  EXPECT_NEAR(planner.getPathInfo(reference_path).cost,
+              planner.getPathInfo(new_path).cost, 1e-6);
+}
+
+TEST(GlobalPlanner, parallelSearchFindsThePathOfTheLowestOverestimate) {
+  // GIVEN: a planner which runs its searches in parallel and a wall between
+  // the start and the goal
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  planner.use_parallel_search_ = true;
+  planner.search_time_ = 0.0;  // No deadline
+  planner.curr_pos_ = Cell(0.5, 0.5, 2.5).toPoint();
+  planner.goal_pos_ = GoalCell(8.5, 0.5, 2.5);
+
+  // WHEN: searching for a path
+  std::vector<Cell> path;
+  bool found_path = planner.findPath(path);
+
+  // THEN: a path to the goal is found with the lowest overestimate
+  ASSERT_TRUE(found_path);
+  EXPECT_TRUE(planner.goal_pos_.withinPlanRadius(path.back()));
+  EXPECT_LT(planner.overestimate_factor_, planner.min_overestimate_factor_);
+
+  // THEN: the risks computed by the search are kept
+  for (int i = 2; i < path.size(); ++i) {
+    EXPECT_FALSE(std::isnan(planner.risk_cache_.get(path[i])));
+    EXPECT_FALSE(std::isnan(planner.single_risk_cache_.get(path[i])));
+  }
+}
+
+TEST(GlobalPlanner, parallelSearchReadsTheMapOfThePlanner) {
+  // GIVEN: two planners which run their searches in parallel, one of them in
+  // the corridor of a coarse path through the gap of a wall, and an obstacle
+  // the coarse planner has seen
+  GlobalPlanner full_planner, coarse_planner;
+  coarse_planner.coarse_levels_ = 2;
+  for (GlobalPlanner* planner : {&full_planner, &coarse_planner}) {
+    planner->octree_ = gapWallOctree();
+    planner->use_parallel_search_ = true;
+    planner->search_time_ = 0.0;  // No deadline
+    planner->max_iterations_ = 100000;
+    planner->curr_pos_ = Cell(0.5, -16.5, 2.5).toPoint();
+    planner->goal_pos_ = GoalCell(40.5, -16.5, 2.5);
+  }
+  const Cell obstacle(20.5, 20.5, 2.5);
+  coarse_planner.setOccupied(obstacle);
+
+  // WHEN: searching for a path
+  std::vector<Cell> full_path, coarse_path;
+  ASSERT_TRUE(full_planner.findPath(full_path));
+  ASSERT_TRUE(coarse_planner.findPath(coarse_path));
+
+  // THEN: the searches of the coarse planner stayed in its corridor, and its
+  // map is unchanged
+  EXPECT_TRUE(coarse_planner.goal_pos_.withinPlanRadius(coarse_path.back()));
+  for (const Cell& cell : coarse_path) {
+    EXPECT_LT(coarse_planner.getRisk(cell), coarse_planner.max_cell_risk_);
+  }
+  EXPECT_LT(coarse_planner.risk_cache_stats_.misses,
+            full_planner.risk_cache_stats_.misses / 2);
+  EXPECT_TRUE(coarse_planner.occupied_.get(obstacle));
+  EXPECT_EQ(0, coarse_planner.corridor_level_);
+}
+
+TEST(GlobalPlanner, riskFieldIsALowerBoundOfTheRiskOfThePath) {
+  // GIVEN: a planner with a risk field to the goal behind a wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  planner.use_risk_field_ = true;
+  planner.overestimate_factor_ = 1.0;
+  const Cell start(0.5, 0.5, 2.5);
+  const Cell parent_of_start(-0.5, 0.5, 2.5);
+  const GoalCell goal(8.5, 0.5, 2.5);
+  planner.risk_field_.expand(&planner, goal, SearchLimits(20000));
+
+  // WHEN: searching for a path with and without the field as heuristic
+  std::vector<Cell> path;
+  SearchInfo info = findSmoothPath(&planner, path, start, parent_of_start,
+                                   "Node", goal, 5000, planner.visitor_);
+  planner.use_risk_heuristics_ = false;
+  std::vector<Cell> reference_path;
+  SearchInfo reference_info =
+      findSmoothPath(&planner, reference_path, start, parent_of_start, "Node",
+                     goal, 5000, planner.visitor_);
+
+  // THEN: the field does not overestimate the risk and the search with it
+  // expands fewer cells for a path of the same cost
+  ASSERT_TRUE(info.found_path);
+  ASSERT_TRUE(reference_info.found_path);
+  EXPECT_EQ(0.0, planner.risk_field_.lowerBound(goal));
+  EXPECT_GT(planner.risk_field_.lowerBound(start), 0.0);
+  EXPECT_LE(planner.risk_field_.lowerBound(start),
+            planner.getPathInfo(path).risk + 1e-6);
+  EXPECT_LT(info.num_iter, reference_info.num_iter);
+  EXPECT_NEAR(planner.getPathInfo(reference_path).cost,
+              planner.getPathInfo(path).cost, 1e-6);
+}
+
+TEST(GlobalPlanner, riskFieldIsRepairedAroundChanges) {
+  // GIVEN: a planner with a risk field to the goal behind a wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const Cell start(0.5, 0.5, 2.5);
+  const GoalCell goal(8.5, 0.5, 2.5);
+  planner.risk_field_.expand(&planner, goal, SearchLimits(20000));
+  double start_risk = planner.risk_field_.lowerBound(start);
+
+  // WHEN: an obstacle appears next to the start and the field is expanded
+  OctomapDeltaMsg msg;
+  msg.resolution = 1.0;
+  msg.points.push_back(Cell(1.5, 0.5, 2.5).toPoint());
+  msg.log_odds.push_back(2.f);
+  planner.updateOctomapDelta(msg);
+  int num_repaired =
+      planner.risk_field_.expand(&planner, goal, SearchLimits(20000));
+
+  // THEN: the risk of the start has increased and is the same as in a new
+  // field
+  RiskField<GlobalPlanner> new_field;
+  new_field.expand(&planner, goal, SearchLimits(40000));
+  EXPECT_GT(num_repaired, 0);
+  EXPECT_GT(planner.risk_field_.lowerBound(start), start_risk);
+  for (const Cell& cell : start.getNeighbors()) {
+    EXPECT_NEAR(new_field.lowerBound(cell),
+                planner.risk_field_.lowerBound(cell), 1e-6);
+  }
+}
+
+TEST(GlobalPlanner, pathInfoOfALongPathIsTheSumOfItsEdges) {
+  // GIVEN: a path which is long enough to be evaluated in parallel and goes
+  // back and forth through the wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  std::vector<Cell> path = {Cell(-0.5, 0.5, 2.5)};
+  for (int i = 0; i < 6000; ++i) {
+    int x = i % 20 < 10 ? i % 10 : 10 - i % 10;
+    path.push_back(Cell(x + 0.5, 0.5 + (i / 10) % 3, 2.5 + (i / 30) % 2));
+  }
+
+  // WHEN: evaluating the path
+  PathInfo info = planner.getPathInfo(path);
+
+  // THEN: it is the same as evaluating the edges one at a time
+  PathInfo expected_info = {};
+  for (int i = 2; i < path.size(); ++i) {
+    Node curr_node(path[i], path[i - 1]);
+    Node last_node(path[i - 1], path[i - 2]);
+    double cell_risk = planner.getRisk(curr_node);
+    expected_info.dist += planner.getEdgeDist(last_node.cell_, curr_node.cell_);
+    expected_info.risk += planner.risk_factor_ * cell_risk;
+    expected_info.cost += planner.getEdgeCost(last_node, curr_node);
+    expected_info.is_blocked |= cell_risk > planner.max_cell_risk_;
+  }
+  EXPECT_TRUE(info.is_blocked);
+  EXPECT_EQ(expected_info.is_blocked, info.is_blocked);
+  EXPECT_NEAR(expected_info.dist, info.dist, 1e-6 * expected_info.dist);
+  EXPECT_NEAR(expected_info.risk, info.risk, 1e-6 * expected_info.risk);
+  EXPECT_NEAR(expected_info.cost, info.cost, 1e-6 * expected_info.cost);
+}
+
+TEST(GlobalPlanner, pathWithRiskReusesTheBuiltPathMsg) {
+  // GIVEN: a planner with a path next to a wall and its path message
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  std::vector<Cell> path;
+  for (int x = 0; x < 5; ++x) {
+    path.push_back(Cell(x + 0.5, 0.5, 2.5));
+  }
+  planner.setPath(path);
+  nav_msgs::Path path_msg = planner.getPathMsg();
+
+  // WHEN: adding the risk to the built message
+  PathWithRiskMsg risk_msg = planner.getPathWithRiskMsg(path_msg);
+
+  // THEN: it has the poses of the message and the risk of their cells
+  ASSERT_EQ(path.size(), risk_msg.poses.size());
+  ASSERT_EQ(path.size(), risk_msg.risks.size());
+  for (int i = 0; i < path.size(); ++i) {
+    EXPECT_EQ(path[i], Cell(risk_msg.poses[i].pose.position));
+    EXPECT_DOUBLE_EQ(planner.getRisk(path[i]), risk_msg.risks[i]);
+  }
+  EXPECT_GT(risk_msg.risks.back(), risk_msg.risks.front());
+}
+
+TEST(GlobalPlanner, simplifyPathRemovesTheVerticesOfStraightEdges) {
+  // GIVEN: a straight path through free space, away from the wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  std::vector<Cell> path;
+  for (int x = -5; x < 0; ++x) {
+    path.push_back(Cell(x + 0.5, 0.5, 2.5));
+  }
+  const std::vector<Cell> original_path = path;
+
+  // WHEN: simplifying the path in place
+  simplifyPath(&planner, path, 1.1);
+
+  // THEN: only the first two vertices and the doubled end are left
+  ASSERT_EQ(4, path.size());
+  EXPECT_EQ(original_path[0], path[0]);
+  EXPECT_EQ(original_path[1], path[1]);
+  EXPECT_EQ(original_path.back(), path[2]);
+  EXPECT_EQ(original_path.back(), path[3]);
+}
+
+TEST(GlobalPlanner, smoothPathOverwritesTheGivenMsg) {
+  // GIVEN: the smoothed message of a long path
+  GlobalPlanner planner;
+  std::vector<Cell> long_path, short_path;
+  for (int i = 0; i < 6; ++i) {
+    long_path.push_back(Cell(0.5 + i, 0.5 + i % 2, 2.5));
+  }
+  short_path = {Cell(0.5, 0.5, 2.5), Cell(1.5, 0.5, 2.5),
+                Cell(1.5, 1.5, 2.5)};
+  nav_msgs::Path smooth_path;
+  smoothPath(planner.getPathMsg(long_path), smooth_path);
+  ASSERT_EQ((long_path.size() - 2) * 11 + 2, smooth_path.poses.size());
+
+  // WHEN: smoothing a shorter path into the same message
+  nav_msgs::Path short_path_msg = planner.getPathMsg(short_path);
+  smoothPath(short_path_msg, smooth_path);
+
+  // THEN: it is the same as a newly smoothed path
+  nav_msgs::Path expected_path = smoothPath(short_path_msg);
+  ASSERT_EQ(expected_path.poses.size(), smooth_path.poses.size());
+  for (int i = 0; i < expected_path.poses.size(); ++i) {
+    const geometry_msgs::Point& expected = expected_path.poses[i].pose.position;
+    const geometry_msgs::Point& actual = smooth_path.poses[i].pose.position;
+    EXPECT_DOUBLE_EQ(expected.x, actual.x);
+    EXPECT_DOUBLE_EQ(expected.y, actual.y);
+    EXPECT_DOUBLE_EQ(expected.z, actual.z);
+  }
+  EXPECT_EQ(short_path_msg.header.frame_id, smooth_path.header.frame_id);
+}
+
+TEST(GlobalPlanner, simplifyPathKeepsTheVerticesBeforeRiskyCells) {
+  // GIVEN: a straight path which ends right in front of the wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  std::vector<Cell> path;
+  for (int x = 0; x < 5; ++x) {
+    path.push_back(Cell(x + 0.5, 0.5, 2.5));
+  }
+
+  // WHEN: simplifying the path
+  simplifyPath(&planner, path, 1.1, false);
+
+  // THEN: the vertex before the risky last cell is kept, since an edge over
+  // it would cost more
+  ASSERT_GE(path.size(), 4);
+  EXPECT_EQ(Cell(3.5, 0.5, 2.5), path[path.size() - 2]);
+  EXPECT_EQ(Cell(4.5, 0.5, 2.5), path.back());
+}
+
+TEST(GlobalPlanner, bezierRiskBoundsTheRiskOfADenselySampledCurve) {
+  // GIVEN: a curve which turns in front of the wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const geometry_msgs::Point p0 = Cell(0.5, 0.5, 2.5).toPoint();
+  const geometry_msgs::Point p1 = Cell(4.5, 0.5, 2.5).toPoint();
+  const geometry_msgs::Point p2 = Cell(4.5, 4.5, 2.5).toPoint();
+  auto cell_risk = [&planner](const Cell& cell) {
+    return planner.getRisk(cell);
+  };
+
+  // WHEN: finding its risk by subdividing it, and by sampling it densely
+  CurveRisk curve_risk;
+  addBezierRisk(p0, p1, p2, cell_risk, curve_risk);
+  const int num_samples = 1000;
+  double sampled_risk = 0.0;
+  double sampled_length = 0.0;
+  geometry_msgs::Point last_point = p0;
+  for (int i = 1; i <= num_samples; ++i) {
+    geometry_msgs::Point point = quadraticBezierPoint(
+        p0, p1, p2, static_cast<double>(i) / num_samples);
+    sampled_risk += cell_risk(Cell(point)) * distance(last_point, point);
+    sampled_length += distance(last_point, point);
+    last_point = point;
+  }
+
+  // THEN: the risk is not lower, but close, and needs far fewer lookups
+  EXPECT_GE(curve_risk.risk, 0.99 * sampled_risk);
+  EXPECT_LT(curve_risk.risk, 1.5 * sampled_risk);
+  EXPECT_LT(curve_risk.num_lookups, num_samples / 10);
+  EXPECT_GE(curve_risk.length, sampled_length);
+  EXPECT_LE(curve_risk.length, distance(p0, p1) + distance(p1, p2));
+}
+
+TEST(GlobalPlanner, bezierRiskStopsAtABlockedCell) {
+  // GIVEN: a curve through the wall
+  GlobalPlanner planner;
+  planner.octree_ = wallOctree();
+  const geometry_msgs::Point p0 = Cell(0.5, 0.5, 2.5).toPoint();
+  const geometry_msgs::Point p1 = Cell(5.5, 0.5, 2.5).toPoint();
+  const geometry_msgs::Point p2 = Cell(8.5, 4.5, 2.5).toPoint();
+  auto cell_risk = [&planner](const Cell& cell) {
+    return planner.getRisk(cell);
+  };
+
+  // WHEN: checking it against the maximal risk of a cell
+  CurveRisk full_risk, checked_risk;
+  addBezierRisk(p0, p1, p2, cell_risk, full_risk);
+  addBezierRisk(p0, p1, p2, cell_risk, checked_risk, planner.max_cell_risk_);
+
+  // THEN: the check finds the blocked cell with fewer lookups
+  EXPECT_GT(checked_risk.max_cell_risk, planner.max_cell_risk_);
+  EXPECT_LT(checked_risk.num_lookups, full_risk.num_lookups);
+}
+
+TEST(GlobalPlanner, cellsOfHigherLevelsContainTheCellsBelow) {
+  // GIVEN: a Cell of full resolution
+  const Cell cell(std::tuple<int, int, int>(-3, 5, 2));
+
+  // WHEN: taking the Cells of higher levels
+  const Cell coarse_cell = cell.atLevel(2);
+
+  // THEN: they contain the Cell, and differ from the Cells with the same
+  // indices
+  EXPECT_EQ(Cell(std::tuple<int, int, int>(-1, 1, 0), 2), coarse_cell);
+  EXPECT_DOUBLE_EQ(4.0 * CELL_SCALE, coarse_cell.scale());
+  EXPECT_EQ(coarse_cell, Cell(cell.toPoint()).atLevel(2));
+  EXPECT_EQ(coarse_cell, Cell(cell.xPos(), cell.yPos(), cell.zPos(), 2));
+  EXPECT_EQ(coarse_cell.atLevel(0).atLevel(2), coarse_cell);
+  const Cell same_indices(std::tuple<int, int, int>(-1, 1, 0));
+  EXPECT_NE(same_indices, coarse_cell);
+  EXPECT_NE(same_indices.key(), coarse_cell.key());
+  EXPECT_EQ(2, coarse_cell.getNeighbors()[0].level());
+}
+
+TEST(GlobalPlanner, coarseToFineSearchOnlyExpandsTheCorridor) {
+  // GIVEN: two planners, one of them plans on coarse Cells first, and a wall
+  // with a gap between the start and the goal
+  GlobalPlanner full_planner, coarse_planner;
+  coarse_planner.coarse_levels_ = 2;
+  for (GlobalPlanner* planner : {&full_planner, &coarse_planner}) {
+    planner->octree_ = gapWallOctree();
+    planner->search_time_ = 0.0;  // No deadline
+    planner->max_iterations_ = 100000;
+    planner->curr_pos_ = Cell(0.5, -16.5, 2.5).toPoint();
+    planner->goal_pos_ = GoalCell(40.5, -16.5, 2.5);
+  }
+
+  // WHEN: searching for a path
+  std::vector<Cell> full_path, coarse_path;
+  ASSERT_TRUE(full_planner.findPath(full_path));
+  ASSERT_TRUE(coarse_planner.findPath(coarse_path));
+
+  // THEN: both paths go through the gap, but the risk of far fewer Cells is
+  // computed to find the path in the corridor, which costs about the same
+  for (const std::vector<Cell>* path : {&full_path, &coarse_path}) {
+    EXPECT_TRUE(coarse_planner.goal_pos_.withinPlanRadius(path->back()));
+    for (const Cell& cell : *path) {
+      EXPECT_EQ(0, cell.level());
+      EXPECT_LT(coarse_planner.getRisk(cell), coarse_planner.max_cell_risk_);
+    }
+  }
+  EXPECT_LT(coarse_planner.risk_cache_stats_.misses,
+            full_planner.risk_cache_stats_.misses / 2);
+  EXPECT_LT(coarse_planner.getPathInfo(coarse_path).cost,
+            1.1 * full_planner.getPathInfo(full_path).cost);
+
+  // THEN: the searches afterwards are not restricted
+  EXPECT_EQ(0, coarse_planner.corridor_level_);
+}
+
+TEST(GlobalPlanner, cachesAboveTheMemoryLimitAreFreedFarFromTheVehicle) {
+  // GIVEN: a planner which has cached the risk along a flight of 200 m
+  GlobalPlanner global_planner;
+  global_planner.octree_ = wallOctree();
+  for (int x = -100; x < 100; ++x) {
+    global_planner.getRisk(Cell(x + 0.5, 0.5, 2.5));
+  }
+  global_planner.curr_pos_ = Cell(90.5, 0.5, 2.5).toPoint();
+  MemoryUsageMsg before = global_planner.getMemoryUsageMsg();
+
+  // WHEN: there is no limit
+  // THEN: nothing is freed
+  EXPECT_EQ(0, global_planner.limitMemory());
+
+  // WHEN: the limit is half of the memory of the caches
+  global_planner.max_cache_memory_ = before.risk_caches / 2 / 1000000.0;
+  EXPECT_GT(global_planner.limitMemory(), 0);
+
+  // THEN: the caches are below the limit, the risk around the vehicle is
+  // still cached, the far risk is gone but computed again when needed
+  MemoryUsageMsg after = global_planner.getMemoryUsageMsg();
+  EXPECT_LE(after.risk_caches, after.limit);
+  EXPECT_LT(after.total, before.total);
+  EXPECT_FALSE(std::isnan(
+      global_planner.risk_cache_.get(Cell(global_planner.curr_pos_))));
+  Cell far_cell(-99.5, 0.5, 2.5);
+  EXPECT_TRUE(std::isnan(global_planner.risk_cache_.get(far_cell)));
+  GlobalPlanner other_planner;
+  other_planner.octree_ = wallOctree();
+  EXPECT_DOUBLE_EQ(other_planner.getRisk(far_cell),
+                   global_planner.getRisk(far_cell));
+}
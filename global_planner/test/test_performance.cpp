@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "global_planner/global_planner.h"
+
+using namespace global_planner;
+
+// Performance regression tests. They are built into their own target, which
+// is only added with GLOBAL_PLANNER_PERFORMANCE_TESTS, because the bounds
+// depend on the machine. They leave a wide margin over the release build on
+// a desktop CPU, such that they only fail for a regression of the search.
+
+namespace {
+// octree of an explored space with a wall at x = 10 which has a gap at
+// 12 <= y < 15, the search has to go around a large part of it
+octomap::OcTree* longWallOctree() {
+  octomap::OcTree* octree = new octomap::OcTree(1.0);
+  for (int x = -4; x < 24; ++x) {
+    for (int y = -20; y < 20; ++y) {
+      for (int z = 1; z < 8; ++z) {
+        bool is_wall = x == 10 && (y < 12 || y >= 15);
+        octree->setNodeValue(x + 0.5, y + 0.5, z + 0.5, is_wall ? 2.f : -1.f);
+      }
+    }
+  }
+  return octree;
+}
+}
+
+TEST(Performance, findSmoothPathIterationsPerSecond) {
+  // GIVEN: a planner with a long wall between the start and the goal, of
+  // which the risk is cached by a first search
+  GlobalPlanner planner;
+  planner.octree_ = longWallOctree();
+  const Cell start(0.5, -10.5, 2.5);
+  const Cell parent_of_start(-0.5, -10.5, 2.5);
+  const GoalCell goal(20.5, -10.5, 2.5);
+  NullVisitor visitor;
+  std::vector<Cell> path;
+  ASSERT_TRUE(findSmoothPath(&planner, path, start, parent_of_start, "Node",
+                             goal, 20000, visitor)
+                  .found_path);
+
+  // WHEN: we time more searches
+  int num_iter = 0;
+  double search_time = 0.0;
+  for (int i = 0; i < 10; i++) {
+    path.clear();
+    SearchInfo info = findSmoothPath(&planner, path, start, parent_of_start,
+                                     "Node", goal, 20000, visitor);
+    ASSERT_TRUE(info.found_path);
+    num_iter += info.num_iter;
+    search_time += info.search_time;
+  }
+
+  // THEN: the searches are long enough to be timed and expand about 50000
+  // nodes per second
+  EXPECT_GT(num_iter / 10, 1000);
+  EXPECT_GT(num_iter / (search_time * 1e-6), 1e4);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "global_planner/run_length_path.h"
+
+using namespace global_planner;
+
+TEST(RunLengthPath, straightFlightIsASingleRun) {
+  // GIVEN: an empty path
+  RunLengthPath path;
+  EXPECT_TRUE(path.empty());
+
+  // WHEN: the Cells of a straight diagonal line are added
+  for (int i = 0; i < 100; ++i) {
+    path.push_back(Cell(std::tuple<int, int, int>(i, -i, 3)));
+  }
+
+  // THEN: the path has all Cells in a single run
+  EXPECT_EQ(100, path.size());
+  EXPECT_EQ(1, path.numRuns());
+  EXPECT_EQ(Cell(std::tuple<int, int, int>(99, -99, 3)), path.back());
+  EXPECT_LT(path.memoryUsage(), 100 * sizeof(Cell));
+}
+
+TEST(RunLengthPath, returnsTheAddedCells) {
+  // GIVEN: a path with turns, climbs and a jump of several Cells
+  std::vector<Cell> cells;
+  for (int i = 0; i < 10; ++i) {
+    cells.push_back(Cell(std::tuple<int, int, int>(i, 0, 2)));
+  }
+  for (int i = 1; i < 5; ++i) {
+    cells.push_back(Cell(std::tuple<int, int, int>(9, i, 2 + i)));
+  }
+  cells.push_back(Cell(std::tuple<int, int, int>(-20, 30, 1)));
+  cells.push_back(Cell(std::tuple<int, int, int>(-20, 30, 2)));
+  RunLengthPath path;
+  for (const Cell& cell : cells) {
+    path.push_back(cell);
+  }
+
+  // WHEN: the Cells are read back
+  std::vector<Cell> read_cells;
+  path.getCells(read_cells);
+
+  // THEN: they are the added Cells in the same order, in 4 runs
+  EXPECT_EQ(cells, read_cells);
+  EXPECT_EQ(4, path.numRuns());
+}
+
+TEST(RunLengthPath, resizeKeepsTheFirstCells) {
+  // GIVEN: a path of 20 Cells in two runs
+  std::vector<Cell> cells;
+  for (int i = 0; i < 10; ++i) {
+    cells.push_back(Cell(std::tuple<int, int, int>(i, 0, 1)));
+  }
+  for (int i = 1; i <= 10; ++i) {
+    cells.push_back(Cell(std::tuple<int, int, int>(9, i, 1)));
+  }
+  RunLengthPath path;
+  for (const Cell& cell : cells) {
+    path.push_back(cell);
+  }
+
+  // WHEN: the path is shortened into the first run
+  path.resize(7);
+
+  // THEN: the first Cells are kept and new Cells continue from the new end
+  std::vector<Cell> read_cells;
+  path.getCells(read_cells);
+  cells.resize(7);
+  EXPECT_EQ(cells, read_cells);
+  EXPECT_EQ(cells.back(), path.back());
+  path.push_back(Cell(std::tuple<int, int, int>(7, 0, 1)));
+  EXPECT_EQ(1, path.numRuns());
+
+  // WHEN: the path is resized to 0
+  path.resize(0);
+
+  // THEN: it is empty
+  EXPECT_TRUE(path.empty());
+  path.getCells(read_cells);
+  EXPECT_TRUE(read_cells.empty());
+}
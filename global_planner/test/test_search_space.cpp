@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "global_planner/node.h"
+#include "global_planner/search_space.h"
+
+using namespace global_planner;
+
+namespace {
+Cell cellAt(int x, int y, int z) {
+  return Cell(std::tuple<int, int, int>(x, y, z));
+}
+}
+
+TEST(SearchSpace, findsNodesAfterGrowing) {
+  // GIVEN: a small search space
+  SearchSpace<Node> space(16);
+  Node start(cellAt(0, 0, 1), cellAt(-1, 0, 1));
+  int start_index = space.findOrInsert(start);
+  space[start_index].distance = 0.0;
+
+  // WHEN: many more nodes are inserted than it had room for
+  std::vector<Node> nodes;
+  for (int x = -10; x <= 10; ++x) {
+    for (int y = -10; y <= 10; ++y) {
+      nodes.push_back(Node(cellAt(x, y, 2), cellAt(x, y, 1)));
+    }
+  }
+  for (const Node& node : nodes) {
+    space.findOrInsert(node);
+  }
+
+  // THEN: every node has kept its entry and new nodes are open and unvisited
+  EXPECT_EQ(nodes.size() + 1, space.size());
+  EXPECT_EQ(start_index, space.findOrInsert(start));
+  EXPECT_DOUBLE_EQ(0.0, space[start_index].distance);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    int index = space.findOrInsert(nodes[i]);
+    EXPECT_TRUE(nodes[i].isEqual(space[index].node));
+    EXPECT_FALSE(space[index].closed);
+    EXPECT_EQ(-1, space[index].parent);
+    EXPECT_TRUE(std::isinf(space[index].distance));
+  }
+  EXPECT_EQ(nodes.size() + 1, space.size());
+}
+
+TEST(SearchSpace, usesTheEqualityOfTheNodeType) {
+  // GIVEN: two nodes in the same Cell with different parents
+  Cell cell = cellAt(3, 4, 5);
+  Cell parent_a = cellAt(2, 4, 5);
+  Cell parent_b = cellAt(3, 3, 5);
+
+  // WHEN: they are inserted as Nodes and as NodeWithoutSmooths
+  SearchSpace<Node> node_space;
+  int node_a = node_space.findOrInsert(Node(cell, parent_a));
+  int node_b = node_space.findOrInsert(Node(cell, parent_b));
+  SearchSpace<NodeWithoutSmooth> no_smooth_space;
+  int no_smooth_a =
+      no_smooth_space.findOrInsert(NodeWithoutSmooth(cell, parent_a));
+  int no_smooth_b =
+      no_smooth_space.findOrInsert(NodeWithoutSmooth(cell, parent_b));
+
+  // THEN: only a NodeWithoutSmooth ignores the parent
+  EXPECT_NE(node_a, node_b);
+  EXPECT_EQ(no_smooth_a, no_smooth_b);
+  EXPECT_EQ(1, no_smooth_space.size());
+}
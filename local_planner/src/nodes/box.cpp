@@ -37,8 +37,19 @@ void Box::setBoxLimits(const geometry_msgs::Point& pos,
   zmax_ = pos.z + radius_;
 }
 
-bool Box::isPointWithinBox(const double& x, const double& y, const double& z) {
+bool Box::isPointWithinBox(const double& x, const double& y,
+                           const double& z) const {
   return x < xmax_ && x > xmin_ && y < ymax_ && y > ymin_ && z < zmax_ &&
          z > zmin_;
 }
+
+void Box::getLimits(geometry_msgs::Point& min,
+                    geometry_msgs::Point& max) const {
+  min.x = xmin_;
+  min.y = ymin_;
+  min.z = zmin_;
+  max.x = xmax_;
+  max.y = ymax_;
+  max.z = zmax_;
+}
 }
@@ -12,7 +12,10 @@ class Box {
 
   void setBoxLimits(const geometry_msgs::Point& pos,
                     const double ground_distance);
-  bool isPointWithinBox(const double& x, const double& y, const double& z);
+  bool isPointWithinBox(const double& x, const double& y,
+                        const double& z) const;
+  // corners of the box, the points within are strictly between them
+  void getLimits(geometry_msgs::Point& min, geometry_msgs::Point& max) const;
 
   double radius_;
   double box_dist_to_ground_ = 2.0;
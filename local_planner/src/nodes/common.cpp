@@ -1,5 +1,6 @@
 #include "common.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -9,6 +10,71 @@
 #include <tf/transform_listener.h>
 namespace avoidance {
 
+namespace {
+// cosine and sine of every integer degree in [-180, 180], evaluated exactly
+// like fromPolarToCartesian does for arbitrary angles
+struct DegreeTable {
+  double cos_deg[361];
+  double sin_deg[361];
+  DegreeTable() {
+    for (int i = 0; i <= 360; i++) {
+      float angle = i - 180;
+      cos_deg[i] = cos(angle * (M_PI / 180.f));
+      sin_deg[i] = sin(angle * (M_PI / 180.f));
+    }
+  }
+};
+const DegreeTable degree_table;
+
+// true if the angle is an integer degree in [-180, 180], index is its
+// position in the degree table
+inline bool degreeTableIndex(float angle, int& index) {
+  if (angle < -180.f || angle > 180.f) {
+    return false;
+  }
+  int angle_int = static_cast<int>(angle);
+  index = angle_int + 180;
+  return angle_int == angle;
+}
+
+// atan2 in degrees, octant reduced polynomial approximation with an error
+// of about 1e-4 degrees
+inline float fastAtan2Deg(float y, float x) {
+  float abs_x = std::abs(x);
+  float abs_y = std::abs(y);
+  float max_xy = std::max(abs_x, abs_y);
+  if (max_xy == 0.f) {
+    return 0.f;
+  }
+  float t = std::min(abs_x, abs_y) / max_xy;
+  float t2 = t * t;
+  float angle =
+      t * (0.99997726f +
+           t2 * (-0.33262347f +
+                 t2 * (0.19354346f +
+                       t2 * (-0.11643287f +
+                             t2 * (0.05265332f + t2 * -0.01172120f)))));
+  if (abs_y > abs_x) {
+    angle = static_cast<float>(M_PI_2) - angle;
+  }
+  if (x < 0.f) {
+    angle = static_cast<float>(M_PI) - angle;
+  }
+  if (y < 0.f) {
+    angle = -angle;
+  }
+  return angle * static_cast<float>(180.0 / M_PI);
+}
+
+// the approximation is only used if it is further than this from an integer
+// degree, such that it truncates and floors to the same value as the exact one
+const float FAST_ANGLE_MARGIN_DEG = 1e-3f;
+
+inline bool closeToIntegerDegree(float angle) {
+  return std::abs(angle - std::round(angle)) < FAST_ANGLE_MARGIN_DEG;
+}
+}
+
 float distance2DPolar(int e1, int z1, int e2, int z2) {
   return sqrt(pow((e1 - e2), 2) + pow((z1 - z2), 2));
 }
@@ -16,10 +82,25 @@ float distance2DPolar(int e1, int z1, int e2, int z2) {
 // transform polar coordinates into Cartesian coordinates
 Eigen::Vector3f fromPolarToCartesian(float e, float z, double radius,
                                      const geometry_msgs::Point& pos) {
+  double cos_e, sin_e, cos_z, sin_z;
+  int e_index, z_index;
+  if (degreeTableIndex(e, e_index) && degreeTableIndex(z, z_index)) {
+    // all histogram cell centers and corners are at integer degrees
+    cos_e = degree_table.cos_deg[e_index];
+    sin_e = degree_table.sin_deg[e_index];
+    cos_z = degree_table.cos_deg[z_index];
+    sin_z = degree_table.sin_deg[z_index];
+  } else {
+    cos_e = cos(e * (M_PI / 180.f));
+    sin_e = sin(e * (M_PI / 180.f));
+    cos_z = cos(z * (M_PI / 180.f));
+    sin_z = sin(z * (M_PI / 180.f));
+  }
+
   Eigen::Vector3f p;
-  p.x() = pos.x + radius * cos(e * (M_PI / 180.f)) * sin(z * (M_PI / 180.f));
-  p.y() = pos.y + radius * cos(e * (M_PI / 180.f)) * cos(z * (M_PI / 180.f));
-  p.z() = pos.z + radius * sin(e * (M_PI / 180.f));
+  p.x() = pos.x + radius * cos_e * sin_z;
+  p.y() = pos.y + radius * cos_e * cos_z;
+  p.z() = pos.z + radius * sin_e;
 
   return p;
 }
@@ -58,6 +139,26 @@ float elevationAnglefromCartesian(const Eigen::Vector3f& pos,
   return elevationAnglefromCartesian(pos.x(), pos.y(), pos.z(), origin);
 }
 
+float fastAzimuthAnglefromCartesian(const Eigen::Vector3f& position,
+                                    const Eigen::Vector3f& origin) {
+  float angle = fastAtan2Deg(position.x() - origin.x(),
+                             position.y() - origin.y());
+  if (closeToIntegerDegree(angle)) {
+    return azimuthAnglefromCartesian(position, origin);
+  }
+  return angle;
+}
+
+float fastElevationAnglefromCartesian(const Eigen::Vector3f& position,
+                                      const Eigen::Vector3f& origin) {
+  float den = (position.topRows<2>() - origin.topRows<2>()).norm();
+  float angle = fastAtan2Deg(position.z() - origin.z(), den);
+  if (closeToIntegerDegree(angle)) {
+    return elevationAnglefromCartesian(position, origin);
+  }
+  return angle;
+}
+
 int elevationAngletoIndex(float e, int res) {  //[-90,90]
   // TODO: wrap e to [-90, 90] to be sure input is valid such that this check is
   // not necessary anymore
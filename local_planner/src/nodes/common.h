@@ -19,6 +19,7 @@ float distance2DPolar(int e1, int z1, int e2, int z2);
 * @param[in] radius
 * @param[in] pos Position from which to convert the point
 * @returns   point in cartesian CS
+* @note      Integer degree angles are looked up in a precomputed table
 **/
 Eigen::Vector3f fromPolarToCartesian(float e, float z, double radius,
                                      const geometry_msgs::Point& pos);
@@ -51,6 +52,20 @@ float elevationAnglefromCartesian(const Eigen::Vector3f& pos,
                                   const Eigen::Vector3f& origin);
 float elevationAnglefromCartesian(double x, double y, double z,
                                   const Eigen::Vector3f& pos);
+
+/**
+* @brief     Fast versions of azimuthAnglefromCartesian and
+*            elevationAnglefromCartesian for binning points into histograms
+* @details   Uses a polynomial approximation of atan2 which deviates less than
+*            1e-3 degrees from the exact angle. Close to integer degrees the
+*            exact angle is returned, hence truncating or flooring the result
+*            gives the same integer degree and histogram index as the exact
+*            functions.
+**/
+float fastAzimuthAnglefromCartesian(const Eigen::Vector3f& position,
+                                    const Eigen::Vector3f& origin);
+float fastElevationAnglefromCartesian(const Eigen::Vector3f& position,
+                                      const Eigen::Vector3f& origin);
 /**
 * @brief     Checks if the computed histogram index given an elevation angle and
 *resolution is valid
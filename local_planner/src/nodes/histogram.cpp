@@ -2,105 +2,77 @@
 namespace avoidance {
 Histogram::Histogram(const int res)
     : resolution{res}, z_dim{360 / resolution}, e_dim{180 / resolution} {
-  bin.resize(e_dim);
-  age.resize(e_dim);
-  dist.resize(e_dim);
-  for (int i = 0; i < e_dim; ++i) {
-    bin[i].resize(z_dim);
-    age[i].resize(z_dim);
-    dist[i].resize(z_dim);
-  }
   setZero();
 }
 
-Histogram::~Histogram() {}
-
 void Histogram::upsample() {
   resolution = resolution / 2;
   z_dim = 2 * z_dim;
   e_dim = 2 * e_dim;
-  std::vector<std::vector<double> > temp_bin;
-  std::vector<std::vector<double> > temp_age;
-  std::vector<std::vector<double> > temp_dist;
-  temp_bin.resize(e_dim);
-  temp_age.resize(e_dim);
-  temp_dist.resize(e_dim);
-  for (int i = 0; i < e_dim; ++i) {
-    temp_bin[i].resize(z_dim);
-    temp_age[i].resize(z_dim);
-    temp_dist[i].resize(z_dim);
-  }
-  for (int i = 0; i < e_dim; ++i) {
-    for (int j = 0; j < z_dim; ++j) {
+  bin.resize(e_dim * z_dim);
+  age.resize(e_dim * z_dim);
+  dist.resize(e_dim * z_dim);
+
+  // iterate backwards so that the low resolution cells are read before they
+  // are overwritten
+  const int z_dim_lowres = z_dim / 2;
+  for (int i = e_dim - 1; i >= 0; --i) {
+    for (int j = z_dim - 1; j >= 0; --j) {
       int i_lowres = floor(i / 2);
       int j_lowres = floor(j / 2);
-      temp_bin[i][j] = bin[i_lowres][j_lowres];
-      temp_age[i][j] = age[i_lowres][j_lowres];
-      temp_dist[i][j] = dist[i_lowres][j_lowres];
+      int lowres = i_lowres * z_dim_lowres + j_lowres;
+      bin[i * z_dim + j] = bin[lowres];
+      age[i * z_dim + j] = age[lowres];
+      dist[i * z_dim + j] = dist[lowres];
     }
   }
-  bin = temp_bin;
-  age = temp_age;
-  dist = temp_dist;
 }
 
 void Histogram::downsample() {
+  const int z_dim_high_res = z_dim;
   resolution = 2 * resolution;
   z_dim = z_dim / 2;
   e_dim = e_dim / 2;
-  std::vector<std::vector<double> > temp_bin;
-  std::vector<std::vector<double> > temp_age;
-  std::vector<std::vector<double> > temp_dist;
-  temp_bin.resize(e_dim);
-  temp_age.resize(e_dim);
-  temp_dist.resize(e_dim);
-  for (int i = 0; i < e_dim; ++i) {
-    temp_bin[i].resize(z_dim);
-    temp_age[i].resize(z_dim);
-    temp_dist[i].resize(z_dim);
-  }
+
+  // iterate forwards: the high resolution cells of a low resolution cell are
+  // never in front of it
   for (int i = 0; i < e_dim; ++i) {
     for (int j = 0; j < z_dim; ++j) {
       int i_high_res = 2 * i;
       int j_high_res = 2 * j;
+      int c00 = i_high_res * z_dim_high_res + j_high_res;
+      int c10 = c00 + z_dim_high_res;
+      int c01 = c00 + 1;
+      int c11 = c10 + 1;
 
-      double mean_bin =
-          (bin[i_high_res][j_high_res] + bin[i_high_res + 1][j_high_res] +
-           bin[i_high_res][j_high_res + 1] +
-           bin[i_high_res + 1][j_high_res + 1]) /
-          4.0;
-      double mean_age =
-          (age[i_high_res][j_high_res] + age[i_high_res + 1][j_high_res] +
-           age[i_high_res][j_high_res + 1] +
-           age[i_high_res + 1][j_high_res + 1]) /
-          4.0;
-      double mean_dist =
-          (dist[i_high_res][j_high_res] + dist[i_high_res + 1][j_high_res] +
-           dist[i_high_res][j_high_res + 1] +
-           dist[i_high_res + 1][j_high_res + 1]) /
-          4.0;
+      double mean_bin = (bin[c00] + bin[c10] + bin[c01] + bin[c11]) / 4.0;
+      double mean_age = (age[c00] + age[c10] + age[c01] + age[c11]) / 4.0;
+      double mean_dist = (dist[c00] + dist[c10] + dist[c01] + dist[c11]) / 4.0;
 
       if (mean_bin >= 0.5) {
-        temp_bin[i][j] = 1.0;
+        bin[i * z_dim + j] = 1.0;
       } else {
-        temp_bin[i][j] = 0.0;
+        bin[i * z_dim + j] = 0.0;
       }
-      temp_age[i][j] = mean_age;
-      temp_dist[i][j] = mean_dist;
+      age[i * z_dim + j] = mean_age;
+      dist[i * z_dim + j] = mean_dist;
     }
   }
-  bin = temp_bin;
-  age = temp_age;
-  dist = temp_dist;
+  bin.resize(e_dim * z_dim);
+  age.resize(e_dim * z_dim);
+  dist.resize(e_dim * z_dim);
 }
 
 void Histogram::setZero() {
-  for (int i = 0; i < e_dim; ++i) {
-    for (int j = 0; j < z_dim; ++j) {
-      bin[i][j] = 0.0;
-      age[i][j] = 0.0;
-      dist[i][j] = 0.0;
-    }
-  }
+  bin.assign(e_dim * z_dim, 0.f);
+  age.assign(e_dim * z_dim, 0.f);
+  dist.assign(e_dim * z_dim, 0.f);
+}
+
+void Histogram::reset(const int res) {
+  resolution = res;
+  z_dim = 360 / resolution;
+  e_dim = 180 / resolution;
+  setZero();
 }
 }
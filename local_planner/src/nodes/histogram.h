@@ -16,43 +16,49 @@ class Histogram {
   int resolution;
   int z_dim;
   int e_dim;
-  std::vector<std::vector<double> > bin;
-  std::vector<std::vector<double> > age;
-  std::vector<std::vector<double> > dist;
-
-  inline void wrapIndex(int &x, int &y) const {
-    while (x < 0) x += e_dim;
-    while (x > e_dim - 1) x -= e_dim;
-    while (y < 0) y += z_dim;
-    while (y > z_dim - 1) y -= z_dim;
+  // row-major [e][z] cells, kept in one contiguous buffer per layer. Resizing
+  // and resampling reuse the buffers, so a histogram only allocates when it
+  // grows past its largest previous size.
+  std::vector<float> bin;
+  std::vector<float> age;
+  std::vector<float> dist;
+
+  inline int index(int x, int y) const {
+    // branch-free wrap, also handles indices more than one period away
+    x %= e_dim;
+    y %= z_dim;
+    x += e_dim * (x < 0);
+    y += z_dim * (y < 0);
+    return x * z_dim + y;
   }
 
  public:
   Histogram(const int res);
-  ~Histogram();
 
-  inline double get_bin(int x, int y) const {
-    wrapIndex(x, y);
-    return bin[x][y];
-  }
+  inline double get_bin(int x, int y) const { return bin[index(x, y)]; }
+  inline double get_age(int x, int y) const { return age[index(x, y)]; }
+  inline double get_dist(int x, int y) const { return dist[index(x, y)]; }
+  // all bins in row-major [e][z] order, for loops over the whole histogram
+  inline const float* bins() const { return bin.data(); }
 
-  inline double get_age(int x, int y) const {
-    wrapIndex(x, y);
-    return age[x][y];
+  inline void set_bin(int x, int y, double value) {
+    bin[x * z_dim + y] = value;
   }
-
-  inline double get_dist(int x, int y) const {
-    wrapIndex(x, y);
-    return dist[x][y];
+  inline void set_age(int x, int y, double value) {
+    age[x * z_dim + y] = value;
+  }
+  inline void set_dist(int x, int y, double value) {
+    dist[x * z_dim + y] = value;
   }
-
-  inline void set_bin(int x, int y, double value) { bin[x][y] = value; }
-  inline void set_age(int x, int y, double value) { age[x][y] = value; }
-  inline void set_dist(int x, int y, double value) { dist[x][y] = value; }
 
   void upsample();
   void downsample();
   void setZero();
+  /**
+  * @brief     Sets the resolution and clears all cells, reusing the storage
+  * @param[in] res new resolution in degrees
+  **/
+  void reset(const int res);
 };
 }
 
@@ -0,0 +1,160 @@
+#include "histogram_binning.h"
+
+#include "planner_functions.h"
+
+#ifdef LOCAL_PLANNER_USE_CUDA
+#include "histogram_binning_cuda.h"
+
+#include <ros/console.h>
+
+#include <cmath>
+#endif
+
+namespace avoidance {
+
+void CpuBinningBackend::setCloud(
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud) {
+  complete_cloud_ = &complete_cloud;
+}
+
+void CpuBinningBackend::binPoints(
+    const binningParams& params, const binningQuery* queries,
+    Histogram* const* histograms, binningResult* results, size_t n_queries,
+    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud) {
+  static const std::vector<pcl::PointCloud<pcl::PointXYZ>> no_cloud;
+  const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud =
+      complete_cloud_ ? *complete_cloud_ : no_cloud;
+  for (size_t i = 0; i < n_queries; i++) {
+    Eigen::Vector3f closest_point;
+    double distance_to_closest_point;
+    histograms[i]->reset(ALPHA_RES);
+    results[i].n_points = filterPointCloud(
+        cropped_cloud, *histograms[i], closest_point,
+        distance_to_closest_point, results[i].counter_backoff, complete_cloud,
+        params.min_cloud_size, params.min_dist_backoff, queries[i].box,
+        queries[i].position, queries[i].histogram_position,
+        params.min_realsense_dist, 0.0);
+  }
+}
+
+#ifdef LOCAL_PLANNER_USE_CUDA
+namespace {
+// bins the points of a batch of queries in one kernel launch. If a CUDA call
+// fails, the batch and all later ones are binned on the CPU.
+class CudaBinningBackend : public BinningBackend {
+ public:
+  void setCloud(const std::vector<pcl::PointCloud<pcl::PointXYZ>>&
+                    complete_cloud) override {
+    cpu_backend_.setCloud(complete_cloud);
+    if (failed_) {
+      return;
+    }
+    xyz_.clear();
+    for (const pcl::PointCloud<pcl::PointXYZ>& cloud : complete_cloud) {
+      for (const pcl::PointXYZ& p : cloud) {
+        if (!std::isnan(p.x) && !std::isnan(p.y) && !std::isnan(p.z)) {
+          xyz_.push_back(p.x);
+          xyz_.push_back(p.y);
+          xyz_.push_back(p.z);
+        }
+      }
+    }
+    checkFailure(device_.setPoints(xyz_));
+  }
+
+  void binPoints(const binningParams& params, const binningQuery* queries,
+                 Histogram* const* histograms, binningResult* results,
+                 size_t n_queries,
+                 pcl::PointCloud<pcl::PointXYZ>& cropped_cloud) override {
+    if (!failed_) {
+      device_queries_.resize(n_queries);
+      for (size_t i = 0; i < n_queries; i++) {
+        device_queries_[i] = toDeviceQuery(queries[i], params);
+      }
+      checkFailure(device_.binPoints(device_queries_, counts_, dist_sums_,
+                                     n_points_, counter_backoff_));
+    }
+    if (failed_) {
+      cpu_backend_.binPoints(params, queries, histograms, results, n_queries,
+                             cropped_cloud);
+      return;
+    }
+
+    // the normalization of filterPointCloud
+    const int n_bins = GRID_LENGTH_E * GRID_LENGTH_Z;
+    for (size_t i = 0; i < n_queries; i++) {
+      Histogram& histogram = *histograms[i];
+      histogram.reset(ALPHA_RES);
+      results[i].counter_backoff = counter_backoff_[i];
+      results[i].n_points = n_points_[i];
+      if (n_points_[i] <= params.min_cloud_size) {
+        results[i].n_points = 0;
+        continue;
+      }
+      for (int e = 0; e < GRID_LENGTH_E; e++) {
+        for (int z = 0; z < GRID_LENGTH_Z; z++) {
+          const int bin = i * n_bins + e * GRID_LENGTH_Z + z;
+          if (counts_[bin] > 0) {
+            histogram.set_bin(e, z, 1);
+            histogram.set_dist(e, z, dist_sums_[bin] / counts_[bin]);
+          }
+        }
+      }
+    }
+  }
+
+  bool batched() const override { return !failed_; }
+
+ private:
+  cuda::DeviceBinning device_;
+  CpuBinningBackend cpu_backend_;
+  bool failed_ = false;
+
+  std::vector<float> xyz_;
+  std::vector<cuda::deviceQuery> device_queries_;
+  std::vector<int> counts_;
+  std::vector<float> dist_sums_;
+  std::vector<int> n_points_;
+  std::vector<int> counter_backoff_;
+
+  static cuda::deviceQuery toDeviceQuery(const binningQuery& query,
+                                         const binningParams& params) {
+    cuda::deviceQuery q;
+    geometry_msgs::Point box_min, box_max;
+    query.box.getLimits(box_min, box_max);
+    for (int k = 0; k < 3; k++) {
+      q.position[k] = query.position[k];
+      q.histogram_position[k] = query.histogram_position[k];
+    }
+    q.box_min[0] = box_min.x;
+    q.box_min[1] = box_min.y;
+    q.box_min[2] = box_min.z;
+    q.box_max[0] = box_max.x;
+    q.box_max[1] = box_max.y;
+    q.box_max[2] = box_max.z;
+    q.min_dist = params.min_realsense_dist;
+    q.max_dist = query.box.radius_;
+    q.min_dist_backoff = params.min_dist_backoff;
+    return q;
+  }
+
+  void checkFailure(bool success) {
+    if (!success && !failed_) {
+      ROS_WARN("CUDA binning failed, the histograms are built on the CPU");
+      failed_ = true;
+    }
+  }
+};
+}
+#endif
+
+std::unique_ptr<BinningBackend> createBinningBackend() {
+#ifdef LOCAL_PLANNER_USE_CUDA
+  if (cuda::DeviceBinning::deviceAvailable()) {
+    return std::unique_ptr<BinningBackend>(new CudaBinningBackend());
+  }
+  ROS_WARN("No CUDA device found, the histograms are built on the CPU");
+#endif
+  return std::unique_ptr<BinningBackend>(new CpuBinningBackend());
+}
+}
@@ -0,0 +1,96 @@
+#ifndef HISTOGRAM_BINNING_H
+#define HISTOGRAM_BINNING_H
+
+#include "box.h"
+#include "histogram.h"
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <memory>
+#include <vector>
+
+namespace avoidance {
+
+// the crop box and the histogram origin of one histogram
+struct binningQuery {
+  Eigen::Vector3f position;            // the distances are measured from here
+  Eigen::Vector3f histogram_position;  // origin of the histogram
+  Box box;                             // with the limits around position
+};
+
+struct binningParams {
+  double min_cloud_size = 0.0;
+  double min_dist_backoff = 0.0;
+  double min_realsense_dist = 0.0;
+};
+
+// the counts of filterPointCloud without the cropped cloud
+struct binningResult {
+  size_t n_points = 0;  // 0 if there were not more than min_cloud_size
+  int counter_backoff = 0;
+};
+
+/**
+* @brief Crops a point cloud and bins it into histograms, like the
+*        filterPointCloud which builds a histogram but for many queries at
+*        once. The CPU backend does one query after the other, a backend of
+*        an accelerator can do a whole batch in one pass over the points.
+**/
+class BinningBackend {
+ public:
+  virtual ~BinningBackend() = default;
+
+  /**
+  * @brief     Sets the points of the following queries. The clouds are
+  *            referenced, not copied, until the next call
+  **/
+  virtual void setCloud(
+      const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud) = 0;
+
+  /**
+  * @brief     Fills a normalized histogram of the points of each query, at
+  *            ALPHA_RES. Concurrent calls for different histograms are safe
+  *            unless the backend is batched
+  * @param[out] histograms one per query, reset by the call
+  * @param     cropped_cloud, working memory of the caller such that a call
+  *            does not allocate, one for each of the concurrent calls
+  **/
+  virtual void binPoints(const binningParams& params,
+                         const binningQuery* queries,
+                         Histogram* const* histograms, binningResult* results,
+                         size_t n_queries,
+                         pcl::PointCloud<pcl::PointXYZ>& cropped_cloud) = 0;
+
+  /**
+  * @brief     True if the queries of a batch should be given to binPoints
+  *            together, instead of one by one from the threads which use them
+  **/
+  virtual bool batched() const = 0;
+};
+
+class CpuBinningBackend : public BinningBackend {
+ public:
+  void setCloud(const std::vector<pcl::PointCloud<pcl::PointXYZ>>&
+                    complete_cloud) override;
+  void binPoints(const binningParams& params, const binningQuery* queries,
+                 Histogram* const* histograms, binningResult* results,
+                 size_t n_queries,
+                 pcl::PointCloud<pcl::PointXYZ>& cropped_cloud) override;
+  bool batched() const override { return false; }
+
+ private:
+  const std::vector<pcl::PointCloud<pcl::PointXYZ>>* complete_cloud_ = nullptr;
+};
+
+/**
+* @brief     Returns the CUDA backend if the package was built with
+*            LOCAL_PLANNER_USE_CUDA and a device is found, the CPU backend
+*            otherwise
+**/
+std::unique_ptr<BinningBackend> createBinningBackend();
+}
+
+#endif  // HISTOGRAM_BINNING_H
@@ -0,0 +1,207 @@
+#include "histogram_binning_cuda.h"
+
+#include "histogram.h"
+
+#include <cuda_runtime.h>
+
+#include <math.h>
+
+namespace avoidance {
+namespace cuda {
+namespace {
+const int N_BINS = GRID_LENGTH_E * GRID_LENGTH_Z;
+const int THREADS_PER_BLOCK = 256;
+
+bool ok(cudaError_t error) { return error == cudaSuccess; }
+
+template <typename T>
+bool grow(T*& buffer, size_t& capacity, size_t size) {
+  if (size <= capacity) {
+    return true;
+  }
+  cudaFree(buffer);
+  buffer = nullptr;
+  capacity = 0;
+  if (!ok(cudaMalloc(reinterpret_cast<void**>(&buffer), size * sizeof(T)))) {
+    buffer = nullptr;
+    return false;
+  }
+  capacity = size;
+  return true;
+}
+
+// the same as elevationAngletoIndex and azimuthAngletoIndex of common.cpp
+__device__ int elevationIndex(float e) {
+  if (e < -90.f || e > 90.f) {
+    return 0;
+  }
+  if (e == 90.f) {
+    e = 89;
+  }
+  e += 90;
+  e = e + (ALPHA_RES - ((int)e % ALPHA_RES));
+  return (int)floorf(e / ALPHA_RES) - 1;
+}
+
+__device__ int azimuthIndex(float z) {
+  if (z < -180.f || z > 180.f) {
+    return 0;
+  }
+  if (z == 180.f) {
+    z = -180;
+  }
+  z += 180;
+  z = z + (ALPHA_RES - ((int)z % ALPHA_RES));
+  return (int)(z / ALPHA_RES - 1);
+}
+
+// one thread per point and query, blockIdx.y is the query. The angles are
+// computed in double like the exact functions of common.cpp, such that the
+// points fall into the same bins as on the CPU
+__global__ void binPointsKernel(const float* points, int n_points,
+                                const deviceQuery* queries, int* counts,
+                                float* dist_sums, int* query_counts) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  const int q = blockIdx.y;
+  if (i >= n_points) {
+    return;
+  }
+  const deviceQuery& query = queries[q];
+  const float x = points[3 * i];
+  const float y = points[3 * i + 1];
+  const float z = points[3 * i + 2];
+
+  // false for NaN points as well
+  if (!(x < query.box_max[0] && x > query.box_min[0] &&
+        y < query.box_max[1] && y > query.box_min[1] &&
+        z < query.box_max[2] && z > query.box_min[2])) {
+    return;
+  }
+  const float dx = query.position[0] - x;
+  const float dy = query.position[1] - y;
+  const float dz = query.position[2] - z;
+  const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+  if (!(distance > query.min_dist && distance < query.max_dist)) {
+    return;
+  }
+  atomicAdd(&query_counts[2 * q], 1);
+  if (distance < query.min_dist_backoff) {
+    atomicAdd(&query_counts[2 * q + 1], 1);
+  }
+
+  const float hx = x - query.histogram_position[0];
+  const float hy = y - query.histogram_position[1];
+  const float hz = z - query.histogram_position[2];
+  const float bin_distance = sqrtf(hx * hx + hy * hy + hz * hz);
+  const float den = sqrtf(hx * hx + hy * hy);
+  // truncated to whole degrees like in addPointToHistogram
+  const int e_angle = (float)(atan2((double)hz, (double)den) * 180.0 / M_PI);
+  const int z_angle = (float)(atan2((double)hx, (double)hy) * 180.0 / M_PI);
+  const int bin = q * N_BINS + elevationIndex(e_angle) * GRID_LENGTH_Z +
+                  azimuthIndex(z_angle);
+  atomicAdd(&counts[bin], 1);
+  atomicAdd(&dist_sums[bin], bin_distance);
+}
+}
+
+DeviceBinning::~DeviceBinning() {
+  cudaFree(points_);
+  cudaFree(queries_);
+  cudaFree(counts_);
+  cudaFree(dist_sums_);
+  cudaFree(query_counts_);
+}
+
+bool DeviceBinning::deviceAvailable() {
+  int n_devices = 0;
+  return ok(cudaGetDeviceCount(&n_devices)) && n_devices > 0;
+}
+
+bool DeviceBinning::setPoints(const std::vector<float>& xyz) {
+  n_points_ = 0;
+  if (!grow(points_, points_capacity_, xyz.size())) {
+    return false;
+  }
+  if (!xyz.empty() &&
+      !ok(cudaMemcpy(points_, xyz.data(), xyz.size() * sizeof(float),
+                     cudaMemcpyHostToDevice))) {
+    return false;
+  }
+  n_points_ = xyz.size() / 3;
+  return true;
+}
+
+bool DeviceBinning::reserveQueries(size_t n_queries) {
+  if (n_queries <= queries_capacity_) {
+    return true;
+  }
+  size_t capacity = queries_capacity_;
+  size_t bins_capacity = queries_capacity_ * N_BINS;
+  size_t counts_capacity = queries_capacity_ * 2;
+  bool grown = grow(queries_, capacity, n_queries);
+  capacity = bins_capacity;
+  grown = grown && grow(counts_, capacity, n_queries * N_BINS);
+  capacity = bins_capacity;
+  grown = grown && grow(dist_sums_, capacity, n_queries * N_BINS);
+  capacity = counts_capacity;
+  grown = grown && grow(query_counts_, capacity, n_queries * 2);
+  // on a failure all buffers are allocated again by the next call
+  queries_capacity_ = grown ? n_queries : 0;
+  return grown;
+}
+
+bool DeviceBinning::binPoints(const std::vector<deviceQuery>& queries,
+                              std::vector<int>& counts,
+                              std::vector<float>& dist_sums,
+                              std::vector<int>& n_points,
+                              std::vector<int>& counter_backoff) {
+  const size_t n_queries = queries.size();
+  counts.assign(n_queries * N_BINS, 0);
+  dist_sums.assign(n_queries * N_BINS, 0.f);
+  n_points.assign(n_queries, 0);
+  counter_backoff.assign(n_queries, 0);
+  if (n_queries == 0 || n_points_ == 0) {
+    return true;
+  }
+  if (!reserveQueries(n_queries)) {
+    return false;
+  }
+
+  bool success =
+      ok(cudaMemcpy(queries_, queries.data(), n_queries * sizeof(deviceQuery),
+                    cudaMemcpyHostToDevice)) &&
+      ok(cudaMemset(counts_, 0, n_queries * N_BINS * sizeof(int))) &&
+      ok(cudaMemset(dist_sums_, 0, n_queries * N_BINS * sizeof(float))) &&
+      ok(cudaMemset(query_counts_, 0, n_queries * 2 * sizeof(int)));
+  if (!success) {
+    return false;
+  }
+
+  dim3 blocks((n_points_ + THREADS_PER_BLOCK - 1) / THREADS_PER_BLOCK,
+              n_queries);
+  binPointsKernel<<<blocks, THREADS_PER_BLOCK>>>(
+      points_, n_points_, queries_, counts_, dist_sums_, query_counts_);
+  if (!ok(cudaGetLastError())) {
+    return false;
+  }
+
+  // the copies wait for the kernel
+  std::vector<int>& query_counts = host_query_counts_;
+  query_counts.resize(n_queries * 2);
+  success =
+      ok(cudaMemcpy(counts.data(), counts_, counts.size() * sizeof(int),
+                    cudaMemcpyDeviceToHost)) &&
+      ok(cudaMemcpy(dist_sums.data(), dist_sums_,
+                    dist_sums.size() * sizeof(float),
+                    cudaMemcpyDeviceToHost)) &&
+      ok(cudaMemcpy(query_counts.data(), query_counts_,
+                    query_counts.size() * sizeof(int),
+                    cudaMemcpyDeviceToHost));
+  for (size_t q = 0; q < n_queries; q++) {
+    n_points[q] = query_counts[2 * q];
+    counter_backoff[q] = query_counts[2 * q + 1];
+  }
+  return success;
+}
+}
+}
@@ -0,0 +1,69 @@
+#ifndef HISTOGRAM_BINNING_CUDA_H
+#define HISTOGRAM_BINNING_CUDA_H
+
+// interface of the CUDA kernels, without Eigen and PCL such that nvcc only
+// compiles plain C++
+
+#include <cstddef>
+#include <vector>
+
+namespace avoidance {
+namespace cuda {
+
+// a binningQuery and the distance limits of binningParams in plain floats
+struct deviceQuery {
+  float position[3];
+  float histogram_position[3];
+  float box_min[3];
+  float box_max[3];
+  float min_dist;  // min_realsense_dist
+  float max_dist;  // radius of the box
+  float min_dist_backoff;
+};
+
+/**
+* @brief Keeps the points on the device and bins them for a batch of queries
+*        in one kernel launch, with a thread per point and query. The device
+*        buffers only grow, such that a tree build does not allocate.
+**/
+class DeviceBinning {
+ public:
+  DeviceBinning() = default;
+  ~DeviceBinning();
+  DeviceBinning(const DeviceBinning&) = delete;
+  DeviceBinning& operator=(const DeviceBinning&) = delete;
+
+  static bool deviceAvailable();
+
+  /**
+  * @brief     Copies the points to the device, three floats per point
+  **/
+  bool setPoints(const std::vector<float>& xyz);
+
+  /**
+  * @brief     Bins the points for every query. The bins of query q are at
+  *            q * GRID_LENGTH_E * GRID_LENGTH_Z in row-major [e][z] order
+  * @returns   false if a CUDA call failed
+  **/
+  bool binPoints(const std::vector<deviceQuery>& queries,
+                 std::vector<int>& counts, std::vector<float>& dist_sums,
+                 std::vector<int>& n_points, std::vector<int>& counter_backoff);
+
+ private:
+  float* points_ = nullptr;
+  size_t n_points_ = 0;
+  size_t points_capacity_ = 0;
+
+  deviceQuery* queries_ = nullptr;
+  int* counts_ = nullptr;
+  float* dist_sums_ = nullptr;
+  int* query_counts_ = nullptr;  // n_points and counter_backoff of each query
+  size_t queries_capacity_ = 0;
+  std::vector<int> host_query_counts_;
+
+  bool reserveQueries(size_t n_queries);
+};
+}
+}
+
+#endif  // HISTOGRAM_BINNING_CUDA_H
@@ -2,17 +2,24 @@
 
 #include "common.h"
 #include "planner_functions.h"
+#include "stage_timer.h"
 #include "star_planner.h"
 #include "tree_node.h"
 
 #include <sensor_msgs/image_encodings.h>
 
+#include <utility>
+
 namespace avoidance {
 
 LocalPlanner::LocalPlanner() : star_planner_(new StarPlanner()) {}
 
 LocalPlanner::~LocalPlanner() {}
 
+void LocalPlanner::setStageTimers(StageTimers* stage_timers) {
+  stage_timers_ = stage_timers;
+}
+
 // update UAV pose
 void LocalPlanner::setPose(const geometry_msgs::PoseStamped msg) {
   pose_.header = msg.header;
@@ -41,6 +48,7 @@ void LocalPlanner::setPose(const geometry_msgs::PoseStamped msg) {
 void LocalPlanner::dynamicReconfigureSetParams(
     avoidance::LocalPlannerNodeConfig &config, uint32_t level) {
   histogram_box_.radius_ = config.box_radius_;
+  obstacle_memory_.setMaxDistance(2.0 * histogram_box_.radius_);
   goal_cost_param_ = config.goal_cost_param_;
   smooth_cost_param_ = config.smooth_cost_param_;
   min_speed_ = config.min_speed_;
@@ -54,6 +62,7 @@ void LocalPlanner::dynamicReconfigureSetParams(
   no_progress_slope_ = config.no_progress_slope_;
   min_cloud_size_ = config.min_cloud_size_;
   min_realsense_dist_ = config.min_realsense_dist_;
+  downsample_distance_ = config.downsample_distance_;
   min_dist_backoff_ = config.min_dist_backoff_;
   pointcloud_timeout_hover_ = config.pointcloud_timeout_hover_;
   pointcloud_timeout_land_ = config.pointcloud_timeout_land_;
@@ -71,6 +80,15 @@ void LocalPlanner::dynamicReconfigureSetParams(
   stop_in_front_ = config.stop_in_front_;
   use_back_off_ = config.use_back_off_;
   use_VFH_star_ = config.use_VFH_star_;
+  if (use_obstacle_memory_ != config.use_obstacle_memory_) {
+    obstacle_memory_.clear();
+  }
+  use_obstacle_memory_ = config.use_obstacle_memory_;
+  if (use_obstacle_tracker_ != config.use_obstacle_tracker_) {
+    obstacle_tracker_.clear();
+  }
+  use_obstacle_tracker_ = config.use_obstacle_tracker_;
+  deduplicate_camera_overlap_ = config.deduplicate_camera_overlap_;
   adapt_cost_params_ = config.adapt_cost_params_;
   send_obstacles_fcu_ = config.send_obstacles_fcu_;
 
@@ -102,7 +120,7 @@ void LocalPlanner::applyGoal() {
 
 void LocalPlanner::runPlanner() {
   // reset candidates for visualization
-  initGridCells(path_candidates_);
+  candidates_.clear();
   initGridCells(path_rejected_);
   initGridCells(path_blocked_);
   initGridCells(path_selected_);
@@ -117,30 +135,32 @@ void LocalPlanner::runPlanner() {
   tf::Matrix3x3 m(q);
   double roll, pitch, yaw;
   m.getRPY(roll, pitch, yaw);
-  z_FOV_idx_.clear();
-  calculateFOV(h_FOV_, v_FOV_, z_FOV_idx_, e_FOV_min_, e_FOV_max_, yaw, pitch);
-
-  // visualization of FOV in RViz
-  initGridCells(FOV_cells_);
-  geometry_msgs::Point p;
-  for (int j = e_FOV_min_; j <= e_FOV_max_; j++) {
-    for (size_t i = 0; i < z_FOV_idx_.size(); i++) {
-      p.x = elevationIndexToAngle(j, ALPHA_RES);
-      p.y = azimuthIndexToAngle(z_FOV_idx_[i], ALPHA_RES);
-      p.z = 0;
-      FOV_cells_.cells.push_back(p);
-    }
-  }
+  calculateFOV(h_FOV_, v_FOV_, z_FOV_idx_, z_FOV_mask_, e_FOV_min_,
+               e_FOV_max_, yaw, pitch);
 
   histogram_box_.setBoxLimits(pose_.pose.position, ground_distance_);
 
-  filterPointCloud(final_cloud_, closest_point_, distance_to_closest_point_,
-                   counter_close_points_backoff_, complete_cloud_,
-                   min_cloud_size_, min_dist_backoff_, histogram_box_,
-                   toEigen(pose_.pose.position), min_realsense_dist_);
+  {
+    ScopedStageTimer timer(stage_timers_, Stage::filterPointCloud);
+    cropped_cloud_size_ = filterPointCloud(
+        final_cloud_, new_histogram_, closest_point_,
+        distance_to_closest_point_, counter_close_points_backoff_,
+        complete_cloud_, min_cloud_size_, min_dist_backoff_, histogram_box_,
+        toEigen(pose_.pose.position), toEigen(pose_.pose.position),
+        min_realsense_dist_, downsample_distance_,
+        deduplicate_camera_overlap_ ? camera_frustums_
+                                    : std::vector<CameraFrustum>());
+  }
+  if (use_obstacle_tracker_) {
+    ScopedStageTimer timer(stage_timers_, Stage::trackObstacles);
+    // pcl stamps are in microseconds
+    obstacle_tracker_.update(final_cloud_, final_cloud_.header.stamp * 1e-6,
+                             toEigen(pose_.pose.position),
+                             histogram_box_.radius_);
+  }
 
   safety_radius_ = adaptSafetyMarginHistogram(
-      distance_to_closest_point_, final_cloud_.points.size(), min_cloud_size_);
+      distance_to_closest_point_, cropped_cloud_size_, min_cloud_size_);
 
   determineStrategy();
 }
@@ -148,49 +168,34 @@ void LocalPlanner::runPlanner() {
 void LocalPlanner::create2DObstacleRepresentation(const bool send_to_fcu) {
   // construct histogram if it is needed
   // or if it is required by the FCU
-  reprojectPoints(polar_histogram_);
-  Histogram propagated_histogram = Histogram(2 * ALPHA_RES);
-  Histogram new_histogram = Histogram(ALPHA_RES);
-  to_fcu_histogram_.setZero();
-
-  propagateHistogram(propagated_histogram, reprojected_points_,
-                     reprojected_points_age_, reprojected_points_dist_, pose_);
-  generateNewHistogram(new_histogram, final_cloud_, pose_);
-  combinedHistogram(hist_is_empty_, new_histogram, propagated_histogram,
-                    waypoint_outside_FOV_, z_FOV_idx_, e_FOV_min_, e_FOV_max_);
-  if (send_to_fcu) {
-    compressHistogramElevation(to_fcu_histogram_, new_histogram);
-    updateObstacleDistanceMsg(to_fcu_histogram_);
-  }
-  polar_histogram_ = new_histogram;
-
-  // generate histogram image for logging
-  histogram_image_ = generateHistogramImage(polar_histogram_);
-}
-
-sensor_msgs::Image LocalPlanner::generateHistogramImage(Histogram &histogram) {
-  sensor_msgs::Image image;
-  double sensor_max_dist = 20.0;
-  image.header.stamp = ros::Time::now();
-  image.height = GRID_LENGTH_E;
-  image.width = GRID_LENGTH_Z;
-  image.encoding = sensor_msgs::image_encodings::MONO8;
-  image.is_bigendian = 0;
-  image.step = 255;
-
-  int image_size = static_cast<int>(image.height * image.width);
-  image.data.reserve(image_size);
-
-  // fill image data
-  for (int e = GRID_LENGTH_E - 1; e >= 0; e--) {
-    for (int z = 0; z < GRID_LENGTH_Z; z++) {
-      double depth_val =
-          image.step * histogram.get_dist(e, z) / sensor_max_dist;
-      image.data.push_back(
-          (int)std::max(0.0, std::min((double)image.step, depth_val)));
+  // new_histogram_ has been filled while cropping the point cloud
+  if (use_obstacle_memory_) {
+    ScopedStageTimer timer(stage_timers_, Stage::propagateHistogram);
+    obstacle_memory_.update(final_cloud_, !waypoint_outside_FOV_);
+    obstacle_memory_.getHistogram(
+        propagated_histogram_, toEigen(pose_.pose.position), z_FOV_idx_,
+        e_FOV_min_, e_FOV_max_, 0.3f, reproj_age_);
+  } else {
+    {
+      ScopedStageTimer timer(stage_timers_, Stage::reprojectPoints);
+      reprojectPoints(polar_histogram_);
     }
+    ScopedStageTimer timer(stage_timers_, Stage::propagateHistogram);
+    propagated_histogram_.reset(2 * ALPHA_RES);
+    propagateHistogram(propagated_histogram_, reprojected_points_,
+                       reprojected_points_age_, reprojected_points_dist_,
+                       pose_);
+  }
+  {
+    ScopedStageTimer timer(stage_timers_, Stage::combinedHistogram);
+    combinedHistogram(hist_is_empty_, new_histogram_, propagated_histogram_,
+                      waypoint_outside_FOV_, z_FOV_mask_, e_FOV_min_,
+                      e_FOV_max_);
+  }
+  if (send_to_fcu) {
+    updateObstacleDistanceMsg();
   }
-  return image;
+  std::swap(polar_histogram_, new_histogram_);
 }
 
 void LocalPlanner::determineStrategy() {
@@ -213,9 +218,9 @@ void LocalPlanner::determineStrategy() {
     }
 
     if (send_obstacles_fcu_) {
-      create2DObstacleRepresentation(true);
+      updateObstacleDistanceMsg();
     }
-  } else if (final_cloud_.points.size() > min_cloud_size_ && stop_in_front_ &&
+  } else if (cropped_cloud_size_ > min_cloud_size_ && stop_in_front_ &&
              reach_altitude_) {
     obstacle_ = true;
     ROS_INFO(
@@ -224,11 +229,11 @@ void LocalPlanner::determineStrategy() {
     waypoint_type_ = direct;
 
     if (send_obstacles_fcu_) {
-      create2DObstacleRepresentation(true);
+      updateObstacleDistanceMsg();
     }
   } else {
     if (((counter_close_points_backoff_ > 200 &&
-          final_cloud_.points.size() > min_cloud_size_) ||
+          cropped_cloud_size_ > min_cloud_size_) ||
          back_off_) &&
         reach_altitude_ && use_back_off_) {
       if (!back_off_) {
@@ -243,7 +248,7 @@ void LocalPlanner::determineStrategy() {
       }
       waypoint_type_ = goBack;
       if (send_obstacles_fcu_) {
-        create2DObstacleRepresentation(true);
+        updateObstacleDistanceMsg();
       }
 
     } else {
@@ -292,40 +297,43 @@ void LocalPlanner::determineStrategy() {
       if (!hist_is_empty_ && hist_relevant && reach_altitude_) {
         obstacle_ = true;
 
-        findFreeDirections(
-            polar_histogram_, safety_radius_, path_candidates_, path_selected_,
-            path_rejected_, path_blocked_, path_waypoints_,
-            cost_path_candidates_, goal_, toEigen(pose_.pose.position),
-            position_old_, goal_cost_param_, smooth_cost_param_,
-            height_change_cost_param_adapted_, height_change_cost_param_,
-            velocity_mod_ < 0.1, ALPHA_RES);
+        {
+          ScopedStageTimer timer(stage_timers_, Stage::findFreeDirections);
+          findFreeDirections(
+              polar_histogram_, safety_radius_, candidates_, path_selected_,
+              path_rejected_, path_blocked_, path_waypoints_, goal_,
+              toEigen(pose_.pose.position), position_old_, goal_cost_param_,
+              smooth_cost_param_, height_change_cost_param_adapted_,
+              height_change_cost_param_, velocity_mod_ < 0.1, ALPHA_RES);
+        }
 
         if (use_VFH_star_) {
           star_planner_->setParams(min_cloud_size_, min_dist_backoff_,
                                    path_waypoints_, curr_yaw_,
                                    min_realsense_dist_);
           star_planner_->setFOV(h_FOV_, v_FOV_);
-          star_planner_->setReprojectedPoints(reprojected_points_,
-                                              reprojected_points_age_,
-                                              reprojected_points_dist_);
+          star_planner_->setPropagatedHistogram(propagated_histogram_);
           star_planner_->setCostParams(goal_cost_param_, smooth_cost_param_,
                                        height_change_cost_param_adapted_,
                                        height_change_cost_param_);
           star_planner_->setBoxSize(histogram_box_, ground_distance_);
+          ScopedStageTimer timer(stage_timers_, Stage::treeBuild);
           star_planner_->setCloud(complete_cloud_);
           star_planner_->buildLookAheadTree();
 
           waypoint_type_ = tryPath;
           last_path_time_ = ros::Time::now();
         } else {
-          findFreeDirections(
-              polar_histogram_, safety_radius_, path_candidates_,
-              path_selected_, path_rejected_, path_blocked_, path_waypoints_,
-              cost_path_candidates_, goal_, toEigen(pose_.pose.position),
-              position_old_, goal_cost_param_, smooth_cost_param_,
-              height_change_cost_param_adapted_, height_change_cost_param_,
-              velocity_mod_ < 0.1, ALPHA_RES);
-          if (calculateCostMap(cost_path_candidates_, cost_idx_sorted_)) {
+          {
+            ScopedStageTimer timer(stage_timers_, Stage::findFreeDirections);
+            findFreeDirections(
+                polar_histogram_, safety_radius_, candidates_, path_selected_,
+                path_rejected_, path_blocked_, path_waypoints_, goal_,
+                toEigen(pose_.pose.position), position_old_, goal_cost_param_,
+                smooth_cost_param_, height_change_cost_param_adapted_,
+                height_change_cost_param_, velocity_mod_ < 0.1, ALPHA_RES);
+          }
+          if (calculateCostMap(candidates_, cost_order_)) {
             stopInFrontObstacles();
             waypoint_type_ = direct;
             stop_in_front_ = true;
@@ -345,63 +353,18 @@ void LocalPlanner::determineStrategy() {
   position_old_ = toEigen(pose_.pose.position);
 }
 
-void LocalPlanner::updateObstacleDistanceMsg(Histogram hist) {
-  sensor_msgs::LaserScan msg = {};
-  msg.header.stamp = ros::Time::now();
-  msg.header.frame_id = "local_origin";
-  msg.angle_increment = ALPHA_RES * M_PI / 180.0f;
-  msg.range_min = 0.2f;
-  msg.range_max = 20.0f;
-
-  // turn idxs 180 degress to point to local north instead of south
-  std::vector<int> z_FOV_idx_north;
-
-  for (size_t i = 0; i < z_FOV_idx_.size(); i++) {
-    int new_idx = z_FOV_idx_[i] + GRID_LENGTH_Z / 2;
-
-    if (new_idx >= GRID_LENGTH_Z) {
-      new_idx = new_idx - GRID_LENGTH_Z;
-    }
-
-    z_FOV_idx_north.push_back(new_idx);
-  }
-
-  for (int idx = 0; idx < GRID_LENGTH_Z; idx++) {
-    if (std::find(z_FOV_idx_north.begin(), z_FOV_idx_north.end(), idx) ==
-        z_FOV_idx_north.end()) {
-      msg.ranges.push_back(UINT16_MAX);
-      continue;
-    }
-
-    int hist_idx = idx - GRID_LENGTH_Z / 2;
-
-    if (hist_idx < 0) {
-      hist_idx = hist_idx + GRID_LENGTH_Z;
-    }
-
-    if (hist.get_dist(0, hist_idx) == 0.0) {
-      msg.ranges.push_back(msg.range_max + 1.0f);
-    } else {
-      msg.ranges.push_back(hist.get_dist(0, hist_idx));
-    }
-  }
-
-  distance_data_ = msg;
-}
-
+// obstacle distance for the FCU straight from the cropped cloud, such that the
+// strategies which don't plan don't need the histograms
 void LocalPlanner::updateObstacleDistanceMsg() {
-  sensor_msgs::LaserScan msg = {};
-  msg.header.stamp = ros::Time::now();
-  msg.header.frame_id = "local_origin";
-  msg.angle_increment = ALPHA_RES * M_PI / 180.0f;
-  msg.range_min = 0.2f;
-  msg.range_max = 20.0f;
-
-  distance_data_ = msg;
+  obstacle_ranges_.assign(GRID_LENGTH_Z, HUGE_VALF);
+  addObstacleDistances(final_cloud_, toEigen(pose_.pose.position),
+                       min_realsense_dist_, histogram_box_.radius_,
+                       obstacle_ranges_);
+  rangesToObstacleDistanceMsg(obstacle_ranges_, z_FOV_mask_, distance_data_);
 }
 
 // get 3D points from old histogram
-void LocalPlanner::reprojectPoints(Histogram histogram) {
+void LocalPlanner::reprojectPoints(const Histogram &histogram) {
   double n_points = 0;
   double dist, age;
   Eigen::Vector3f temp_array[4];
@@ -411,6 +374,11 @@ void LocalPlanner::reprojectPoints(Histogram histogram) {
   reprojected_points_.points.clear();
   reprojected_points_.header.stamp = final_cloud_.header.stamp;
   reprojected_points_.header.frame_id = "local_origin";
+  // the stale copies of moving obstacles are dropped, the obstacles are seen
+  // where they are now. A copy is at most reproj_age_ updates old.
+  const bool drop_dynamic =
+      use_obstacle_tracker_ && obstacle_tracker_.numDynamic() > 0;
+  const float trail_horizon = reproj_age_ * obstacle_tracker_.updateInterval();
 
   for (int e = 0; e < GRID_LENGTH_E; e++) {
     for (int z = 0; z < GRID_LENGTH_Z; z++) {
@@ -439,7 +407,9 @@ void LocalPlanner::reprojectPoints(Histogram histogram) {
           age = histogram.get_age(e, z);
 
           if (dist < 2.0 * histogram_box_.radius_ && dist > 0.3 &&
-              age < reproj_age_) {
+              age < reproj_age_ &&
+              !(drop_dynamic && obstacle_tracker_.isOnDynamicTrail(
+                                    temp_array[i], trail_horizon))) {
             reprojected_points_.points.push_back(toXYZ(temp_array[i]));
             reprojected_points_age_.push_back(age);
             reprojected_points_dist_.push_back(dist);
@@ -497,8 +467,8 @@ void LocalPlanner::evaluateProgressRate() {
 
 // get waypoint from sorted cost list
 void LocalPlanner::getDirectionFromCostMap() {
-  costmap_direction_e_ = path_candidates_.cells[cost_idx_sorted_[0]].x;
-  costmap_direction_z_ = path_candidates_.cells[cost_idx_sorted_[0]].y;
+  costmap_direction_e_ = candidates_[cost_order_.at(0)].elevation_angle;
+  costmap_direction_z_ = candidates_[cost_order_.at(0)].azimuth_angle;
 }
 
 // stop in front of an obstacle at a distance defined by the variable
@@ -522,22 +492,77 @@ void LocalPlanner::stopInFrontObstacles() {
 
 geometry_msgs::PoseStamped LocalPlanner::getPosition() { return pose_; }
 
-void LocalPlanner::getCloudsForVisualization(
-    pcl::PointCloud<pcl::PointXYZ> &final_cloud,
-    pcl::PointCloud<pcl::PointXYZ> &reprojected_points) {
+void LocalPlanner::getFinalCloudForVisualization(
+    pcl::PointCloud<pcl::PointXYZ> &final_cloud) {
   final_cloud = final_cloud_;
-  reprojected_points = reprojected_points_;
+}
+
+void LocalPlanner::getReprojectedPointsForVisualization(
+    pcl::PointCloud<pcl::PointXYZ> &reprojected_points) {
+  if (use_obstacle_memory_) {
+    obstacle_memory_.getPoints(reprojected_points);
+    reprojected_points.header = final_cloud_.header;
+  } else {
+    reprojected_points = reprojected_points_;
+  }
 }
 
 void LocalPlanner::getCandidateDataForVisualization(
     nav_msgs::GridCells &path_candidates, nav_msgs::GridCells &path_selected,
-    nav_msgs::GridCells &path_rejected, nav_msgs::GridCells &path_blocked,
-    nav_msgs::GridCells &FOV_cells) {
-  path_candidates = path_candidates_;
+    nav_msgs::GridCells &path_rejected, nav_msgs::GridCells &path_blocked) {
+  candidatesToGridCells(candidates_, path_candidates);
   path_selected = path_selected_;
   path_rejected = path_rejected_;
   path_blocked = path_blocked_;
-  FOV_cells = FOV_cells_;
+}
+
+// cells of the FOV, only generated on request for the visualization
+void LocalPlanner::getFOVForVisualization(nav_msgs::GridCells &FOV_cells) {
+  initGridCells(FOV_cells);
+  geometry_msgs::Point p;
+  for (int j = e_FOV_min_; j <= e_FOV_max_; j++) {
+    for (size_t i = 0; i < z_FOV_idx_.size(); i++) {
+      p.x = elevationIndexToAngle(j, ALPHA_RES);
+      p.y = azimuthIndexToAngle(z_FOV_idx_[i], ALPHA_RES);
+      p.z = 0;
+      FOV_cells.cells.push_back(p);
+    }
+  }
+}
+
+void LocalPlanner::getHistogramImage(sensor_msgs::Image &image) {
+  const double sensor_max_dist = 20.0;
+  image.header.stamp = ros::Time::now();
+  image.height = GRID_LENGTH_E;
+  image.width = GRID_LENGTH_Z;
+  image.encoding = sensor_msgs::image_encodings::MONO8;
+  image.is_bigendian = 0;
+  image.step = image.width;
+  image.data.resize(image.height * image.step);
+
+  // the highest elevation is the first row
+  size_t i = 0;
+  for (int e = GRID_LENGTH_E - 1; e >= 0; e--) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      double depth_val =
+          255.0 * polar_histogram_.get_dist(e, z) / sensor_max_dist;
+      image.data[i++] =
+          static_cast<uint8_t>(std::max(0.0, std::min(255.0, depth_val)));
+    }
+  }
+}
+
+void LocalPlanner::getCompressedHistogram(std_msgs::UInt8MultiArray &msg) {
+  if (msg.layout.dim.size() != 2) {
+    msg.layout.dim.resize(2);
+    msg.layout.dim[0].label = "e";
+    msg.layout.dim[0].size = GRID_LENGTH_E;
+    msg.layout.dim[0].stride = GRID_LENGTH_E * GRID_LENGTH_Z;
+    msg.layout.dim[1].label = "z";
+    msg.layout.dim[1].size = GRID_LENGTH_Z;
+    msg.layout.dim[1].stride = GRID_LENGTH_Z;
+  }
+  compressHistogram(polar_histogram_, 20.f, msg.data);
 }
 
 void LocalPlanner::setCurrentVelocity(const geometry_msgs::TwistStamped &vel) {
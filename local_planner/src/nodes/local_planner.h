@@ -5,6 +5,9 @@
 #include "avoidance_output.h"
 #include "box.h"
 #include "histogram.h"
+#include "obstacle_memory.h"
+#include "obstacle_tracker.h"
+#include "planner_functions.h"
 
 #include <dynamic_reconfigure/server.h>
 #include <local_planner/LocalPlannerNodeConfig.h>
@@ -20,6 +23,8 @@
 #include <sensor_msgs/LaserScan.h>
 #include <sensor_msgs/PointCloud2.h>
 
+#include <std_msgs/UInt8MultiArray.h>
+
 #include <geometry_msgs/Point.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/Twist.h>
@@ -34,6 +39,7 @@
 
 namespace avoidance {
 
+class StageTimers;
 class StarPlanner;
 class TreeNode;
 
@@ -41,6 +47,9 @@ class LocalPlanner {
  private:
   bool use_back_off_;
   bool use_VFH_star_;
+  bool use_obstacle_memory_ = false;
+  bool use_obstacle_tracker_ = false;
+  bool deduplicate_camera_overlap_ = false;
   bool adapt_cost_params_;
   bool stop_in_front_;
 
@@ -59,6 +68,8 @@ class LocalPlanner {
   int n_expanded_nodes_;
   int reproj_age_;
   int counter_close_points_backoff_ = 0;
+  // points in the histogram box, final_cloud_ may be downsampled
+  size_t cropped_cloud_size_ = 0;
 
   double velocity_mod_;
   double curr_yaw_, last_yaw_;
@@ -81,23 +92,26 @@ class LocalPlanner {
   double relevance_margin_e_degree_ = 25;
   double velocity_sigmoid_slope_ = 1;
   double min_realsense_dist_ = 0.2;
-  double costmap_direction_e_;
-  double costmap_direction_z_;
+  double downsample_distance_ = 0.0;
+  double costmap_direction_e_ = 0.0;
+  double costmap_direction_z_ = 0.0;
 
   waypoint_choice waypoint_type_;
   ros::Time last_path_time_;
 
   std::vector<int> e_FOV_idx_;
   std::vector<int> z_FOV_idx_;
+  std::vector<bool> z_FOV_mask_;
   std::deque<double> goal_dist_incline_;
-  std::vector<float> cost_path_candidates_;
-  std::vector<int> cost_idx_sorted_;
+  std::vector<candidateDirection> candidates_;
+  CandidateOrder cost_order_;
   std::vector<int> closed_set_;
   std::vector<double> reprojected_points_age_;
   std::vector<double> reprojected_points_dist_;
 
   std::vector<TreeNode> tree_;
   std::unique_ptr<StarPlanner> star_planner_;
+  StageTimers* stage_timers_ = nullptr;  // not owned, may be null
 
   pcl::PointCloud<pcl::PointXYZ> reprojected_points_, final_cloud_;
 
@@ -110,32 +124,30 @@ class LocalPlanner {
   Eigen::Vector3f avoid_centerpoint_ = Eigen::Vector3f::Zero();
   geometry_msgs::TwistStamped curr_vel_;
 
-  nav_msgs::GridCells FOV_cells_;
-  nav_msgs::GridCells path_candidates_;
   nav_msgs::GridCells path_selected_;
   nav_msgs::GridCells path_rejected_;
   nav_msgs::GridCells path_blocked_;
   nav_msgs::GridCells path_waypoints_;
 
   Histogram polar_histogram_ = Histogram(ALPHA_RES);
-  Histogram to_fcu_histogram_ = Histogram(ALPHA_RES);
+  Histogram new_histogram_ = Histogram(ALPHA_RES);
+  Histogram propagated_histogram_ = Histogram(2 * ALPHA_RES);
+  ObstacleMemory obstacle_memory_;
+  ObstacleTracker obstacle_tracker_;
 
   void fitPlane();
-  void reprojectPoints(Histogram histogram);
+  void reprojectPoints(const Histogram& histogram);
   void setVelocity();
   void evaluateProgressRate();
   void getDirectionFromCostMap();
   void stopInFrontObstacles();
-  void updateObstacleDistanceMsg(Histogram hist);
   void updateObstacleDistanceMsg();
   void create2DObstacleRepresentation(const bool send_to_fcu);
-  sensor_msgs::Image generateHistogramImage(Histogram& histogram);
 
  public:
   double h_FOV_ = 59.0;
   double v_FOV_ = 46.0;
   Box histogram_box_;
-  sensor_msgs::Image histogram_image_;
   bool use_vel_setpoints_;
   bool currently_armed_ = false;
   bool offboard_ = false;
@@ -154,9 +166,12 @@ class LocalPlanner {
   geometry_msgs::PoseStamped take_off_pose_;
   geometry_msgs::PoseStamped offboard_pose_;
   sensor_msgs::LaserScan distance_data_ = {};
+  std::vector<float> obstacle_ranges_;
 
   // complete_cloud_ contains n complete clouds from the cameras
   std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud_;
+  // viewing frustums of the cameras of complete_cloud_, empty if unknown
+  std::vector<CameraFrustum> camera_frustums_;
 
   LocalPlanner();
   ~LocalPlanner();
@@ -168,19 +183,35 @@ class LocalPlanner {
   void dynamicReconfigureSetParams(avoidance::LocalPlannerNodeConfig& config,
                                    uint32_t level);
   geometry_msgs::PoseStamped getPosition();
-  void getCloudsForVisualization(
-      pcl::PointCloud<pcl::PointXYZ>& final_cloud,
+  void getFinalCloudForVisualization(
+      pcl::PointCloud<pcl::PointXYZ>& final_cloud);
+  void getReprojectedPointsForVisualization(
       pcl::PointCloud<pcl::PointXYZ>& reprojected_points);
   void getCandidateDataForVisualization(nav_msgs::GridCells& path_candidates,
                                         nav_msgs::GridCells& path_selected,
                                         nav_msgs::GridCells& path_rejected,
-                                        nav_msgs::GridCells& path_blocked,
-                                        nav_msgs::GridCells& FOV_cells);
+                                        nav_msgs::GridCells& path_blocked);
+  void getFOVForVisualization(nav_msgs::GridCells& FOV_cells);
+
+  /**
+  * @brief     fills the image with the distances of the polar histogram, one
+  *            pixel per cell and the highest elevation in the first row. The
+  *            data of the image is reused, such that no allocation is needed
+  *            for a buffer which is filled every cycle
+  **/
+  void getHistogramImage(sensor_msgs::Image& image);
+
+  /**
+  * @brief     fills the message with the compressHistogram encoding of the
+  *            polar histogram, for links with a low bandwidth
+  **/
+  void getCompressedHistogram(std_msgs::UInt8MultiArray& msg);
   void setCurrentVelocity(const geometry_msgs::TwistStamped& vel);
   void getTree(std::vector<TreeNode>& tree, std::vector<int>& closed_set,
                std::vector<geometry_msgs::Point>& path_node_positions);
   void sendObstacleDistanceDataToFcu(sensor_msgs::LaserScan& obstacle_distance);
   avoidanceOutput getAvoidanceOutput();
+  void setStageTimers(StageTimers* stage_timers);
 
   void determineStrategy();
   void runPlanner();
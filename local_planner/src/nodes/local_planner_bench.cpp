@@ -0,0 +1,510 @@
+// Offline benchmark of the local planner core. Runs point clouds through
+// LocalPlanner::runPlanner without a ROS master and reports the latency
+// distribution of the pipeline stages, followed by microbenchmarks of
+// filterPointCloud, propagateHistogram and findFreeDirections on the same
+// frames.
+//
+// The clouds either come from a recording or are rendered from a world file
+// of sim/worlds (axis aligned cubes) by a virtual depth camera. In the second
+// case the vehicle follows the waypoints of the planner, the simulated time
+// makes the runs deterministic.
+//
+// usage:
+//   local_planner_bench --world sim/worlds/boxes3.yaml [--goal x y z]
+//                       [--start x y z] [--frames n] [--repeat n]
+//                       [--obstacle-memory] [--obstacle-tracker]
+//   local_planner_bench --replay recording.bin [--goal x y z] [--repeat n]
+//                       [--obstacle-memory] [--obstacle-tracker]
+//   local_planner_bench --replay planner.log [--repeat n]
+//
+// A recording is a flat sequence of frames, each one made of the pose as 7
+// doubles (x, y, z, qx, qy, qz, qw), the number of points as uint32 and the
+// points as 3 floats each.
+//
+// A planner log is written by the node with the planner_log parameter. Its
+// inputs are run with the logged config and clock and the results are
+// compared with the logged outputs, the other options do not apply.
+
+#include "common.h"
+#include "local_planner.h"
+#include "planner_functions.h"
+#include "planner_log.h"
+#include "rviz_world_loader.h"
+#include "stage_timer.h"
+#include "waypoint_generator.h"
+
+#include <ros/console.h>
+#include <ros/time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace avoidance;
+
+namespace {
+
+struct benchFrame {
+  geometry_msgs::PoseStamped pose;
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+};
+
+const double frame_period = 0.1;  // [s], the node runs at about 10 Hz
+const float camera_range = 15.f;
+const int camera_width = 80;
+const int camera_height = 60;
+const double height_change_cost_param = 4.0;  // default of the LocalPlanner
+const float max_speed = 2.f;                  // [m/s] of the simulated vehicle
+
+bool readRecording(const std::string& path, std::vector<benchFrame>& frames) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  double pose[7];
+  while (file.read(reinterpret_cast<char*>(pose), sizeof(pose))) {
+    uint32_t n_points = 0;
+    if (!file.read(reinterpret_cast<char*>(&n_points), sizeof(n_points))) {
+      return false;
+    }
+    std::vector<float> xyz(3 * n_points);
+    if (!file.read(reinterpret_cast<char*>(xyz.data()),
+                   xyz.size() * sizeof(float))) {
+      return false;
+    }
+
+    frames.emplace_back();
+    benchFrame& frame = frames.back();
+    frame.pose.header.frame_id = "/local_origin";
+    frame.pose.pose.position.x = pose[0];
+    frame.pose.pose.position.y = pose[1];
+    frame.pose.pose.position.z = pose[2];
+    frame.pose.pose.orientation.x = pose[3];
+    frame.pose.pose.orientation.y = pose[4];
+    frame.pose.pose.orientation.z = pose[5];
+    frame.pose.pose.orientation.w = pose[6];
+    frame.cloud.points.reserve(n_points);
+    for (uint32_t i = 0; i < n_points; i++) {
+      frame.cloud.points.push_back(
+          pcl::PointXYZ(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]));
+    }
+    frame.cloud.width = n_points;
+    frame.cloud.height = 1;
+  }
+  return true;
+}
+
+bool readWorld(const std::string& path, std::vector<world_object>& world) {
+  try {
+    YAML::Node doc = YAML::LoadFile(path);
+    for (YAML::const_iterator it = doc.begin(); it != doc.end(); ++it) {
+      world_object item;
+      *it >> item;
+      world.push_back(item);
+    }
+  } catch (const YAML::Exception& e) {
+    std::fprintf(stderr, "Could not read world %s: %s\n", path.c_str(),
+                 e.what());
+    return false;
+  }
+  return true;
+}
+
+// distance along the ray to the first intersection with the axis aligned
+// bounding box of an object, HUGE_VAL if there is none
+float intersectBox(const world_object& object, const Eigen::Vector3f& origin,
+                   const Eigen::Vector3f& direction) {
+  float t_min = 0.f;
+  float t_max = HUGE_VAL;
+  for (int i = 0; i < 3; i++) {
+    float lower = object.position[i] - 0.5f * object.scale[i];
+    float upper = object.position[i] + 0.5f * object.scale[i];
+    if (std::abs(direction[i]) < 1e-6f) {
+      if (origin[i] < lower || origin[i] > upper) {
+        return HUGE_VAL;
+      }
+      continue;
+    }
+    float t1 = (lower - origin[i]) / direction[i];
+    float t2 = (upper - origin[i]) / direction[i];
+    t_min = std::max(t_min, std::min(t1, t2));
+    t_max = std::min(t_max, std::max(t1, t2));
+  }
+  return t_min <= t_max ? t_min : HUGE_VAL;
+}
+
+// render the cloud of a forward looking depth camera at the pose
+void renderCloud(const std::vector<world_object>& world,
+                 const geometry_msgs::PoseStamped& pose,
+                 pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  const Eigen::Vector3f origin = toEigen(pose.pose.position);
+  const double yaw = tf::getYaw(pose.pose.orientation);
+  cloud.points.clear();
+  for (int v = 0; v < camera_height; v++) {
+    double elevation = (V_FOV * (v + 0.5) / camera_height - V_FOV / 2) *
+                       M_PI / 180.0;
+    for (int u = 0; u < camera_width; u++) {
+      double azimuth =
+          yaw + (H_FOV * (u + 0.5) / camera_width - H_FOV / 2) * M_PI / 180.0;
+      Eigen::Vector3f direction(std::cos(elevation) * std::cos(azimuth),
+                                std::cos(elevation) * std::sin(azimuth),
+                                std::sin(elevation));
+      float range = camera_range;
+      for (const world_object& object : world) {
+        range = std::min(range, intersectBox(object, origin, direction));
+      }
+      if (range < camera_range) {
+        Eigen::Vector3f p = origin + range * direction;
+        cloud.points.push_back(pcl::PointXYZ(p.x(), p.y(), p.z()));
+      }
+    }
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+}
+
+geometry_msgs::PoseStamped makePose(const Eigen::Vector3f& position,
+                                    double yaw) {
+  geometry_msgs::PoseStamped pose;
+  pose.header.frame_id = "/local_origin";
+  pose.pose.position = toPoint(position);
+  pose.pose.orientation.z = std::sin(yaw / 2);
+  pose.pose.orientation.w = std::cos(yaw / 2);
+  return pose;
+}
+
+void initPlanner(LocalPlanner& planner, const geometry_msgs::PoseStamped& pose,
+                 const Eigen::Vector3f& goal, bool use_obstacle_memory,
+                 bool use_obstacle_tracker) {
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  config.use_obstacle_memory_ = use_obstacle_memory;
+  config.use_obstacle_tracker_ = use_obstacle_tracker;
+  planner.dynamicReconfigureSetParams(config, 1);
+  planner.disable_rise_to_goal_altitude_ = true;
+  planner.currently_armed_ = false;
+  planner.setPose(pose);
+  planner.currently_armed_ = true;
+  planner.offboard_ = true;
+  planner.setPose(pose);
+  planner.setGoal(toPoint(goal));
+}
+
+void printStatistics(const char* title, const StageTimers& timers,
+                     double total_s, size_t n_frames) {
+  std::printf("\n%s\n", title);
+  std::printf("%-22s %8s %10s %10s %10s\n", "stage", "samples", "p50 [ms]",
+              "p99 [ms]", "max [ms]");
+  for (int i = 0; i < static_cast<int>(Stage::count); i++) {
+    Stage stage = static_cast<Stage>(i);
+    stageStatistics statistics = timers.getStatistics(stage);
+    if (statistics.n_samples == 0) {
+      continue;
+    }
+    std::printf("%-22s %8zu %10.3f %10.3f %10.3f\n", stageName(stage),
+                statistics.n_samples, statistics.p50_ms, statistics.p99_ms,
+                statistics.max_ms);
+  }
+  if (total_s > 0.0) {
+    std::printf("throughput: %.1f frames/s\n", n_frames / total_s);
+  }
+}
+
+// run the single pipeline functions on the frames seen by the planner
+void runMicrobenchmarks(const std::vector<benchFrame>& frames,
+                        const Eigen::Vector3f& goal, int repeat) {
+  if (frames.empty()) {
+    return;
+  }
+  StageTimers timers(frames.size() * repeat);
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  Histogram histogram(ALPHA_RES);
+  Histogram propagated_histogram(2 * ALPHA_RES);
+  pcl::PointCloud<pcl::PointXYZ> cropped_cloud;
+  pcl::PointCloud<pcl::PointXYZ> last_cloud;
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  std::vector<candidateDirection> candidates;
+  Box histogram_box(config.box_radius_);
+  Eigen::Vector3f position_old = toEigen(frames[0].pose.pose.position);
+
+  for (int r = 0; r < repeat; r++) {
+    for (const benchFrame& frame : frames) {
+      const Eigen::Vector3f position = toEigen(frame.pose.pose.position);
+      complete_cloud[0] = frame.cloud;
+      histogram_box.setBoxLimits(frame.pose.pose.position, 2.0);
+
+      Eigen::Vector3f closest_point;
+      double distance_to_closest_point;
+      int counter_backoff = 0;
+      {
+        ScopedStageTimer timer(&timers, Stage::filterPointCloud);
+        filterPointCloud(cropped_cloud, histogram, closest_point,
+                         distance_to_closest_point, counter_backoff,
+                         complete_cloud, config.min_cloud_size_,
+                         config.min_dist_backoff_, histogram_box, position,
+                         position, config.min_realsense_dist_,
+                         config.downsample_distance_);
+      }
+
+      // the points of the last frame stand in for the reprojected points
+      std::vector<double> age(last_cloud.points.size(), 1.0);
+      std::vector<double> dist;
+      dist.reserve(last_cloud.points.size());
+      for (const pcl::PointXYZ& p : last_cloud) {
+        dist.push_back((toEigen(p) - position).norm());
+      }
+      {
+        ScopedStageTimer timer(&timers, Stage::propagateHistogram);
+        propagated_histogram.reset(2 * ALPHA_RES);
+        propagateHistogram(propagated_histogram, last_cloud, age, dist,
+                           frame.pose);
+      }
+      last_cloud = cropped_cloud;
+
+      nav_msgs::GridCells path_selected, path_rejected, path_blocked,
+          path_waypoints;
+      {
+        ScopedStageTimer timer(&timers, Stage::findFreeDirections);
+        findFreeDirections(histogram, 25, candidates, path_selected,
+                           path_rejected, path_blocked, path_waypoints, goal,
+                           position, position_old, config.goal_cost_param_,
+                           config.smooth_cost_param_, height_change_cost_param,
+                           height_change_cost_param, false, ALPHA_RES);
+      }
+      position_old = position;
+    }
+  }
+  printStatistics("microbenchmarks", timers, 0.0, 0);
+}
+
+// runs the inputs of a planner log in the order of the log and returns the
+// number of outputs which differ from the logged ones
+int replayPlannerLog(PlannerLogReader& log, int repeat) {
+  StageTimers timers(10000);
+  LocalPlanner planner;
+  planner.setStageTimers(&timers);
+  std::vector<benchFrame> frames;
+  Eigen::Vector3f goal = Eigen::Vector3f::Zero();
+  LocalPlannerNodeConfig config;
+  double total_s = 0.0;
+  int n_outputs = 0;
+  int n_mismatches = 0;
+  bool has_result = false;
+
+  for (plannerLogRecord record = log.next(); record != plannerLogRecord::none;
+       record = log.next()) {
+    if (record == plannerLogRecord::config) {
+      config = log.config();
+      planner.dynamicReconfigureSetParams(config, log.configLevel());
+    } else if (record == plannerLogRecord::input) {
+      plannerLogInput& input = log.input();
+      ros::Time::setNow(input.time);
+      frames.emplace_back();
+      frames.back().pose = input.state.pose;
+      for (const pcl::PointCloud<pcl::PointXYZ>& cloud : input.complete_cloud) {
+        frames.back().cloud += cloud;
+      }
+
+      std::chrono::steady_clock::time_point start_time =
+          std::chrono::steady_clock::now();
+      planner.complete_cloud_.swap(input.complete_cloud);
+      planner.camera_frustums_.swap(input.camera_frustums);
+      planner.disable_rise_to_goal_altitude_ =
+          input.state.disable_rise_to_goal_altitude;
+      planner.setPose(input.state.pose);
+      planner.setCurrentVelocity(input.state.vel);
+      planner.currently_armed_ = input.state.armed;
+      planner.offboard_ = input.state.offboard;
+      planner.mission_ = input.state.mission;
+      if (input.state.set_goal) {
+        planner.setGoal(input.state.goal);
+        goal = toEigen(input.state.goal);
+      }
+      planner.ground_distance_ = input.state.ground_distance;
+      {
+        ScopedStageTimer timer(&timers, Stage::runPlanner);
+        planner.runPlanner();
+      }
+      total_s += std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start_time)
+                     .count();
+      has_result = true;
+    } else if (record == plannerLogRecord::output && has_result) {
+      if (!sameAvoidanceOutput(planner.getAvoidanceOutput(), log.output())) {
+        n_mismatches++;
+      }
+      n_outputs++;
+      has_result = false;
+    }
+  }
+
+  std::printf("%d frames of the planner log, %d of %d outputs differ\n",
+              static_cast<int>(frames.size()), n_mismatches, n_outputs);
+  printStatistics("planner pipeline", timers, total_s, frames.size());
+  runMicrobenchmarks(frames, goal, repeat);
+  return n_mismatches;
+}
+
+void printUsage() {
+  std::fprintf(stderr,
+               "usage: local_planner_bench (--world <yaml> | --replay <file>) "
+               "[--goal x y z] [--start x y z] [--frames n] [--repeat n] "
+               "[--obstacle-memory] [--obstacle-tracker]\n");
+}
+}
+
+int main(int argc, char** argv) {
+  std::string world_path;
+  std::string replay_path;
+  Eigen::Vector3f goal(20.f, 0.f, 2.5f);
+  Eigen::Vector3f start(0.f, 0.f, 2.5f);
+  int n_frames = 300;
+  int repeat = 5;
+  bool use_obstacle_memory = false;
+  bool use_obstacle_tracker = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--world" && i + 1 < argc) {
+      world_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if ((arg == "--goal" || arg == "--start") && i + 3 < argc) {
+      Eigen::Vector3f& v = arg == "--goal" ? goal : start;
+      for (int j = 0; j < 3; j++) {
+        v[j] = std::atof(argv[++i]);
+      }
+    } else if (arg == "--frames" && i + 1 < argc) {
+      n_frames = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--obstacle-memory") {
+      use_obstacle_memory = true;
+    } else if (arg == "--obstacle-tracker") {
+      use_obstacle_tracker = true;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (world_path.empty() == replay_path.empty()) {
+    printUsage();
+    return 1;
+  }
+  // a world without objects is still rendered
+  const bool replay = !replay_path.empty();
+
+  // simulated time, no ROS master is needed
+  ros::Time::init();
+  ros::Time now(1000.0);
+  ros::Time::setNow(now);
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
+                                     ros::console::levels::Warn)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+
+  std::vector<world_object> world;
+  std::vector<benchFrame> frames;
+  PlannerLogReader log;
+  if (replay && log.open(replay_path)) {
+    return replayPlannerLog(log, repeat) == 0 ? 0 : 2;
+  } else if (replay) {
+    if (!readRecording(replay_path, frames)) {
+      std::fprintf(stderr, "Could not read recording %s\n",
+                   replay_path.c_str());
+      return 1;
+    }
+    if (frames.empty()) {
+      std::fprintf(stderr, "Recording %s has no frames\n",
+                   replay_path.c_str());
+      return 1;
+    }
+    n_frames = frames.size();
+    start = toEigen(frames[0].pose.pose.position);
+  } else if (!readWorld(world_path, world)) {
+    return 1;
+  }
+
+  StageTimers timers(n_frames);
+  LocalPlanner planner;
+  planner.setStageTimers(&timers);
+  WaypointGenerator wp_generator;
+  wp_generator.param_ = {0.5, 1.5, 3.0, 4.0, 0.5, 0.1};
+
+  geometry_msgs::PoseStamped goal_msg = makePose(goal, 0.0);
+  geometry_msgs::PoseStamped pose =
+      makePose(start, std::atan2(goal.y() - start.y(), goal.x() - start.x()));
+  geometry_msgs::TwistStamped vel;
+  initPlanner(planner, replay ? frames[0].pose : pose, goal,
+              use_obstacle_memory, use_obstacle_tracker);
+
+  double total_s = 0.0;
+  int n_run = 0;
+  for (; n_run < n_frames; n_run++) {
+    now += ros::Duration(frame_period);
+    ros::Time::setNow(now);
+    if (replay) {
+      pose = frames[n_run].pose;
+    } else {
+      frames.emplace_back();
+      frames.back().pose = pose;
+      renderCloud(world, pose, frames.back().cloud);
+    }
+    pose.header.stamp = now;
+    frames[n_run].cloud.header.stamp = now.toNSec() / 1000;
+
+    std::chrono::steady_clock::time_point start_time =
+        std::chrono::steady_clock::now();
+    planner.complete_cloud_.assign(1, frames[n_run].cloud);
+    planner.setPose(pose);
+    {
+      ScopedStageTimer timer(&timers, Stage::runPlanner);
+      planner.runPlanner();
+    }
+    waypointResult result;
+    {
+      ScopedStageTimer timer(&timers, Stage::waypointGeneration);
+      wp_generator.setPlannerInfo(planner.getAvoidanceOutput());
+      wp_generator.updateState(pose, goal_msg, vel, false, now);
+      result = wp_generator.getWaypoints();
+    }
+    total_s += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start_time)
+                   .count();
+
+    // in the world the vehicle flies towards the unsmoothed waypoints, the
+    // smoothing expects the dynamics of a real vehicle
+    if (!replay) {
+      Eigen::Vector3f position = toEigen(pose.pose.position);
+      Eigen::Vector3f step = toEigen(result.goto_position) - position;
+      if (step.norm() > max_speed * frame_period) {
+        step *= max_speed * frame_period / step.norm();
+      }
+      Eigen::Vector3f next = position + step;
+      Eigen::Vector3f velocity = step / frame_period;
+      vel.header.stamp = now;
+      vel.twist.linear.x = velocity.x();
+      vel.twist.linear.y = velocity.y();
+      vel.twist.linear.z = velocity.z();
+      pose = makePose(next, std::atan2(step.y(), step.x()));
+      if ((next - goal).norm() < 0.5f) {
+        n_run++;
+        break;
+      }
+    }
+  }
+
+  std::printf("%d frames, %s, %.2f m from the goal\n", n_run,
+              replay ? replay_path.c_str() : world_path.c_str(),
+              (toEigen(pose.pose.position) - goal).norm());
+  printStatistics("planner pipeline", timers, total_s, n_run);
+  frames.resize(n_run);
+  runMicrobenchmarks(frames, goal, repeat);
+  return 0;
+}
@@ -8,18 +8,26 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <pthread.h>
+#include <sched.h>
+
 #include <atomic>
 #include <condition_variable>
+#include <map>
 #include <mutex>
 #include <string>
 #include <thread>
 
 namespace avoidance {
 
-LocalPlannerNode::LocalPlannerNode() {
+LocalPlannerNode::LocalPlannerNode(const ros::NodeHandle& nh)
+    : nh_(nh), nh_pointcloud_(nh), nh_pose_(nh) {
   local_planner_.reset(new LocalPlanner());
+  local_planner_->setStageTimers(&stage_timers_);
   wp_generator_.reset(new WaypointGenerator());
-  nh_ = ros::NodeHandle("~");
+  nh_.setCallbackQueue(&main_queue_);
+  nh_pointcloud_.setCallbackQueue(&pointcloud_queue_);
+  nh_pose_.setCallbackQueue(&pose_queue_);
   readParams();
 
   // Set up Dynamic Reconfigure Server
@@ -40,10 +48,10 @@ LocalPlannerNode::LocalPlannerNode() {
   }
 
   // initialize subscribers and publishers
-  pose_sub_ = nh_.subscribe<const geometry_msgs::PoseStamped&>(
+  pose_sub_ = nh_pose_.subscribe<const geometry_msgs::PoseStamped&>(
       "/mavros/local_position/pose", 1, &LocalPlannerNode::positionCallback,
       this);
-  velocity_sub_ = nh_.subscribe<const geometry_msgs::TwistStamped&>(
+  velocity_sub_ = nh_pose_.subscribe<const geometry_msgs::TwistStamped&>(
       "/mavros/local_position/velocity", 1, &LocalPlannerNode::velocityCallback,
       this);
   state_sub_ =
@@ -60,7 +68,8 @@ LocalPlannerNode::LocalPlannerNode() {
   distance_sensor_sub_ = nh_.subscribe(
       "/mavros/altitude", 1, &LocalPlannerNode::distanceSensorCallback, this);
 
-  world_pub_ = nh_.advertise<visualization_msgs::MarkerArray>("/world", 1);
+  world_pub_ =
+      nh_.advertise<visualization_msgs::MarkerArray>("/world", 1, true);
   drone_pub_ = nh_.advertise<visualization_msgs::Marker>("/drone", 1);
   local_pointcloud_pub_ =
       nh_.advertise<pcl::PointCloud<pcl::PointXYZ>>("/local_pointcloud", 1);
@@ -116,6 +125,10 @@ LocalPlannerNode::LocalPlannerNode() {
       nh_.advertise<visualization_msgs::Marker>("/initial_height", 1);
   histogram_image_pub_ =
       nh_.advertise<sensor_msgs::Image>("/histogram_image", 1);
+  histogram_compressed_pub_ =
+      nh_.advertise<std_msgs::UInt8MultiArray>("/histogram_compressed", 1);
+  stage_timings_pub_ =
+      nh_.advertise<diagnostic_msgs::DiagnosticArray>("/stage_timings", 1);
 
   mavros_set_mode_client_ =
       nh_.serviceClient<mavros_msgs::SetMode>("/mavros/set_mode");
@@ -123,7 +136,19 @@ LocalPlannerNode::LocalPlannerNode() {
   local_planner_->applyGoal();
 }
 
-LocalPlannerNode::~LocalPlannerNode() { delete server_; }
+LocalPlannerNode::~LocalPlannerNode() {
+  should_exit_ = true;
+  for (cameraData& camera : cameras_) {
+    {
+      std::lock_guard<std::mutex> lck(camera.cloud_msg_mutex_);
+      camera.cloud_msg_cv_.notify_all();
+    }
+    if (camera.transform_thread_.joinable()) {
+      camera.transform_thread_.join();
+    }
+  }
+  delete server_;
+}
 
 void LocalPlannerNode::readParams() {
   // Parameter from launch file
@@ -142,6 +167,61 @@ void LocalPlannerNode::readParams() {
   nh_.param<std::string>("world_name", world_path_, "");
   goal_msg_.pose.position = goal;
 
+  // field of view of the last run until the camera info arrives, it is kept
+  // on the parameter server by cameraInfoCallback
+  nh_.param<double>("h_fov", local_planner_->h_FOV_, local_planner_->h_FOV_);
+  nh_.param<double>("v_fov", local_planner_->v_FOV_, local_planner_->v_FOV_);
+  wp_generator_->setFOV(local_planner_->h_FOV_, local_planner_->v_FOV_);
+
+  // maximum rate of the visualization topics [Hz], 0 for no limit. It can be
+  // set per topic by name, e.g. visualization_rates: {complete_tree: 1.0}
+  double visualization_rate;
+  nh_.param<double>("visualization_rate", visualization_rate, 10.0);
+  visualization_period_ = ros::Duration(
+      visualization_rate > 0.0 ? 1.0 / visualization_rate : 0.0);
+  std::map<std::string, double> visualization_rates;
+  nh_.getParam("visualization_rates", visualization_rates);
+  for (const auto& topic_rate : visualization_rates) {
+    visualization_periods_["/" + topic_rate.first] = ros::Duration(
+        topic_rate.second > 0.0 ? 1.0 / topic_rate.second : 0.0);
+  }
+
+  // when to plan: "all_cameras" waits for a new cloud of every camera,
+  // "any_camera" plans on every new cloud and "fixed_rate" at planner_rate.
+  // The latter two use the latest cloud of each camera if it is younger than
+  // max_cloud_age, so that one lagging camera doesn't stall the planner
+  std::string planner_trigger;
+  double planner_rate, max_cloud_age;
+  nh_.param<std::string>("planner_trigger", planner_trigger, "all_cameras");
+  nh_.param<double>("planner_rate", planner_rate, 10.0);
+  nh_.param<double>("max_cloud_age", max_cloud_age, 0.5);
+  if (planner_trigger == "any_camera") {
+    planner_trigger_ = PlannerTrigger::anyCamera;
+  } else if (planner_trigger == "fixed_rate") {
+    planner_trigger_ = PlannerTrigger::fixedRate;
+  } else if (planner_trigger != "all_cameras") {
+    ROS_WARN("Unknown planner_trigger %s, waiting for all cameras",
+             planner_trigger.c_str());
+  }
+  planner_period_ =
+      ros::Duration(planner_rate > 0.0 ? 1.0 / planner_rate : 0.0);
+  max_cloud_age_ = ros::Duration(max_cloud_age);
+  nh_.param<bool>("obstacle_distance_at_camera_rate",
+                  obstacle_distance_at_camera_rate_, false);
+
+  // rate of the waypoint thread [Hz], 0 sends a waypoint on every pose update
+  // from the spin loop. With a priority above 0 the thread is scheduled
+  // SCHED_FIFO, which needs the permission to do so
+  nh_.param<double>("waypoint_rate", waypoint_rate_, 0.0);
+  nh_.param<int>("waypoint_thread_priority", waypoint_thread_priority_, 0);
+
+  // binary log of what the planner gets and returns, see local_planner_bench
+  std::string planner_log_path;
+  nh_.param<std::string>("planner_log", planner_log_path, "");
+  if (!planner_log_path.empty() && !planner_log_.open(planner_log_path)) {
+    ROS_WARN("Could not open the planner log %s", planner_log_path.c_str());
+  }
+
   // Read in parameter for waypoint generator
   waypointGenerator_params new_params;
   nh_.param<double>("goal_acceptance_radius_in",
@@ -163,7 +243,8 @@ void LocalPlannerNode::readParams() {
 
 void LocalPlannerNode::initializeCameraSubscribers(
     std::vector<std::string>& camera_topics) {
-  cameras_.resize(camera_topics.size());
+  // the camera data is not movable, the vector is only constructed once
+  cameras_ = std::vector<cameraData>(camera_topics.size());
 
   // create sting containing the topic with the camera info from
   // the pointcloud topic
@@ -172,9 +253,10 @@ void LocalPlannerNode::initializeCameraSubscribers(
   std::vector<std::string> camera_info(camera_topics.size(), s);
 
   for (size_t i = 0; i < camera_topics.size(); i++) {
-    cameras_[i].pointcloud_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(
-        camera_topics[i], 1,
-        boost::bind(&LocalPlannerNode::pointCloudCallback, this, _1, i));
+    cameras_[i].pointcloud_sub_ =
+        nh_pointcloud_.subscribe<sensor_msgs::PointCloud2>(
+            camera_topics[i], 1,
+            boost::bind(&LocalPlannerNode::pointCloudCallback, this, _1, i));
     cameras_[i].topic_ = camera_topics[i];
 
     // get each namespace in the pointcloud topic and construct the camera_info
@@ -189,6 +271,8 @@ void LocalPlannerNode::initializeCameraSubscribers(
     cameras_[i].camera_info_sub_ = nh_.subscribe<sensor_msgs::CameraInfo>(
         camera_info[i], 1,
         boost::bind(&LocalPlannerNode::cameraInfoCallback, this, _1, i));
+    cameras_[i].transform_thread_ =
+        std::thread(&LocalPlannerNode::cloudTransformThreadFunction, this, i);
   }
 }
 
@@ -201,72 +285,304 @@ size_t LocalPlannerNode::numReceivedClouds() {
 }
 
 bool LocalPlannerNode::canUpdatePlannerInfo() {
-  // Check if we have a transformation available at the time of the current
-  // point cloud
+  // Check if the newest cloud of every camera has been transformed, the
+  // transform threads skip clouds without a transformation
   size_t missing_transforms = 0;
   for (size_t i = 0; i < cameras_.size(); ++i) {
-    if (!tf_listener_.canTransform(
-            "/local_origin", cameras_[i].newest_cloud_msg_.header.frame_id,
-            ros::Time(0))) {
+    std::lock_guard<std::mutex> lck(cameras_[i].transformed_cloud_mutex_);
+    if (!cameras_[i].transformed_) {
       missing_transforms++;
     }
   }
 
   return missing_transforms == 0;
 }
-void LocalPlannerNode::updatePlannerInfo() {
-  // update the point cloud
-  local_planner_->complete_cloud_.clear();
-  for (size_t i = 0; i < cameras_.size(); ++i) {
-    sensor_msgs::PointCloud2 pc2cloud_world;
-    pcl::PointCloud<pcl::PointXYZ> complete_cloud;
+
+// check if new clouds should be handed to the planner, runs in the spin loop
+bool LocalPlannerNode::plannerInputReady(const ros::Time& now) {
+  if (cameras_.empty()) {
+    return false;
+  }
+  switch (planner_trigger_) {
+    case PlannerTrigger::allCameras:
+      return numReceivedClouds() == cameras_.size() && canUpdatePlannerInfo();
+    case PlannerTrigger::anyCamera:
+    case PlannerTrigger::fixedRate: {
+      if (planner_trigger_ == PlannerTrigger::fixedRate &&
+          now - last_planner_trigger_ < planner_period_) {
+        return false;
+      }
+      // fixed rate planning needs a cloud which is recent enough, on camera
+      // trigger it needs a new one
+      for (cameraData& camera : cameras_) {
+        std::lock_guard<std::mutex> lck(camera.transformed_cloud_mutex_);
+        bool usable = planner_trigger_ == PlannerTrigger::anyCamera
+                          ? camera.transformed_
+                          : now - camera.transformed_stamp_ <= max_cloud_age_;
+        if (usable) {
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+  return false;
+}
+
+// set the pose of a camera frustum from the transform of its optical frame
+static void setFrustumPose(const tf::Transform& transform,
+                           CameraFrustum& frustum) {
+  const tf::Vector3& origin = transform.getOrigin();
+  frustum.origin = Eigen::Vector3f(origin.x(), origin.y(), origin.z());
+  const tf::Matrix3x3& basis = transform.getBasis();
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      frustum.rotation(row, col) = basis[row][col];
+    }
+  }
+  frustum.has_pose = true;
+}
+
+// transform the clouds of one camera into /local_origin as they arrive, runs
+// in the transform thread of the camera
+void LocalPlannerNode::cloudTransformThreadFunction(size_t index) {
+  cameraData& camera = cameras_[index];
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  CameraFrustum frustum;
+  std::string optical_frame;
+  Eigen::Vector3f sensor_position;
+  while (!should_exit_) {
+    sensor_msgs::PointCloud2::ConstPtr msg;
+    {
+      std::unique_lock<std::mutex> lk(camera.cloud_msg_mutex_);
+      camera.cloud_msg_cv_.wait(
+          lk, [&] { return camera.newest_cloud_msg_ || should_exit_; });
+      if (should_exit_) break;
+      msg.swap(camera.newest_cloud_msg_);
+    }
+    {
+      std::lock_guard<std::mutex> lck(camera.transformed_cloud_mutex_);
+      frustum = camera.frustum_;
+      optical_frame = camera.optical_frame_;
+    }
+
+    if (!tf_listener_.canTransform("/local_origin", msg->header.frame_id,
+                                   ros::Time(0))) {
+      continue;
+    }
     try {
       tf::StampedTransform transform;
-      tf_listener_.lookupTransform(
-          "/local_origin", cameras_[i].newest_cloud_msg_.header.frame_id,
-          ros::Time(0), transform);
-      pcl_ros::transformPointCloud("/local_origin", transform,
-                                   cameras_[i].newest_cloud_msg_,
-                                   pc2cloud_world);
-      pcl::fromROSMsg(pc2cloud_world, complete_cloud);
-      local_planner_->complete_cloud_.push_back(std::move(complete_cloud));
+      {
+        ScopedStageTimer timer(&stage_timers_, Stage::tfLookup);
+        tf_listener_.lookupTransform("/local_origin", msg->header.frame_id,
+                                     ros::Time(0), transform);
+        const tf::Vector3& origin = transform.getOrigin();
+        sensor_position = Eigen::Vector3f(origin.x(), origin.y(), origin.z());
+        // the frustum is only needed once the field of view is known
+        frustum.has_pose = false;
+        if (optical_frame == msg->header.frame_id) {
+          setFrustumPose(transform, frustum);
+        } else if (!optical_frame.empty() &&
+                   tf_listener_.canTransform("/local_origin", optical_frame,
+                                             ros::Time(0))) {
+          tf::StampedTransform optical_transform;
+          tf_listener_.lookupTransform("/local_origin", optical_frame,
+                                       ros::Time(0), optical_transform);
+          setFrustumPose(optical_transform, frustum);
+        }
+      }
+      ScopedStageTimer timer(&stage_timers_, Stage::cloudTransform);
+      pcl::fromROSMsg(*msg, cloud);
+      pcl_ros::transformPointCloud(cloud, cloud, transform);
+      cloud.header.frame_id = "/local_origin";
     } catch (tf::TransformException& ex) {
       ROS_ERROR("Received an exception trying to transform a pointcloud: %s",
                 ex.what());
+      continue;
+    }
+    if (obstacle_distance_at_camera_rate_ &&
+        local_planner_->send_obstacles_fcu_) {
+      publishObstacleDistance(index, cloud, sensor_position, frustum,
+                              msg->header.stamp);
+    }
+
+    // swap the buffers so that neither side reallocates
+    std::lock_guard<std::mutex> lck(camera.transformed_cloud_mutex_);
+    camera.transformed_cloud_.swap(cloud);
+    camera.transformed_stamp_ = msg->header.stamp;
+    camera.transformed_ = true;
+    camera.frustum_.origin = frustum.origin;
+    camera.frustum_.rotation = frustum.rotation;
+    camera.frustum_.has_pose = frustum.has_pose;
+  }
+}
+// send the obstacle distance of the newest clouds of all cameras to the FCU
+// without waiting for the planner, runs in the transform thread of a camera.
+// The distances are measured from the camera, the sectors outside the fields
+// of view of the cameras are unknown
+void LocalPlannerNode::publishObstacleDistance(
+    size_t index, const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    const Eigen::Vector3f& sensor_position, const CameraFrustum& frustum,
+    const ros::Time& stamp) {
+  ScopedStageTimer timer(&stage_timers_, Stage::obstacleDistance);
+  std::lock_guard<std::mutex> lck(obstacle_distance_mutex_);
+  cameraData& camera = cameras_[index];
+  camera.obstacle_ranges_.assign(GRID_LENGTH_Z, HUGE_VALF);
+  addObstacleDistances(cloud, sensor_position, 0.2f, 20.f,
+                       camera.obstacle_ranges_);
+  camera.obstacle_ranges_in_view_.assign(GRID_LENGTH_Z, false);
+  if (frustum.isValid()) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      camera.obstacle_ranges_in_view_[z] = frustum.contains(
+          fromPolarToCartesian(0.f, azimuthIndexToAngle(z, ALPHA_RES), 1.0,
+                               toPoint(frustum.origin)));
     }
   }
+  camera.obstacle_ranges_stamp_ = stamp;
+
+  // the closest obstacle of the cameras with a recent cloud
+  std::vector<float> ranges(GRID_LENGTH_Z, HUGE_VALF);
+  std::vector<bool> in_view(GRID_LENGTH_Z, false);
+  for (const cameraData& c : cameras_) {
+    if (c.obstacle_ranges_.empty() ||
+        stamp - c.obstacle_ranges_stamp_ > max_cloud_age_) {
+      continue;
+    }
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      ranges[z] = std::min(ranges[z], c.obstacle_ranges_[z]);
+      in_view[z] = in_view[z] || c.obstacle_ranges_in_view_[z];
+    }
+  }
+  sensor_msgs::LaserScan distance_data_to_fcu;
+  rangesToObstacleDistanceMsg(ranges, in_view, distance_data_to_fcu);
+  mavros_obstacle_distance_pub_.publish(distance_data_to_fcu);
+}
 
-  // update position
-  local_planner_->setPose(newest_pose_);
+// collect the newest sensor data and hand it to the planner thread
+void LocalPlannerNode::updatePlannerInfo() {
+  plannerInput& input = planner_input_.back();
 
-  // Update velocity
-  local_planner_->setCurrentVelocity(vel_msg_);
+  // update the point cloud: the clouds have already been transformed by the
+  // transform threads. When waiting for all cameras they are swapped with the
+  // buffers of an earlier cycle, otherwise they are copied such that they can
+  // be used again if the camera doesn't send a new one in time
+  const ros::Time now = ros::Time::now();
+  last_planner_trigger_ = now;
+  input.complete_cloud.resize(cameras_.size());
+  input.camera_frustums.resize(cameras_.size());
+  for (size_t i = 0; i < cameras_.size(); ++i) {
+    cameraData& camera = cameras_[i];
+    std::lock_guard<std::mutex> lck(camera.transformed_cloud_mutex_);
+    input.camera_frustums[i] = camera.frustum_;
+    if (planner_trigger_ == PlannerTrigger::allCameras) {
+      input.complete_cloud[i].swap(camera.transformed_cloud_);
+    } else if (now - camera.transformed_stamp_ > max_cloud_age_) {
+      input.complete_cloud[i].clear();
+    } else {
+      input.complete_cloud[i] = camera.transformed_cloud_;
+    }
+    camera.transformed_ = false;
+  }
 
-  // update state
-  local_planner_->currently_armed_ = armed_;
-  local_planner_->offboard_ = offboard_;
-  local_planner_->mission_ = mission_;
+  // update position, velocity and state
+  {
+    std::lock_guard<std::mutex> lock(pose_mutex_);
+    input.pose = newest_pose_;
+    input.vel = vel_msg_;
+  }
+  input.armed = armed_;
+  input.offboard = offboard_;
+  input.mission = mission_;
 
-  // update goal
+  // update goal, counted so that it is not missed if the planner skips an input
   if (new_goal_) {
-    local_planner_->setGoal(goal_msg_.pose.position);
+    goal_count_++;
     new_goal_ = false;
   }
+  input.goal_count = goal_count_;
+  input.goal = goal_msg_.pose.position;
 
   // update ground distance
   if (ros::Time::now() - ground_distance_msg_.header.stamp <
       ros::Duration(0.5)) {
-    local_planner_->ground_distance_ = ground_distance_msg_.bottom_clearance;
+    input.ground_distance = ground_distance_msg_.bottom_clearance;
   } else {
-    local_planner_->ground_distance_ = 2.0;  // in case where no range data is
+    input.ground_distance = 2.0;  // in case where no range data is
     // available assume vehicle is close to ground
   }
+
+  planner_input_.publish();
+
+  // Wake up the planner
+  std::unique_lock<std::mutex> lck(data_ready_mutex_);
+  data_ready_ = true;
+  data_ready_cv_.notify_one();
+}
+
+// set the planner input, runs in the planner thread. The clouds are swapped so
+// that the input buffers keep their memory
+void LocalPlannerNode::applyPlannerInput(plannerInput& input) {
+  const bool set_goal = input.goal_count != applied_goal_count_;
+  local_planner_->complete_cloud_.swap(input.complete_cloud);
+  local_planner_->camera_frustums_.swap(input.camera_frustums);
+  local_planner_->setPose(input.pose);
+  local_planner_->setCurrentVelocity(input.vel);
+  local_planner_->currently_armed_ = input.armed;
+  local_planner_->offboard_ = input.offboard;
+  local_planner_->mission_ = input.mission;
+  if (set_goal) {
+    local_planner_->setGoal(input.goal);
+    applied_goal_count_ = input.goal_count;
+  }
+  local_planner_->ground_distance_ = input.ground_distance;
+
+  if (planner_log_.isOpen()) {
+    plannerLogState state;
+    state.pose = input.pose;
+    state.vel = input.vel;
+    state.armed = input.armed;
+    state.offboard = input.offboard;
+    state.mission = input.mission;
+    state.set_goal = set_goal;
+    state.goal = input.goal;
+    state.ground_distance = input.ground_distance;
+    state.disable_rise_to_goal_altitude =
+        local_planner_->disable_rise_to_goal_altitude_;
+    planner_log_.writeInput(ros::Time::now(), local_planner_->complete_cloud_,
+                            local_planner_->camera_frustums_, state);
+  }
+}
+
+// pass the latest planner results to the waypoint generator, runs in the spin
+// loop
+void LocalPlannerNode::updatePlannerOutput() {
+  if (!planner_output_.update()) {
+    return;
+  }
+  const plannerOutput& output = planner_output_.front();
+  {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    wp_generator_->setPlannerInfo(output.avoidance_output);
+  }
+  if (output.stop_in_front_active) {
+    goal_msg_.pose.position = output.goal;
+  }
 }
 
 void LocalPlannerNode::positionCallback(const geometry_msgs::PoseStamped& msg) {
-  last_pose_ = newest_pose_;
-  newest_pose_ = msg;
-  curr_yaw_ = tf::getYaw(msg.pose.orientation);
+  geometry_msgs::PoseStamped last_pose;
+  {
+    std::lock_guard<std::mutex> lock(pose_mutex_);
+    last_pose_ = newest_pose_;
+    newest_pose_ = msg;
+    curr_yaw_ = tf::getYaw(msg.pose.orientation);
+    last_pose = last_pose_;
+  }
+  if (waypoint_rate_ > 0.0) {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    waypoint_state_.last_pose = last_pose;
+    waypoint_state_.pose = msg;
+  }
   position_received_ = true;
 
   // visualize drone in RVIZ
@@ -280,7 +596,14 @@ void LocalPlannerNode::positionCallback(const geometry_msgs::PoseStamped& msg) {
 
 void LocalPlannerNode::velocityCallback(
     const geometry_msgs::TwistStamped& msg) {
-  vel_msg_ = msg;
+  {
+    std::lock_guard<std::mutex> lock(pose_mutex_);
+    vel_msg_ = msg;
+  }
+  if (waypoint_rate_ > 0.0) {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    waypoint_state_.vel = msg;
+  }
 }
 
 void LocalPlannerNode::stateCallback(const mavros_msgs::State& msg) {
@@ -298,7 +621,8 @@ void LocalPlannerNode::stateCallback(const mavros_msgs::State& msg) {
   }
 }
 
-void LocalPlannerNode::publishPaths() {
+void LocalPlannerNode::publishPaths(const geometry_msgs::Point& last_position,
+                                    const geometry_msgs::Point& position) {
   // publish actual path
   visualization_msgs::Marker path_actual_marker;
   path_actual_marker.header.frame_id = "local_origin";
@@ -313,8 +637,8 @@ void LocalPlannerNode::publishPaths() {
   path_actual_marker.color.g = 1.0;
   path_actual_marker.color.b = 0.0;
 
-  path_actual_marker.points.push_back(last_pose_.pose.position);
-  path_actual_marker.points.push_back(newest_pose_.pose.position);
+  path_actual_marker.points.push_back(last_position);
+  path_actual_marker.points.push_back(position);
   path_actual_pub_.publish(path_actual_marker);
 
   // publish path set by calculated waypoints
@@ -339,8 +663,10 @@ void LocalPlannerNode::publishPaths() {
 }
 
 void LocalPlannerNode::initMarker(visualization_msgs::MarkerArray* marker,
-                                  nav_msgs::GridCells& path, const float red,
-                                  const float green, const float blue) {
+                                  const nav_msgs::GridCells& path,
+                                  const geometry_msgs::Point& drone_pos,
+                                  const float red, const float green,
+                                  const float blue) {
   visualization_msgs::Marker m;
   m.header.frame_id = "local_origin";
   m.header.stamp = ros::Time::now();
@@ -354,14 +680,12 @@ void LocalPlannerNode::initMarker(visualization_msgs::MarkerArray* marker,
   m.id = 0;
   marker->markers.push_back(m);
 
-  geometry_msgs::PoseStamped drone_pos = local_planner_->getPosition();
-
   for (size_t i = 0; i < path.cells.size(); i++) {
     m.id = i + 1;
     m.action = visualization_msgs::Marker::ADD;
     geometry_msgs::Point p =
         toPoint(fromPolarToCartesian((int)path.cells[i].x, (int)path.cells[i].y,
-                                     1.0, drone_pos.pose.position));
+                                     1.0, drone_pos));
     m.pose.position = p;
 
     m.color.r = red;
@@ -372,45 +696,43 @@ void LocalPlannerNode::initMarker(visualization_msgs::MarkerArray* marker,
   }
 }
 
-void LocalPlannerNode::publishMarkerBlocked(nav_msgs::GridCells& path_blocked) {
+void LocalPlannerNode::publishMarkerBlocked(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_blocked;
-  initMarker(&marker_blocked, path_blocked, 0.0, 0.0, 1.0);
+  initMarker(&marker_blocked, data.path_blocked, data.position, 0.0, 0.0, 1.0);
   marker_blocked_pub_.publish(marker_blocked);
 }
 
-void LocalPlannerNode::publishMarkerRejected(
-    nav_msgs::GridCells& path_rejected) {
+void LocalPlannerNode::publishMarkerRejected(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_rejected;
-  initMarker(&marker_rejected, path_rejected, 1.0, 0.0, 0.0);
+  initMarker(&marker_rejected, data.path_rejected, data.position, 1.0, 0.0,
+             0.0);
   marker_rejected_pub_.publish(marker_rejected);
 }
 
-void LocalPlannerNode::publishMarkerCandidates(
-    nav_msgs::GridCells& path_candidates) {
+void LocalPlannerNode::publishMarkerCandidates(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_candidates;
-  initMarker(&marker_candidates, path_candidates, 0.0, 1.0, 0.0);
+  initMarker(&marker_candidates, data.path_candidates, data.position, 0.0, 1.0,
+             0.0);
   marker_candidates_pub_.publish(marker_candidates);
 }
 
-void LocalPlannerNode::publishMarkerSelected(
-    nav_msgs::GridCells& path_selected) {
+void LocalPlannerNode::publishMarkerSelected(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_selected;
-  initMarker(&marker_selected, path_selected, 0.8, 0.16, 0.8);
+  initMarker(&marker_selected, data.path_selected, data.position, 0.8, 0.16,
+             0.8);
   marker_selected_pub_.publish(marker_selected);
 }
 
-void LocalPlannerNode::publishMarkerFOV(nav_msgs::GridCells& FOV_cells) {
+void LocalPlannerNode::publishMarkerFOV(const visualizationData& data) {
   visualization_msgs::MarkerArray FOV_marker;
-  initMarker(&FOV_marker, FOV_cells, 0.16, 0.8, 0.8);
+  initMarker(&FOV_marker, data.FOV_cells, data.position, 0.16, 0.8, 0.8);
   marker_FOV_pub_.publish(FOV_marker);
 }
 
-void LocalPlannerNode::publishGoal() {
+void LocalPlannerNode::publishGoal(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_goal;
   visualization_msgs::Marker m;
 
-  geometry_msgs::Point goal = local_planner_->getGoal();
-
   m.header.frame_id = "local_origin";
   m.header.stamp = ros::Time::now();
   m.type = visualization_msgs::Marker::SPHERE;
@@ -424,19 +746,19 @@ void LocalPlannerNode::publishGoal() {
   m.color.b = 0.0;
   m.lifetime = ros::Duration();
   m.id = 0;
-  m.pose.position = goal;
+  m.pose.position = data.goal;
   marker_goal.markers.push_back(m);
   marker_goal_pub_.publish(marker_goal);
 }
 
-void LocalPlannerNode::publishReachHeight() {
+void LocalPlannerNode::publishReachHeight(const visualizationData& data) {
   visualization_msgs::Marker m;
   m.header.frame_id = "local_origin";
   m.header.stamp = ros::Time::now();
   m.type = visualization_msgs::Marker::CUBE;
-  m.pose.position.x = local_planner_->take_off_pose_.pose.position.x;
-  m.pose.position.y = local_planner_->take_off_pose_.pose.position.y;
-  m.pose.position.z = local_planner_->starting_height_;
+  m.pose.position.x = data.take_off_position.x;
+  m.pose.position.y = data.take_off_position.y;
+  m.pose.position.z = data.starting_height;
   m.pose.orientation.x = 0.0;
   m.pose.orientation.y = 0.0;
   m.pose.orientation.z = 0.0;
@@ -467,7 +789,7 @@ void LocalPlannerNode::publishReachHeight() {
   t.color.b = 0.0;
   t.lifetime = ros::Duration();
   t.id = 0;
-  t.pose.position = local_planner_->take_off_pose_.pose.position;
+  t.pose.position = data.take_off_position;
   takeoff_pose_pub_.publish(t);
 
   visualization_msgs::Marker a;
@@ -484,13 +806,12 @@ void LocalPlannerNode::publishReachHeight() {
   a.color.b = 0.5;
   a.lifetime = ros::Duration();
   a.id = 0;
-  a.pose.position = local_planner_->offboard_pose_.pose.position;
+  a.pose.position = data.offboard_position;
   offboard_pose_pub_.publish(a);
 }
 
-void LocalPlannerNode::publishBox() {
+void LocalPlannerNode::publishBox(const visualizationData& data) {
   visualization_msgs::MarkerArray marker_array;
-  geometry_msgs::PoseStamped drone_pos = local_planner_->getPosition();
 
   visualization_msgs::Marker box;
   box.header.frame_id = "local_origin";
@@ -498,16 +819,16 @@ void LocalPlannerNode::publishBox() {
   box.id = 0;
   box.type = visualization_msgs::Marker::SPHERE;
   box.action = visualization_msgs::Marker::ADD;
-  box.pose.position.x = drone_pos.pose.position.x;
-  box.pose.position.y = drone_pos.pose.position.y;
-  box.pose.position.z = drone_pos.pose.position.z;
+  box.pose.position.x = data.position.x;
+  box.pose.position.y = data.position.y;
+  box.pose.position.z = data.position.z;
   box.pose.orientation.x = 0.0;
   box.pose.orientation.y = 0.0;
   box.pose.orientation.z = 0.0;
   box.pose.orientation.w = 1.0;
-  box.scale.x = 2.0 * local_planner_->histogram_box_.radius_;
-  box.scale.y = 2.0 * local_planner_->histogram_box_.radius_;
-  box.scale.z = 2.0 * local_planner_->histogram_box_.radius_;
+  box.scale.x = 2.0 * data.histogram_box.radius_;
+  box.scale.y = 2.0 * data.histogram_box.radius_;
+  box.scale.z = 2.0 * data.histogram_box.radius_;
   box.color.a = 0.5;
   box.color.r = 0.0;
   box.color.g = 1.0;
@@ -520,15 +841,15 @@ void LocalPlannerNode::publishBox() {
   plane.id = 1;
   plane.type = visualization_msgs::Marker::CUBE;
   plane.action = visualization_msgs::Marker::ADD;
-  plane.pose.position.x = drone_pos.pose.position.x;
-  plane.pose.position.y = drone_pos.pose.position.y;
-  plane.pose.position.z = local_planner_->histogram_box_.zmin_;
+  plane.pose.position.x = data.position.x;
+  plane.pose.position.y = data.position.y;
+  plane.pose.position.z = data.histogram_box.zmin_;
   plane.pose.orientation.x = 0.0;
   plane.pose.orientation.y = 0.0;
   plane.pose.orientation.z = 0.0;
   plane.pose.orientation.w = 1.0;
-  plane.scale.x = 2.0 * local_planner_->histogram_box_.radius_;
-  plane.scale.y = 2.0 * local_planner_->histogram_box_.radius_;
+  plane.scale.x = 2.0 * data.histogram_box.radius_;
+  plane.scale.y = 2.0 * data.histogram_box.radius_;
   plane.scale.z = 0.001;
   plane.color.a = 0.5;
   plane.color.r = 0.0;
@@ -540,10 +861,61 @@ void LocalPlannerNode::publishBox() {
 }
 
 void LocalPlannerNode::publishWaypoints(bool hover) {
-  const ros::Time now = ros::Time::now();
+  geometry_msgs::PoseStamped pose, last_pose;
+  geometry_msgs::TwistStamped vel;
+  {
+    std::lock_guard<std::mutex> lock(pose_mutex_);
+    pose = newest_pose_;
+    last_pose = last_pose_;
+    vel = vel_msg_;
+  }
+  waypointResult result;
+  {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    ScopedStageTimer timer(&stage_timers_, Stage::waypointGeneration);
+    wp_generator_->updateState(pose, goal_msg_, vel, hover, ros::Time::now());
+    result = wp_generator_->getWaypoints();
+  }
+  publishWaypointResult(result, last_pose.pose.position, pose.pose.position);
+}
 
-  wp_generator_->updateState(newest_pose_, goal_msg_, vel_msg_, hover, now);
-  waypointResult result = wp_generator_->getWaypoints();
+// send the waypoints at waypoint_rate_ with the latest vehicle state and
+// planner output. The generator follows the latest tree path from the newest
+// pose, so the setpoints change smoothly between the planner cycles.
+void LocalPlannerNode::waypointThreadFunction() {
+  if (waypoint_thread_priority_ > 0) {
+    sched_param param = {};
+    param.sched_priority = waypoint_thread_priority_;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+      ROS_WARN("Could not set the priority of the waypoint thread");
+    }
+  }
+  ros::Rate rate(waypoint_rate_);
+  while (ros::ok() && !should_exit_) {
+    waypointState state;
+    waypointResult result;
+    {
+      std::lock_guard<std::mutex> lock(waypoint_mutex_);
+      state = waypoint_state_;
+      if (state.active) {
+        ScopedStageTimer timer(&stage_timers_, Stage::waypointGeneration);
+        wp_generator_->updateState(state.pose, state.goal, state.vel,
+                                   state.hover, ros::Time::now());
+        result = wp_generator_->getWaypoints();
+      }
+    }
+    if (state.active) {
+      publishWaypointResult(result, state.last_pose.pose.position,
+                            state.pose.pose.position);
+    }
+    rate.sleep();
+  }
+}
+
+void LocalPlannerNode::publishWaypointResult(
+    const waypointResult& result, const geometry_msgs::Point& last_position,
+    const geometry_msgs::Point& position) {
+  const ros::Time now = ros::Time::now();
 
   visualization_msgs::Marker sphere1;
   visualization_msgs::Marker sphere2;
@@ -615,8 +987,8 @@ void LocalPlannerNode::publishWaypoints(bool hover) {
 
   last_waypoint_position_ = newest_waypoint_position_;
   newest_waypoint_position_ = result.smoothed_goto_position;
-  publishPaths();
-  publishSetpoint(result.velocity_waypoint, result.waypoint_type);
+  publishPaths(last_position, position);
+  publishSetpoint(result.velocity_waypoint, position, result.waypoint_type);
 
   // to mavros
 
@@ -631,11 +1003,194 @@ void LocalPlannerNode::publishWaypoints(bool hover) {
   mavros_obstacle_free_path_pub_.publish(obst_free_path);
 }
 
-void LocalPlannerNode::publishHistogramImage() {
-  histogram_image_pub_.publish(local_planner_->histogram_image_);
+// publish the rolling latency statistics of the pipeline stages
+void LocalPlannerNode::publishStageTimings() {
+  diagnostic_msgs::DiagnosticArray timings;
+  timings.header.stamp = ros::Time::now();
+  for (int i = 0; i < static_cast<int>(Stage::count); i++) {
+    Stage stage = static_cast<Stage>(i);
+    stageStatistics statistics = stage_timers_.getStatistics(stage);
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = stageName(stage);
+    status.hardware_id = "local_planner";
+    diagnostic_msgs::KeyValue value;
+    value.key = "p50_ms";
+    value.value = std::to_string(statistics.p50_ms);
+    status.values.push_back(value);
+    value.key = "p99_ms";
+    value.value = std::to_string(statistics.p99_ms);
+    status.values.push_back(value);
+    value.key = "max_ms";
+    value.value = std::to_string(statistics.max_ms);
+    status.values.push_back(value);
+    value.key = "samples";
+    value.value = std::to_string(statistics.n_samples);
+    status.values.push_back(value);
+    timings.status.push_back(status);
+  }
+  stage_timings_pub_.publish(timings);
+}
+
+// the world is only shown in RVIZ, it is parsed in the background such that it
+// doesn't delay the first waypoint
+void LocalPlannerNode::worldThreadFunction() {
+  visualization_msgs::MarkerArray marker_array;
+  if (!visualizeRVIZWorld(world_path_, marker_array)) {
+    world_pub_.publish(marker_array);
+  }
+}
+
+// the loop starts right away, the planner runs as soon as the clouds of the
+// cameras can be transformed
+void LocalPlannerNode::spinLoop() {
+  ros::Time start_time = ros::Time::now();
+  bool hover = false;
+  bool landing = false;
+  local_planner_->disable_rise_to_goal_altitude_ =
+      disable_rise_to_goal_altitude_;
+  status_msg_.state = (int)MAV_STATE::MAV_STATE_BOOT;
+
+  std::thread worker(&LocalPlannerNode::threadFunction, this);
+  ros::AsyncSpinner pointcloud_spinner(1, &pointcloud_queue_);
+  pointcloud_spinner.start();
+  ros::AsyncSpinner pose_spinner(1, &pose_queue_);
+  pose_spinner.start();
+  std::thread visualizer(&LocalPlannerNode::visualizationThreadFunction, this);
+  std::thread world_loader;
+  if (!world_path_.empty()) {
+    world_loader = std::thread(&LocalPlannerNode::worldThreadFunction, this);
+  }
+  std::thread waypoint_thread;
+  if (waypoint_rate_ > 0.0) {
+    waypoint_thread =
+        std::thread(&LocalPlannerNode::waypointThreadFunction, this);
+  }
+
+  // spin node, execute callbacks
+  while (ros::ok() && !should_exit_) {
+    hover = false;
+
+    // Process callbacks & wait for a position update, which comes from the
+    // pose spinner
+    while (!position_received_ && ros::ok() && !should_exit_) {
+      main_queue_.callAvailable(ros::WallDuration(0.01));
+    }
+
+    // Check if all information was received
+    ros::Time now = ros::Time::now();
+    ros::Duration pointcloud_timeout_land =
+        ros::Duration(local_planner_->pointcloud_timeout_land_);
+    ros::Duration pointcloud_timeout_hover =
+        ros::Duration(local_planner_->pointcloud_timeout_hover_);
+    ros::Duration since_last_cloud = now - last_wp_time_;
+    ros::Duration since_start = now - start_time;
+
+    if (since_last_cloud > pointcloud_timeout_land &&
+        since_start > pointcloud_timeout_land) {
+      if (!landing) {
+        mavros_msgs::SetMode mode_msg;
+        mode_msg.request.custom_mode = "AUTO.LOITER";
+        landing = true;
+        status_msg_.state = (int)MAV_STATE::MAV_STATE_FLIGHT_TERMINATION;
+        if (mavros_set_mode_client_.call(mode_msg) &&
+            mode_msg.response.mode_sent) {
+          ROS_WARN("\033[1;33m Pointcloud timeout: Landing \n \033[0m");
+        } else {
+          ROS_ERROR(
+              "\033[1;33m Pointcloud timeout: Landing failed! \n \033[0m");
+        }
+      }
+    } else {
+      if (never_run_ || (since_last_cloud > pointcloud_timeout_hover &&
+                         since_start > pointcloud_timeout_hover)) {
+        if (position_received_) {
+          hover = true;
+          status_msg_.state = (int)MAV_STATE::MAV_STATE_CRITICAL;
+          std::string not_received = "";
+          for (size_t i = 0; i < cameras_.size(); i++) {
+            if (!cameras_[i].received_) {
+              not_received.append(" , no cloud received on topic ");
+              not_received.append(cameras_[i].topic_);
+            }
+          }
+          if (!canUpdatePlannerInfo()) {
+            not_received.append(" , missing transforms ");
+          }
+          ROS_INFO(
+              "\033[1;33m Pointcloud timeout %s (Hovering at current position) "
+              "\n "
+              "\033[0m",
+              not_received.c_str());
+        } else {
+          ROS_WARN(
+              "\033[1;33m Pointcloud timeout: No position received, no WP to "
+              "output.... \n \033[0m");
+        }
+      }
+    }
+
+    // hand the newest data to the planner, it picks up the latest input when
+    // it is done with the current one
+    if (plannerInputReady(now)) {
+      updatePlannerInfo();
+      // reset all clouds to not yet received
+      for (size_t i = 0; i < cameras_.size(); i++) {
+        cameras_[i].received_ = false;
+      }
+    }
+
+    // get the last planner results
+    updatePlannerOutput();
+
+    // send waypoint, or hand the state to the waypoint thread
+    const bool active = !never_run_ && !landing;
+    if (waypoint_thread.joinable()) {
+      // the pose and velocity are set by their callbacks
+      std::lock_guard<std::mutex> lock(waypoint_mutex_);
+      waypoint_state_.goal = goal_msg_;
+      waypoint_state_.hover = hover;
+      waypoint_state_.active = active;
+    } else if (active) {
+      publishWaypoints(hover);
+    }
+    if (active && !hover) {
+      status_msg_.state = (int)MAV_STATE::MAV_STATE_ACTIVE;
+    }
+
+    position_received_ = false;
+
+    // publish system status
+    if (now - t_status_sent_ > ros::Duration(0.2)) {
+      status_msg_.header.stamp = ros::Time::now();
+      status_msg_.component = 196;  // MAV_COMPONENT_ID_AVOIDANCE
+      mavros_system_status_pub_.publish(status_msg_);
+      t_status_sent_ = now;
+    }
+
+    // publish latency statistics of the pipeline stages
+    if (now - t_stage_timings_sent_ > ros::Duration(1.0)) {
+      publishStageTimings();
+      t_stage_timings_sent_ = now;
+    }
+  }
+
+  pointcloud_spinner.stop();
+  pose_spinner.stop();
+  should_exit_ = true;
+  data_ready_cv_.notify_all();
+  visualization_ready_cv_.notify_all();
+  worker.join();
+  visualizer.join();
+  if (world_loader.joinable()) {
+    world_loader.join();
+  }
+  if (waypoint_thread.joinable()) {
+    waypoint_thread.join();
+  }
 }
 
-void LocalPlannerNode::publishTree() {
+void LocalPlannerNode::publishTree(const visualizationData& data) {
   visualization_msgs::Marker tree_marker;
   tree_marker.header.frame_id = "local_origin";
   tree_marker.header.stamp = ros::Time::now();
@@ -662,27 +1217,25 @@ void LocalPlannerNode::publishTree() {
   path_marker.color.g = 0.0;
   path_marker.color.b = 0.0;
 
-  std::vector<TreeNode> tree;
-  std::vector<int> closed_set;
-
-  local_planner_->getTree(tree, closed_set, path_node_positions_);
-
-  for (size_t i = 0; i < closed_set.size(); i++) {
-    int node_nr = closed_set[i];
-    geometry_msgs::Point p1 = toPoint(tree[node_nr].getPosition());
-    int origin = tree[node_nr].origin_;
-    geometry_msgs::Point p2 = toPoint(tree[origin].getPosition());
-    tree_marker.points.push_back(p1);
-    tree_marker.points.push_back(p2);
+  if (data.complete_tree) {
+    for (size_t i = 0; i < data.closed_set.size(); i++) {
+      int node_nr = data.closed_set[i];
+      geometry_msgs::Point p1 = toPoint(data.tree[node_nr].getPosition());
+      int origin = data.tree[node_nr].origin_;
+      geometry_msgs::Point p2 = toPoint(data.tree[origin].getPosition());
+      tree_marker.points.push_back(p1);
+      tree_marker.points.push_back(p2);
+    }
+    complete_tree_pub_.publish(tree_marker);
   }
 
-  for (size_t i = 1; i < path_node_positions_.size(); i++) {
-    path_marker.points.push_back(path_node_positions_[i - 1]);
-    path_marker.points.push_back(path_node_positions_[i]);
+  if (data.tree_path) {
+    for (size_t i = 1; i < data.path_node_positions.size(); i++) {
+      path_marker.points.push_back(data.path_node_positions[i - 1]);
+      path_marker.points.push_back(data.path_node_positions[i]);
+    }
+    tree_path_pub_.publish(path_marker);
   }
-
-  complete_tree_pub_.publish(tree_marker);
-  tree_path_pub_.publish(path_marker);
 }
 
 void LocalPlannerNode::clickedPointCallback(
@@ -779,7 +1332,12 @@ void LocalPlannerNode::printPointInfo(double x, double y, double z) {
 
 void LocalPlannerNode::pointCloudCallback(
     const sensor_msgs::PointCloud2::ConstPtr& msg, int index) {
-  cameras_[index].newest_cloud_msg_ = *msg;  // FIXME: avoid a copy
+  // a message the transform thread has not picked up yet is replaced
+  {
+    std::lock_guard<std::mutex> lck(cameras_[index].cloud_msg_mutex_);
+    cameras_[index].newest_cloud_msg_ = msg;
+  }
+  cameras_[index].cloud_msg_cv_.notify_one();
   cameras_[index].received_ = true;
 }
 
@@ -795,11 +1353,28 @@ void LocalPlannerNode::cameraInfoCallback(
                            atan(msg->width / (2.0 * msg->K[0])) * 180.0 / M_PI;
   local_planner_->v_FOV_ =
       2.0 * atan(msg->height / (2.0 * msg->K[4])) * 180.0 / M_PI;
-  wp_generator_->setFOV(local_planner_->h_FOV_, local_planner_->v_FOV_);
+  {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    wp_generator_->setFOV(local_planner_->h_FOV_, local_planner_->v_FOV_);
+  }
+  nh_.setParam("h_fov", local_planner_->h_FOV_);
+  nh_.setParam("v_fov", local_planner_->v_FOV_);
+
+  // the field of view of this camera alone, for the overlap with the others
+  {
+    std::lock_guard<std::mutex> lck(cameras_[index].transformed_cloud_mutex_);
+    cameras_[index].frustum_.tan_half_h_fov = msg->width / (2.0 * msg->K[0]);
+    cameras_[index].frustum_.tan_half_v_fov = msg->height / (2.0 * msg->K[4]);
+    cameras_[index].optical_frame_ = msg->header.frame_id;
+  }
+
+  // the camera info is set once
+  cameras_[index].camera_info_sub_.shutdown();
 }
 
 void LocalPlannerNode::publishSetpoint(const geometry_msgs::Twist& wp,
-                                       waypoint_choice& waypoint_type) {
+                                       const geometry_msgs::Point& position,
+                                       const waypoint_choice& waypoint_type) {
   visualization_msgs::Marker setpoint;
   setpoint.header.frame_id = "local_origin";
   setpoint.header.stamp = ros::Time::now();
@@ -808,10 +1383,10 @@ void LocalPlannerNode::publishSetpoint(const geometry_msgs::Twist& wp,
   setpoint.action = visualization_msgs::Marker::ADD;
 
   geometry_msgs::Point tip;
-  tip.x = newest_pose_.pose.position.x + wp.linear.x;
-  tip.y = newest_pose_.pose.position.y + wp.linear.y;
-  tip.z = newest_pose_.pose.position.z + wp.linear.z;
-  setpoint.points.push_back(newest_pose_.pose.position);
+  tip.x = position.x + wp.linear.x;
+  tip.y = position.y + wp.linear.y;
+  tip.z = position.z + wp.linear.z;
+  setpoint.points.push_back(position);
   setpoint.points.push_back(tip);
   setpoint.scale.x = 0.1;
   setpoint.scale.y = 0.1;
@@ -927,44 +1502,153 @@ void LocalPlannerNode::transformVelocityToTrajectory(
   obst_avoid.point_valid = {true, false, false, false, false};
 }
 
-void LocalPlannerNode::publishPlannerData() {
-  pcl::PointCloud<pcl::PointXYZ> final_cloud, reprojected_points;
-  local_planner_->getCloudsForVisualization(final_cloud, reprojected_points);
-  local_pointcloud_pub_.publish(final_cloud);
-  reprojected_points_pub_.publish(reprojected_points);
-
-  publishTree();
-
-  last_wp_time_ = ros::Time::now();
+// check if a visualization topic has subscribers and its last message is
+// older than the period configured for it, runs in the planner thread
+bool LocalPlannerNode::visualizationDue(const ros::Publisher& pub,
+                                        const ros::Time& now) {
+  if (pub.getNumSubscribers() == 0) {
+    return false;
+  }
+  const std::string topic = pub.getTopic();
+  auto period = visualization_periods_.find(topic);
+  ros::Duration min_period = period == visualization_periods_.end()
+                                 ? visualization_period_
+                                 : period->second;
+  ros::Time& sent = visualization_sent_[topic];
+  if (!sent.isZero() && now - sent < min_period) {
+    return false;
+  }
+  sent = now;
+  return true;
+}
 
-  nav_msgs::GridCells path_candidates, path_selected, path_rejected,
-      path_blocked, FOV_cells;
-  local_planner_->getCandidateDataForVisualization(
-      path_candidates, path_selected, path_rejected, path_blocked, FOV_cells);
+// send the obstacle distance to the FCU and hand a snapshot of the data for
+// the due visualization topics to the visualization thread, runs in the
+// planner thread
+void LocalPlannerNode::publishPlannerData() {
+  const ros::Time now = ros::Time::now();
+  last_wp_time_ = now;
 
-  if (local_planner_->send_obstacles_fcu_) {
+  if (local_planner_->send_obstacles_fcu_ &&
+      !obstacle_distance_at_camera_rate_) {
     sensor_msgs::LaserScan distance_data_to_fcu;
     local_planner_->sendObstacleDistanceDataToFcu(distance_data_to_fcu);
     mavros_obstacle_distance_pub_.publish(distance_data_to_fcu);
   }
 
-  publishMarkerCandidates(path_candidates);
-  publishMarkerSelected(path_selected);
-  publishMarkerRejected(path_rejected);
-  publishMarkerBlocked(path_blocked);
-  publishMarkerFOV(FOV_cells);
-  publishGoal();
-  publishBox();
-  publishReachHeight();
-  publishHistogramImage();
+  visualizationData& data = visualization_data_.back();
+  data.local_pointcloud = visualizationDue(local_pointcloud_pub_, now);
+  data.reprojected_points = visualizationDue(reprojected_points_pub_, now);
+  data.complete_tree = visualizationDue(complete_tree_pub_, now);
+  data.tree_path = visualizationDue(tree_path_pub_, now);
+  data.candidates_marker = visualizationDue(marker_candidates_pub_, now);
+  data.selected_marker = visualizationDue(marker_selected_pub_, now);
+  data.rejected_marker = visualizationDue(marker_rejected_pub_, now);
+  data.blocked_marker = visualizationDue(marker_blocked_pub_, now);
+  data.FOV_marker = visualizationDue(marker_FOV_pub_, now);
+  data.goal_position = visualizationDue(marker_goal_pub_, now);
+  data.bounding_box = visualizationDue(bounding_box_pub_, now);
+  // the three reach height markers are sent together, all of them are checked
+  // such that they are marked as sent
+  data.reach_height = visualizationDue(initial_height_pub_, now) |
+                      visualizationDue(takeoff_pose_pub_, now) |
+                      visualizationDue(offboard_pose_pub_, now);
+  data.histogram_image = visualizationDue(histogram_image_pub_, now);
+  data.histogram_compressed = visualizationDue(histogram_compressed_pub_, now);
+
+  if (data.local_pointcloud) {
+    local_planner_->getFinalCloudForVisualization(data.final_cloud);
+  }
+  if (data.reprojected_points) {
+    local_planner_->getReprojectedPointsForVisualization(
+        data.reprojected_points_cloud);
+  }
+  if (data.complete_tree || data.tree_path) {
+    local_planner_->getTree(data.tree, data.closed_set,
+                            data.path_node_positions);
+  }
+  if (data.candidates_marker || data.selected_marker || data.rejected_marker ||
+      data.blocked_marker) {
+    local_planner_->getCandidateDataForVisualization(
+        data.path_candidates, data.path_selected, data.path_rejected,
+        data.path_blocked);
+  }
+  if (data.FOV_marker) {
+    local_planner_->getFOVForVisualization(data.FOV_cells);
+  }
+  if (data.histogram_image) {
+    local_planner_->getHistogramImage(data.histogram_image_msg);
+  }
+  if (data.histogram_compressed) {
+    local_planner_->getCompressedHistogram(data.histogram_compressed_msg);
+  }
+  data.position = local_planner_->getPosition().pose.position;
+  data.goal = local_planner_->getGoal();
+  data.histogram_box = local_planner_->histogram_box_;
+  data.take_off_position = local_planner_->take_off_pose_.pose.position;
+  data.offboard_position = local_planner_->offboard_pose_.pose.position;
+  data.starting_height = local_planner_->starting_height_;
+  visualization_data_.publish();
+
+  std::unique_lock<std::mutex> lck(visualization_ready_mutex_);
+  visualization_ready_ = true;
+  visualization_ready_cv_.notify_one();
+}
+
+// build and send the messages of the due visualization topics, runs in the
+// visualization thread
+void LocalPlannerNode::publishVisualization(const visualizationData& data) {
+  if (data.local_pointcloud) {
+    local_pointcloud_pub_.publish(data.final_cloud);
+  }
+  if (data.reprojected_points) {
+    reprojected_points_pub_.publish(data.reprojected_points_cloud);
+  }
+  if (data.complete_tree || data.tree_path) {
+    publishTree(data);
+  }
+  if (data.candidates_marker) {
+    publishMarkerCandidates(data);
+  }
+  if (data.selected_marker) {
+    publishMarkerSelected(data);
+  }
+  if (data.rejected_marker) {
+    publishMarkerRejected(data);
+  }
+  if (data.blocked_marker) {
+    publishMarkerBlocked(data);
+  }
+  if (data.FOV_marker) {
+    publishMarkerFOV(data);
+  }
+  if (data.goal_position) {
+    publishGoal(data);
+  }
+  if (data.bounding_box) {
+    publishBox(data);
+  }
+  if (data.reach_height) {
+    publishReachHeight(data);
+  }
+  if (data.histogram_image) {
+    histogram_image_pub_.publish(data.histogram_image_msg);
+  }
+  if (data.histogram_compressed) {
+    histogram_compressed_pub_.publish(data.histogram_compressed_msg);
+  }
 }
 
 void LocalPlannerNode::dynamicReconfigureCallback(
     avoidance::LocalPlannerNodeConfig& config, uint32_t level) {
-  std::lock_guard<std::mutex> guard(running_mutex_);
-  local_planner_->dynamicReconfigureSetParams(config, level);
-  wp_generator_->setMinJerkLimit(config.min_jerk_limit_);
-  wp_generator_->setMaxJerkLimit(config.max_jerk_limit_);
+  // the planner thread applies the parameters before its next run
+  planner_config_.back() = std::make_pair(config, level);
+  planner_config_.publish();
+  {
+    std::lock_guard<std::mutex> lock(waypoint_mutex_);
+    wp_generator_->setMinJerkLimit(config.min_jerk_limit_);
+    wp_generator_->setMaxJerkLimit(config.max_jerk_limit_);
+  }
   rqt_param_config_ = config;
 }
 
@@ -973,21 +1657,62 @@ void LocalPlannerNode::threadFunction() {
     // wait for data
     {
       std::unique_lock<std::mutex> lk(data_ready_mutex_);
-      data_ready_cv_.wait(lk, [this] { return data_ready_ && !should_exit_; });
+      data_ready_cv_.wait(lk, [this] { return data_ready_ || should_exit_; });
       data_ready_ = false;
     }
 
     if (should_exit_) break;
 
+    if (planner_config_.update()) {
+      local_planner_->dynamicReconfigureSetParams(
+          planner_config_.front().first, planner_config_.front().second);
+      planner_log_.writeConfig(planner_config_.front().first,
+                               planner_config_.front().second);
+    }
+    if (!planner_input_.update()) continue;
+    applyPlannerInput(planner_input_.front());
+
+    never_run_ = false;
+    std::clock_t start_time = std::clock();
     {
-      std::lock_guard<std::mutex> guard(running_mutex_);
-      never_run_ = false;
-      std::clock_t start_time = std::clock();
+      ScopedStageTimer timer(&stage_timers_, Stage::runPlanner);
       local_planner_->runPlanner();
+    }
+    {
+      ScopedStageTimer timer(&stage_timers_, Stage::publish);
       publishPlannerData();
+    }
+
+    plannerOutput& output = planner_output_.back();
+    output.avoidance_output = local_planner_->getAvoidanceOutput();
+    output.stop_in_front_active = local_planner_->stop_in_front_active_;
+    output.goal = local_planner_->getGoal();
+    planner_log_.writeOutput(output.avoidance_output);
+    planner_output_.publish();
+
+    ROS_DEBUG("\033[0;35m[OA]Planner calculation time: %2.2f ms \n \033[0m",
+              (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
+  }
+}
+
+void LocalPlannerNode::visualizationThreadFunction() {
+#ifdef SCHED_IDLE
+  // only run when the planner and the spin loop leave the CPU idle
+  sched_param param = {};
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+  while (!should_exit_) {
+    {
+      std::unique_lock<std::mutex> lk(visualization_ready_mutex_);
+      visualization_ready_cv_.wait(
+          lk, [this] { return visualization_ready_ || should_exit_; });
+      visualization_ready_ = false;
+    }
+
+    if (should_exit_) break;
 
-      ROS_DEBUG("\033[0;35m[OA]Planner calculation time: %2.2f ms \n \033[0m",
-                (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
+    if (visualization_data_.update()) {
+      publishVisualization(visualization_data_.front());
     }
   }
 }
@@ -3,8 +3,16 @@
 
 #include "avoidance/common_ros.h"
 #include "avoidance_output.h"
+#include "box.h"
+#include "planner_functions.h"
+#include "planner_log.h"
 #include "rviz_world_loader.h"
+#include "stage_timer.h"
+#include "tree_node.h"
+#include "triple_buffer.h"
+#include "waypoint_generator.h"
 
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <geometry_msgs/Point.h>
 #include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/TransformStamped.h>
@@ -18,13 +26,16 @@
 #include <pcl_conversions/pcl_conversions.h>  // fromROSMsg
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>  // transformPointCloud
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/Range.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
 #include <std_msgs/String.h>
+#include <std_msgs/UInt8MultiArray.h>
 #include <tf/transform_listener.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -39,6 +50,8 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 
 namespace avoidance {
 
@@ -49,8 +62,107 @@ struct cameraData {
   std::string topic_;
   ros::Subscriber pointcloud_sub_;
   ros::Subscriber camera_info_sub_;
-  sensor_msgs::PointCloud2 newest_cloud_msg_;
-  bool received_;
+  std::atomic<bool> received_{false};
+
+  // each camera has a thread which transforms its clouds into /local_origin
+  // as soon as they arrive. The newest message waiting for it:
+  std::thread transform_thread_;
+  std::mutex cloud_msg_mutex_;
+  std::condition_variable cloud_msg_cv_;
+  sensor_msgs::PointCloud2::ConstPtr newest_cloud_msg_;
+
+  // the newest transformed cloud, transformed_ is true until it is handed to
+  // the planner
+  std::mutex transformed_cloud_mutex_;
+  pcl::PointCloud<pcl::PointXYZ> transformed_cloud_;
+  ros::Time transformed_stamp_;  // stamp of the message it was created from
+  bool transformed_ = false;
+  // field of view from the camera info and pose of the newest cloud
+  CameraFrustum frustum_;
+  std::string optical_frame_;  // frame of the camera info
+
+  // obstacle distance of the newest cloud by sector, guarded by the
+  // obstacle_distance_mutex_ of the node
+  std::vector<float> obstacle_ranges_;
+  std::vector<bool> obstacle_ranges_in_view_;
+  ros::Time obstacle_ranges_stamp_;
+};
+
+// when the spin loop hands new clouds to the planner
+enum class PlannerTrigger {
+  allCameras,  // as soon as every camera has sent a new cloud
+  anyCamera,   // on every new cloud, with the latest clouds of the others
+  fixedRate    // at planner_rate, with the latest clouds of all cameras
+};
+
+// sensor data and state for one planner cycle, collected by the spin loop
+struct plannerInput {
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud;
+  std::vector<CameraFrustum> camera_frustums;
+  geometry_msgs::PoseStamped pose;
+  geometry_msgs::TwistStamped vel;
+  bool armed = false;
+  bool offboard = false;
+  bool mission = false;
+  int goal_count = 0;  // incremented with every new goal
+  geometry_msgs::Point goal;
+  double ground_distance = 2.0;
+};
+
+// results of one planner cycle, used by the spin loop to send waypoints
+struct plannerOutput {
+  avoidanceOutput avoidance_output;
+  bool stop_in_front_active = false;
+  geometry_msgs::Point goal;
+};
+
+// vehicle state for the waypoint thread, copied by the spin loop
+struct waypointState {
+  geometry_msgs::PoseStamped pose;
+  geometry_msgs::PoseStamped last_pose;
+  geometry_msgs::PoseStamped goal;
+  geometry_msgs::TwistStamped vel;
+  bool hover = false;
+  bool active = false;  // the planner has run and the vehicle isn't landing
+};
+
+// snapshot of the planner state taken by the planner thread for the
+// visualization thread. A topic flag is only set if the topic is due, the data
+// of the other topics is neither copied nor valid
+struct visualizationData {
+  bool local_pointcloud = false;
+  bool reprojected_points = false;
+  bool complete_tree = false;
+  bool tree_path = false;
+  bool candidates_marker = false;
+  bool selected_marker = false;
+  bool rejected_marker = false;
+  bool blocked_marker = false;
+  bool FOV_marker = false;
+  bool goal_position = false;
+  bool bounding_box = false;
+  bool reach_height = false;
+  bool histogram_image = false;
+  bool histogram_compressed = false;
+
+  geometry_msgs::Point position;
+  geometry_msgs::Point goal;
+  pcl::PointCloud<pcl::PointXYZ> final_cloud;
+  pcl::PointCloud<pcl::PointXYZ> reprojected_points_cloud;
+  std::vector<TreeNode> tree;
+  std::vector<int> closed_set;
+  std::vector<geometry_msgs::Point> path_node_positions;
+  nav_msgs::GridCells path_candidates;
+  nav_msgs::GridCells path_selected;
+  nav_msgs::GridCells path_rejected;
+  nav_msgs::GridCells path_blocked;
+  nav_msgs::GridCells FOV_cells;
+  Box histogram_box;
+  geometry_msgs::Point take_off_position;
+  geometry_msgs::Point offboard_position;
+  double starting_height = 0.0;
+  sensor_msgs::Image histogram_image_msg;
+  std_msgs::UInt8MultiArray histogram_compressed_msg;
 };
 
 enum class MAV_STATE {
@@ -67,14 +179,15 @@ enum class MAV_STATE {
 
 class LocalPlannerNode {
  public:
-  LocalPlannerNode();
+  // nh is the private node handle, the nodelet passes its own
+  explicit LocalPlannerNode(const ros::NodeHandle& nh = ros::NodeHandle("~"));
   ~LocalPlannerNode();
 
   mavros_msgs::CompanionProcessStatus status_msg_;
 
   std::string world_path_;
-  bool never_run_ = true;
-  bool position_received_ = false;
+  std::atomic<bool> never_run_{true};
+  std::atomic<bool> position_received_{false};
   bool disable_rise_to_goal_altitude_;
   bool accept_goal_input_topic_;
 
@@ -84,10 +197,16 @@ class LocalPlannerNode {
 
   std::vector<cameraData> cameras_;
 
+  // the point clouds and the pose and velocity are received by their own
+  // spinner threads, all other callbacks run in the spin loop, such that a
+  // burst of clouds or a slow callback doesn't delay the pose updates which
+  // drive the waypoint output. pose_mutex_ guards newest_pose_, last_pose_,
+  // vel_msg_ and curr_yaw_
   ros::CallbackQueue pointcloud_queue_;
+  ros::CallbackQueue pose_queue_;
   ros::CallbackQueue main_queue_;
+  std::mutex pose_mutex_;
 
-  std::vector<geometry_msgs::Point> path_node_positions_;
   geometry_msgs::PoseStamped hover_point_;
   geometry_msgs::PoseStamped newest_pose_;
   geometry_msgs::PoseStamped last_pose_;
@@ -99,7 +218,11 @@ class LocalPlannerNode {
   const ros::Duration pointcloud_timeout_land_ = ros::Duration(10);
 
   ros::Time last_wp_time_;
+  ros::Time last_planner_trigger_;
   ros::Time t_status_sent_;
+  ros::Time t_stage_timings_sent_;
+
+  StageTimers stage_timers_;
 
   std::unique_ptr<LocalPlanner> local_planner_;
   std::unique_ptr<WaypointGenerator> wp_generator_;
@@ -116,20 +239,42 @@ class LocalPlannerNode {
   ros::Publisher mavros_system_status_pub_;
   tf::TransformListener tf_listener_;
 
-  std::mutex running_mutex_;  ///< guard against concurrent access to input &
-                              /// output data (point cloud, position, ...)
+  // handoff between the spin loop and the planner thread, neither side waits
+  // for the other
+  TripleBuffer<plannerInput> planner_input_;
+  TripleBuffer<plannerOutput> planner_output_;
+  TripleBuffer<std::pair<avoidance::LocalPlannerNodeConfig, uint32_t>>
+      planner_config_;
 
   std::mutex data_ready_mutex_;
   bool data_ready_ = false;
   std::condition_variable data_ready_cv_;
 
+  // handoff from the planner thread to the visualization thread
+  TripleBuffer<visualizationData> visualization_data_;
+  std::mutex visualization_ready_mutex_;
+  bool visualization_ready_ = false;
+  std::condition_variable visualization_ready_cv_;
+
   void publishSetpoint(const geometry_msgs::Twist& wp,
-                       waypoint_choice& waypoint_type);
+                       const geometry_msgs::Point& position,
+                       const waypoint_choice& waypoint_type);
   void threadFunction();
+  void cloudTransformThreadFunction(size_t index);
+  void publishObstacleDistance(size_t index,
+                               const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                               const Eigen::Vector3f& sensor_position,
+                               const CameraFrustum& frustum,
+                               const ros::Time& stamp);
+  void visualizationThreadFunction();
+  void worldThreadFunction();
   void getInterimWaypoint(geometry_msgs::PoseStamped& wp,
                           geometry_msgs::Twist& wp_vel);
   bool canUpdatePlannerInfo();
+  bool plannerInputReady(const ros::Time& now);
   void updatePlannerInfo();
+  void applyPlannerInput(plannerInput& input);
+  void updatePlannerOutput();
   size_t numReceivedClouds();
   void transformPoseToTrajectory(mavros_msgs::Trajectory& obst_avoid,
                                  geometry_msgs::PoseStamped pose);
@@ -137,14 +282,43 @@ class LocalPlannerNode {
                                      geometry_msgs::Twist vel);
   void fillUnusedTrajectoryPoint(mavros_msgs::PositionTarget& point);
   void publishWaypoints(bool hover);
+  void publishWaypointResult(const waypointResult& result,
+                             const geometry_msgs::Point& last_position,
+                             const geometry_msgs::Point& position);
+  void waypointThreadFunction();
+  void publishStageTimings();
+  // runs the planner and visualization threads and the spin loop until
+  // shutdown or should_exit_ is set
+  void spinLoop();
 
   const ros::NodeHandle& nodeHandle() const { return nh_; }
 
  private:
   ros::NodeHandle nh_;
+  ros::NodeHandle nh_pointcloud_;  // with the point cloud callback queue
+  ros::NodeHandle nh_pose_;        // with the pose callback queue
   avoidance::LocalPlannerNodeConfig rqt_param_config_;
 
   mavros_msgs::Altitude ground_distance_msg_;
+  PlannerTrigger planner_trigger_ = PlannerTrigger::allCameras;
+  ros::Duration planner_period_;
+  // clouds older than this are not used for planning, except when waiting for
+  // all cameras
+  ros::Duration max_cloud_age_;
+  // the transform threads send the obstacle distance of every new cloud to
+  // the FCU instead of the planner once per cycle
+  bool obstacle_distance_at_camera_rate_ = false;
+  std::mutex obstacle_distance_mutex_;
+  // log of the planner inputs and outputs for the replay, written by the
+  // planner thread
+  PlannerLogWriter planner_log_;
+  // with a waypoint_rate the waypoints are sent by their own thread at that
+  // rate instead of on every pose update. waypoint_mutex_ guards the
+  // wp_generator_ and the waypoint_state_
+  double waypoint_rate_ = 0.0;
+  int waypoint_thread_priority_ = 0;
+  std::mutex waypoint_mutex_;
+  waypointState waypoint_state_;
   int path_length_ = 0;
 
   // Subscribers
@@ -183,11 +357,21 @@ class LocalPlannerNode {
   ros::Publisher adapted_wp_pub_;
   ros::Publisher smoothed_wp_pub_;
   ros::Publisher histogram_image_pub_;
+  ros::Publisher histogram_compressed_pub_;
+  ros::Publisher stage_timings_pub_;
 
   std::vector<float> algo_time;
 
+  // minimum time between two messages on a visualization topic, by topic name,
+  // and the time of the last message. Only used by the planner thread
+  ros::Duration visualization_period_;
+  std::unordered_map<std::string, ros::Duration> visualization_periods_;
+  std::unordered_map<std::string, ros::Time> visualization_sent_;
+
   geometry_msgs::TwistStamped vel_msg_;
   bool armed_, offboard_, mission_, new_goal_;
+  int goal_count_ = 0;
+  int applied_goal_count_ = 0;
 
   dynamic_reconfigure::Server<avoidance::LocalPlannerNodeConfig>* server_;
   boost::recursive_mutex config_mutex_;
@@ -203,16 +387,20 @@ class LocalPlannerNode {
   void velocityCallback(const geometry_msgs::TwistStamped& msg);
   void stateCallback(const mavros_msgs::State& msg);
   void readParams();
+  bool visualizationDue(const ros::Publisher& pub, const ros::Time& now);
   void publishPlannerData();
-  void publishPaths();
+  void publishVisualization(const visualizationData& data);
+  void publishPaths(const geometry_msgs::Point& last_position,
+                    const geometry_msgs::Point& position);
   void initMarker(visualization_msgs::MarkerArray* marker,
-                  nav_msgs::GridCells& path, const float red, const float green,
-                  const float blue);
-  void publishMarkerBlocked(nav_msgs::GridCells& path_blocked);
-  void publishMarkerRejected(nav_msgs::GridCells& path_rejected);
-  void publishMarkerCandidates(nav_msgs::GridCells& path_candidates);
-  void publishMarkerSelected(nav_msgs::GridCells& path_selected);
-  void publishMarkerFOV(nav_msgs::GridCells& FOV_cells);
+                  const nav_msgs::GridCells& path,
+                  const geometry_msgs::Point& drone_pos, const float red,
+                  const float green, const float blue);
+  void publishMarkerBlocked(const visualizationData& data);
+  void publishMarkerRejected(const visualizationData& data);
+  void publishMarkerCandidates(const visualizationData& data);
+  void publishMarkerSelected(const visualizationData& data);
+  void publishMarkerFOV(const visualizationData& data);
   void clickedPointCallback(const geometry_msgs::PointStamped& msg);
   void clickedGoalCallback(const geometry_msgs::PoseStamped& msg);
   void updateGoalCallback(const visualization_msgs::MarkerArray& msg);
@@ -220,11 +408,10 @@ class LocalPlannerNode {
   void distanceSensorCallback(const mavros_msgs::Altitude& msg);
 
   void printPointInfo(double x, double y, double z);
-  void publishGoal();
-  void publishBox();
-  void publishReachHeight();
-  void publishTree();
-  void publishHistogramImage();
+  void publishGoal(const visualizationData& data);
+  void publishBox(const visualizationData& data);
+  void publishReachHeight(const visualizationData& data);
+  void publishTree(const visualizationData& data);
   void publishGround();
 };
 }
@@ -0,0 +1,38 @@
+#include "local_planner_node.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <memory>
+#include <thread>
+
+namespace avoidance {
+
+// Runs the LocalPlannerNode in a nodelet manager. The point clouds of camera
+// drivers in the same manager are then passed by pointer instead of being
+// serialized. The node keeps its own callback queues, the spin loop runs on
+// a thread of the nodelet.
+class LocalPlannerNodelet : public nodelet::Nodelet {
+ public:
+  ~LocalPlannerNodelet() {
+    if (node_) {
+      node_->should_exit_ = true;
+    }
+    if (spin_thread_.joinable()) {
+      spin_thread_.join();
+    }
+  }
+
+ private:
+  std::unique_ptr<LocalPlannerNode> node_;
+  std::thread spin_thread_;
+
+  void onInit() override {
+    node_.reset(new LocalPlannerNode(getPrivateNodeHandle()));
+    spin_thread_ = std::thread(&LocalPlannerNode::spinLoop, node_.get());
+  }
+};
+
+}  // namespace avoidance
+
+PLUGINLIB_EXPORT_CLASS(avoidance::LocalPlannerNodelet, nodelet::Nodelet)
@@ -0,0 +1,151 @@
+#include "obstacle_memory.h"
+
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace avoidance {
+
+ObstacleMemory::ObstacleMemory(float voxel_size, float max_distance)
+    : voxel_size_(voxel_size), max_distance_(max_distance) {
+  allocate();
+}
+
+void ObstacleMemory::allocate() {
+  // two live voxels can only share a storage cell if they are further than
+  // 2 * max_distance_ apart
+  side_ = 2 * static_cast<int>(std::ceil(max_distance_ / voxel_size_)) + 2;
+  voxels_.assign(side_ * side_ * side_, voxel());
+  occupied_.clear();
+}
+
+void ObstacleMemory::setMaxDistance(float max_distance) {
+  if (max_distance != max_distance_) {
+    max_distance_ = max_distance;
+    allocate();
+  }
+}
+
+void ObstacleMemory::clear() {
+  for (int i : occupied_) {
+    voxels_[i].update = -1;
+  }
+  occupied_.clear();
+}
+
+int ObstacleMemory::wrap(int i) const {
+  i %= side_;
+  return i < 0 ? i + side_ : i;
+}
+
+void ObstacleMemory::update(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                            bool advance_age) {
+  update_++;
+  if (advance_age) {
+    age_clock_++;
+  }
+
+  for (const pcl::PointXYZ& xyz : cloud) {
+    int x = static_cast<int>(std::floor(xyz.x / voxel_size_));
+    int y = static_cast<int>(std::floor(xyz.y / voxel_size_));
+    int z = static_cast<int>(std::floor(xyz.z / voxel_size_));
+    int i = (wrap(x) * side_ + wrap(y)) * side_ + wrap(z);
+
+    // a remembered voxel sharing the cell is out of range and gets replaced
+    voxel& v = voxels_[i];
+    if (v.update < 0) {
+      occupied_.push_back(i);
+    }
+    v.point = toEigen(xyz);
+    v.update = update_;
+    v.age_stamp = age_clock_;
+  }
+}
+
+void ObstacleMemory::getHistogram(Histogram& histogram,
+                                  const Eigen::Vector3f& position,
+                                  const std::vector<int>& z_FOV_idx,
+                                  int e_FOV_min, int e_FOV_max,
+                                  float min_distance, int max_age) {
+  histogram.reset(ALPHA_RES);
+  bool z_in_FOV[GRID_LENGTH_Z] = {};
+  for (int z : z_FOV_idx) {
+    if (z >= 0 && z < GRID_LENGTH_Z) {
+      z_in_FOV[z] = true;
+    }
+  }
+
+  // accumulate the remembered points and drop forgotten voxels in place
+  size_t n_kept = 0;
+  for (size_t n = 0; n < occupied_.size(); n++) {
+    voxel& v = voxels_[occupied_[n]];
+    float dist = (v.point - position).norm();
+    int age = age_clock_ - v.age_stamp;
+    bool forget = dist < min_distance || dist > max_distance_ || age >= max_age;
+
+    float e_angle = 0.f, z_angle = 0.f;
+    if (!forget) {
+      e_angle = fastElevationAnglefromCartesian(v.point, position);
+      z_angle = fastAzimuthAnglefromCartesian(v.point, position);
+      int e = elevationAngletoIndex(e_angle, ALPHA_RES);
+      int z = azimuthAngletoIndex(z_angle, ALPHA_RES);
+      bool in_FOV = z_in_FOV[z] && e > e_FOV_min && e < e_FOV_max;
+      forget = in_FOV && v.update != update_;
+    }
+
+    if (forget) {
+      v.update = -1;
+      continue;
+    }
+    occupied_[n_kept++] = occupied_[n];
+
+    // add the voxel to all cells its extent covers, such that a close surface
+    // stays closed although its voxels are larger than the cells
+    float half_size = std::min(
+        90.f, static_cast<float>(voxel_size_ / (2.f * dist) * 180.0 / M_PI));
+    int e_min = std::max(
+        0, static_cast<int>(std::floor((e_angle - half_size + 90.f) /
+                                       ALPHA_RES)));
+    int e_max = std::min(
+        GRID_LENGTH_E - 1,
+        static_cast<int>(std::floor((e_angle + half_size + 90.f) /
+                                    ALPHA_RES)));
+    int z_min =
+        static_cast<int>(std::floor((z_angle - half_size + 180.f) / ALPHA_RES));
+    int z_max =
+        static_cast<int>(std::floor((z_angle + half_size + 180.f) / ALPHA_RES));
+    z_max = std::min(z_max, z_min + GRID_LENGTH_Z - 1);
+    for (int e = e_min; e <= e_max; e++) {
+      for (int z_unwrapped = z_min; z_unwrapped <= z_max; z_unwrapped++) {
+        int z = (z_unwrapped + GRID_LENGTH_Z) % GRID_LENGTH_Z;
+        histogram.set_bin(e, z, histogram.get_bin(e, z) + 1);
+        histogram.set_age(e, z, histogram.get_age(e, z) + age);
+        histogram.set_dist(e, z, histogram.get_dist(e, z) + dist);
+      }
+    }
+  }
+  occupied_.resize(n_kept);
+
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      double n_points = histogram.get_bin(e, z);
+      if (n_points > 0) {
+        histogram.set_age(e, z, histogram.get_age(e, z) / n_points);
+        histogram.set_dist(e, z, histogram.get_dist(e, z) / n_points);
+        histogram.set_bin(e, z, 1);
+      }
+    }
+  }
+}
+
+void ObstacleMemory::getPoints(pcl::PointCloud<pcl::PointXYZ>& points) const {
+  points.points.clear();
+  points.points.reserve(occupied_.size());
+  for (int i : occupied_) {
+    points.points.push_back(toXYZ(voxels_[i].point));
+  }
+  points.height = 1;
+  points.width = points.points.size();
+}
+}
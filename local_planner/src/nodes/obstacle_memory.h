@@ -0,0 +1,84 @@
+#ifndef OBSTACLE_MEMORY_H
+#define OBSTACLE_MEMORY_H
+
+#include "histogram.h"
+
+#include <Eigen/Core>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief Robot centric memory of obstacle points in a fixed size rolling voxel
+*        grid. New clouds are inserted incrementally and the polar histogram
+*        of the remembered obstacles is built directly from the voxels.
+**/
+class ObstacleMemory {
+  struct voxel {
+    Eigen::Vector3f point = Eigen::Vector3f::Zero();
+    int update = -1;    // update in which it was last observed, -1 if empty
+    int age_stamp = 0;  // age clock when it was last observed
+  };
+
+  float voxel_size_;
+  float max_distance_;
+  // number of voxels along each side of the grid, wrapped around such that
+  // the vehicle is always in the center
+  int side_;
+  int update_ = 0;
+  int age_clock_ = 0;
+  std::vector<voxel> voxels_;
+  std::vector<int> occupied_;  // indices of all non empty voxels
+
+  int wrap(int i) const;
+  void allocate();
+
+ public:
+  /**
+  * @param[in] voxel_size edge length of a voxel [m]
+  * @param[in] max_distance obstacles further away from the vehicle than this
+  *            are forgotten, determines the size of the grid [m]
+  **/
+  ObstacleMemory(float voxel_size = 0.5f, float max_distance = 14.f);
+
+  /**
+  * @brief     Changes the memory range, clears the memory if it changed
+  **/
+  void setMaxDistance(float max_distance);
+  void clear();
+  size_t size() const { return occupied_.size(); }
+
+  /**
+  * @brief     Inserts the points of a new cloud, a voxel keeps the last point
+  *            observed in it
+  * @param[in] advance_age if true all remembered obstacles get one step older
+  **/
+  void update(const pcl::PointCloud<pcl::PointXYZ>& cloud, bool advance_age);
+
+  /**
+  * @brief     Builds the histogram of the remembered obstacles as seen from
+  *            position, with the mean distance and age per cell. A voxel is
+  *            added to all cells covered by its extent. Obstacles which are
+  *            too close, too far or too old are forgotten, as well as those
+  *            inside the FOV which were not observed in the last update.
+  * @param[out] histogram at ALPHA_RES, reset before filling
+  * @param[in] z_FOV_idx, e_FOV_min, e_FOV_max FOV as in combinedHistogram
+  * @param[in] min_distance obstacles closer than this are forgotten [m]
+  * @param[in] max_age obstacles of at least this age are forgotten
+  **/
+  void getHistogram(Histogram& histogram, const Eigen::Vector3f& position,
+                    const std::vector<int>& z_FOV_idx, int e_FOV_min,
+                    int e_FOV_max, float min_distance, int max_age);
+
+  /**
+  * @brief     Returns the remembered obstacle points, e.g. for visualization
+  **/
+  void getPoints(pcl::PointCloud<pcl::PointXYZ>& points) const;
+};
+}
+
+#endif  // OBSTACLE_MEMORY_H
@@ -0,0 +1,191 @@
+#include "obstacle_tracker.h"
+
+#include "common.h"
+
+#include <algorithm>
+
+namespace avoidance {
+
+ObstacleTracker::ObstacleTracker(size_t max_tracks, float cluster_radius,
+                                 float min_speed)
+    : max_tracks_(max_tracks),
+      cluster_radius_(cluster_radius),
+      min_speed_(min_speed) {
+  clusters_.reserve(max_tracks_);
+  tracks_.reserve(max_tracks_);
+}
+
+void ObstacleTracker::clear() {
+  clusters_.clear();
+  tracks_.clear();
+  has_time_ = false;
+  last_dt_ = 0.f;
+}
+
+// each point joins the closest cluster within the radius or starts a new
+// one. Touching clusters are merged afterwards, such that a large obstacle is
+// one cluster instead of pieces which slide along it with the view.
+void ObstacleTracker::clusterPoints(
+    const pcl::PointCloud<pcl::PointXYZ>& cloud,
+    const Eigen::Vector3f& position, float range) {
+  clusters_.clear();
+  const float radius_sq = cluster_radius_ * cluster_radius_;
+  const float border_sq = std::max(range - merge_gap_, 0.f) *
+                          std::max(range - merge_gap_, 0.f);
+  for (const pcl::PointXYZ& xyz : cloud) {
+    const Eigen::Vector3f p = toEigen(xyz);
+    cluster* closest = nullptr;
+    float closest_dist_sq = radius_sq;
+    for (cluster& c : clusters_) {
+      float dist_sq = (c.centroid - p).squaredNorm();
+      if (dist_sq < closest_dist_sq) {
+        closest_dist_sq = dist_sq;
+        closest = &c;
+      }
+    }
+    if (!closest) {
+      if (clusters_.size() == max_tracks_) {
+        continue;
+      }
+      clusters_.push_back(cluster());
+      closest = &clusters_.back();
+      closest->min = p;
+      closest->max = p;
+    }
+    closest->min = closest->min.cwiseMin(p);
+    closest->max = closest->max.cwiseMax(p);
+    closest->cut = closest->cut || (p - position).squaredNorm() > border_sq;
+    closest->sum += p;
+    closest->n_points++;
+    closest->centroid = closest->sum / closest->n_points;
+  }
+
+  for (size_t i = 0; i < clusters_.size(); i++) {
+    for (size_t j = i + 1; j < clusters_.size();) {
+      cluster& a = clusters_[i];
+      const cluster& b = clusters_[j];
+      bool touching = ((a.min - b.max).array() < merge_gap_).all() &&
+                      ((b.min - a.max).array() < merge_gap_).all();
+      if (touching) {
+        a.min = a.min.cwiseMin(b.min);
+        a.max = a.max.cwiseMax(b.max);
+        a.n_points += b.n_points;
+        a.cut = a.cut || b.cut;
+        clusters_[j] = clusters_.back();
+        clusters_.pop_back();
+        j = i + 1;  // the grown cluster may touch the ones before j
+      } else {
+        j++;
+      }
+    }
+  }
+}
+
+void ObstacleTracker::update(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                             double time, const Eigen::Vector3f& position,
+                             float range) {
+  clusterPoints(cloud, position, range);
+  const float dt = has_time_ ? static_cast<float>(time - last_time_) : 0.f;
+  const bool has_dt = dt > 0.f;
+  if (has_dt) {
+    last_dt_ = dt;
+  }
+  if (has_dt || !has_time_) {
+    last_time_ = time;
+    has_time_ = true;
+  }
+
+  // match the tracks to the closest cluster around their predicted position
+  const float gate = cluster_radius_ + max_speed_ * std::max(dt, 0.f);
+  for (track& t : tracks_) {
+    const Eigen::Vector3f predicted =
+        has_dt ? Eigen::Vector3f(t.position + t.velocity * dt) : t.position;
+    cluster* closest = nullptr;
+    float closest_dist = gate;
+    for (cluster& c : clusters_) {
+      float dist = (c.center() - predicted).norm();
+      if (!c.matched && dist < closest_dist) {
+        closest_dist = dist;
+        closest = &c;
+      }
+    }
+
+    if (closest) {
+      closest->matched = true;
+      const Eigen::Vector3f extent = closest->max - closest->min;
+      // compared to the extent at the start of the track, such that the slow
+      // changes at the border of the cloud are not taken for motion
+      if (closest->cut ||
+          (extent - t.extent).cwiseAbs().maxCoeff() > extent_tolerance_) {
+        // another part of the obstacle is seen, the motion is unknown
+        t.velocity.setZero();
+        t.extent = extent;
+        t.hits = 1;
+      } else {
+        if (has_dt) {
+          Eigen::Vector3f measured = (closest->center() - t.position) / dt;
+          t.velocity =
+              t.hits < 2 ? measured
+                         : Eigen::Vector3f(t.velocity + velocity_gain_ *
+                                                            (measured -
+                                                             t.velocity));
+        }
+        t.hits++;
+      }
+      t.position = closest->center();
+      t.misses = 0;
+    } else {
+      t.position = predicted;
+      t.misses++;
+    }
+  }
+
+  // drop the lost tracks, the order of the tracks does not matter
+  for (size_t i = 0; i < tracks_.size();) {
+    if (tracks_[i].misses > max_misses_) {
+      tracks_[i] = tracks_.back();
+      tracks_.pop_back();
+    } else {
+      i++;
+    }
+  }
+
+  // the unmatched clusters start new tracks
+  for (const cluster& c : clusters_) {
+    if (!c.matched && tracks_.size() < max_tracks_) {
+      track t;
+      t.position = c.center();
+      t.extent = c.max - c.min;
+      t.hits = 1;
+      tracks_.push_back(t);
+    }
+  }
+}
+
+bool ObstacleTracker::isDynamic(const track& t) const {
+  return t.hits >= min_hits_ && t.velocity.norm() > min_speed_;
+}
+
+size_t ObstacleTracker::numDynamic() const {
+  return std::count_if(tracks_.begin(), tracks_.end(),
+                       [this](const track& t) { return isDynamic(t); });
+}
+
+bool ObstacleTracker::isOnDynamicTrail(const Eigen::Vector3f& point,
+                                       float horizon) const {
+  for (const track& t : tracks_) {
+    if (!isDynamic(t) || (point - t.position).norm() < cluster_radius_) {
+      continue;
+    }
+    // distance to the segment the track has moved along
+    const Eigen::Vector3f trail = -t.velocity * horizon;
+    float s = std::min(
+        1.f, std::max(0.f, (point - t.position).dot(trail) /
+                               std::max(trail.squaredNorm(), 1e-6f)));
+    if ((point - (t.position + s * trail)).norm() < cluster_radius_) {
+      return true;
+    }
+  }
+  return false;
+}
+}
@@ -0,0 +1,101 @@
+#ifndef OBSTACLE_TRACKER_H
+#define OBSTACLE_TRACKER_H
+
+#include <Eigen/Core>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief Tracks clusters of obstacle points over consecutive clouds and
+*        estimates their velocity, such that the reprojected copies of moving
+*        obstacles can be dropped. The clusters and tracks live in flat
+*        arrays of fixed capacity, points beyond the capacity are ignored.
+**/
+class ObstacleTracker {
+ public:
+  struct track {
+    Eigen::Vector3f position = Eigen::Vector3f::Zero();  // bounding box center
+    Eigen::Vector3f extent = Eigen::Vector3f::Zero();    // size at the start
+    Eigen::Vector3f velocity = Eigen::Vector3f::Zero();  // filtered [m/s]
+    int hits = 0;    // number of consecutive updates with the same extent
+    int misses = 0;  // number of updates since it was last observed
+  };
+
+  /**
+  * @param[in] max_tracks capacity of the clusters and tracks of one update
+  * @param[in] cluster_radius points within this distance of the centroid of
+  *            a cluster belong to it [m]
+  * @param[in] min_speed tracks slower than this are static [m/s]
+  **/
+  ObstacleTracker(size_t max_tracks = 32, float cluster_radius = 1.f,
+                  float min_speed = 0.5f);
+
+  void clear();
+  const std::vector<track>& tracks() const { return tracks_; }
+  // time between the last two clouds [s]
+  float updateInterval() const { return last_dt_; }
+
+  /**
+  * @brief     Clusters the points of a new cloud and matches the clusters to
+  *            the predicted positions of the tracks
+  * @param[in] time stamp of the cloud [s]
+  * @param[in] position, range the cloud has been cropped to this distance
+  *            from position, the clusters cut by it move with the vehicle
+  **/
+  void update(const pcl::PointCloud<pcl::PointXYZ>& cloud, double time,
+              const Eigen::Vector3f& position, float range);
+
+  /**
+  * @brief     Returns true if the track has been observed often enough with
+  *            the same extent and moves faster than the minimum speed. The
+  *            extent of static obstacles which come into view changes.
+  **/
+  bool isDynamic(const track& t) const;
+  size_t numDynamic() const;
+
+  /**
+  * @brief     Returns true if point is where a dynamic track has been during
+  *            the last horizon seconds but not where it is now, i.e. a stale
+  *            copy of a moving obstacle
+  **/
+  bool isOnDynamicTrail(const Eigen::Vector3f& point, float horizon) const;
+
+ private:
+  struct cluster {
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+    Eigen::Vector3f min = Eigen::Vector3f::Zero();
+    Eigen::Vector3f max = Eigen::Vector3f::Zero();
+    int n_points = 0;
+    bool matched = false;
+    bool cut = false;  // has points at the border of the range
+
+    Eigen::Vector3f center() const { return 0.5f * (min + max); }
+  };
+
+  size_t max_tracks_;
+  float cluster_radius_;
+  float min_speed_;
+  float max_speed_ = 5.f;       // tracks are matched within this speed [m/s]
+  float velocity_gain_ = 0.3f;  // weight of a new velocity measurement
+  float extent_tolerance_ = 0.1f;  // change of the extent of a rigid body [m]
+  float merge_gap_ = 0.3f;  // clusters closer than this are one obstacle [m]
+  int min_hits_ = 5;
+  int max_misses_ = 3;
+  double last_time_ = 0.0;
+  float last_dt_ = 0.f;
+  bool has_time_ = false;
+  std::vector<cluster> clusters_;
+  std::vector<track> tracks_;
+
+  void clusterPoints(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                     const Eigen::Vector3f& position, float range);
+};
+}
+
+#endif  // OBSTACLE_TRACKER_H
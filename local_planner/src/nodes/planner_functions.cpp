@@ -4,7 +4,8 @@
 
 #include <ros/console.h>
 
-#include <numeric>
+#include <algorithm>
+#include <functional>
 
 namespace avoidance {
 
@@ -18,6 +19,17 @@ void initGridCells(nav_msgs::GridCells& cell) {
   cell.cells = {};
 }
 
+void candidatesToGridCells(const std::vector<candidateDirection>& candidates,
+                           nav_msgs::GridCells& path_candidates) {
+  initGridCells(path_candidates);
+  geometry_msgs::Point p;
+  for (const candidateDirection& candidate : candidates) {
+    p.x = candidate.elevation_angle;
+    p.y = candidate.azimuth_angle;
+    path_candidates.cells.push_back(p);
+  }
+}
+
 // adapt histogram safety margin around blocked cells to distance of pointcloud
 double adaptSafetyMarginHistogram(double dist_to_closest_point,
                                   double cloud_size, double min_cloud_size) {
@@ -30,51 +42,188 @@ double adaptSafetyMarginHistogram(double dist_to_closest_point,
   return safety_margin;
 }
 
-// trim the point cloud so that only points inside the bounding box are
-// considered
-void filterPointCloud(
-    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud,
+// add a point to the histogram bin it falls into as seen from position, the
+// bin indices and the distance to position are returned
+void addPointToHistogram(Histogram& polar_histogram, const Eigen::Vector3f& p,
+                         const Eigen::Vector3f& position, int& e_ind,
+                         int& z_ind, float& dist) {
+  dist = (p - position).norm();
+  int e_angle = fastElevationAnglefromCartesian(p, position);
+  int z_angle = fastAzimuthAnglefromCartesian(p, position);
+
+  e_ind = elevationAngletoIndex(e_angle, ALPHA_RES);
+  z_ind = azimuthAngletoIndex(z_angle, ALPHA_RES);
+
+  polar_histogram.set_bin(e_ind, z_ind,
+                          polar_histogram.get_bin(e_ind, z_ind) + 1);
+  polar_histogram.set_dist(e_ind, z_ind,
+                           polar_histogram.get_dist(e_ind, z_ind) + dist);
+}
+
+void addPointToHistogram(Histogram& polar_histogram, const Eigen::Vector3f& p,
+                         const Eigen::Vector3f& position) {
+  int e_ind, z_ind;
+  float dist;
+  addPointToHistogram(polar_histogram, p, position, e_ind, z_ind, dist);
+}
+
+// Normalize and get mean in distance bins
+void normalizeHistogram(Histogram& polar_histogram) {
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      if (polar_histogram.get_bin(e, z) > 0) {
+        polar_histogram.set_dist(e, z, polar_histogram.get_dist(e, z) /
+                                           polar_histogram.get_bin(e, z));
+        polar_histogram.set_bin(e, z, 1);
+      }
+    }
+  }
+}
+
+// crop the point cloud to the bounding box and optionally bin the remaining
+// points into a polar histogram in the same pass. If downsample_distance is
+// positive, only the first point of every histogram bin and distance interval
+// is kept in the cropped cloud. Points which lie in the frustum of an earlier
+// camera are skipped. Returns the number of points in the box.
+template <bool bin_points>
+size_t cropPointCloud(
+    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud, Histogram* polar_histogram,
     Eigen::Vector3f& closest_point, double& distance_to_closest_point,
     int& counter_backoff,
     const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
-    double min_cloud_size, double min_dist_backoff, Box histogram_box,
-    const Eigen::Vector3f& position, double min_realsense_dist) {
+    double min_cloud_size, double min_dist_backoff, const Box& histogram_box,
+    const Eigen::Vector3f& position, const Eigen::Vector3f& histogram_position,
+    double min_realsense_dist, double downsample_distance,
+    const std::vector<CameraFrustum>& camera_frustums) {
   cropped_cloud.points.clear();
   cropped_cloud.width = 0;
   distance_to_closest_point = HUGE_VAL;
   float distance;
   counter_backoff = 0;
+  size_t n_points = 0;
+
+  // occupied downsampling voxels, indexed by histogram bin and distance. The
+  // buffers are kept by each thread, such that the calls don't allocate
+  const bool downsample = bin_points && downsample_distance > 0.0;
+  int n_distance_steps = 0;
+  static thread_local std::vector<bool> voxel_occupied;
+  if (downsample) {
+    n_distance_steps =
+        static_cast<int>(histogram_box.radius_ / downsample_distance) + 1;
+    voxel_occupied.assign(GRID_LENGTH_E * GRID_LENGTH_Z * n_distance_steps,
+                          false);
+  }
 
-  for (const auto& cloud : complete_cloud) {
+  const bool deduplicate = camera_frustums.size() == complete_cloud.size();
+  static thread_local std::vector<const CameraFrustum*> earlier_frustums;
+  earlier_frustums.clear();
+  for (size_t i = 0; i < complete_cloud.size(); i++) {
+    const pcl::PointCloud<pcl::PointXYZ>& cloud = complete_cloud[i];
+    // only cameras which delivered a cloud have seen the overlap
+    for (size_t j = 0; deduplicate && j < i; j++) {
+      if (camera_frustums[j].isValid() && !complete_cloud[j].empty()) {
+        earlier_frustums.push_back(&camera_frustums[j]);
+      }
+    }
     for (const pcl::PointXYZ& xyz : cloud) {
       // Check if the point is invalid
       if (!std::isnan(xyz.x) && !std::isnan(xyz.y) && !std::isnan(xyz.z)) {
         if (histogram_box.isPointWithinBox(xyz.x, xyz.y, xyz.z)) {
-          distance = (position - toEigen(xyz)).norm();
+          const Eigen::Vector3f p = toEigen(xyz);
+          distance = (position - p).norm();
           if (distance > min_realsense_dist &&
-              distance < histogram_box.radius_) {
-            cropped_cloud.points.push_back(pcl::PointXYZ(xyz.x, xyz.y, xyz.z));
+              distance < histogram_box.radius_ &&
+              std::none_of(earlier_frustums.begin(), earlier_frustums.end(),
+                           [&p](const CameraFrustum* f) {
+                             return f->contains(p);
+                           })) {
+            n_points++;
             if (distance < distance_to_closest_point) {
               distance_to_closest_point = distance;
-              closest_point = toEigen(xyz);
+              closest_point = p;
             }
             if (distance < min_dist_backoff) {
               counter_backoff++;
             }
+            bool keep_point = true;
+            if (bin_points) {
+              int e_ind, z_ind;
+              float bin_distance;
+              addPointToHistogram(*polar_histogram, p, histogram_position,
+                                  e_ind, z_ind, bin_distance);
+              if (downsample) {
+                int distance_step = std::min(
+                    static_cast<int>(bin_distance / downsample_distance),
+                    n_distance_steps - 1);
+                size_t voxel =
+                    (e_ind * GRID_LENGTH_Z + z_ind) * n_distance_steps +
+                    distance_step;
+                keep_point = !voxel_occupied[voxel];
+                voxel_occupied[voxel] = true;
+              }
+            }
+            if (keep_point) {
+              cropped_cloud.points.push_back(
+                  pcl::PointXYZ(xyz.x, xyz.y, xyz.z));
+            }
           }
         }
       }
     }
+    earlier_frustums.clear();
   }
 
-  cropped_cloud.header.stamp = complete_cloud[0].header.stamp;
-  cropped_cloud.header.frame_id = complete_cloud[0].header.frame_id;
+  if (!complete_cloud.empty()) {
+    cropped_cloud.header.stamp = complete_cloud[0].header.stamp;
+    cropped_cloud.header.frame_id = complete_cloud[0].header.frame_id;
+  }
   cropped_cloud.height = 1;
   cropped_cloud.width = cropped_cloud.points.size();
-  if (cropped_cloud.points.size() <= min_cloud_size) {
+  if (n_points <= min_cloud_size) {
     cropped_cloud.points.clear();
     cropped_cloud.width = 0;
+    n_points = 0;
+    if (bin_points) {
+      polar_histogram->setZero();
+    }
   }
+  return n_points;
+}
+
+// trim the point cloud so that only points inside the bounding box are
+// considered
+void filterPointCloud(
+    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud,
+    Eigen::Vector3f& closest_point, double& distance_to_closest_point,
+    int& counter_backoff,
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+    double min_cloud_size, double min_dist_backoff, Box histogram_box,
+    const Eigen::Vector3f& position, double min_realsense_dist) {
+  cropPointCloud<false>(cropped_cloud, nullptr, closest_point,
+                        distance_to_closest_point, counter_backoff,
+                        complete_cloud, min_cloud_size, min_dist_backoff,
+                        histogram_box, position, position, min_realsense_dist,
+                        0.0, std::vector<CameraFrustum>());
+}
+
+// trim the point cloud and build the histogram of the remaining points
+size_t filterPointCloud(
+    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud, Histogram& polar_histogram,
+    Eigen::Vector3f& closest_point, double& distance_to_closest_point,
+    int& counter_backoff,
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+    double min_cloud_size, double min_dist_backoff, const Box& histogram_box,
+    const Eigen::Vector3f& position, const Eigen::Vector3f& histogram_position,
+    double min_realsense_dist, double downsample_distance,
+    const std::vector<CameraFrustum>& camera_frustums) {
+  polar_histogram.setZero();
+  size_t n_points = cropPointCloud<true>(
+      cropped_cloud, &polar_histogram, closest_point, distance_to_closest_point,
+      counter_backoff, complete_cloud, min_cloud_size, min_dist_backoff,
+      histogram_box, position, histogram_position, min_realsense_dist,
+      downsample_distance, camera_frustums);
+  normalizeHistogram(polar_histogram);
+  return n_points;
 }
 
 // Calculate FOV. Azimuth angle is wrapped, elevation is not!
@@ -120,6 +269,19 @@ void calculateFOV(double h_fov, double v_fov, std::vector<int>& z_FOV_idx,
   }
 }
 
+void calculateFOV(double h_fov, double v_fov, std::vector<int>& z_FOV_idx,
+                  std::vector<bool>& z_FOV_mask, int& e_FOV_min,
+                  int& e_FOV_max, double yaw, double pitch) {
+  calculateFOV(h_fov, v_fov, z_FOV_idx, e_FOV_min, e_FOV_max, yaw, pitch);
+  z_FOV_mask.assign(GRID_LENGTH_Z, false);
+  for (int z : z_FOV_idx) {
+    // close to the wrap the indices can leave the grid, they match no cell
+    if (z >= 0 && z < GRID_LENGTH_Z) {
+      z_FOV_mask[z] = true;
+    }
+  }
+}
+
 // Build histogram estimate from reprojected points
 void propagateHistogram(
     Histogram& polar_histogram_est,
@@ -127,11 +289,11 @@ void propagateHistogram(
     const std::vector<double>& reprojected_points_age,
     const std::vector<double>& reprojected_points_dist,
     const geometry_msgs::PoseStamped& position) {
+  const Eigen::Vector3f origin = toEigen(position.pose.position);
   for (size_t i = 0; i < reprojected_points.points.size(); i++) {
-    float e_angle = elevationAnglefromCartesian(
-        toEigen(reprojected_points.points[i]), toEigen(position.pose.position));
-    float z_angle = azimuthAnglefromCartesian(
-        toEigen(reprojected_points.points[i]), toEigen(position.pose.position));
+    Eigen::Vector3f p = toEigen(reprojected_points.points[i]);
+    float e_angle = fastElevationAnglefromCartesian(p, origin);
+    float z_angle = fastAzimuthAnglefromCartesian(p, origin);
 
     int e_ind = elevationAngletoIndex(e_angle, 2 * ALPHA_RES);
     int z_ind = azimuthAngletoIndex(z_angle, 2 * ALPHA_RES);
@@ -171,46 +333,25 @@ void propagateHistogram(
 // Generate new histogram from pointcloud
 void generateNewHistogram(Histogram& polar_histogram,
                           const pcl::PointCloud<pcl::PointXYZ>& cropped_cloud,
-                          geometry_msgs::PoseStamped position) {
-  for (auto xyz : cropped_cloud) {
-    Eigen::Vector3f p = toEigen(xyz);
-    float dist = (p - toEigen(position.pose.position)).norm();
-    int e_angle =
-        elevationAnglefromCartesian(p, toEigen(position.pose.position));
-    int z_angle = azimuthAnglefromCartesian(p, toEigen(position.pose.position));
-
-    int e_ind = elevationAngletoIndex(e_angle, ALPHA_RES);
-    int z_ind = azimuthAngletoIndex(z_angle, ALPHA_RES);
-
-    polar_histogram.set_bin(e_ind, z_ind,
-                            polar_histogram.get_bin(e_ind, z_ind) + 1);
-    polar_histogram.set_dist(e_ind, z_ind,
-                             polar_histogram.get_dist(e_ind, z_ind) + dist);
+                          const geometry_msgs::PoseStamped& position) {
+  const Eigen::Vector3f origin = toEigen(position.pose.position);
+  for (const pcl::PointXYZ& xyz : cropped_cloud) {
+    addPointToHistogram(polar_histogram, toEigen(xyz), origin);
   }
 
-  // Normalize and get mean in distance bins
-  for (int e = 0; e < GRID_LENGTH_E; e++) {
-    for (int z = 0; z < GRID_LENGTH_Z; z++) {
-      if (polar_histogram.get_bin(e, z) > 0) {
-        polar_histogram.set_dist(e, z, polar_histogram.get_dist(e, z) /
-                                           polar_histogram.get_bin(e, z));
-        polar_histogram.set_bin(e, z, 1);
-      }
-    }
-  }
+  normalizeHistogram(polar_histogram);
 }
 
 // Combine propagated histogram and new histogram to the final binary histogram
 void combinedHistogram(bool& hist_empty, Histogram& new_hist,
                        const Histogram& propagated_hist,
                        bool waypoint_outside_FOV,
-                       const std::vector<int>& z_FOV_idx, int e_FOV_min,
+                       const std::vector<bool>& z_FOV_mask, int e_FOV_min,
                        int e_FOV_max) {
   hist_empty = true;
   for (int e = 0; e < GRID_LENGTH_E; e++) {
     for (int z = 0; z < GRID_LENGTH_Z; z++) {
-      if (std::find(z_FOV_idx.begin(), z_FOV_idx.end(), z) != z_FOV_idx.end() &&
-          e > e_FOV_min && e < e_FOV_max) {  // inside FOV
+      if (z_FOV_mask[z] && e > e_FOV_min && e < e_FOV_max) {  // inside FOV
         if (new_hist.get_bin(e, z) > 0) {
           new_hist.set_age(e, z, 1);
           hist_empty = false;
@@ -238,57 +379,56 @@ void combinedHistogram(bool& hist_empty, Histogram& new_hist,
 }
 
 // costfunction for every free histogram cell
-double costFunction(int e, int z, nav_msgs::GridCells& path_waypoints,
-                    const Eigen::Vector3f& goal,
-                    const Eigen::Vector3f& position,
-                    const Eigen::Vector3f& position_old, double goal_cost_param,
-                    double smooth_cost_param,
-                    double height_change_cost_param_adapted,
-                    double height_change_cost_param, bool only_yawed) {
-  double cost;
-  int waypoint_index = path_waypoints.cells.size() - 1;
-  if (waypoint_index < 0) {
-    waypoint_index = 0;
-    path_waypoints.cells.push_back(toPoint(position_old));
-  }
-
+void costFunction(std::vector<candidateDirection>& candidates,
+                  const nav_msgs::GridCells& path_waypoints,
+                  const Eigen::Vector3f& goal, const Eigen::Vector3f& position,
+                  const Eigen::Vector3f& position_old, double goal_cost_param,
+                  double smooth_cost_param,
+                  double height_change_cost_param_adapted,
+                  double height_change_cost_param, bool only_yawed) {
+  // terms which don't depend on the candidate
   double dist = (position - goal).norm();
   double dist_old = (position_old - goal).norm();
-  Eigen::Vector3f candidate_goal =
-      fromPolarToCartesian(e, z, dist, toPoint(position));
-  Eigen::Vector3f old_candidate_goal =
-      fromPolarToCartesian(path_waypoints.cells[waypoint_index - 1].x,
-                           path_waypoints.cells[waypoint_index - 1].y, dist_old,
-                           toPoint(position_old));
-  double yaw_cost = goal_cost_param *
-                    (goal.topRows<2>() - candidate_goal.topRows<2>()).norm();
-
-  double pitch_cost_up = 0.0;
-  double pitch_cost_down = 0.0;
-  if (candidate_goal.z() > goal.z()) {
-    pitch_cost_up = goal_cost_param * std::abs(goal.z() - candidate_goal.z());
-  } else {
-    pitch_cost_down = goal_cost_param * std::abs(goal.z() - candidate_goal.z());
-  }
+  const geometry_msgs::Point position_point = toPoint(position);
+  // direction of the previous waypoint, or of the only one if there is none
+  const int n_waypoints = path_waypoints.cells.size();
+  const geometry_msgs::Point old_waypoint =
+      n_waypoints == 0 ? toPoint(position_old)
+                       : path_waypoints.cells[std::max(n_waypoints - 2, 0)];
+  const Eigen::Vector3f old_candidate_goal = fromPolarToCartesian(
+      old_waypoint.x, old_waypoint.y, dist_old, toPoint(position_old));
+  const double smooth_weight = only_yawed ? 0.5 : 1.0;
+
+  for (candidateDirection& candidate : candidates) {
+    Eigen::Vector3f candidate_goal = fromPolarToCartesian(
+        static_cast<int>(candidate.elevation_angle),
+        static_cast<int>(candidate.azimuth_angle), dist, position_point);
+    double yaw_cost = goal_cost_param *
+                      (goal.topRows<2>() - candidate_goal.topRows<2>()).norm();
+
+    double pitch_cost_up = 0.0;
+    double pitch_cost_down = 0.0;
+    if (candidate_goal.z() > goal.z()) {
+      pitch_cost_up = goal_cost_param * std::abs(goal.z() - candidate_goal.z());
+    } else {
+      pitch_cost_down =
+          goal_cost_param * std::abs(goal.z() - candidate_goal.z());
+    }
 
-  double yaw_cost_smooth =
-      smooth_cost_param *
-      (old_candidate_goal.topRows<2>() - candidate_goal.topRows<2>()).norm();
+    double yaw_cost_smooth =
+        smooth_cost_param *
+        (old_candidate_goal.topRows<2>() - candidate_goal.topRows<2>()).norm();
 
-  double pitch_cost_smooth =
-      smooth_cost_param * std::abs(old_candidate_goal.z() - candidate_goal.z());
+    double pitch_cost_smooth =
+        smooth_cost_param *
+        std::abs(old_candidate_goal.z() - candidate_goal.z());
 
-  if (!only_yawed) {
-    cost = yaw_cost + height_change_cost_param_adapted * pitch_cost_up +
-           height_change_cost_param * pitch_cost_down + yaw_cost_smooth +
-           pitch_cost_smooth;
-  } else {
-    cost = yaw_cost + height_change_cost_param_adapted * pitch_cost_up +
-           height_change_cost_param * pitch_cost_down + 0.5 * yaw_cost_smooth +
-           0.5 * pitch_cost_smooth;
+    candidate.cost = yaw_cost +
+                     height_change_cost_param_adapted * pitch_cost_up +
+                     height_change_cost_param * pitch_cost_down +
+                     smooth_weight * yaw_cost_smooth +
+                     smooth_weight * pitch_cost_smooth;
   }
-
-  return cost;
 }
 
 void compressHistogramElevation(Histogram& new_hist,
@@ -311,101 +451,199 @@ void compressHistogramElevation(Histogram& new_hist,
   }
 }
 
+void addObstacleDistances(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                          const Eigen::Vector3f& position, float min_dist,
+                          float max_dist, std::vector<float>& ranges) {
+  // the elevation band of compressHistogramElevation
+  const int lower_index = elevationAngletoIndex(-10.f, ALPHA_RES);
+  const int upper_index = elevationAngletoIndex(10.f, ALPHA_RES);
+  for (const pcl::PointXYZ& xyz : cloud) {
+    if (std::isnan(xyz.x) || std::isnan(xyz.y) || std::isnan(xyz.z)) {
+      continue;
+    }
+    const Eigen::Vector3f p = toEigen(xyz);
+    float dist = (p - position).norm();
+    if (dist <= min_dist || dist >= max_dist) {
+      continue;
+    }
+    int e_ind = elevationAngletoIndex(
+        fastElevationAnglefromCartesian(p, position), ALPHA_RES);
+    if (e_ind < lower_index || e_ind > upper_index) {
+      continue;
+    }
+    int z_ind = azimuthAngletoIndex(fastAzimuthAnglefromCartesian(p, position),
+                                    ALPHA_RES);
+    ranges[z_ind] = std::min(ranges[z_ind], dist);
+  }
+}
+
+void compressHistogram(const Histogram& histogram, float max_dist,
+                       std::vector<uint8_t>& data) {
+  const int n_cells = GRID_LENGTH_E * GRID_LENGTH_Z;
+  const int mask_bytes = (n_cells + 7) / 8;
+  data.assign(mask_bytes, 0);
+  data.reserve(mask_bytes + n_cells);
+
+  int cell = 0;
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++, cell++) {
+      if (histogram.get_bin(e, z) != 0) {
+        data[cell / 8] |= 1 << (cell % 8);
+        float dist = histogram.get_dist(e, z) / max_dist * 255.f;
+        data.push_back(static_cast<uint8_t>(
+            std::max(0.f, std::min(255.f, std::round(dist)))));
+      }
+    }
+  }
+}
+
+void rangesToObstacleDistanceMsg(const std::vector<float>& ranges,
+                                 const std::vector<bool>& z_FOV_mask,
+                                 sensor_msgs::LaserScan& msg) {
+  msg.header.stamp = ros::Time::now();
+  msg.header.frame_id = "local_origin";
+  msg.angle_increment = ALPHA_RES * M_PI / 180.0f;
+  msg.range_min = 0.2f;
+  msg.range_max = 20.0f;
+  msg.ranges.clear();
+
+  // turn idxs 180 degress to point to local north instead of south
+  for (int idx = 0; idx < GRID_LENGTH_Z; idx++) {
+    int hist_idx = idx - GRID_LENGTH_Z / 2;
+
+    if (hist_idx < 0) {
+      hist_idx = hist_idx + GRID_LENGTH_Z;
+    }
+
+    if (!z_FOV_mask[hist_idx]) {
+      msg.ranges.push_back(UINT16_MAX);
+    } else if (ranges[hist_idx] > msg.range_max) {
+      msg.ranges.push_back(msg.range_max + 1.0f);
+    } else {
+      msg.ranges.push_back(ranges[hist_idx]);
+    }
+  }
+}
+
+// map a cell of the moving window to the histogram cell it refers to. Returns
+// false for cells outside the histogram in both elevation and azimuth.
+bool mapWindowCell(int i, int j, int e_dim, int z_dim, int resolution_alpha,
+                   int& a, int& b) {
+  // Elevation index < 0
+  if (i < 0 && j >= 0 && j < z_dim) {
+    a = 0;
+    b = j + (180 / resolution_alpha) - 1;
+    if (b >= z_dim) {
+      b = b % (z_dim - 1);
+    }
+  }
+  // Azimuth index < 0
+  else if (j < 0 && i >= 0 && i < e_dim) {
+    b = j + z_dim;
+    a = i;
+  }
+  // Elevation index > e_dim
+  else if (i >= e_dim && j >= 0 && j < z_dim) {
+    a = e_dim - (i % (e_dim - 1));
+    b = j + (180 / resolution_alpha) - 1;
+    if (b >= z_dim) {
+      b = b % (z_dim - 1);
+    }
+  }
+  // Azimuth index > z_dim
+  else if (j >= z_dim && i >= 0 && i < e_dim) {
+    b = j - z_dim;
+    a = i;
+  }
+  // Elevation and Azimuth index both within histogram
+  else if (i >= 0 && i < e_dim && j >= 0 && j < z_dim) {
+    a = i;
+    b = j;
+  }
+  // Elevation and azimuth index both < 0 OR elevation index >
+  // e_dim and azimuth index <> z_dim OR elevation index < 0 and
+  // azimuth index > z_dim OR elevation index > e_dim and azimuth index
+  // < 0. These cells are not part of the polar histogram.
+  else {
+    return false;
+  }
+  return true;
+}
+
 // search for free directions in the 2D polar histogram with a moving window
 // approach
-void findFreeDirections(
+// findFreeDirections for a resolution known at compile time, such that the
+// loops over the histogram have constant bounds. RESOLUTION 0 takes the
+// resolution at runtime.
+template <int RESOLUTION>
+static void findFreeDirectionsAtResolution(
     const Histogram& histogram, double safety_radius,
-    nav_msgs::GridCells& path_candidates, nav_msgs::GridCells& path_selected,
-    nav_msgs::GridCells& path_rejected, nav_msgs::GridCells& path_blocked,
-    nav_msgs::GridCells& path_waypoints,
-    std::vector<float>& cost_path_candidates, const Eigen::Vector3f& goal,
+    std::vector<candidateDirection>& candidates,
+    nav_msgs::GridCells& path_selected, nav_msgs::GridCells& path_rejected,
+    nav_msgs::GridCells& path_blocked,
+    const nav_msgs::GridCells& path_waypoints, const Eigen::Vector3f& goal,
     const Eigen::Vector3f& position, const Eigen::Vector3f& position_old,
     double goal_cost_param, double smooth_cost_param,
     double height_change_cost_param_adapted, double height_change_cost_param,
-    bool only_yawed, int resolution_alpha) {
+    bool only_yawed, int runtime_resolution) {
+  const int resolution_alpha =
+      RESOLUTION > 0 ? RESOLUTION : runtime_resolution;
+  const int z_dim = 360 / resolution_alpha;
+  const int e_dim = 180 / resolution_alpha;
   int n = floor(safety_radius / resolution_alpha);  // safety radius
-  int z_dim = 360 / resolution_alpha;
-  int e_dim = 180 / resolution_alpha;
   int a = 0, b = 0;
-  bool free = true;
-  bool corner = false;
   geometry_msgs::Point p;
-  cost_path_candidates.clear();
+  candidates.clear();
 
-  initGridCells(path_candidates);
   initGridCells(path_rejected);
   initGridCells(path_blocked);
   initGridCells(path_selected);
 
+  // occupancy of the cells, read from the bins in one pass
+  const float* bins = histogram.bins();
+  std::vector<int> occupied(e_dim * z_dim);
+  for (int i = 0; i < e_dim * z_dim; i++) {
+    occupied[i] = bins[i] != 0.f;
+  }
+
+  // summed area table of the occupancy of the histogram padded by n cells on
+  // each side, where the padding follows the wrapping rules of mapWindowCell.
+  // The window around a cell is then free if its sum is zero.
+  const int width = z_dim + 2 * n + 1;
+  std::vector<int> occupied_sum((e_dim + 2 * n + 1) * width, 0);
+  for (int i = -n; i < e_dim + n; i++) {
+    const bool inside_e = i >= 0 && i < e_dim;
+    for (int j = -n; j < z_dim + n; j++) {
+      int cell_occupied = 0;
+      if (inside_e && j >= 0 && j < z_dim) {
+        cell_occupied = occupied[i * z_dim + j];
+      } else if (mapWindowCell(i, j, e_dim, z_dim, resolution_alpha, a, b)) {
+        cell_occupied = occupied[a * z_dim + b];
+      }
+      int row = i + n + 1, col = j + n + 1;
+      occupied_sum[row * width + col] =
+          cell_occupied + occupied_sum[(row - 1) * width + col] +
+          occupied_sum[row * width + col - 1] -
+          occupied_sum[(row - 1) * width + col - 1];
+    }
+  }
+
   // determine which bins are candidates
   for (int e = 0; e < e_dim; e++) {
     for (int z = 0; z < z_dim; z++) {
-      for (int i = (e - n); i <= (e + n); i++) {
-        for (int j = (z - n); j <= (z + n); j++) {
-          free = true;
-          corner = false;
-
-          // Elevation index < 0
-          if (i < 0 && j >= 0 && j < z_dim) {
-            a = 0;
-            b = j + (180 / resolution_alpha) - 1;
-            if (b >= z_dim) {
-              b = b % (z_dim - 1);
-            }
-          }
-          // Azimuth index < 0
-          else if (j < 0 && i >= 0 && i < e_dim) {
-            b = j + z_dim;
-            a = i;
-          }
-          // Elevation index > e_dim
-          else if (i >= e_dim && j >= 0 && j < z_dim) {
-            a = e_dim - (i % (e_dim - 1));
-            b = j + (180 / resolution_alpha) - 1;
-            if (b >= z_dim) {
-              b = b % (z_dim - 1);
-            };
-          }
-          // Azimuth index > z_dim
-          else if (j >= z_dim && i >= 0 && i < e_dim) {
-            b = j - z_dim;
-          }
-          // Elevation and Azimuth index both within histogram
-          else if (i >= 0 && i < e_dim && j >= 0 && j < z_dim) {
-            a = i;
-            b = j;
-          }
-          // Elevation and azimuth index both < 0 OR elevation index >
-          // e_dim and azimuth index <> z_dim OR elevation index < 0 and
-          // azimuth index > z_dim OR elevation index > e_dim and azimuth index
-          // < 0. These cells are not part of the polar histogram.
-          else {
-            corner = true;
-          }
-
-          if (!corner) {
-            if (histogram.get_bin(a, b) != 0) {
-              free = false;
-              break;
-            }
-          }
-        }
-
-        if (!free) break;
-      }
+      // window rows e - n .. e + n and columns z - n .. z + n
+      int top = e, bottom = e + 2 * n + 1;
+      int left = z, right = z + 2 * n + 1;
+      int n_occupied = occupied_sum[bottom * width + right] -
+                       occupied_sum[top * width + right] -
+                       occupied_sum[bottom * width + left] +
+                       occupied_sum[top * width + left];
+      bool free = n_occupied == 0;
 
       if (free) {
-        p.x = elevationIndexToAngle(e, resolution_alpha);
-        p.y = azimuthIndexToAngle(z, resolution_alpha);
-        p.z = 0.0;
-        path_candidates.cells.push_back(p);
-        double cost =
-            costFunction((int)p.x, (int)p.y, path_waypoints, goal, position,
-                         position_old, goal_cost_param, smooth_cost_param,
-                         height_change_cost_param_adapted,
-                         height_change_cost_param, only_yawed);
-        cost_path_candidates.push_back(cost);
-      } else if (!free && histogram.get_bin(e, z) != 0) {
+        candidates.emplace_back(0.f, elevationIndexToAngle(e, resolution_alpha),
+                                azimuthIndexToAngle(z, resolution_alpha));
+      } else if (!free && occupied[e * z_dim + z]) {
         p.x = elevationIndexToAngle(e, resolution_alpha);
         p.y = azimuthIndexToAngle(z, resolution_alpha);
         p.z = 0.0;
@@ -418,29 +656,72 @@ void findFreeDirections(
       }
     }
   }
+
+  costFunction(candidates, path_waypoints, goal, position, position_old,
+               goal_cost_param, smooth_cost_param,
+               height_change_cost_param_adapted, height_change_cost_param,
+               only_yawed);
+}
+
+// the planner histogram has ALPHA_RES, the histograms of the tree nodes have
+// 2 * ALPHA_RES, other resolutions take the generic version
+void findFreeDirections(
+    const Histogram& histogram, double safety_radius,
+    std::vector<candidateDirection>& candidates,
+    nav_msgs::GridCells& path_selected, nav_msgs::GridCells& path_rejected,
+    nav_msgs::GridCells& path_blocked,
+    const nav_msgs::GridCells& path_waypoints, const Eigen::Vector3f& goal,
+    const Eigen::Vector3f& position, const Eigen::Vector3f& position_old,
+    double goal_cost_param, double smooth_cost_param,
+    double height_change_cost_param_adapted, double height_change_cost_param,
+    bool only_yawed, int resolution_alpha) {
+  auto find = &findFreeDirectionsAtResolution<0>;
+  if (resolution_alpha == ALPHA_RES) {
+    find = &findFreeDirectionsAtResolution<ALPHA_RES>;
+  } else if (resolution_alpha == 2 * ALPHA_RES) {
+    find = &findFreeDirectionsAtResolution<2 * ALPHA_RES>;
+  }
+  find(histogram, safety_radius, candidates, path_selected, path_rejected,
+       path_blocked, path_waypoints, goal, position, position_old,
+       goal_cost_param, smooth_cost_param, height_change_cost_param_adapted,
+       height_change_cost_param, only_yawed, resolution_alpha);
+}
+
+void CandidateOrder::reset(const std::vector<candidateDirection>& candidates) {
+  heap_.clear();
+  heap_.reserve(candidates.size());
+  for (size_t i = 0; i < candidates.size(); i++) {
+    heap_.emplace_back(candidates[i].cost, i);
+  }
+  std::make_heap(heap_.begin(), heap_.end(),
+                 std::greater<std::pair<float, int>>());
+  n_sorted_ = 0;
 }
 
-// calculate the free direction which has the smallest cost for the UAV to
-// travel to
-bool calculateCostMap(const std::vector<float>& cost_path_candidates,
-                      std::vector<int>& cost_idx_sorted) {
-  if (cost_path_candidates.empty()) {
+int CandidateOrder::at(size_t i) {
+  // pop from the heap into its back until the i-th best candidate is known
+  while (n_sorted_ <= i) {
+    std::pop_heap(heap_.begin(), heap_.end() - n_sorted_,
+                  std::greater<std::pair<float, int>>());
+    n_sorted_++;
+  }
+  return heap_[heap_.size() - 1 - i].second;
+}
+
+// order the free directions by the cost for the UAV to travel to them
+bool calculateCostMap(const std::vector<candidateDirection>& candidates,
+                      CandidateOrder& cost_order) {
+  if (candidates.empty()) {
     ROS_WARN("\033[1;31mbold Empty candidates vector!\033[0m\n");
     return 1;
   } else {
-    cost_idx_sorted.resize(cost_path_candidates.size());
-    std::iota(cost_idx_sorted.begin(), cost_idx_sorted.end(), 0);
-
-    std::sort(cost_idx_sorted.begin(), cost_idx_sorted.end(),
-              [&cost_path_candidates](size_t i1, size_t i2) {
-                return cost_path_candidates[i1] < cost_path_candidates[i2];
-              });
+    cost_order.reset(candidates);
     return 0;
   }
 }
 
-void printHistogram(Histogram hist, std::vector<int> z_FOV_idx, int e_FOV_min,
-                    int e_FOV_max, int e_chosen, int z_chosen,
+void printHistogram(const Histogram& hist, const std::vector<int>& z_FOV_idx,
+                    int e_FOV_min, int e_FOV_max, int e_chosen, int z_chosen,
                     double resolution) {
   int z_dim = 360 / resolution;
   int e_dim = 180 / resolution;
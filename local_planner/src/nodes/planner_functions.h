@@ -14,12 +14,84 @@
 
 #include <nav_msgs/GridCells.h>
 #include <nav_msgs/Path.h>
+#include <sensor_msgs/LaserScan.h>
 
+#include <cmath>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace avoidance {
 
+// free direction of travel, given by the angles of its histogram cell, and
+// the cost of flying into it
+struct candidateDirection {
+  float cost;
+  float elevation_angle;  // [deg]
+  float azimuth_angle;    // [deg]
+
+  candidateDirection(float cost, float elevation_angle, float azimuth_angle)
+      : cost(cost),
+        elevation_angle(elevation_angle),
+        azimuth_angle(azimuth_angle) {}
+};
+
+/**
+* @brief Viewing frustum of a depth camera in /local_origin. Where the
+*        frustums of several cameras overlap, their clouds contain the same
+*        obstacles and the points of all but the first camera are redundant
+**/
+struct CameraFrustum {
+  Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+  // columns are the axes of the optical frame: x right, y down, z forward
+  Eigen::Matrix3f rotation = Eigen::Matrix3f::Identity();
+  float tan_half_h_fov = 0.f;  // 0 until the camera info has been received
+  float tan_half_v_fov = 0.f;
+  bool has_pose = false;
+
+  bool isValid() const {
+    return has_pose && tan_half_h_fov > 0.f && tan_half_v_fov > 0.f;
+  }
+  bool contains(const Eigen::Vector3f& p) const {
+    const Eigen::Vector3f c = rotation.transpose() * (p - origin);
+    return c.z() > 0.f && std::abs(c.x()) < tan_half_h_fov * c.z() &&
+           std::abs(c.y()) < tan_half_v_fov * c.z();
+  }
+};
+
+/**
+* @brief Order of the candidate directions by increasing cost, ties broken by
+*        the index of the candidate. It is only established as far as it is
+*        read, such that taking the k best of n candidates costs
+*        O(n + k log n) instead of a full sort
+**/
+class CandidateOrder {
+  // (cost, index) min-heap in the front, the extracted best candidates in
+  // the back with the best one last
+  std::vector<std::pair<float, int>> heap_;
+  size_t n_sorted_ = 0;
+
+ public:
+  /**
+  * @brief     Starts a new order of the candidates, reusing the storage
+  **/
+  void reset(const std::vector<candidateDirection>& candidates);
+  size_t size() const { return heap_.size(); }
+  bool empty() const { return heap_.empty(); }
+
+  /**
+  * @brief     Returns the index of the candidate with the i-th lowest cost,
+  *            i < size()
+  **/
+  int at(size_t i);
+};
+
 void initGridCells(nav_msgs::GridCells& cell);
+/**
+* @brief     Converts candidate directions to grid cells for visualization
+**/
+void candidatesToGridCells(const std::vector<candidateDirection>& candidates,
+                           nav_msgs::GridCells& path_candidates);
 double adaptSafetyMarginHistogram(double dist_to_closest_point,
                                   double cloud_size, double min_cloud_size);
 void filterPointCloud(
@@ -29,8 +101,41 @@ void filterPointCloud(
     const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
     double min_cloud_size, double min_dist_backoff, Box histogram_box,
     const Eigen::Vector3f& position, double min_realsense_dist);
+/**
+* @brief     Crops the point clouds like filterPointCloud and bins the cropped
+*            points into polar_histogram in the same pass
+* @param[in] histogram_position origin of the polar histogram
+* @param[in] downsample_distance if positive, only one point per histogram bin
+*            and distance interval of this length is kept in cropped_cloud.
+*            The histogram, the closest point and the backoff counter still
+*            account for all points
+* @param[in] camera_frustums if there is one valid frustum per cloud of
+*            complete_cloud, the points of a cloud which lie in the frustum of
+*            an earlier non-empty cloud are dropped as duplicates
+* @returns   number of points in the box before downsampling, 0 if the cloud
+*            was discarded for being smaller than min_cloud_size
+**/
+size_t filterPointCloud(
+    pcl::PointCloud<pcl::PointXYZ>& cropped_cloud, Histogram& polar_histogram,
+    Eigen::Vector3f& closest_point, double& distance_to_closest_point,
+    int& counter_backoff,
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+    double min_cloud_size, double min_dist_backoff, const Box& histogram_box,
+    const Eigen::Vector3f& position, const Eigen::Vector3f& histogram_position,
+    double min_realsense_dist, double downsample_distance,
+    const std::vector<CameraFrustum>& camera_frustums =
+        std::vector<CameraFrustum>());
 void calculateFOV(double h_FOV, double v_FOV, std::vector<int>& z_FOV_idx,
                   int& e_FOV_min, int& e_FOV_max, double yaw, double pitch);
+/**
+* @brief     Calculates the FOV like above and additionally marks its azimuth
+*            indices, such that testing if a cell is inside is O(1)
+* @param[out] z_FOV_mask GRID_LENGTH_Z entries, true for the indices in
+*             z_FOV_idx
+**/
+void calculateFOV(double h_FOV, double v_FOV, std::vector<int>& z_FOV_idx,
+                  std::vector<bool>& z_FOV_mask, int& e_FOV_min,
+                  int& e_FOV_max, double yaw, double pitch);
 void propagateHistogram(
     Histogram& polar_histogram_est,
     const pcl::PointCloud<pcl::PointXYZ>& reprojected_points,
@@ -39,36 +144,73 @@ void propagateHistogram(
     const geometry_msgs::PoseStamped& position);
 void generateNewHistogram(Histogram& polar_histogram,
                           const pcl::PointCloud<pcl::PointXYZ>& cropped_cloud,
-                          geometry_msgs::PoseStamped position);
+                          const geometry_msgs::PoseStamped& position);
 void combinedHistogram(bool& hist_empty, Histogram& new_hist,
                        const Histogram& propagated_hist,
                        bool waypoint_outside_FOV,
-                       const std::vector<int>& z_FOV_idx, int e_FOV_min,
+                       const std::vector<bool>& z_FOV_mask, int e_FOV_min,
                        int e_FOV_max);
 void compressHistogramElevation(Histogram& new_hist,
                                 const Histogram& input_hist);
-double costFunction(int e, int z, nav_msgs::GridCells& path_waypoints,
-                    const Eigen::Vector3f& goal,
-                    const Eigen::Vector3f& position,
-                    const Eigen::Vector3f& position_old, double goal_cost_param,
-                    double smooth_cost_param,
-                    double height_change_cost_param_adapted,
-                    double height_change_cost_param, bool only_yawed);
+/**
+* @brief     Lowers the range of each azimuth sector to the distance of the
+*            closest point within +-10 degrees elevation of position, the
+*            obstacle distance of the FCU. Goes straight from the points to
+*            the sectors without building a histogram
+* @param[in] min_dist, max_dist points outside of this distance are ignored
+* @param[in,out] ranges GRID_LENGTH_Z ranges indexed like the azimuth of the
+*            histogram, initialized with infinity. Several clouds can be
+*            added in turn
+**/
+void addObstacleDistances(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                          const Eigen::Vector3f& position, float min_dist,
+                          float max_dist, std::vector<float>& ranges);
+/**
+* @brief     Fills the obstacle distance message of the FCU with the ranges of
+*            addObstacleDistances, starting at local north. The sectors
+*            outside of z_FOV_mask are unknown, the ones without obstacles
+*            beyond range_max
+**/
+void rangesToObstacleDistanceMsg(const std::vector<float>& ranges,
+                                 const std::vector<bool>& z_FOV_mask,
+                                 sensor_msgs::LaserScan& msg);
+/**
+* @brief     Encodes the histogram compactly for a link with a low bandwidth.
+*            A bitmask of the occupied cells in row-major [e][z] order, the
+*            lowest bit first, is followed by one byte per occupied cell in the
+*            same order with its distance quantized to 0..255 over max_dist
+* @param[out] data encoding, the buffer is reused
+**/
+void compressHistogram(const Histogram& histogram, float max_dist,
+                       std::vector<uint8_t>& data);
+/**
+* @brief     Sets the cost of all candidate directions. The terms which are
+*            the same for all candidates are only computed once.
+* @param[in] path_waypoints previous waypoints, the smoothness cost is relative
+*            to the direction of the second to last one
+**/
+void costFunction(std::vector<candidateDirection>& candidates,
+                  const nav_msgs::GridCells& path_waypoints,
+                  const Eigen::Vector3f& goal, const Eigen::Vector3f& position,
+                  const Eigen::Vector3f& position_old, double goal_cost_param,
+                  double smooth_cost_param,
+                  double height_change_cost_param_adapted,
+                  double height_change_cost_param, bool only_yawed);
 void findFreeDirections(
     const Histogram& histogram, double safety_radius,
-    nav_msgs::GridCells& path_candidates, nav_msgs::GridCells& path_selected,
-    nav_msgs::GridCells& path_rejected, nav_msgs::GridCells& path_blocked,
-    nav_msgs::GridCells& path_waypoints,
-    std::vector<float>& cost_path_candidates, const Eigen::Vector3f& goal,
+    std::vector<candidateDirection>& candidates,
+    nav_msgs::GridCells& path_selected, nav_msgs::GridCells& path_rejected,
+    nav_msgs::GridCells& path_blocked,
+    const nav_msgs::GridCells& path_waypoints, const Eigen::Vector3f& goal,
     const Eigen::Vector3f& position, const Eigen::Vector3f& position_old,
     double goal_cost_param, double smooth_cost_param,
     double height_change_cost_param_adapted, double height_change_cost_param,
     bool only_yawed, int resolution_alpha);
-void printHistogram(Histogram hist, std::vector<int> z_FOV_idx, int e_FOV_min,
-                    int e_FOV_max, int e_chosen, int z_chosen,
+void printHistogram(const Histogram& hist, const std::vector<int>& z_FOV_idx,
+                    int e_FOV_min, int e_FOV_max, int e_chosen, int z_chosen,
                     double resolution);
-bool calculateCostMap(const std::vector<float>& cost_path_candidates,
-                      std::vector<int>& cost_idx_sorted);
+bool calculateCostMap(const std::vector<candidateDirection>& candidates,
+                      CandidateOrder& cost_order);
 bool getDirectionFromTree(
     Eigen::Vector3f& p,
     const std::vector<geometry_msgs::Point>& path_node_positions,
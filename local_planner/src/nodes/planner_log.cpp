@@ -0,0 +1,533 @@
+#include "planner_log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace avoidance {
+
+namespace {
+
+const char log_magic[8] = {'A', 'V', 'O', 'I', 'D', 'L', 'O', 'G'};
+const uint32_t log_version = 1;
+
+// appends the values to the payload of a record
+class RecordWriter {
+  std::vector<char>& buffer_;
+
+ public:
+  explicit RecordWriter(std::vector<char>& buffer) : buffer_(buffer) {
+    buffer_.clear();
+  }
+
+  template <typename T>
+  void put(const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+  }
+  void put(bool value) { put(static_cast<uint8_t>(value)); }
+  void put(const std::string& value) {
+    put(static_cast<uint32_t>(value.size()));
+    buffer_.insert(buffer_.end(), value.begin(), value.end());
+  }
+  void put(const ros::Time& time) { put(time.toNSec()); }
+  void put(const geometry_msgs::Point& p) {
+    put(p.x);
+    put(p.y);
+    put(p.z);
+  }
+  void put(const geometry_msgs::PoseStamped& pose) {
+    put(pose.header.stamp);
+    put(pose.header.frame_id);
+    put(pose.pose.position);
+    put(pose.pose.orientation.x);
+    put(pose.pose.orientation.y);
+    put(pose.pose.orientation.z);
+    put(pose.pose.orientation.w);
+  }
+  void put(const geometry_msgs::TwistStamped& vel) {
+    put(vel.header.stamp);
+    put(vel.header.frame_id);
+    put(vel.twist.linear.x);
+    put(vel.twist.linear.y);
+    put(vel.twist.linear.z);
+    put(vel.twist.angular.x);
+    put(vel.twist.angular.y);
+    put(vel.twist.angular.z);
+  }
+  void put(const pcl::PointCloud<pcl::PointXYZ>& cloud) {
+    put(static_cast<uint64_t>(cloud.header.stamp));
+    put(cloud.header.frame_id);
+    put(static_cast<uint32_t>(cloud.points.size()));
+    size_t offset = buffer_.size();
+    buffer_.resize(offset + 3 * sizeof(float) * cloud.points.size());
+    char* out = &buffer_[offset];
+    for (const pcl::PointXYZ& xyz : cloud) {
+      const float p[3] = {xyz.x, xyz.y, xyz.z};
+      std::memcpy(out, p, sizeof(p));
+      out += sizeof(p);
+    }
+  }
+  void put(const CameraFrustum& frustum) {
+    for (int i = 0; i < 3; i++) {
+      put(frustum.origin[i]);
+    }
+    for (int i = 0; i < 9; i++) {
+      put(frustum.rotation.data()[i]);
+    }
+    put(frustum.tan_half_h_fov);
+    put(frustum.tan_half_v_fov);
+    put(frustum.has_pose);
+  }
+};
+
+// reads the values of a record, ok() turns false if it is too short
+class RecordReader {
+  const char* data_;
+  const char* end_;
+  bool ok_ = true;
+
+ public:
+  RecordReader(const char* data, size_t size)
+      : data_(data), end_(data + size) {}
+
+  bool ok() const { return ok_; }
+  bool atEnd() const { return data_ == end_; }
+
+  // returns a pointer to the next n bytes or nullptr if there are less
+  const char* take(size_t n) {
+    if (!ok_ || static_cast<size_t>(end_ - data_) < n) {
+      ok_ = false;
+      return nullptr;
+    }
+    const char* bytes = data_;
+    data_ += n;
+    return bytes;
+  }
+
+  // reads the number of the following elements, which take at least
+  // min_size bytes each. If the rest of the record can't hold them, ok()
+  // turns false and n is 0, so a corrupt count isn't allocated
+  void getCount(uint32_t& n, size_t min_size) {
+    get(n);
+    if (!ok_ || static_cast<size_t>(end_ - data_) / min_size < n) {
+      ok_ = false;
+      n = 0;
+    }
+  }
+
+  template <typename T>
+  void get(T& value) {
+    const char* bytes = take(sizeof(T));
+    if (bytes) {
+      std::memcpy(&value, bytes, sizeof(T));
+    }
+  }
+  void get(bool& value) {
+    uint8_t byte = 0;
+    get(byte);
+    value = byte != 0;
+  }
+  void get(std::string& value) {
+    uint32_t size = 0;
+    get(size);
+    const char* bytes = take(size);
+    if (bytes) {
+      value.assign(bytes, size);
+    }
+  }
+  void get(ros::Time& time) {
+    uint64_t nsec = 0;
+    get(nsec);
+    time.fromNSec(nsec);
+  }
+  void get(geometry_msgs::Point& p) {
+    get(p.x);
+    get(p.y);
+    get(p.z);
+  }
+  void get(geometry_msgs::PoseStamped& pose) {
+    get(pose.header.stamp);
+    get(pose.header.frame_id);
+    get(pose.pose.position);
+    get(pose.pose.orientation.x);
+    get(pose.pose.orientation.y);
+    get(pose.pose.orientation.z);
+    get(pose.pose.orientation.w);
+  }
+  void get(geometry_msgs::TwistStamped& vel) {
+    get(vel.header.stamp);
+    get(vel.header.frame_id);
+    get(vel.twist.linear.x);
+    get(vel.twist.linear.y);
+    get(vel.twist.linear.z);
+    get(vel.twist.angular.x);
+    get(vel.twist.angular.y);
+    get(vel.twist.angular.z);
+  }
+  void get(pcl::PointCloud<pcl::PointXYZ>& cloud) {
+    uint64_t stamp = 0;
+    uint32_t n_points = 0;
+    get(stamp);
+    get(cloud.header.frame_id);
+    get(n_points);
+    cloud.header.stamp = stamp;
+    cloud.points.clear();
+    const char* bytes = take(3 * sizeof(float) * size_t(n_points));
+    if (bytes) {
+      cloud.points.reserve(n_points);
+      for (uint32_t i = 0; i < n_points; i++) {
+        float p[3];
+        std::memcpy(p, bytes + i * sizeof(p), sizeof(p));
+        cloud.points.push_back(pcl::PointXYZ(p[0], p[1], p[2]));
+      }
+    }
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+  }
+  void get(CameraFrustum& frustum) {
+    for (int i = 0; i < 3; i++) {
+      get(frustum.origin[i]);
+    }
+    for (int i = 0; i < 9; i++) {
+      get(frustum.rotation.data()[i]);
+    }
+    get(frustum.tan_half_h_fov);
+    get(frustum.tan_half_v_fov);
+    get(frustum.has_pose);
+  }
+};
+
+bool samePoint(const geometry_msgs::Point& a, const geometry_msgs::Point& b) {
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool samePose(const geometry_msgs::PoseStamped& a,
+              const geometry_msgs::PoseStamped& b) {
+  return a.header.stamp == b.header.stamp &&
+         samePoint(a.pose.position, b.pose.position) &&
+         a.pose.orientation.x == b.pose.orientation.x &&
+         a.pose.orientation.y == b.pose.orientation.y &&
+         a.pose.orientation.z == b.pose.orientation.z &&
+         a.pose.orientation.w == b.pose.orientation.w;
+}
+}
+
+PlannerLogWriter::~PlannerLogWriter() { close(); }
+
+bool PlannerLogWriter::open(const std::string& path) {
+  close();
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) {
+    return false;
+  }
+  std::fwrite(log_magic, sizeof(log_magic), 1, file_);
+  std::fwrite(&log_version, sizeof(log_version), 1, file_);
+  return true;
+}
+
+void PlannerLogWriter::close() {
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+void PlannerLogWriter::writeRecord(plannerLogRecord type) {
+  const uint32_t record_type = static_cast<uint32_t>(type);
+  const uint64_t size = buffer_.size();
+  std::fwrite(&record_type, sizeof(record_type), 1, file_);
+  std::fwrite(&size, sizeof(size), 1, file_);
+  std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+}
+
+// the config is logged as the message of dynamic_reconfigure, such that the
+// log doesn't have to list the parameters
+void PlannerLogWriter::writeConfig(const LocalPlannerNodeConfig& config,
+                                   uint32_t level) {
+  if (!file_) {
+    return;
+  }
+  dynamic_reconfigure::Config msg;
+  config.__toMessage__(msg);
+  RecordWriter record(buffer_);
+  record.put(level);
+  record.put(static_cast<uint32_t>(msg.bools.size()));
+  for (const dynamic_reconfigure::BoolParameter& p : msg.bools) {
+    record.put(p.name);
+    record.put(static_cast<bool>(p.value));
+  }
+  record.put(static_cast<uint32_t>(msg.ints.size()));
+  for (const dynamic_reconfigure::IntParameter& p : msg.ints) {
+    record.put(p.name);
+    record.put(p.value);
+  }
+  record.put(static_cast<uint32_t>(msg.strs.size()));
+  for (const dynamic_reconfigure::StrParameter& p : msg.strs) {
+    record.put(p.name);
+    record.put(p.value);
+  }
+  record.put(static_cast<uint32_t>(msg.doubles.size()));
+  for (const dynamic_reconfigure::DoubleParameter& p : msg.doubles) {
+    record.put(p.name);
+    record.put(p.value);
+  }
+  record.put(static_cast<uint32_t>(msg.groups.size()));
+  for (const dynamic_reconfigure::GroupState& g : msg.groups) {
+    record.put(g.name);
+    record.put(static_cast<bool>(g.state));
+    record.put(g.id);
+    record.put(g.parent);
+  }
+  writeRecord(plannerLogRecord::config);
+}
+
+void PlannerLogWriter::writeInput(
+    const ros::Time& time,
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+    const std::vector<CameraFrustum>& camera_frustums,
+    const plannerLogState& state) {
+  if (!file_) {
+    return;
+  }
+  RecordWriter record(buffer_);
+  record.put(time);
+  record.put(static_cast<uint32_t>(complete_cloud.size()));
+  for (const pcl::PointCloud<pcl::PointXYZ>& cloud : complete_cloud) {
+    record.put(cloud);
+  }
+  record.put(static_cast<uint32_t>(camera_frustums.size()));
+  for (const CameraFrustum& frustum : camera_frustums) {
+    record.put(frustum);
+  }
+  record.put(state.pose);
+  record.put(state.vel);
+  record.put(state.armed);
+  record.put(state.offboard);
+  record.put(state.mission);
+  record.put(state.set_goal);
+  record.put(state.goal);
+  record.put(state.ground_distance);
+  record.put(state.disable_rise_to_goal_altitude);
+  writeRecord(plannerLogRecord::input);
+}
+
+// the avoid sphere is not set by the LocalPlanner and not logged
+void PlannerLogWriter::writeOutput(const avoidanceOutput& output) {
+  if (!file_) {
+    return;
+  }
+  RecordWriter record(buffer_);
+  record.put(static_cast<int32_t>(output.waypoint_type));
+  record.put(output.pose);
+  record.put(output.obstacle_ahead);
+  record.put(output.reach_altitude);
+  record.put(output.min_speed);
+  record.put(output.max_speed);
+  record.put(output.velocity_sigmoid_slope);
+  record.put(output.last_path_time);
+  record.put(output.back_off_point);
+  record.put(output.back_off_start_point);
+  record.put(output.min_dist_backoff);
+  record.put(output.take_off_pose);
+  record.put(output.offboard_pose);
+  record.put(output.costmap_direction_e);
+  record.put(output.costmap_direction_z);
+  record.put(static_cast<uint32_t>(output.path_node_positions.size()));
+  for (const geometry_msgs::Point& p : output.path_node_positions) {
+    record.put(p);
+  }
+  writeRecord(plannerLogRecord::output);
+}
+
+PlannerLogReader::~PlannerLogReader() { close(); }
+
+bool PlannerLogReader::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      file_stat.st_size < static_cast<off_t>(sizeof(log_magic) +
+                                             sizeof(log_version))) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<const char*>(data);
+  size_ = file_stat.st_size;
+
+  uint32_t version = 0;
+  std::memcpy(&version, data_ + sizeof(log_magic), sizeof(version));
+  if (std::memcmp(data_, log_magic, sizeof(log_magic)) != 0 ||
+      version != log_version) {
+    close();
+    return false;
+  }
+  offset_ = sizeof(log_magic) + sizeof(log_version);
+  return true;
+}
+
+void PlannerLogReader::close() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+  offset_ = 0;
+}
+
+plannerLogRecord PlannerLogReader::next() {
+  uint32_t type = 0;
+  uint64_t size = 0;
+  if (!data_ || size_ - offset_ < sizeof(type) + sizeof(size)) {
+    return plannerLogRecord::none;
+  }
+  std::memcpy(&type, data_ + offset_, sizeof(type));
+  std::memcpy(&size, data_ + offset_ + sizeof(type), sizeof(size));
+  offset_ += sizeof(type) + sizeof(size);
+  if (size > size_ - offset_) {
+    offset_ = size_;
+    return plannerLogRecord::none;
+  }
+  RecordReader record(data_ + offset_, size);
+  offset_ += size;
+
+  const plannerLogRecord record_type = static_cast<plannerLogRecord>(type);
+  uint32_t n = 0;
+  switch (record_type) {
+    case plannerLogRecord::config: {
+      dynamic_reconfigure::Config msg;
+      record.get(config_level_);
+      // the elements start with the size of their name
+      record.getCount(n, sizeof(uint32_t) + 1);
+      msg.bools.resize(n);
+      for (dynamic_reconfigure::BoolParameter& p : msg.bools) {
+        bool value = false;
+        record.get(p.name);
+        record.get(value);
+        p.value = value;
+      }
+      record.getCount(n, sizeof(uint32_t) + sizeof(int32_t));
+      msg.ints.resize(n);
+      for (dynamic_reconfigure::IntParameter& p : msg.ints) {
+        record.get(p.name);
+        record.get(p.value);
+      }
+      record.getCount(n, 2 * sizeof(uint32_t));
+      msg.strs.resize(n);
+      for (dynamic_reconfigure::StrParameter& p : msg.strs) {
+        record.get(p.name);
+        record.get(p.value);
+      }
+      record.getCount(n, sizeof(uint32_t) + sizeof(double));
+      msg.doubles.resize(n);
+      for (dynamic_reconfigure::DoubleParameter& p : msg.doubles) {
+        record.get(p.name);
+        record.get(p.value);
+      }
+      record.getCount(n, sizeof(uint32_t) + 1 + 2 * sizeof(int32_t));
+      msg.groups.resize(n);
+      for (dynamic_reconfigure::GroupState& g : msg.groups) {
+        bool state = false;
+        record.get(g.name);
+        record.get(state);
+        record.get(g.id);
+        record.get(g.parent);
+        g.state = state;
+      }
+      // parameters which the log doesn't know keep their defaults
+      config_ = LocalPlannerNodeConfig::__getDefault__();
+      if (record.ok()) {
+        config_.__fromMessage__(msg);
+      }
+      break;
+    }
+    case plannerLogRecord::input:
+      record.get(input_.time);
+      // stamp, frame id and number of points
+      record.getCount(n, sizeof(uint64_t) + 2 * sizeof(uint32_t));
+      input_.complete_cloud.resize(n);
+      for (pcl::PointCloud<pcl::PointXYZ>& cloud : input_.complete_cloud) {
+        record.get(cloud);
+      }
+      // origin, rotation, the two fovs and has_pose
+      record.getCount(n, 14 * sizeof(float) + 1);
+      input_.camera_frustums.resize(n);
+      for (CameraFrustum& frustum : input_.camera_frustums) {
+        record.get(frustum);
+      }
+      record.get(input_.state.pose);
+      record.get(input_.state.vel);
+      record.get(input_.state.armed);
+      record.get(input_.state.offboard);
+      record.get(input_.state.mission);
+      record.get(input_.state.set_goal);
+      record.get(input_.state.goal);
+      record.get(input_.state.ground_distance);
+      record.get(input_.state.disable_rise_to_goal_altitude);
+      break;
+    case plannerLogRecord::output: {
+      int32_t waypoint_type = 0;
+      record.get(waypoint_type);
+      output_.waypoint_type = static_cast<waypoint_choice>(waypoint_type);
+      record.get(output_.pose);
+      record.get(output_.obstacle_ahead);
+      record.get(output_.reach_altitude);
+      record.get(output_.min_speed);
+      record.get(output_.max_speed);
+      record.get(output_.velocity_sigmoid_slope);
+      record.get(output_.last_path_time);
+      record.get(output_.back_off_point);
+      record.get(output_.back_off_start_point);
+      record.get(output_.min_dist_backoff);
+      record.get(output_.take_off_pose);
+      record.get(output_.offboard_pose);
+      record.get(output_.costmap_direction_e);
+      record.get(output_.costmap_direction_z);
+      record.getCount(n, 3 * sizeof(double));
+      output_.path_node_positions.resize(n);
+      for (geometry_msgs::Point& p : output_.path_node_positions) {
+        record.get(p);
+      }
+      break;
+    }
+    default:
+      return plannerLogRecord::none;
+  }
+  return record.ok() && record.atEnd() ? record_type : plannerLogRecord::none;
+}
+
+bool sameAvoidanceOutput(const avoidanceOutput& a, const avoidanceOutput& b) {
+  if (a.path_node_positions.size() != b.path_node_positions.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.path_node_positions.size(); i++) {
+    if (!samePoint(a.path_node_positions[i], b.path_node_positions[i])) {
+      return false;
+    }
+  }
+  return a.waypoint_type == b.waypoint_type && samePose(a.pose, b.pose) &&
+         a.obstacle_ahead == b.obstacle_ahead &&
+         a.reach_altitude == b.reach_altitude && a.min_speed == b.min_speed &&
+         a.max_speed == b.max_speed &&
+         a.velocity_sigmoid_slope == b.velocity_sigmoid_slope &&
+         a.last_path_time == b.last_path_time &&
+         samePoint(a.back_off_point, b.back_off_point) &&
+         samePoint(a.back_off_start_point, b.back_off_start_point) &&
+         a.min_dist_backoff == b.min_dist_backoff &&
+         samePose(a.take_off_pose, b.take_off_pose) &&
+         samePose(a.offboard_pose, b.offboard_pose) &&
+         a.costmap_direction_e == b.costmap_direction_e &&
+         a.costmap_direction_z == b.costmap_direction_z;
+}
+}
@@ -0,0 +1,122 @@
+#ifndef PLANNER_LOG_H
+#define PLANNER_LOG_H
+
+#include "avoidance_output.h"
+#include "planner_functions.h"
+
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <ros/time.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <dynamic_reconfigure/Config.h>
+#include <local_planner/LocalPlannerNodeConfig.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace avoidance {
+
+// the planner input of one cycle besides the clouds
+struct plannerLogState {
+  geometry_msgs::PoseStamped pose;
+  geometry_msgs::TwistStamped vel;
+  bool armed = false;
+  bool offboard = false;
+  bool mission = false;
+  bool set_goal = false;  // the goal has changed with this input
+  geometry_msgs::Point goal;
+  double ground_distance = 2.0;
+  bool disable_rise_to_goal_altitude = false;
+};
+
+// everything the node hands to the LocalPlanner in one cycle
+struct plannerLogInput {
+  ros::Time time;  // ros::Time::now() when the input was applied
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud;
+  std::vector<CameraFrustum> camera_frustums;
+  plannerLogState state;
+};
+
+enum class plannerLogRecord : uint32_t { none, config, input, output };
+
+/**
+* @brief Writes a binary log of the planner config, inputs and outputs. The
+*        log is a header followed by records of a type, a size and the
+*        payload, in the byte order of the host. The config is logged before
+*        the first input and on every change, every input is followed by the
+*        output of its planner cycle.
+**/
+class PlannerLogWriter {
+ public:
+  ~PlannerLogWriter();
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const { return file_ != nullptr; }
+
+  void writeConfig(const LocalPlannerNodeConfig& config, uint32_t level);
+  void writeInput(
+      const ros::Time& time,
+      const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+      const std::vector<CameraFrustum>& camera_frustums,
+      const plannerLogState& state);
+  void writeOutput(const avoidanceOutput& output);
+
+ private:
+  std::FILE* file_ = nullptr;
+  std::vector<char> buffer_;  // payload of the record being written
+
+  void writeRecord(plannerLogRecord type);
+};
+
+/**
+* @brief Reads a log of the PlannerLogWriter from a memory mapping of the
+*        file, one record after the other
+**/
+class PlannerLogReader {
+ public:
+  ~PlannerLogReader();
+
+  /**
+  * @brief     Maps the file, returns false if it is not a planner log
+  **/
+  bool open(const std::string& path);
+  void close();
+
+  /**
+  * @brief     Reads the next record into the member of its type
+  * @returns   type of the record, none at the end of the log or if the
+  *            record is corrupt
+  **/
+  plannerLogRecord next();
+
+  const LocalPlannerNodeConfig& config() const { return config_; }
+  uint32_t configLevel() const { return config_level_; }
+  plannerLogInput& input() { return input_; }
+  const avoidanceOutput& output() const { return output_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+
+  LocalPlannerNodeConfig config_;
+  uint32_t config_level_ = 0;
+  plannerLogInput input_;
+  avoidanceOutput output_;
+};
+
+/**
+* @brief     Returns true if the outputs are the same, such that a replay can
+*            be checked against the log
+**/
+bool sameAvoidanceOutput(const avoidanceOutput& a, const avoidanceOutput& b);
+}
+
+#endif  // PLANNER_LOG_H
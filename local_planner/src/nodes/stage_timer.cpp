@@ -0,0 +1,87 @@
+#include "stage_timer.h"
+
+#include <algorithm>
+
+namespace avoidance {
+
+const char* stageName(Stage stage) {
+  switch (stage) {
+    case Stage::tfLookup:
+      return "tf_lookup";
+    case Stage::cloudTransform:
+      return "cloud_transform";
+    case Stage::obstacleDistance:
+      return "obstacle_distance";
+    case Stage::filterPointCloud:
+      return "filter_point_cloud";
+    case Stage::trackObstacles:
+      return "track_obstacles";
+    case Stage::reprojectPoints:
+      return "reproject_points";
+    case Stage::propagateHistogram:
+      return "propagate_histogram";
+    case Stage::combinedHistogram:
+      return "combined_histogram";
+    case Stage::findFreeDirections:
+      return "find_free_directions";
+    case Stage::treeBuild:
+      return "tree_build";
+    case Stage::runPlanner:
+      return "run_planner";
+    case Stage::waypointGeneration:
+      return "waypoint_generation";
+    case Stage::publish:
+      return "publish";
+    default:
+      return "unknown";
+  }
+}
+
+StageTimers::StageTimers(size_t window_size)
+    : window_size_(std::max<size_t>(1, window_size)),
+      durations_ms_(static_cast<size_t>(Stage::count)),
+      next_sample_(static_cast<size_t>(Stage::count), 0) {
+  for (std::vector<double>& durations : durations_ms_) {
+    durations.reserve(window_size_);
+  }
+}
+
+void StageTimers::record(Stage stage, double duration_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t i = static_cast<size_t>(stage);
+  std::vector<double>& durations = durations_ms_[i];
+  if (durations.size() < window_size_) {
+    durations.push_back(duration_ms);
+  } else {
+    durations[next_sample_[i]] = duration_ms;
+  }
+  next_sample_[i] = (next_sample_[i] + 1) % window_size_;
+}
+
+stageStatistics StageTimers::getStatistics(Stage stage) const {
+  std::vector<double> durations;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    durations = durations_ms_[static_cast<size_t>(stage)];
+  }
+
+  stageStatistics statistics;
+  statistics.n_samples = durations.size();
+  if (durations.empty()) {
+    return statistics;
+  }
+
+  // nearest rank percentiles
+  size_t p50_idx = (durations.size() - 1) / 2;
+  size_t p99_idx = (99 * durations.size() - 1) / 100;
+  std::nth_element(durations.begin(), durations.begin() + p50_idx,
+                   durations.end());
+  statistics.p50_ms = durations[p50_idx];
+  std::nth_element(durations.begin() + p50_idx, durations.begin() + p99_idx,
+                   durations.end());
+  statistics.p99_ms = durations[p99_idx];
+  statistics.max_ms = *std::max_element(durations.begin() + p99_idx,
+                                        durations.end());
+  return statistics;
+}
+}
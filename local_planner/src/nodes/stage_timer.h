@@ -0,0 +1,79 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace avoidance {
+
+// stages of the planner pipeline which are timed
+enum class Stage {
+  tfLookup,
+  cloudTransform,
+  obstacleDistance,
+  filterPointCloud,
+  trackObstacles,
+  reprojectPoints,
+  propagateHistogram,
+  combinedHistogram,
+  findFreeDirections,
+  treeBuild,
+  runPlanner,
+  waypointGeneration,
+  publish,
+  count
+};
+
+const char* stageName(Stage stage);
+
+struct stageStatistics {
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+  size_t n_samples = 0;
+};
+
+/**
+* @brief Keeps the durations of the last window_size runs of every stage.
+*        Recording and reading are thread safe.
+**/
+class StageTimers {
+  size_t window_size_;
+  mutable std::mutex mutex_;
+  // ring buffer of durations and index of the next sample per stage
+  std::vector<std::vector<double>> durations_ms_;
+  std::vector<size_t> next_sample_;
+
+ public:
+  explicit StageTimers(size_t window_size = 200);
+
+  void record(Stage stage, double duration_ms);
+  stageStatistics getStatistics(Stage stage) const;
+};
+
+/**
+* @brief Measures the wall time of a scope with a monotonic clock and records
+*        it on destruction. Does nothing if timers is null.
+**/
+class ScopedStageTimer {
+  StageTimers* timers_;
+  Stage stage_;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  ScopedStageTimer(StageTimers* timers, Stage stage)
+      : timers_(timers),
+        stage_(stage),
+        start_(std::chrono::steady_clock::now()) {}
+  ~ScopedStageTimer() {
+    if (timers_) {
+      std::chrono::duration<double, std::milli> duration =
+          std::chrono::steady_clock::now() - start_;
+      timers_->record(stage_, duration.count());
+    }
+  }
+};
+}
+
+#endif  // STAGE_TIMER_H
@@ -6,9 +6,21 @@
 
 #include <ros/console.h>
 
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <thread>
+
 namespace avoidance {
 
-StarPlanner::StarPlanner() : tree_age_(0) {}
+StarPlanner::StarPlanner()
+    : expansion_threads_(std::max(1u, std::thread::hardware_concurrency())),
+      tree_age_(0) {
+  setDiscountFactor(tree_discount_factor_);
+  expansion_buffers_.resize(expansion_threads_);
+  expansion_pool_.reset(new WorkerPool(expansion_threads_ - 1));
+  binning_backend_ = createBinningBackend();
+}
 
 StarPlanner::~StarPlanner() {}
 
@@ -18,7 +30,8 @@ void StarPlanner::dynamicReconfigureSetStarParams(
   childs_per_node_ = config.childs_per_node_;
   n_expanded_nodes_ = config.n_expanded_nodes_;
   tree_node_distance_ = config.tree_node_distance_;
-  tree_discount_factor_ = config.tree_discount_factor_;
+  setDiscountFactor(config.tree_discount_factor_);
+  tree_warm_start_ = config.tree_warm_start_;
 }
 
 void StarPlanner::setParams(double min_cloud_size, double min_dist_backoff,
@@ -40,9 +53,32 @@ void StarPlanner::setPose(const geometry_msgs::PoseStamped& pose) {
   pose_ = pose;
 }
 
+// keep the points which can be inside the box of a tree node. Nodes are less
+// than n_expanded_nodes_ * tree_node_distance_ away from the pose, so this
+// needs setPose and setBoxSize to be called first
 void StarPlanner::setCloud(
     const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud) {
-  complete_cloud_ = complete_cloud;
+  const Eigen::Vector3f position = toEigen(pose_.pose.position);
+  const float max_dist =
+      histogram_box_.radius_ + n_expanded_nodes_ * tree_node_distance_;
+
+  complete_cloud_.resize(1);
+  pcl::PointCloud<pcl::PointXYZ>& tree_cloud = complete_cloud_[0];
+  tree_cloud.points.clear();
+  for (const auto& cloud : complete_cloud) {
+    for (const pcl::PointXYZ& xyz : cloud) {
+      if (!std::isnan(xyz.x) && !std::isnan(xyz.y) && !std::isnan(xyz.z) &&
+          (toEigen(xyz) - position).norm() < max_dist) {
+        tree_cloud.points.push_back(xyz);
+      }
+    }
+  }
+  if (!complete_cloud.empty()) {
+    tree_cloud.header = complete_cloud[0].header;
+  }
+  tree_cloud.height = 1;
+  tree_cloud.width = tree_cloud.points.size();
+  binning_backend_->setCloud(complete_cloud_);
 }
 
 void StarPlanner::setBoxSize(const Box& histogram_box, double ground_distance) {
@@ -65,85 +101,434 @@ void StarPlanner::setCostParams(double goal_cost_param,
   height_change_cost_param_ = height_change_cost_param;
 }
 
-void StarPlanner::setReprojectedPoints(
-    const pcl::PointCloud<pcl::PointXYZ>& reprojected_points,
-    const std::vector<double>& reprojected_points_age,
-    const std::vector<double>& reprojected_points_dist) {
-  reprojected_points_ = reprojected_points;
-  reprojected_points_age_ = reprojected_points_age;
-  reprojected_points_dist_ = reprojected_points_dist;
+// check if two histograms have the same occupied cells among the first e_dim
+// by z_dim ones
+static bool sameOccupiedCells(const Histogram& a, const Histogram& b,
+                              int e_dim, int z_dim) {
+  for (int e = 0; e < e_dim; e++) {
+    for (int z = 0; z < z_dim; z++) {
+      if ((a.get_bin(e, z) > 0) != (b.get_bin(e, z) > 0)) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
-double StarPlanner::treeCostFunction(int node_number) {
-  int origin = tree_[node_number].origin_;
+void StarPlanner::setPropagatedHistogram(
+    const Histogram& propagated_histogram) {
+  // the cells combinedHistogram reads
+  if (!sameOccupiedCells(propagated_histogram_, propagated_histogram,
+                         GRID_LENGTH_E, GRID_LENGTH_Z)) {
+    propagated_version_++;
+  }
+  propagated_histogram_ = propagated_histogram;
+}
+
+// the powers of the discount factor of the depths which a tree can reach,
+// the nodes grafted from the last tree can be deeper than n_expanded_nodes_
+void StarPlanner::setDiscountFactor(double tree_discount_factor) {
+  tree_discount_factor_ = tree_discount_factor;
+  depth_discounts_.resize(2 * n_expanded_nodes_ + 2);
+  for (size_t depth = 0; depth < depth_discounts_.size(); depth++) {
+    depth_discounts_[depth] = std::pow(tree_discount_factor_, depth);
+  }
+}
+
+double StarPlanner::depthDiscount(int depth) const {
+  return depth < static_cast<int>(depth_discounts_.size())
+             ? depth_discounts_[depth]
+             : std::pow(tree_discount_factor_, depth);
+}
+
+StarPlanner::OriginTerms StarPlanner::originTerms(int origin,
+                                                  int depth) const {
+  OriginTerms terms;
+  terms.position = tree_[origin].getPosition();
+  terms.goal_z = azimuthAnglefromCartesian(goal_, terms.position);
+  terms.goal_e = elevationAnglefromCartesian(goal_, terms.position);
+  terms.last_e = tree_[origin].last_e_;
+  terms.last_z = tree_[origin].last_z_;
+  terms.goal_dist = (goal_ - terms.position).norm();
+  terms.depth = depth;
+  terms.discount = depthDiscount(depth);
+  int partner_node_idx = path_node_positions_.size() - 1 - depth;
+  if (tree_age_ < 10 && partner_node_idx >= 0) {
+    terms.has_partner = true;
+    terms.partner_position = toEigen(path_node_positions_[partner_node_idx]);
+  }
+  return terms;
+}
+
+double StarPlanner::nodeCost(int node_number, const OriginTerms& terms) const {
   float e = tree_[node_number].last_e_;
   float z = tree_[node_number].last_z_;
-  Eigen::Vector3f origin_position = tree_[origin].getPosition();
-  float goal_z = azimuthAnglefromCartesian(goal_, origin_position);
-  float goal_e = elevationAnglefromCartesian(goal_, origin_position);
 
-  double target_cost =
-      2 * indexAngleDifference(z, goal_z) +
-      20 * indexAngleDifference(e, goal_e);  // include effective direction?
+  // include effective direction?
+  double target_cost = 2 * indexAngleDifference(z, terms.goal_z) +
+                       20 * indexAngleDifference(e, terms.goal_e);
   double turning_cost =
       1 *
       indexAngleDifference(z, tree_[0].yaw_);  // maybe include pitching cost?
 
-  float last_e = tree_[origin].last_e_;
-  float last_z = tree_[origin].last_z_;
-
-  double smooth_cost = 5 * (2 * indexAngleDifference(z, last_z) +
-                            5 * indexAngleDifference(e, last_e));
-  if (indexAngleDifference(z, last_z) > 100) {
+  double smooth_cost = 5 * (2 * indexAngleDifference(z, terms.last_z) +
+                            5 * indexAngleDifference(e, terms.last_e));
+  if (indexAngleDifference(z, terms.last_z) > 100) {
     smooth_cost = HUGE_VAL;
   }
 
   double smooth_cost_to_old_tree = 0.0;
-  if (tree_age_ < 10) {
-    int partner_node_idx =
-        path_node_positions_.size() - 1 - tree_[node_number].depth_;
-    if (partner_node_idx >= 0) {
-      geometry_msgs::Point partner_node_position =
-          path_node_positions_[partner_node_idx];
-      Eigen::Vector3f node_position = tree_[node_number].getPosition();
-      double dist = (toEigen(partner_node_position) - node_position).norm();
-      smooth_cost_to_old_tree = 200 * dist / (0.5 * tree_[node_number].depth_);
-    }
+  if (terms.has_partner) {
+    Eigen::Vector3f node_position = tree_[node_number].getPosition();
+    double dist = (terms.partner_position - node_position).norm();
+    smooth_cost_to_old_tree = 200 * dist / (0.5 * terms.depth);
   }
 
-  return std::pow(tree_discount_factor_, tree_[node_number].depth_) *
+  return terms.discount *
          (target_cost + smooth_cost + smooth_cost_to_old_tree + turning_cost);
 }
-double StarPlanner::treeHeuristicFunction(int node_number) {
+
+double StarPlanner::nodeHeuristic(int node_number,
+                                  const OriginTerms& terms) const {
   Eigen::Vector3f node_position = tree_[node_number].getPosition();
   int goal_z = float(azimuthAnglefromCartesian(goal_, node_position));
   int goal_e = float(elevationAnglefromCartesian(goal_, node_position));
 
-  int origin = tree_[node_number].origin_;
-  Eigen::Vector3f origin_position = tree_[origin].getPosition();
-  double origin_goal_dist = (goal_ - origin_position).norm();
   double goal_dist = (goal_ - node_position).norm();
-  double goal_cost = (goal_dist / origin_goal_dist - 0.9) * 5000;
+  double goal_cost = (goal_dist / terms.goal_dist - 0.9) * 5000;
 
   //  double turning_cost = 2*indexAngleDifference(z, curr_yaw_z);
   double smooth_cost =
       10 * (1 * indexAngleDifference(goal_z, tree_[node_number].last_z_) +
             1 * indexAngleDifference(goal_e, tree_[node_number].last_e_));
 
-  return std::pow(tree_discount_factor_, tree_[node_number].depth_) *
-         (smooth_cost + goal_cost);
+  return terms.discount * (smooth_cost + goal_cost);
+}
+
+// scores the children of origin from first_node to the end of the tree
+// together, the terms of the origin are computed once
+void StarPlanner::scoreNodes(int origin, int first_node) {
+  if (first_node >= static_cast<int>(tree_.size())) {
+    return;
+  }
+  const OriginTerms terms = originTerms(origin, tree_[first_node].depth_);
+  for (size_t node = first_node; node < tree_.size(); node++) {
+    double h = nodeHeuristic(node, terms);
+    double c = nodeCost(node, terms);
+    tree_[node].heuristic_ = h;
+    tree_[node].total_cost_ =
+        tree_[origin].total_cost_ - tree_[origin].heuristic_ + c + h;
+  }
+}
+
+double StarPlanner::treeCostFunction(int node_number) {
+  return nodeCost(node_number, originTerms(tree_[node_number].origin_,
+                                           tree_[node_number].depth_));
+}
+
+double StarPlanner::treeHeuristicFunction(int node_number) {
+  return nodeHeuristic(node_number, originTerms(tree_[node_number].origin_,
+                                                tree_[node_number].depth_));
+}
+
+// check if a direction lies in one of the candidate cells
+static bool isCandidateDirection(
+    const std::vector<candidateDirection>& candidates, float e, float z) {
+  for (const candidateDirection& candidate : candidates) {
+    if (std::abs(candidate.elevation_angle - e) <= ALPHA_RES &&
+        indexAngleDifference(candidate.azimuth_angle, z) <= ALPHA_RES) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// move the expansions to the spare ones
+void StarPlanner::recycleExpansions(
+    std::unordered_map<int, NodeExpansion>& expansions) {
+  for (auto& node_expansion : expansions) {
+    spare_expansions_.push_back(std::move(node_expansion.second));
+  }
+  expansions.clear();
+}
+
+// the expansion of a node of the current tree, it reuses a spare one
+StarPlanner::NodeExpansion& StarPlanner::addExpansion(int node_number) {
+  auto it = expansions_.find(node_number);
+  if (it != expansions_.end()) {
+    return it->second;
+  }
+  if (spare_expansions_.empty()) {
+    return expansions_[node_number];
+  }
+  NodeExpansion& expansion =
+      expansions_.emplace(node_number, std::move(spare_expansions_.back()))
+          .first->second;
+  spare_expansions_.pop_back();
+  expansion.valid = false;
+  return expansion;
+}
+
+// with warm start, the expansion of the last path which the node reuses if its
+// binned cells have not changed either
+const StarPlanner::NodeExpansion* StarPlanner::cachedExpansion(
+    int node_number) const {
+  if (!tree_warm_start_) {
+    return nullptr;
+  }
+  auto it = path_expansions_.find(node_number);
+  if (it == path_expansions_.end()) {
+    return nullptr;
+  }
+  const NodeExpansion& cached = it->second;
+  const TreeNode& node = tree_[node_number];
+  if (cached.origin_position != tree_[node.origin_].getPosition() ||
+      cached.goal != goal_ || cached.yaw != node.yaw_ ||
+      cached.propagated_version != propagated_version_ ||
+      (cached.pose_position - toEigen(pose_.pose.position)).norm() >
+          warm_start_pose_tolerance_) {
+    return nullptr;
+  }
+  return &cached;
+}
+
+// the crop box and histogram of a node for the binning backend
+binningQuery StarPlanner::nodeQuery(int node_number) const {
+  binningQuery query;
+  query.position = tree_[node_number].getPosition();
+  query.histogram_position = toEigen(pose_.pose.position);
+  query.box = histogram_box_;
+  query.box.setBoxLimits(toPoint(query.position), ground_distance_);
+  return query;
+}
+
+binningParams StarPlanner::binningParameters() const {
+  binningParams params;
+  params.min_cloud_size = min_cloud_size_;
+  params.min_dist_backoff = min_dist_backoff_;
+  params.min_realsense_dist = min_realsense_dist_;
+  return params;
+}
+
+// build the histogram of a node and find its free directions. A batched
+// binning backend has already built the histogram of the node
+void StarPlanner::expandNode(int node_number, NodeExpansion& expansion,
+                             ExpansionBuffers& buffers) const {
+  int old_origin = tree_[node_number].origin_;
+  Eigen::Vector3f origin_origin_position = tree_[old_origin].getPosition();
+  const NodeExpansion* cached = cachedExpansion(node_number);
+
+  // crop pointcloud
+  Histogram& histogram = buffers.histogram;
+  if (!binning_backend_->batched()) {
+    const binningQuery query = nodeQuery(node_number);
+    Histogram* histograms[] = {&histogram};
+    binning_backend_->binPoints(binningParameters(), &query, histograms,
+                                &buffers.binning, 1, buffers.cropped_cloud);
+  }
+  bool hist_is_empty = false;  // unused
+
+  if (node_number != 0 && buffers.binning.counter_backoff > 20 &&
+      buffers.binning.n_points > 160) {
+    expansion.valid = false;
+    return;
+  }
+
+  // the binned cells tell if the obstacles changed, the rest of the expansion
+  // is only computed if they did
+  if (cached &&
+      sameOccupiedCells(cached->histogram, histogram, GRID_LENGTH_E,
+                        GRID_LENGTH_Z)) {
+    expansion = *cached;
+    return;
+  }
+  if (tree_warm_start_) {
+    expansion.origin_position = origin_origin_position;
+    expansion.goal = goal_;
+    expansion.pose_position = toEigen(pose_.pose.position);
+    expansion.yaw = tree_[node_number].yaw_;
+    expansion.propagated_version = propagated_version_;
+    expansion.histogram = histogram;
+  }
+
+  // build new histogram
+  int e_FOV_min, e_FOV_max;
+  calculateFOV(h_FOV_, v_FOV_, buffers.z_FOV_idx, buffers.z_FOV_mask,
+               e_FOV_min, e_FOV_max, tree_[node_number].yaw_,
+               0.0);  // assume pitch is zero at every node
+
+  combinedHistogram(hist_is_empty, histogram, propagated_histogram_, false,
+                    buffers.z_FOV_mask, e_FOV_min, e_FOV_max);
+
+  // calculate candidates
+  histogram.downsample();
+
+  findFreeDirections(histogram, 25, expansion.candidates,
+                     buffers.path_selected, buffers.path_rejected,
+                     buffers.path_blocked, path_waypoints_, goal_,
+                     toEigen(pose_.pose.position), origin_origin_position,
+                     goal_cost_param_, smooth_cost_param_,
+                     height_change_cost_param_adapted_,
+                     height_change_cost_param_, false, 2 * ALPHA_RES);
+
+  expansion.valid =
+      !calculateCostMap(expansion.candidates, expansion.cost_order);
+}
+
+// expand the origin and speculatively, on the other threads, the open nodes
+// most likely to be expanded next
+void StarPlanner::expandNodes(int origin) {
+  std::vector<int> batch = {origin};
+  if (expansion_threads_ > 1) {
+    std::vector<int> open_nodes;
+    for (size_t i = 0; i < tree_.size(); i++) {
+      if ((int)i != origin && tree_[i].total_cost_ < HUGE_VAL &&
+          expansions_.count(i) == 0 && !tree_[i].closed_) {
+        open_nodes.push_back(i);
+      }
+    }
+    size_t n_speculative =
+        std::min(open_nodes.size(), (size_t)expansion_threads_ - 1);
+    std::partial_sort(open_nodes.begin(), open_nodes.begin() + n_speculative,
+                      open_nodes.end(), [this](int a, int b) {
+                        return tree_[a].total_cost_ < tree_[b].total_cost_;
+                      });
+    batch.insert(batch.end(), open_nodes.begin(),
+                 open_nodes.begin() + n_speculative);
+  }
+
+  // the references stay valid while the other expansions are added
+  std::vector<NodeExpansion*> batch_expansions;
+  for (int node : batch) {
+    batch_expansions.push_back(&addExpansion(node));
+  }
+
+  // an accelerator bins the points for the whole batch in one pass
+  if (binning_backend_->batched()) {
+    std::vector<binningQuery> queries;
+    std::vector<Histogram*> histograms;
+    std::vector<binningResult> results(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      queries.push_back(nodeQuery(batch[i]));
+      histograms.push_back(&expansion_buffers_[i].histogram);
+    }
+    binning_backend_->binPoints(binningParameters(), queries.data(),
+                                histograms.data(), results.data(),
+                                batch.size(),
+                                expansion_buffers_[0].cropped_cloud);
+    for (size_t i = 0; i < batch.size(); i++) {
+      expansion_buffers_[i].binning = results[i];
+    }
+  }
+  expansion_pool_->run(batch.size(), [&](int i) {
+    expandNode(batch[i], *batch_expansions[i], expansion_buffers_[i]);
+  });
+}
+
+int64_t StarPlanner::voxelKey(int x, int y, int z) const {
+  const int64_t offset = 1 << 20;
+  return ((x + offset) << 42) | ((y + offset) << 21) | (z + offset);
+}
+
+void StarPlanner::addNodeToVoxels(int node_number) {
+  Eigen::Vector3f voxel =
+      (tree_[node_number].getPosition() / min_node_distance_).array().floor();
+  node_voxels_[voxelKey(voxel.x(), voxel.y(), voxel.z())].push_back(
+      node_number);
+}
+
+// check if there is a node closer than min_node_distance_ to a position. Such
+// a node can only be in the same or in one of the neighboring voxels
+bool StarPlanner::hasCloseNode(const Eigen::Vector3f& position) const {
+  Eigen::Vector3f voxel = (position / min_node_distance_).array().floor();
+  for (int x = voxel.x() - 1; x <= voxel.x() + 1; x++) {
+    for (int y = voxel.y() - 1; y <= voxel.y() + 1; y++) {
+      for (int z = voxel.z() - 1; z <= voxel.z() + 1; z++) {
+        auto it = node_voxels_.find(voxelKey(x, y, z));
+        if (it == node_voxels_.end()) continue;
+        for (int i : it->second) {
+          double dist = (tree_[i].getPosition() - position).norm();
+          if (dist < min_node_distance_) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+// re-root the last path at the current position. The nodes beyond the path
+// node closest to the root are attached to it and keep their positions, they
+// are opened once the direction to them is found free again
+void StarPlanner::graftLastPath(const std::vector<TreeNode>& last_tree,
+                                std::vector<int>& grafted_nodes) {
+  std::unordered_map<int, NodeExpansion> last_expansions;
+  last_expansions.swap(path_expansions_);
+  grafted_nodes.clear();
+  if (!tree_warm_start_ || tree_age_ >= 10 || path_node_origins_.size() < 2) {
+    recycleExpansions(last_expansions);
+    return;
+  }
+
+  // path_node_origins_ go from the end of the path to the old root
+  Eigen::Vector3f root_position = tree_[0].getPosition();
+  int closest = 0;
+  float min_dist = HUGE_VAL;
+  for (size_t i = 0; i < path_node_origins_.size(); i++) {
+    Eigen::Vector3f node_position =
+        last_tree[path_node_origins_[i]].getPosition();
+    float dist = (node_position - root_position).norm();
+    if (dist < min_dist) {
+      min_dist = dist;
+      closest = i;
+    }
+  }
+
+  for (int i = closest - 1; i >= 0; i--) {
+    int origin = grafted_nodes.empty() ? 0 : grafted_nodes.back();
+    Eigen::Vector3f origin_position = tree_[origin].getPosition();
+    Eigen::Vector3f node_position =
+        last_tree[path_node_origins_[i]].getPosition();
+    Eigen::Vector3f diff = node_position - origin_position;
+    if (diff.norm() > 1.5 * tree_node_distance_) {
+      break;
+    }
+
+    tree_.push_back(TreeNode(origin, tree_[origin].depth_ + 1, node_position));
+    int node = tree_.size() - 1;
+    tree_.back().last_e_ =
+        elevationAnglefromCartesian(node_position, origin_position);
+    tree_.back().last_z_ =
+        azimuthAnglefromCartesian(node_position, origin_position);
+    scoreNodes(origin, node);
+    tree_.back().yaw_ = atan2(diff.y(), diff.x());
+    if (!(tree_.back().total_cost_ < HUGE_VAL)) {
+      tree_.pop_back();
+      break;
+    }
+
+    auto it = last_expansions.find(path_node_origins_[i]);
+    if (it != last_expansions.end()) {
+      path_expansions_.emplace(node, std::move(it->second));
+    }
+    grafted_nodes.push_back(node);
+  }
+  recycleExpansions(last_expansions);
 }
 
 void StarPlanner::buildLookAheadTree() {
-  nav_msgs::GridCells path_candidates;
-  nav_msgs::GridCells path_selected;
-  nav_msgs::GridCells path_rejected;
-  nav_msgs::GridCells path_blocked;
-  std::vector<float> cost_path_candidates;
-  std::vector<int> cost_idx_sorted;
   std::clock_t start_time = std::clock();
+  last_tree_.swap(tree_);
   tree_.clear();
   closed_set_.clear();
+  node_voxels_.clear();
+
+  // open nodes ordered by cost and index, closed ones are skipped when popped
+  typedef std::pair<double, int> CostIndex;
+  std::priority_queue<CostIndex, std::vector<CostIndex>,
+                      std::greater<CostIndex>>
+      open_set;
 
   // insert first node
   tree_.push_back(TreeNode(0, 0, toEigen(pose_.pose.position)));
@@ -151,119 +536,100 @@ void StarPlanner::buildLookAheadTree() {
   tree_.back().yaw_ = std::round((-curr_yaw_ * 180.0 / M_PI)) +
                       90;  // from radian to angle and shift reference to y-axis
   tree_.back().last_z_ = tree_.back().yaw_;
+  addNodeToVoxels(0);
+
+  std::vector<int> grafted_nodes;
+  graftLastPath(last_tree_, grafted_nodes);
+  size_t n_grafted_open = 0;
 
+  recycleExpansions(expansions_);
   int origin = 0;
   int n = 0;
 
   while (n < n_expanded_nodes_) {
     Eigen::Vector3f origin_position = tree_[origin].getPosition();
-    int old_origin = tree_[origin].origin_;
-    Eigen::Vector3f origin_origin_position = tree_[old_origin].getPosition();
-
-    bool node_valid = true;
-
-    // crop pointcloud
-    pcl::PointCloud<pcl::PointXYZ> cropped_cloud;
-    Eigen::Vector3f closest_point;  // unused
-    bool hist_is_empty = false;     // unused
-    int backoff_points_counter = 0;
-    double distance_to_closest_point;
-    histogram_box_.setBoxLimits(toPoint(origin_position), ground_distance_);
-
-    filterPointCloud(cropped_cloud, closest_point, distance_to_closest_point,
-                     backoff_points_counter, complete_cloud_, min_cloud_size_,
-                     min_dist_backoff_, histogram_box_, origin_position,
-                     min_realsense_dist_);
-
-    if (origin != 0 && backoff_points_counter > 20 &&
-        cropped_cloud.points.size() > 160) {
-      tree_[origin].total_cost_ = HUGE_VAL;
-      node_valid = false;
-    }
 
-    if (node_valid) {
-      // build new histogram
-      std::vector<int> z_FOV_idx;
-      int e_FOV_min, e_FOV_max;
-      calculateFOV(h_FOV_, v_FOV_, z_FOV_idx, e_FOV_min, e_FOV_max,
-                   tree_[origin].yaw_,
-                   0.0);  // assume pitch is zero at every node
-
-      Histogram propagated_histogram = Histogram(2 * ALPHA_RES);
-      Histogram histogram = Histogram(ALPHA_RES);
-
-      propagateHistogram(propagated_histogram, reprojected_points_,
-                         reprojected_points_age_, reprojected_points_dist_,
-                         pose_);
-      generateNewHistogram(histogram, cropped_cloud, pose_);
-      combinedHistogram(hist_is_empty, histogram, propagated_histogram, false,
-                        z_FOV_idx, e_FOV_min, e_FOV_max);
-
-      // calculate candidates
-      histogram.downsample();
-      findFreeDirections(histogram, 25, path_candidates, path_selected,
-                         path_rejected, path_blocked, path_waypoints_,
-                         cost_path_candidates, goal_,
-                         toEigen(pose_.pose.position), origin_origin_position,
-                         goal_cost_param_, smooth_cost_param_,
-                         height_change_cost_param_adapted_,
-                         height_change_cost_param_, false, 2 * ALPHA_RES);
-
-      if (calculateCostMap(cost_path_candidates, cost_idx_sorted)) {
-        tree_[origin].total_cost_ = HUGE_VAL;
+    if (expansions_.count(origin) == 0) {
+      expandNodes(origin);
+    }
+    NodeExpansion& expansion = expansions_[origin];
+    const std::vector<candidateDirection>& candidates = expansion.candidates;
+    CandidateOrder& cost_order = expansion.cost_order;
+
+    // open the grafted child of the origin if its direction is still free,
+    // otherwise drop it and the rest of the grafted path
+    if (n_grafted_open < grafted_nodes.size() &&
+        tree_[grafted_nodes[n_grafted_open]].origin_ == origin) {
+      int node = grafted_nodes[n_grafted_open];
+      if (expansion.valid &&
+          isCandidateDirection(candidates, tree_[node].last_e_,
+                               tree_[node].last_z_)) {
+        addNodeToVoxels(node);
+        open_set.push(CostIndex(tree_[node].total_cost_, node));
+        n_grafted_open++;
       } else {
-        // insert new nodes
-        int depth = tree_[origin].depth_ + 1;
-        int childs = 0;
-        for (int i = 0; i < (int)path_candidates.cells.size(); i++) {
-          int e = path_candidates.cells[cost_idx_sorted[i]].x;
-          int z = path_candidates.cells[cost_idx_sorted[i]].y;
-
-          // check if another close node has been added
-          Eigen::Vector3f node_location = fromPolarToCartesian(
-              e, z, tree_node_distance_, toPoint(origin_position));
-          int close_nodes = 0;
-          for (size_t i = 0; i < tree_.size(); i++) {
-            double dist = (tree_[i].getPosition() - node_location).norm();
-            if (dist < 0.2) {
-              close_nodes++;
-            }
-          }
-
-          if (childs < childs_per_node_ && close_nodes == 0) {
-            tree_.push_back(TreeNode(origin, depth, node_location));
-            tree_.back().last_e_ = e;
-            tree_.back().last_z_ = z;
-            double h = treeHeuristicFunction(tree_.size() - 1);
-            double c = treeCostFunction(tree_.size() - 1);
-            tree_.back().heuristic_ = h;
-            tree_.back().total_cost_ =
-                tree_[origin].total_cost_ - tree_[origin].heuristic_ + c + h;
-            Eigen::Vector3f diff = node_location - origin_position;
-            tree_.back().yaw_ = atan2(diff.y(), diff.x());
-            childs++;
+        for (size_t i = n_grafted_open; i < grafted_nodes.size(); i++) {
+          tree_[grafted_nodes[i]].total_cost_ = HUGE_VAL;
+          auto it = path_expansions_.find(grafted_nodes[i]);
+          if (it != path_expansions_.end()) {
+            spare_expansions_.push_back(std::move(it->second));
+            path_expansions_.erase(it);
           }
         }
+        grafted_nodes.resize(n_grafted_open);
       }
     }
 
-    closed_set_.push_back(origin);
-    n++;
+    if (!expansion.valid) {
+      tree_[origin].total_cost_ = HUGE_VAL;
+    } else {
+      // insert new nodes
+      int depth = tree_[origin].depth_ + 1;
+      int childs = 0;
+      const int first_child = tree_.size();
+      for (int i = 0; i < (int)candidates.size(); i++) {
+        int e = candidates[cost_order.at(i)].elevation_angle;
+        int z = candidates[cost_order.at(i)].azimuth_angle;
+
+        if (childs >= childs_per_node_) {
+          break;
+        }
 
-    // find best node to continue
-    double minimal_cost = HUGE_VAL;
-    for (size_t i = 0; i < tree_.size(); i++) {
-      bool closed = false;
-      for (size_t j = 0; j < closed_set_.size(); j++) {
-        if (closed_set_[j] == (int)i) {
-          closed = true;
+        // check if another close node has been added
+        Eigen::Vector3f node_location = fromPolarToCartesian(
+            e, z, tree_node_distance_, toPoint(origin_position));
+
+        if (!hasCloseNode(node_location)) {
+          tree_.push_back(TreeNode(origin, depth, node_location));
+          tree_.back().last_e_ = e;
+          tree_.back().last_z_ = z;
+          Eigen::Vector3f diff = node_location - origin_position;
+          tree_.back().yaw_ = atan2(diff.y(), diff.x());
+          addNodeToVoxels(tree_.size() - 1);
+          childs++;
         }
       }
-      if (tree_[i].total_cost_ < minimal_cost && !closed) {
-        minimal_cost = tree_[i].total_cost_;
-        origin = i;
+
+      scoreNodes(origin, first_child);
+      for (int node = first_child; node < static_cast<int>(tree_.size());
+           node++) {
+        if (tree_[node].total_cost_ < HUGE_VAL) {
+          open_set.push(CostIndex(tree_[node].total_cost_, node));
+        }
       }
     }
+
+    closed_set_.push_back(origin);
+    tree_[origin].closed_ = true;
+    n++;
+
+    // find best node to continue, if there is none expand the origin again
+    while (!open_set.empty() && tree_[open_set.top().second].closed_) {
+      open_set.pop();
+    }
+    if (!open_set.empty()) {
+      origin = open_set.top().second;
+    }
   }
   // smoothing between trees
   int tree_end = origin;
@@ -278,6 +644,23 @@ void StarPlanner::buildLookAheadTree() {
   path_node_origins_.push_back(0);
   tree_age_ = 0;
 
+  // keep the expansions of the new path only, the others belong to nodes
+  // which are not on it
+  std::unordered_map<int, NodeExpansion> grafted_expansions;
+  grafted_expansions.swap(path_expansions_);
+  if (tree_warm_start_) {
+    for (int node : path_node_origins_) {
+      auto it = expansions_.find(node);
+      if (it != expansions_.end()) {
+        path_expansions_[node] = std::move(it->second);
+      } else if ((it = grafted_expansions.find(node)) !=
+                 grafted_expansions.end()) {
+        path_expansions_[node] = std::move(it->second);
+      }
+    }
+  }
+  recycleExpansions(grafted_expansions);
+
   ROS_INFO("\033[0;35m[SP]Tree calculated in %2.2fms.\033[0m",
            (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
 }
@@ -3,6 +3,9 @@
 
 #include "box.h"
 #include "histogram.h"
+#include "histogram_binning.h"
+#include "planner_functions.h"
+#include "worker_pool.h"
 
 #include <Eigen/Dense>
 
@@ -17,6 +20,9 @@
 #include <dynamic_reconfigure/server.h>
 #include <local_planner/LocalPlannerNodeConfig.h>
 
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace avoidance {
@@ -29,6 +35,9 @@ class StarPlanner {
   int n_expanded_nodes_ = 5;
   double tree_node_distance_ = 1.0;
   double tree_discount_factor_ = 0.8;
+  // tree_discount_factor_ to the power of the depth
+  std::vector<double> depth_discounts_;
+  bool tree_warm_start_ = false;
   double goal_cost_param_;
   double smooth_cost_param_;
   double height_change_cost_param_adapted_;
@@ -41,18 +50,110 @@ class StarPlanner {
   double min_realsense_dist_;
   double ground_distance_ = 2.0;
 
-  std::vector<double> reprojected_points_age_;
-  std::vector<double> reprojected_points_dist_;
   std::vector<int> path_node_origins_;
 
+  // points of the camera clouds which can lie in the box of any tree node
   std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud_;
-  pcl::PointCloud<pcl::PointXYZ> reprojected_points_;
 
   Eigen::Vector3f goal_;
   geometry_msgs::PoseStamped pose_;
 
   nav_msgs::GridCells path_waypoints_;
   Box histogram_box_;
+  // histogram of the remembered obstacles as seen from the vehicle pose, it
+  // is the same for all nodes
+  Histogram propagated_histogram_ = Histogram(ALPHA_RES);
+
+  // maximum number of tree nodes expanded concurrently
+  int expansion_threads_;
+
+  // result of expanding a tree node, which does not depend on the rest of the
+  // tree and can therefore be computed ahead of time
+  struct NodeExpansion {
+    bool valid = false;
+    std::vector<candidateDirection> candidates;
+    CandidateOrder cost_order;
+    // with warm start, what the expansion was computed from
+    Eigen::Vector3f origin_position;
+    Eigen::Vector3f goal;
+    Eigen::Vector3f pose_position;
+    double yaw;
+    int propagated_version;
+    Histogram histogram = Histogram(ALPHA_RES);  // binned, before combining
+  };
+
+  // expansions of the nodes on the last path, by their index in tree_. With
+  // warm start they are reused while the node origins, the goal, the
+  // propagated histogram and the binned cells of the nodes don't change, and
+  // the pose stays within warm_start_pose_tolerance_
+  std::unordered_map<int, NodeExpansion> path_expansions_;
+  const float warm_start_pose_tolerance_ = 0.1f;
+  // counts the changes of the occupied cells of propagated_histogram_
+  int propagated_version_ = 0;
+  // expansions of the current tree and the ones of earlier trees which are
+  // not used any more, such that their buffers keep their capacity
+  std::unordered_map<int, NodeExpansion> expansions_;
+  std::vector<NodeExpansion> spare_expansions_;
+
+  // working memory of one expansion, one for each of the concurrent ones
+  struct ExpansionBuffers {
+    binningResult binning;
+    pcl::PointCloud<pcl::PointXYZ> cropped_cloud;
+    Histogram histogram = Histogram(ALPHA_RES);
+    std::vector<int> z_FOV_idx;
+    std::vector<bool> z_FOV_mask;
+    nav_msgs::GridCells path_selected;
+    nav_msgs::GridCells path_rejected;
+    nav_msgs::GridCells path_blocked;
+  };
+  std::vector<ExpansionBuffers> expansion_buffers_;
+  // runs the speculative expansions, one thread less than expansion_buffers_
+  // as the planner thread expands the origin
+  std::unique_ptr<WorkerPool> expansion_pool_;
+
+  // crops complete_cloud_ and builds the histograms of the expansions
+  std::unique_ptr<BinningBackend> binning_backend_;
+
+  // the tree before the current one, kept for its capacity
+  std::vector<TreeNode> last_tree_;
+
+  // tree nodes by the voxel of edge length min_node_distance_ they lie in
+  const double min_node_distance_ = 0.2;
+  std::unordered_map<int64_t, std::vector<int>> node_voxels_;
+
+  // the terms of the costs which are the same for all children of an origin
+  struct OriginTerms {
+    Eigen::Vector3f position;
+    float goal_e, goal_z;  // direction from the origin to the goal
+    float last_e, last_z;  // direction from its own origin to the origin
+    double goal_dist;
+    int depth;        // of the children
+    double discount;  // of the depth of the children
+    // node of the last path at the depth of the children
+    bool has_partner = false;
+    Eigen::Vector3f partner_position;
+  };
+
+  void setDiscountFactor(double tree_discount_factor);
+  double depthDiscount(int depth) const;
+  OriginTerms originTerms(int origin, int depth) const;
+  double nodeCost(int node_number, const OriginTerms& terms) const;
+  double nodeHeuristic(int node_number, const OriginTerms& terms) const;
+  void scoreNodes(int origin, int first_node);
+
+  int64_t voxelKey(int x, int y, int z) const;
+  void addNodeToVoxels(int node_number);
+  bool hasCloseNode(const Eigen::Vector3f& position) const;
+  void graftLastPath(const std::vector<TreeNode>& last_tree,
+                     std::vector<int>& grafted_nodes);
+  const NodeExpansion* cachedExpansion(int node_number) const;
+  void recycleExpansions(std::unordered_map<int, NodeExpansion>& expansions);
+  NodeExpansion& addExpansion(int node_number);
+  binningQuery nodeQuery(int node_number) const;
+  binningParams binningParameters() const;
+  void expandNode(int node_number, NodeExpansion& expansion,
+                  ExpansionBuffers& buffers) const;
+  void expandNodes(int origin);
 
  public:
   std::vector<geometry_msgs::Point> path_node_positions_;
@@ -68,16 +169,15 @@ class StarPlanner {
                  const nav_msgs::GridCells& path_waypoints, double curr_yaw,
                  double min_realsense_dist);
   void setFOV(double h_FOV, double v_FOV);
-  void setReprojectedPoints(
-      const pcl::PointCloud<pcl::PointXYZ>& reprojected_points,
-      const std::vector<double>& reprojected_points_age,
-      const std::vector<double>& reprojected_points_dist);
+  void setPropagatedHistogram(const Histogram& propagated_histogram);
   void setCostParams(double goal_cost_param, double smooth_cost_param,
                      double height_change_cost_param_adapted,
                      double height_change_cost_param);
   void setPose(const geometry_msgs::PoseStamped& pose);
   void setBoxSize(const Box& histogram_box, double ground_distance);
   void setGoal(const geometry_msgs::Point& pose);
+  // crops the cloud around the pose, setPose and setBoxSize of the same
+  // frame need to be called first
   void setCloud(
       const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud);
   double treeCostFunction(int node_number);
@@ -9,7 +9,8 @@ TreeNode::TreeNode()
       last_z_{0},
       origin_{0},
       depth_{0},
-      yaw_{0.0} {
+      yaw_{0.0},
+      closed_{false} {
   position_ = Eigen::Vector3f::Zero();
 }
 
@@ -20,7 +21,8 @@ TreeNode::TreeNode(int from, int d, const Eigen::Vector3f& pos)
       last_z_{0},
       origin_{from},
       depth_{d},
-      yaw_{0.0} {
+      yaw_{0.0},
+      closed_{false} {
   position_ = pos;
 }
 
@@ -31,5 +33,5 @@ void TreeNode::setCosts(double h, double c) {
   total_cost_ = c;
 }
 
-Eigen::Vector3f TreeNode::getPosition() { return position_; }
+Eigen::Vector3f TreeNode::getPosition() const { return position_; }
 }
@@ -17,13 +17,14 @@ class TreeNode {
   int origin_;
   int depth_;
   double yaw_;
+  bool closed_;
 
   TreeNode();
   TreeNode(int from, int d, const Eigen::Vector3f& pos);
   ~TreeNode();
 
   void setCosts(double h, double c);
-  Eigen::Vector3f getPosition();
+  Eigen::Vector3f getPosition() const;
 };
 }
 
@@ -0,0 +1,58 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace avoidance {
+
+/**
+* @brief Lock-free handoff of the latest value from one producer thread to one
+*        consumer thread. The producer fills back() and publishes it, the
+*        consumer picks up the most recently published value with update().
+*        Values published in between are overwritten, neither side blocks.
+**/
+template <typename T>
+class TripleBuffer {
+  static const int INDEX_MASK = 3;
+  static const int NEW_DATA = 4;
+
+  T buffers_[3];
+  int back_ = 0;
+  int front_ = 1;
+  // index of the buffer exchanged between the two sides and a flag telling if
+  // it holds data the consumer has not seen yet
+  std::atomic<int> middle_{2};
+
+ public:
+  /**
+  * @brief     producer side: buffer to fill before calling publish. It
+  *            contains an older value which can be reused or overwritten
+  **/
+  T& back() { return buffers_[back_]; }
+
+  /**
+  * @brief     producer side: makes the content of back() available to the
+  *            consumer and hands out a new back buffer
+  **/
+  void publish() { back_ = middle_.exchange(back_ | NEW_DATA) & INDEX_MASK; }
+
+  /**
+  * @brief     consumer side: switches front() to the latest published value
+  * @returns   true if a value was published since the last update
+  **/
+  bool update() {
+    if (!(middle_.load() & NEW_DATA)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_) & INDEX_MASK;
+    return true;
+  }
+
+  /**
+  * @brief     consumer side: latest value picked up by update
+  **/
+  T& front() { return buffers_[front_]; }
+};
+}
+
+#endif  // TRIPLE_BUFFER_H
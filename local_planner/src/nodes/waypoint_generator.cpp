@@ -18,9 +18,10 @@ void WaypointGenerator::calculateWaypoint() {
       pose_.pose.position.x, pose_.pose.position.y, pose_.pose.position.z);
   output_.waypoint_type = planner_info_.waypoint_type;
 
-  // Timing
+  // Timing, of the updates such that the steps don't depend on when the
+  // waypoints are requested
   last_time_ = current_time_;
-  current_time_ = ros::Time::now();
+  current_time_ = update_time_;
 
   switch (planner_info_.waypoint_type) {
     case hover: {
@@ -49,7 +50,7 @@ void WaypointGenerator::calculateWaypoint() {
           p, planner_info_.path_node_positions, toEigen(pose_.pose.position));
       double dist_goal = (goal_ - toEigen(pose_.pose.position)).norm();
       ros::Duration since_last_path =
-          ros::Time::now() - planner_info_.last_path_time;
+          update_time_ - planner_info_.last_path_time;
       if (tree_available && (planner_info_.obstacle_ahead || dist_goal > 4.0) &&
           since_last_path < ros::Duration(5)) {
         ROS_DEBUG("[WG] Use calculated tree\n");
@@ -248,7 +249,7 @@ void WaypointGenerator::smoothWaypoint(double dt) {
 }
 
 void WaypointGenerator::adaptSpeed() {
-  ros::Duration since_last_velocity = ros::Time::now() - velocity_time_;
+  ros::Duration since_last_velocity = update_time_ - velocity_time_;
   double since_last_velocity_sec = since_last_velocity.toSec();
 
   if (!planner_info_.obstacle_ahead) {
@@ -294,7 +295,7 @@ void WaypointGenerator::adaptSpeed() {
       }
     }
   }
-  velocity_time_ = ros::Time::now();
+  velocity_time_ = update_time_;
 
   // calculate correction for computation delay
   ros::Duration since_update = ros::Time::now() - update_time_;
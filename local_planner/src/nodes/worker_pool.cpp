@@ -0,0 +1,71 @@
+#include "worker_pool.h"
+
+namespace avoidance {
+
+WorkerPool::WorkerPool(int n_threads) {
+  for (int i = 0; i < n_threads; i++) {
+    threads_.emplace_back(&WorkerPool::work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  batch_started_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(int n_tasks, const std::function<void(int)>& task) {
+  if (n_tasks <= 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  n_tasks_ = n_tasks;
+  next_task_ = 1;
+  n_pending_ = n_tasks - 1;
+  batch_++;
+  lock.unlock();
+  if (n_tasks > 1) {
+    batch_started_.notify_all();
+  }
+
+  task(0);
+
+  // take the tasks no thread has started yet, then wait for the others
+  lock.lock();
+  runTasks(lock);
+  batch_done_.wait(lock, [this] { return n_pending_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex>& lock) {
+  while (next_task_ < n_tasks_) {
+    int i = next_task_++;
+    lock.unlock();
+    (*task_)(i);
+    lock.lock();
+    if (--n_pending_ == 0) {
+      batch_done_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t last_batch = batch_;
+  while (true) {
+    batch_started_.wait(lock,
+                        [&] { return stop_ || batch_ != last_batch; });
+    if (stop_) {
+      return;
+    }
+    last_batch = batch_;
+    runTasks(lock);
+  }
+}
+}
@@ -0,0 +1,53 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief Threads which are started once and then run the tasks of one batch
+*        after the other, such that a batch does not need to start threads.
+*        The thread calling run works on the batch too.
+**/
+class WorkerPool {
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable batch_started_;
+  std::condition_variable batch_done_;
+  const std::function<void(int)>* task_ = nullptr;
+  int n_tasks_ = 0;
+  int next_task_ = 0;
+  int n_pending_ = 0;
+  uint64_t batch_ = 0;
+  bool stop_ = false;
+
+  void work();
+  // runs the tasks which have not been taken yet, the lock is held between
+  // them
+  void runTasks(std::unique_lock<std::mutex>& lock);
+
+ public:
+  /**
+  * @brief     starts n_threads threads, with none the batches run on the
+  *            thread calling run
+  **/
+  explicit WorkerPool(int n_threads);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /**
+  * @brief     calls task(i) for every i from 0 to n_tasks - 1 and returns once
+  *            all calls have returned. Task 0 runs on the calling thread
+  **/
+  void run(int n_tasks, const std::function<void(int)>& task);
+};
+}
+
+#endif  // WORKER_POOL_H
@@ -125,6 +125,40 @@ TEST(Common, elevationAnglefromCartesian) {
   EXPECT_FLOAT_EQ(-50.194428, angle_non_zero_origin);
 }
 
+TEST(Common, fastAnglesfromCartesianGiveSameIndex) {
+  // GIVEN: an origin and points in all directions, some of them exactly on an
+  // integer degree
+  const Eigen::Vector3f origin(0.81f, 5.17f, 3.84f);
+  std::vector<Eigen::Vector3f> points = {
+      origin, origin + Eigen::Vector3f(1.f, 0.f, 0.f),
+      origin + Eigen::Vector3f(0.f, -1.f, 0.f),
+      origin + Eigen::Vector3f(0.f, 0.f, 1.f),
+      origin + Eigen::Vector3f(1.f, 1.f, 1.f)};
+  for (float x = -5.f; x <= 5.f; x = x + 0.37f) {
+    for (float y = -5.f; y <= 5.f; y = y + 0.41f) {
+      for (float z = -5.f; z <= 5.f; z = z + 0.43f) {
+        points.push_back(origin + Eigen::Vector3f(x, y, z));
+      }
+    }
+  }
+
+  for (const Eigen::Vector3f& p : points) {
+    // WHEN: computing the angles with the exact and the fast functions
+    float z_exact = azimuthAnglefromCartesian(p, origin);
+    float e_exact = elevationAnglefromCartesian(p, origin);
+    float z_fast = fastAzimuthAnglefromCartesian(p, origin);
+    float e_fast = fastElevationAnglefromCartesian(p, origin);
+
+    // THEN: they are close and truncate and floor to the same integer degree
+    EXPECT_NEAR(z_exact, z_fast, 1e-3);
+    EXPECT_NEAR(e_exact, e_fast, 1e-3);
+    EXPECT_EQ(static_cast<int>(z_exact), static_cast<int>(z_fast));
+    EXPECT_EQ(static_cast<int>(e_exact), static_cast<int>(e_fast));
+    EXPECT_EQ(std::floor(z_exact), std::floor(z_fast));
+    EXPECT_EQ(std::floor(e_exact), std::floor(e_fast));
+  }
+}
+
 TEST(Common, elevationAngletoIndex) {
   // GIVEN: the elevation angle of a point and the histogram resolution
   const float elevation_1 = 0.f;
@@ -268,6 +302,15 @@ TEST(Common, fromPolarToCartesian) {
   EXPECT_NEAR(1.f, pos_out[9].x(), 0.00001);
   EXPECT_NEAR(1.f, pos_out[9].y(), 0.00001);
   EXPECT_NEAR(1.414213562, pos_out[9].z(), 0.00001);
+
+  // WHEN: converting a point at non integer angles
+  Eigen::Vector3f pos_non_integer =
+      fromPolarToCartesian(30.5f, -60.25f, radius[1], toPoint(pos));
+
+  // THEN: the cartesian coordinates are
+  EXPECT_NEAR(-1.496131, pos_non_integer.x(), 0.00001);
+  EXPECT_NEAR(0.855109, pos_non_integer.y(), 0.00001);
+  EXPECT_NEAR(1.015077, pos_non_integer.z(), 0.00001);
 }
 
 TEST(Common, PolarToCatesianToPolar) {
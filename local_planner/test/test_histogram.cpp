@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/histogram.h"
+
+using namespace avoidance;
+
+TEST(Histogram, getWrapsIndices) {
+  // GIVEN: a histogram with a single occupied cell
+  Histogram histogram = Histogram(ALPHA_RES);
+  histogram.set_bin(2, 3, 1.0);
+  histogram.set_dist(2, 3, 4.5);
+
+  // WHEN: we read the cell with indices shifted by whole periods
+  // THEN: the same cell is returned
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(2, 3));
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(2 + GRID_LENGTH_E, 3));
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(2 - GRID_LENGTH_E, 3));
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(2, 3 + 2 * GRID_LENGTH_Z));
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(2, 3 - 3 * GRID_LENGTH_Z));
+  EXPECT_DOUBLE_EQ(4.5,
+                   histogram.get_dist(2 - GRID_LENGTH_E, 3 - GRID_LENGTH_Z));
+  EXPECT_DOUBLE_EQ(0.0, histogram.get_bin(3, 2));
+}
+
+TEST(Histogram, upsampleDownsample) {
+  // GIVEN: a low resolution histogram with some occupied cells
+  Histogram histogram = Histogram(2 * ALPHA_RES);
+  const int e_dim = GRID_LENGTH_E / 2;
+  const int z_dim = GRID_LENGTH_Z / 2;
+  for (int e = 0; e < e_dim; e++) {
+    for (int z = 0; z < z_dim; z++) {
+      if ((e + 2 * z) % 3 == 0) {
+        histogram.set_bin(e, z, 1.0);
+        histogram.set_age(e, z, e);
+        histogram.set_dist(e, z, z + 0.5);
+      }
+    }
+  }
+
+  // WHEN: we upsample it
+  histogram.upsample();
+
+  // THEN: every high resolution cell takes the value of its low resolution
+  // cell
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      bool occupied = ((e / 2) + 2 * (z / 2)) % 3 == 0;
+      EXPECT_DOUBLE_EQ(occupied ? 1.0 : 0.0, histogram.get_bin(e, z));
+      EXPECT_DOUBLE_EQ(occupied ? e / 2 : 0.0, histogram.get_age(e, z));
+      EXPECT_DOUBLE_EQ(occupied ? z / 2 + 0.5 : 0.0, histogram.get_dist(e, z));
+    }
+  }
+
+  // WHEN: we downsample it again
+  histogram.downsample();
+
+  // THEN: we get back the original histogram
+  for (int e = 0; e < e_dim; e++) {
+    for (int z = 0; z < z_dim; z++) {
+      bool occupied = (e + 2 * z) % 3 == 0;
+      EXPECT_DOUBLE_EQ(occupied ? 1.0 : 0.0, histogram.get_bin(e, z));
+      EXPECT_DOUBLE_EQ(occupied ? e : 0.0, histogram.get_age(e, z));
+      EXPECT_DOUBLE_EQ(occupied ? z + 0.5 : 0.0, histogram.get_dist(e, z));
+    }
+  }
+}
+
+TEST(Histogram, resetClearsAndChangesResolution) {
+  // GIVEN: a downsampled histogram with an occupied cell
+  Histogram histogram = Histogram(ALPHA_RES);
+  histogram.set_bin(0, 0, 1.0);
+  histogram.downsample();
+
+  // WHEN: we reset it to the original resolution
+  histogram.reset(ALPHA_RES);
+
+  // THEN: it is empty and has the original dimensions
+  histogram.set_bin(GRID_LENGTH_E - 1, GRID_LENGTH_Z - 1, 1.0);
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      bool occupied = e == GRID_LENGTH_E - 1 && z == GRID_LENGTH_Z - 1;
+      EXPECT_DOUBLE_EQ(occupied ? 1.0 : 0.0, histogram.get_bin(e, z));
+    }
+  }
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/histogram_binning.h"
+#include "../src/nodes/planner_functions.h"
+
+using namespace avoidance;
+
+namespace {
+// points on a few walls around the origin
+std::vector<pcl::PointCloud<pcl::PointXYZ>> wallClouds() {
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(2);
+  for (float y = -3.f; y <= 3.f; y += 0.1f) {
+    for (float z = 0.f; z <= 4.f; z += 0.1f) {
+      complete_cloud[0].push_back(pcl::PointXYZ(3.f, y, z));
+      complete_cloud[1].push_back(pcl::PointXYZ(y, -2.5f, z));
+    }
+  }
+  complete_cloud[1].push_back(pcl::PointXYZ(NAN, NAN, NAN));
+  return complete_cloud;
+}
+
+binningQuery queryAt(const Eigen::Vector3f& position) {
+  binningQuery query;
+  query.position = position;
+  query.histogram_position = Eigen::Vector3f(0.f, 0.f, 2.f);
+  query.box = Box(5.0);
+  query.box.setBoxLimits(toPoint(position), 2.0);
+  return query;
+}
+}
+
+TEST(HistogramBinning, cpuBackendMatchesFilterPointCloud) {
+  // GIVEN: the CPU backend with the clouds of two walls and a few queries
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud = wallClouds();
+  CpuBinningBackend backend;
+  backend.setCloud(complete_cloud);
+  binningParams params;
+  params.min_cloud_size = 20.0;
+  params.min_dist_backoff = 1.5;
+  params.min_realsense_dist = 0.2;
+  std::vector<binningQuery> queries = {
+      queryAt(Eigen::Vector3f(0.f, 0.f, 2.f)),
+      queryAt(Eigen::Vector3f(2.f, 1.f, 2.5f)),
+      queryAt(Eigen::Vector3f(-20.f, 0.f, 2.f))};
+  // at another resolution, which the backend resets
+  std::vector<Histogram> histograms(queries.size(),
+                                    Histogram(2 * ALPHA_RES));
+  std::vector<Histogram*> histogram_ptrs;
+  for (Histogram& histogram : histograms) {
+    histogram_ptrs.push_back(&histogram);
+  }
+
+  // WHEN: the queries are binned in one batch
+  std::vector<binningResult> results(queries.size());
+  pcl::PointCloud<pcl::PointXYZ> scratch;
+  backend.binPoints(params, queries.data(), histogram_ptrs.data(),
+                    results.data(), queries.size(), scratch);
+
+  // THEN: the histograms and counts are the ones of filterPointCloud
+  EXPECT_FALSE(backend.batched());
+  for (size_t i = 0; i < queries.size(); i++) {
+    pcl::PointCloud<pcl::PointXYZ> cropped_cloud;
+    Histogram expected(ALPHA_RES);
+    Eigen::Vector3f closest_point;
+    double distance_to_closest_point;
+    int counter_backoff = 0;
+    size_t n_points = filterPointCloud(
+        cropped_cloud, expected, closest_point, distance_to_closest_point,
+        counter_backoff, complete_cloud, params.min_cloud_size,
+        params.min_dist_backoff, queries[i].box, queries[i].position,
+        queries[i].histogram_position, params.min_realsense_dist, 0.0);
+    EXPECT_EQ(n_points, results[i].n_points) << i;
+    EXPECT_EQ(counter_backoff, results[i].counter_backoff) << i;
+    for (int e = 0; e < GRID_LENGTH_E; e++) {
+      for (int z = 0; z < GRID_LENGTH_Z; z++) {
+        EXPECT_EQ(expected.get_bin(e, z), histograms[i].get_bin(e, z));
+        EXPECT_EQ(expected.get_dist(e, z), histograms[i].get_dist(e, z));
+      }
+    }
+  }
+  EXPECT_GT(results[0].n_points, 0u);
+  EXPECT_GT(results[1].counter_backoff, 0);
+  EXPECT_EQ(0u, results[2].n_points);
+}
+
+TEST(HistogramBinning, createdBackendBinsTheCloud) {
+  // GIVEN: the backend of this build, CUDA if it was built with it and there
+  // is a device, and the same query binned by the CPU backend
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud = wallClouds();
+  std::unique_ptr<BinningBackend> backend = createBinningBackend();
+  ASSERT_TRUE(backend != nullptr);
+  backend->setCloud(complete_cloud);
+  CpuBinningBackend cpu_backend;
+  cpu_backend.setCloud(complete_cloud);
+  binningParams params;
+  params.min_dist_backoff = 1.0;
+  const binningQuery query = queryAt(Eigen::Vector3f(0.f, 0.f, 2.f));
+
+  // WHEN: both bin the points
+  Histogram histogram(ALPHA_RES), cpu_histogram(ALPHA_RES);
+  Histogram* histogram_ptr = &histogram;
+  Histogram* cpu_histogram_ptr = &cpu_histogram;
+  binningResult result, cpu_result;
+  pcl::PointCloud<pcl::PointXYZ> scratch;
+  backend->binPoints(params, &query, &histogram_ptr, &result, 1, scratch);
+  cpu_backend.binPoints(params, &query, &cpu_histogram_ptr, &cpu_result, 1,
+                        scratch);
+
+  // THEN: they find the same points in the same cells, the distances can
+  // differ by the order of the sums
+  EXPECT_EQ(cpu_result.n_points, result.n_points);
+  EXPECT_EQ(cpu_result.counter_backoff, result.counter_backoff);
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      EXPECT_EQ(cpu_histogram.get_bin(e, z), histogram.get_bin(e, z));
+      EXPECT_NEAR(cpu_histogram.get_dist(e, z), histogram.get_dist(e, z),
+                  1e-4);
+    }
+  }
+}
@@ -121,6 +121,17 @@ TEST_F(LocalPlannerTests, all_obstacles) {
 
   bool steer_clear = node_max_y > max_y || node_min_y < min_y;
   EXPECT_TRUE(steer_clear);
+
+  // AND: the histogram image has one byte per cell and shows the obstacle
+  sensor_msgs::Image image;
+  planner.getHistogramImage(image);
+  EXPECT_EQ(GRID_LENGTH_Z, image.step);
+  ASSERT_EQ(GRID_LENGTH_E * GRID_LENGTH_Z, image.data.size());
+  int n_obstacle_pixels = 0;
+  for (uint8_t pixel : image.data) {
+    n_obstacle_pixels += pixel > 0;
+  }
+  EXPECT_GT(n_obstacle_pixels, 0);
 }
 
 TEST_F(LocalPlannerTests, obstacles_right) {
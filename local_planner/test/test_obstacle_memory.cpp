@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/obstacle_memory.h"
+
+using namespace avoidance;
+
+namespace {
+// cloud of a square wall in front of position at the given distance
+pcl::PointCloud<pcl::PointXYZ> wallCloud(const Eigen::Vector3f& position,
+                                         float distance) {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (float x = -1.f; x <= 1.f; x += 0.1f) {
+    for (float z = -1.f; z <= 1.f; z += 0.1f) {
+      cloud.push_back(toXYZ(position + Eigen::Vector3f(x, distance, z)));
+    }
+  }
+  return cloud;
+}
+}
+
+TEST(ObstacleMemory, remembersObstaclesOutsideFOV) {
+  // GIVEN: a memory which has seen a wall in front of the vehicle
+  ObstacleMemory memory(0.5f, 14.f);
+  const Eigen::Vector3f position(1.f, 2.f, 3.f);
+  memory.update(wallCloud(position, 3.f), true);
+  const size_t n_voxels = memory.size();
+  ASSERT_GT(n_voxels, 0);
+
+  // WHEN: the FOV has turned away from the wall and no new points arrive
+  std::vector<int> z_FOV_idx = {0, 1, 2, 3, 4};
+  Histogram histogram = Histogram(ALPHA_RES);
+  memory.update(pcl::PointCloud<pcl::PointXYZ>(), true);
+  memory.getHistogram(histogram, position, z_FOV_idx, 0, GRID_LENGTH_E, 0.3f,
+                      50);
+
+  // THEN: the wall is still in the histogram in the direction of the goal
+  // with its distance and age
+  EXPECT_EQ(n_voxels, memory.size());
+  int e = elevationAngletoIndex(0, ALPHA_RES);
+  int z = azimuthAngletoIndex(0, ALPHA_RES);
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_bin(e, z));
+  EXPECT_NEAR(3.f, histogram.get_dist(e, z), 0.1);
+  EXPECT_DOUBLE_EQ(1.0, histogram.get_age(e, z));
+  EXPECT_DOUBLE_EQ(0.0, histogram.get_bin(e, z + GRID_LENGTH_Z / 2));
+}
+
+TEST(ObstacleMemory, forgetsOldFarAndUnobservedObstacles) {
+  // GIVEN: a memory which has seen a wall in front of the vehicle
+  ObstacleMemory memory(0.5f, 14.f);
+  const Eigen::Vector3f position(1.f, 2.f, 3.f);
+  memory.update(wallCloud(position, 3.f), true);
+  std::vector<int> z_FOV_idx = {0, 1, 2, 3, 4};
+  std::vector<int> z_FOV_idx_front;
+  for (int z = 25; z < 35; z++) {
+    z_FOV_idx_front.push_back(z);
+  }
+  Histogram histogram = Histogram(ALPHA_RES);
+
+  // WHEN: the wall gets older than the maximum age
+  memory.update(pcl::PointCloud<pcl::PointXYZ>(), true);
+  memory.update(pcl::PointCloud<pcl::PointXYZ>(), true);
+  memory.getHistogram(histogram, position, z_FOV_idx, 0, GRID_LENGTH_E, 0.3f,
+                      2);
+
+  // THEN: it is forgotten
+  EXPECT_EQ(0, memory.size());
+
+  // WHEN: the wall is seen again and the vehicle moves far away from it
+  memory.update(wallCloud(position, 3.f), true);
+  memory.getHistogram(histogram, position + Eigen::Vector3f(0.f, -20.f, 0.f),
+                      z_FOV_idx, 0, GRID_LENGTH_E, 0.3f, 50);
+
+  // THEN: it is forgotten
+  EXPECT_EQ(0, memory.size());
+
+  // WHEN: the wall is seen, but is not observed in the next update although
+  // it is inside the FOV
+  memory.update(wallCloud(position, 3.f), true);
+  memory.getHistogram(histogram, position, z_FOV_idx_front, 0, GRID_LENGTH_E,
+                      0.3f, 50);
+  EXPECT_GT(memory.size(), 0);
+  memory.update(pcl::PointCloud<pcl::PointXYZ>(), true);
+  memory.getHistogram(histogram, position, z_FOV_idx_front, 0, GRID_LENGTH_E,
+                      0.3f, 50);
+
+  // THEN: it is forgotten
+  EXPECT_EQ(0, memory.size());
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      EXPECT_DOUBLE_EQ(0.0, histogram.get_bin(e, z));
+    }
+  }
+}
+
+TEST(ObstacleMemory, rollsWithTheVehicle) {
+  // GIVEN: a small memory
+  ObstacleMemory memory(0.5f, 5.f);
+  std::vector<int> z_FOV_idx = {0};
+  Histogram histogram = Histogram(ALPHA_RES);
+  pcl::PointCloud<pcl::PointXYZ> points;
+
+  // WHEN: the vehicle flies far along a wall while the memory sees it
+  for (int i = 0; i < 100; i++) {
+    Eigen::Vector3f position(0.5f * i, 0.f, 0.f);
+    memory.update(wallCloud(position, 3.f), true);
+    memory.getHistogram(histogram, position, z_FOV_idx, 0, GRID_LENGTH_E,
+                        0.3f, 1000);
+
+    // THEN: only the part of the wall which is within range is remembered
+    memory.getPoints(points);
+    EXPECT_EQ(memory.size(), points.points.size());
+    for (const pcl::PointXYZ& p : points) {
+      EXPECT_LE((toEigen(p) - position).norm(), 5.f);
+    }
+  }
+  EXPECT_GT(memory.size(), 0);
+}
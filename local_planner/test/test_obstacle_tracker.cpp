@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/obstacle_tracker.h"
+
+using namespace avoidance;
+
+namespace {
+// cloud of a box of 0.6m side around center
+pcl::PointCloud<pcl::PointXYZ> boxCloud(const Eigen::Vector3f& center) {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (float x = -0.3f; x <= 0.3f; x += 0.1f) {
+    for (float z = -0.3f; z <= 0.3f; z += 0.1f) {
+      cloud.push_back(toXYZ(center + Eigen::Vector3f(x, -0.3f, z)));
+    }
+  }
+  return cloud;
+}
+}
+
+TEST(ObstacleTracker, staticObstaclesAreNotDynamic) {
+  // GIVEN: a tracker and two boxes
+  ObstacleTracker tracker;
+  pcl::PointCloud<pcl::PointXYZ> cloud = boxCloud(Eigen::Vector3f(0, 5, 1));
+  cloud += boxCloud(Eigen::Vector3f(4, 5, 1));
+
+  // WHEN: the boxes are observed at the same place at 10Hz
+  for (int i = 0; i < 10; i++) {
+    tracker.update(cloud, 0.1 * i, Eigen::Vector3f::Zero(), 20.f);
+  }
+
+  // THEN: there is a track per box and none of them moves
+  ASSERT_EQ(2, tracker.tracks().size());
+  EXPECT_EQ(0, tracker.numDynamic());
+  for (const ObstacleTracker::track& t : tracker.tracks()) {
+    EXPECT_EQ(10, t.hits);
+    EXPECT_LT(t.velocity.norm(), 1e-3f);
+  }
+}
+
+TEST(ObstacleTracker, movingObstacleHasItsVelocity) {
+  // GIVEN: a tracker, a static box and a box moving at 1.5 m/s
+  ObstacleTracker tracker;
+  const Eigen::Vector3f velocity(1.5f, 0.f, 0.f);
+  const Eigen::Vector3f start(-2.f, 4.f, 1.f);
+
+  // WHEN: the boxes are observed at 10Hz
+  for (int i = 0; i < 20; i++) {
+    pcl::PointCloud<pcl::PointXYZ> cloud =
+        boxCloud(start + velocity * (0.1f * i));
+    cloud += boxCloud(Eigen::Vector3f(0, -5, 1));
+    tracker.update(cloud, 100.0 + 0.1 * i, Eigen::Vector3f::Zero(), 20.f);
+  }
+
+  // THEN: only the moving box is dynamic, with its velocity
+  ASSERT_EQ(2, tracker.tracks().size());
+  ASSERT_EQ(1, tracker.numDynamic());
+  const Eigen::Vector3f now = start + velocity * 1.9f;
+  for (const ObstacleTracker::track& t : tracker.tracks()) {
+    if (tracker.isDynamic(t)) {
+      EXPECT_NEAR(0.f, (t.velocity - velocity).norm(), 0.05f);
+      EXPECT_NEAR(0.f, (t.position - (now + Eigen::Vector3f(0, -0.3f, 0)))
+                           .norm(),
+                  0.05f);
+    }
+  }
+  EXPECT_FLOAT_EQ(0.1f, tracker.updateInterval());
+
+  // THEN: the points where the box has been are on its trail, but neither
+  // where it is now nor the static box or points beside the trail
+  EXPECT_TRUE(tracker.isOnDynamicTrail(now - Eigen::Vector3f(3, 0, 0), 2.f));
+  EXPECT_FALSE(tracker.isOnDynamicTrail(now - Eigen::Vector3f(3, 0, 0), 1.f));
+  EXPECT_FALSE(tracker.isOnDynamicTrail(now, 2.f));
+  EXPECT_FALSE(tracker.isOnDynamicTrail(Eigen::Vector3f(0, -5, 1), 2.f));
+  EXPECT_FALSE(tracker.isOnDynamicTrail(now - Eigen::Vector3f(2, 2, 0), 2.f));
+}
+
+TEST(ObstacleTracker, tracksAreBoundedAndLostTracksAreDropped) {
+  // GIVEN: a tracker of at most 4 tracks
+  ObstacleTracker tracker(4, 1.f, 0.5f);
+
+  // WHEN: 10 boxes far apart are observed
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 10; i++) {
+    cloud += boxCloud(Eigen::Vector3f(3.f * i, 5, 1));
+  }
+  tracker.update(cloud, 0.0, Eigen::Vector3f::Zero(), 20.f);
+
+  // THEN: only 4 of them are tracked
+  EXPECT_EQ(4, tracker.tracks().size());
+
+  // WHEN: the boxes are not seen anymore
+  for (int i = 1; i <= 4; i++) {
+    tracker.update(pcl::PointCloud<pcl::PointXYZ>(), 0.1 * i,
+                   Eigen::Vector3f::Zero(), 20.f);
+  }
+
+  // THEN: the tracks are dropped
+  EXPECT_EQ(0, tracker.tracks().size());
+}
+
+TEST(ObstacleTracker, partlyVisibleStaticObstaclesAreNotDynamic) {
+  // GIVEN: a tracker and a long static wall
+  ObstacleTracker tracker;
+
+  // WHEN: the visible part of the wall slides along it with the vehicle, and
+  // the wall is cut by the range of the cloud
+  for (int i = 0; i < 20; i++) {
+    const Eigen::Vector3f position(0.15f * i, 0.f, 1.f);
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    for (float x = -3.f; x <= 3.f; x += 0.1f) {
+      for (float z = 0.f; z <= 2.f; z += 0.1f) {
+        Eigen::Vector3f p(position.x() + x, 3.f, z);
+        if ((p - position).norm() < 4.f) {
+          cloud.push_back(toXYZ(p));
+        }
+      }
+    }
+    tracker.update(cloud, 0.1 * i, position, 4.f);
+  }
+
+  // THEN: the wall is one cluster which is not dynamic
+  EXPECT_EQ(1, tracker.tracks().size());
+  EXPECT_EQ(0, tracker.numDynamic());
+}
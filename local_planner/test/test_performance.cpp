@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/local_planner.h"
+#include "../src/nodes/star_planner.h"
+#include "../src/nodes/tree_node.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+// Performance regression tests. They are built into their own target, which
+// is only added with LOCAL_PLANNER_PERFORMANCE_TESTS, because the bounds
+// depend on the machine and on the number of threads of the tree build. They
+// leave a wide margin over the release build on a desktop CPU, such that they
+// only fail for a regression of the hot path.
+
+namespace {
+std::atomic<bool> count_allocations(false);
+std::atomic<size_t> n_allocations(0);
+
+// counts the allocations of all threads while it is in scope
+class AllocationCounter {
+ public:
+  AllocationCounter() {
+    n_allocations = 0;
+    count_allocations = true;
+  }
+  ~AllocationCounter() { count_allocations = false; }
+  size_t count() const { return n_allocations; }
+};
+}
+
+// the default operator new[] and the nothrow versions call this one
+void* operator new(std::size_t size) {
+  if (count_allocations) {
+    n_allocations++;
+  }
+  void* p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+using namespace avoidance;
+
+namespace {
+// wall 4m in front of the position, 4m wide and 5m high
+pcl::PointCloud<pcl::PointXYZ> wallCloud(const Eigen::Vector3f& position) {
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (float y = -2.f; y <= 2.f; y += 0.05f) {
+    for (float z = -2.5f; z <= 2.5f; z += 0.05f) {
+      cloud.push_back(toXYZ(position + Eigen::Vector3f(4.f, y, z)));
+    }
+  }
+  return cloud;
+}
+
+double medianOf(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+}
+
+TEST(Performance, allocationsPerPlannerCycle) {
+  // GIVEN: a planner in front of a wall, after a few cycles such that the
+  // buffers have grown to their size
+  ros::Time::init();
+  LocalPlanner planner;
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  config.send_obstacles_fcu_ = true;
+  planner.dynamicReconfigureSetParams(config, 1);
+  geometry_msgs::PoseStamped pose;
+  pose.header.stamp = ros::Time(500, 0);
+  pose.pose.position.z = 30;
+  pose.pose.orientation.w = 1;
+  planner.currently_armed_ = true;
+  planner.setPose(pose);
+  planner.setGoal(toPoint(Eigen::Vector3f(100.f, 0.f, 30.f)));
+  planner.complete_cloud_.push_back(
+      wallCloud(Eigen::Vector3f(0.f, 0.f, 30.f)));
+  for (int i = 0; i < 5; i++) {
+    planner.runPlanner();
+  }
+
+  // WHEN: we count the allocations of more cycles
+  const int n_cycles = 20;
+  size_t allocations = 0;
+  {
+    AllocationCounter counter;
+    for (int i = 0; i < n_cycles; i++) {
+      planner.runPlanner();
+    }
+    allocations = counter.count();
+  }
+
+  // THEN: the cycles reuse their buffers, about 1000 allocations are left
+  // per cycle with one expansion thread, most of them for the tasks of the
+  // tree build of which there are more with more threads
+  const size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+  EXPECT_LT(allocations / n_cycles, 2000u * n_threads);
+}
+
+TEST(Performance, treeBuildTime) {
+  // GIVEN: a star planner in front of a wall
+  StarPlanner star_planner;
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  star_planner.dynamicReconfigureSetStarParams(config, 1);
+  star_planner.setCostParams(config.goal_cost_param_,
+                             config.smooth_cost_param_, 4.0, 4.0);
+  geometry_msgs::PoseStamped pose;
+  pose.pose.position.z = 2.5;
+  pose.pose.orientation.w = 1.0;
+  star_planner.setParams(0.0, 1.0, nav_msgs::GridCells(), 0.0, 0.2);
+  star_planner.setPose(pose);
+  Box histogram_box(config.box_radius_);
+  star_planner.setBoxSize(histogram_box, 2.0);
+  star_planner.setGoal(toPoint(Eigen::Vector3f(15.f, 0.f, 2.5f)));
+  star_planner.setCloud({wallCloud(Eigen::Vector3f(0.f, 0.f, 2.5f))});
+  star_planner.buildLookAheadTree();
+
+  // WHEN: we time the tree builds
+  std::vector<double> build_ms;
+  for (int i = 0; i < 20; i++) {
+    auto start = std::chrono::steady_clock::now();
+    star_planner.buildLookAheadTree();
+    build_ms.push_back(std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+  }
+
+  // THEN: the median build fits well into a planner cycle, it takes about
+  // 6ms
+  ASSERT_GT(star_planner.tree_.size(), 1u);
+  EXPECT_LT(medianOf(build_ms), 30.0);
+}
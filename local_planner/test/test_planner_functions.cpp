@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <numeric>
 
 #include "../src/nodes/planner_functions.h"
 
@@ -162,6 +165,30 @@ TEST(PlannerFunctions, calculateFOV) {
   }
 }
 
+TEST(PlannerFunctions, calculateFOVMask) {
+  // GIVEN: a FOV which wraps around the azimuth
+  double h_fov = 90.0;
+  double v_fov = 45.0;
+  std::vector<int> z_FOV_idx;
+  std::vector<bool> z_FOV_mask;
+  int e_FOV_min, e_FOV_max;
+
+  // WHEN: we calculate the FOV with the azimuth mask
+  calculateFOV(h_fov, v_fov, z_FOV_idx, z_FOV_mask, e_FOV_min, e_FOV_max, -2.3,
+               0.0);
+
+  // THEN: the mask is set exactly for the azimuth indices of the FOV
+  ASSERT_EQ(GRID_LENGTH_Z, z_FOV_mask.size());
+  for (int z = 0; z < GRID_LENGTH_Z; z++) {
+    bool in_FOV = std::find(z_FOV_idx.begin(), z_FOV_idx.end(), z) !=
+                  z_FOV_idx.end();
+    EXPECT_EQ(in_FOV, z_FOV_mask[z]) << z;
+  }
+  EXPECT_TRUE(z_FOV_mask[0]);
+  EXPECT_TRUE(z_FOV_mask[59]);
+  EXPECT_FALSE(z_FOV_mask[30]);
+}
+
 TEST(PlannerFunctionsTests, findAllFreeDirections) {
   // GIVEN: empty histogram
   Histogram empty_histogram = Histogram(ALPHA_RES);
@@ -178,16 +205,16 @@ TEST(PlannerFunctionsTests, findAllFreeDirections) {
   bool only_yawed = false;
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(empty_histogram, safety_radius, path_candidates,
-                     path_selected, path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(empty_histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: all directions should be classified as path_candidates
   EXPECT_EQ(
@@ -232,16 +259,16 @@ TEST(PlannerFunctionsTests, findFreeDirectionsNoWrap) {
   }
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(histogram, safety_radius, path_candidates, path_selected,
-                     path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: we should have one rejected cell and the 8 neightbooring cells
   // blocked
@@ -294,16 +321,16 @@ TEST(PlannerFunctionsTests, findFreeDirectionsWrapLeft) {
   }
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(histogram, safety_radius, path_candidates, path_selected,
-                     path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: we should get one rejected cell, the five neighboring cells blocked
   // plus three other blocked cells at the same elevation index and the last
@@ -356,16 +383,16 @@ TEST(PlannerFunctionsTests, findFreeDirectionsWrapRight) {
   }
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(histogram, safety_radius, path_candidates, path_selected,
-                     path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: we should get one rejected cell, the five neighboring cells blocked
   // plus three other blocked cells at the same elevation index and the first
@@ -420,16 +447,16 @@ TEST(PlannerFunctionsTests, findFreeDirectionsWrapUp) {
   }
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(histogram, safety_radius, path_candidates, path_selected,
-                     path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: we should get one rejected cell, the 14 neighboring cells blocked
   // plus 10 other blocked cells at the same elevation index and azimuth index
@@ -483,16 +510,16 @@ TEST(PlannerFunctionsTests, findFreeDirectionsWrapDown) {
   }
 
   // WHEN: we look for free directions
+  std::vector<candidateDirection> candidates;
   nav_msgs::GridCells path_candidates, path_selected, path_rejected,
       path_blocked, path_waypoints;
-  std::vector<float> cost_path_candidates;  // not needed
 
-  findFreeDirections(histogram, safety_radius, path_candidates, path_selected,
-                     path_rejected, path_blocked, path_waypoints,
-                     cost_path_candidates, goal, position, position_old,
-                     goal_cost_param, smooth_cost_param,
-                     height_change_cost_param_adapted, height_change_cost_param,
-                     only_yawed, resolution_alpha);
+  findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                     path_rejected, path_blocked, path_waypoints, goal,
+                     position, position_old, goal_cost_param,
+                     smooth_cost_param, height_change_cost_param_adapted,
+                     height_change_cost_param, only_yawed, resolution_alpha);
+  candidatesToGridCells(candidates, path_candidates);
 
   // THEN: we should get one rejected cell, the 5 neighboring cells blocked
   // plus 3 other blocked cells at the same elevation index and azimuth index
@@ -570,3 +597,378 @@ TEST(PlannerFunctionsTests, filterPointCloud) {
 
   EXPECT_EQ(0, cropped_cloud2.points.size());
 }
+
+TEST(PlannerFunctionsTests, filterPointCloudAndBinMatchesTwoPasses) {
+  // GIVEN: a point cloud spread around the vehicle, including invalid points
+  const Eigen::Vector3f position(1.5f, 1.0f, 4.5f);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 400; i++) {
+    float x = std::sin(0.37f * i) * (0.5f + 0.02f * i);
+    float y = std::cos(0.91f * i) * (0.3f + 0.015f * i);
+    float z = std::sin(1.71f * i) * 2.0f;
+    cloud.push_back(toXYZ(position + Eigen::Vector3f(x, y, z)));
+  }
+  cloud.push_back(pcl::PointXYZ(NAN, 1.0f, 1.0f));
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud = {cloud};
+
+  Box histogram_box(5.0);
+  histogram_box.setBoxLimits(toPoint(position), 4.5);
+  geometry_msgs::PoseStamped location;
+  location.pose.position = toPoint(position);
+
+  pcl::PointCloud<pcl::PointXYZ> cropped_cloud, cropped_cloud_fused;
+  Eigen::Vector3f closest_point, closest_point_fused;
+  double distance, distance_fused;
+  int counter_backoff, counter_backoff_fused;
+  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram_fused = Histogram(ALPHA_RES);
+
+  // WHEN: we crop and bin in two passes and in a single pass
+  filterPointCloud(cropped_cloud, closest_point, distance, counter_backoff,
+                   complete_cloud, 20.0, 1.0, histogram_box, position, 0.2);
+  generateNewHistogram(histogram, cropped_cloud, location);
+  filterPointCloud(cropped_cloud_fused, histogram_fused, closest_point_fused,
+                   distance_fused, counter_backoff_fused, complete_cloud, 20.0,
+                   1.0, histogram_box, position, position, 0.2, 0.0);
+
+  // THEN: both give the same cloud and histogram
+  ASSERT_GT(cropped_cloud.points.size(), 20);
+  ASSERT_EQ(cropped_cloud.points.size(), cropped_cloud_fused.points.size());
+  EXPECT_EQ(counter_backoff, counter_backoff_fused);
+  EXPECT_DOUBLE_EQ(distance, distance_fused);
+  EXPECT_TRUE(closest_point.isApprox(closest_point_fused));
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      EXPECT_DOUBLE_EQ(histogram.get_bin(e, z), histogram_fused.get_bin(e, z));
+      EXPECT_DOUBLE_EQ(histogram.get_dist(e, z),
+                       histogram_fused.get_dist(e, z));
+    }
+  }
+}
+
+TEST(PlannerFunctionsTests, filterPointCloudDownsampling) {
+  // GIVEN: a dense point cloud of a few surfaces in front of the vehicle
+  const Eigen::Vector3f position(1.5f, 1.0f, 4.5f);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 100; i++) {
+    for (int j = 0; j < 100; j++) {
+      float x = -1.0f + 0.02f * i;
+      float z = -1.0f + 0.02f * j;
+      cloud.push_back(toXYZ(position + Eigen::Vector3f(x, 2.0f, z)));
+      cloud.push_back(toXYZ(position + Eigen::Vector3f(x, 0.9f + 0.001f * j,
+                                                       0.5f * z)));
+    }
+  }
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud = {cloud};
+
+  Box histogram_box(5.0);
+  histogram_box.setBoxLimits(toPoint(position), 4.5);
+
+  pcl::PointCloud<pcl::PointXYZ> cropped_cloud, cropped_cloud_downsampled;
+  Eigen::Vector3f closest_point, closest_point_downsampled;
+  double distance, distance_downsampled;
+  int counter_backoff, counter_backoff_downsampled;
+  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram_downsampled = Histogram(ALPHA_RES);
+
+  // WHEN: we crop the cloud with and without downsampling
+  size_t n_points =
+      filterPointCloud(cropped_cloud, histogram, closest_point, distance,
+                       counter_backoff, complete_cloud, 20.0, 1.0,
+                       histogram_box, position, position, 0.2, 0.0);
+  size_t n_points_downsampled = filterPointCloud(
+      cropped_cloud_downsampled, histogram_downsampled,
+      closest_point_downsampled, distance_downsampled,
+      counter_backoff_downsampled, complete_cloud, 20.0, 1.0, histogram_box,
+      position, position, 0.2, 0.5);
+
+  // THEN: the downsampled cloud is much smaller, but the point count, closest
+  // point, backoff counter and histogram are the same
+  EXPECT_GT(n_points, 1000);
+  EXPECT_EQ(n_points, cropped_cloud.points.size());
+  EXPECT_EQ(n_points, n_points_downsampled);
+  EXPECT_GT(cropped_cloud_downsampled.points.size(), 0);
+  EXPECT_LT(10 * cropped_cloud_downsampled.points.size(), n_points);
+  EXPECT_GT(counter_backoff, 0);
+  EXPECT_EQ(counter_backoff, counter_backoff_downsampled);
+  EXPECT_DOUBLE_EQ(distance, distance_downsampled);
+  EXPECT_TRUE(closest_point.isApprox(closest_point_downsampled));
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      EXPECT_DOUBLE_EQ(histogram.get_bin(e, z),
+                       histogram_downsampled.get_bin(e, z));
+      EXPECT_DOUBLE_EQ(histogram.get_dist(e, z),
+                       histogram_downsampled.get_dist(e, z));
+    }
+  }
+}
+
+TEST(PlannerFunctions, filterPointCloudDropsCameraOverlap) {
+  // GIVEN: two cameras which look at the same wall, the second one also sees
+  // a few points behind the vehicle
+  const Eigen::Vector3f position(1.5f, 1.0f, 4.5f);
+  pcl::PointCloud<pcl::PointXYZ> wall, wall_and_behind;
+  for (int i = 0; i < 40; i++) {
+    for (int j = 0; j < 10; j++) {
+      wall.push_back(toXYZ(position + Eigen::Vector3f(-2.0f + 0.1f * i, 2.0f,
+                                                      -0.5f + 0.1f * j)));
+    }
+  }
+  wall_and_behind = wall;
+  for (int i = 0; i < 30; i++) {
+    wall_and_behind.push_back(
+        toXYZ(position + Eigen::Vector3f(-1.5f + 0.1f * i, -2.0f, 0.f)));
+  }
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud = {
+      wall, wall_and_behind};
+
+  CameraFrustum frustum;
+  frustum.origin = position;
+  // looking along y with x to the right and z up
+  frustum.rotation << 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, -1.f, 0.f;
+  frustum.tan_half_h_fov = 1.5f;
+  frustum.tan_half_v_fov = 1.f;
+  frustum.has_pose = true;
+  std::vector<CameraFrustum> frustums = {frustum, frustum};
+
+  Box histogram_box(5.0);
+  histogram_box.setBoxLimits(toPoint(position), 4.5);
+  pcl::PointCloud<pcl::PointXYZ> cropped_cloud, cropped_cloud_merged;
+  Eigen::Vector3f closest_point, closest_point_merged;
+  double distance, distance_merged;
+  int counter_backoff, counter_backoff_merged;
+  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram_merged = Histogram(ALPHA_RES);
+
+  // WHEN: we crop the clouds with and without the camera frustums
+  size_t n_points =
+      filterPointCloud(cropped_cloud, histogram, closest_point, distance,
+                       counter_backoff, complete_cloud, 20.0, 1.0,
+                       histogram_box, position, position, 0.2, 0.0);
+  size_t n_points_merged = filterPointCloud(
+      cropped_cloud_merged, histogram_merged, closest_point_merged,
+      distance_merged, counter_backoff_merged, complete_cloud, 20.0, 1.0,
+      histogram_box, position, position, 0.2, 0.0, frustums);
+
+  // THEN: the wall is only kept once, the points behind the vehicle are kept
+  // and the histogram is the same
+  EXPECT_EQ(2 * wall.size() + 30, n_points);
+  EXPECT_EQ(wall.size() + 30, n_points_merged);
+  EXPECT_EQ(n_points_merged, cropped_cloud_merged.points.size());
+  EXPECT_DOUBLE_EQ(distance, distance_merged);
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      EXPECT_DOUBLE_EQ(histogram.get_bin(e, z), histogram_merged.get_bin(e, z));
+      EXPECT_NEAR(histogram.get_dist(e, z), histogram_merged.get_dist(e, z),
+                  1e-5);
+    }
+  }
+
+  // WHEN: the first camera has not sent its camera info yet
+  frustums[0].tan_half_h_fov = 0.f;
+  n_points_merged = filterPointCloud(
+      cropped_cloud_merged, histogram_merged, closest_point_merged,
+      distance_merged, counter_backoff_merged, complete_cloud, 20.0, 1.0,
+      histogram_box, position, position, 0.2, 0.0, frustums);
+
+  // THEN: no points are dropped
+  EXPECT_EQ(n_points, n_points_merged);
+}
+
+TEST(PlannerFunctionsTests, addObstacleDistancesKeepsClosestInBand) {
+  // GIVEN: points in a few directions around the vehicle
+  const Eigen::Vector3f position(1.5f, 1.0f, 4.5f);
+  const geometry_msgs::Point pos = toPoint(position);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.push_back(toXYZ(fromPolarToCartesian(0.f, 33.f, 3.0, pos)));
+  cloud.push_back(toXYZ(fromPolarToCartesian(3.f, 33.f, 5.0, pos)));
+  cloud.push_back(toXYZ(fromPolarToCartesian(-3.f, 93.f, 4.0, pos)));
+  cloud.push_back(toXYZ(fromPolarToCartesian(33.f, -87.f, 2.0, pos)));
+  cloud.push_back(toXYZ(fromPolarToCartesian(0.f, -87.f, 0.1, pos)));
+  const int z_front = azimuthAngletoIndex(33.f, ALPHA_RES);
+  const int z_side = azimuthAngletoIndex(93.f, ALPHA_RES);
+  const int z_back = azimuthAngletoIndex(-87.f, ALPHA_RES);
+
+  // WHEN: we compute the obstacle distance of the points
+  std::vector<float> ranges(GRID_LENGTH_Z, HUGE_VALF);
+  addObstacleDistances(cloud, position, 0.2f, 20.f, ranges);
+
+  // THEN: each sector has the closest point within the elevation band, the
+  // points above the band and too close to the vehicle are ignored
+  for (int z = 0; z < GRID_LENGTH_Z; z++) {
+    if (z == z_front) {
+      EXPECT_NEAR(3.f, ranges[z], 1e-4f);
+    } else if (z == z_side) {
+      EXPECT_NEAR(4.f, ranges[z], 1e-4f);
+    } else {
+      EXPECT_EQ(HUGE_VALF, ranges[z]) << z;
+    }
+  }
+
+  // WHEN: we convert them to the message of the FCU with the side unseen
+  std::vector<bool> z_FOV_mask(GRID_LENGTH_Z, true);
+  z_FOV_mask[z_side] = false;
+  sensor_msgs::LaserScan msg;
+  rangesToObstacleDistanceMsg(ranges, z_FOV_mask, msg);
+
+  // THEN: the message starts at local north, the unseen sector is unknown
+  // and the free ones are beyond the maximum range
+  ASSERT_EQ(GRID_LENGTH_Z, msg.ranges.size());
+  EXPECT_NEAR(3.f, msg.ranges[(z_front + GRID_LENGTH_Z / 2) % GRID_LENGTH_Z],
+              1e-4f);
+  EXPECT_EQ(UINT16_MAX,
+            msg.ranges[(z_side + GRID_LENGTH_Z / 2) % GRID_LENGTH_Z]);
+  EXPECT_FLOAT_EQ(msg.range_max + 1.f,
+                  msg.ranges[(z_back + GRID_LENGTH_Z / 2) % GRID_LENGTH_Z]);
+}
+
+// moving window check of findFreeDirections before it used a summed area table
+bool isWindowFreeReference(const Histogram &histogram, int e, int z, int n,
+                           int resolution_alpha) {
+  int z_dim = 360 / resolution_alpha;
+  int e_dim = 180 / resolution_alpha;
+  int a = 0, b = 0;
+  for (int i = (e - n); i <= (e + n); i++) {
+    for (int j = (z - n); j <= (z + n); j++) {
+      bool corner = false;
+      if (i < 0 && j >= 0 && j < z_dim) {
+        a = 0;
+        b = j + (180 / resolution_alpha) - 1;
+        if (b >= z_dim) b = b % (z_dim - 1);
+      } else if (j < 0 && i >= 0 && i < e_dim) {
+        b = j + z_dim;
+        a = i;
+      } else if (i >= e_dim && j >= 0 && j < z_dim) {
+        a = e_dim - (i % (e_dim - 1));
+        b = j + (180 / resolution_alpha) - 1;
+        if (b >= z_dim) b = b % (z_dim - 1);
+      } else if (j >= z_dim && i >= 0 && i < e_dim) {
+        b = j - z_dim;
+      } else if (i >= 0 && i < e_dim && j >= 0 && j < z_dim) {
+        a = i;
+        b = j;
+      } else {
+        corner = true;
+      }
+      if (!corner && histogram.get_bin(a, b) != 0) return false;
+    }
+  }
+  return true;
+}
+
+TEST(PlannerFunctionsTests, findFreeDirectionsMatchesMovingWindow) {
+  // GIVEN: sparse histograms at different resolutions and safety radii
+  for (int resolution_alpha : {3, 5, 6, 10, 12}) {
+    for (double safety_radius : {0.0, 8.0, 25.0, 37.0}) {
+      Histogram histogram = Histogram(resolution_alpha);
+      int z_dim = 360 / resolution_alpha;
+      int e_dim = 180 / resolution_alpha;
+      for (int e = 0; e < e_dim; e++) {
+        for (int z = 0; z < z_dim; z++) {
+          if ((e * 7 + z * 13 + resolution_alpha) % 41 == 0) {
+            histogram.set_bin(e, z, 1);
+          }
+        }
+      }
+      histogram.set_bin(0, z_dim - 1, 1);
+      histogram.set_bin(e_dim - 1, 0, 1);
+
+      std::vector<candidateDirection> candidates;
+      nav_msgs::GridCells path_candidates, path_selected, path_rejected,
+          path_blocked, path_waypoints;
+      Eigen::Vector3f position(0.f, 0.f, 0.f);
+      Eigen::Vector3f goal(0.f, 5.f, 0.f);
+
+      // WHEN: we look for free directions
+      findFreeDirections(histogram, safety_radius, candidates, path_selected,
+                         path_rejected, path_blocked, path_waypoints, goal,
+                         position, position, 1.0, 1.0, 1.0, 1.0, false,
+                         resolution_alpha);
+      candidatesToGridCells(candidates, path_candidates);
+
+      // THEN: a cell is a candidate exactly if the moving window is free
+      int n = floor(safety_radius / resolution_alpha);
+      size_t n_free = 0;
+      for (int e = 0; e < e_dim; e++) {
+        for (int z = 0; z < z_dim; z++) {
+          if (isWindowFreeReference(histogram, e, z, n, resolution_alpha)) {
+            ASSERT_LT(n_free, path_candidates.cells.size());
+            EXPECT_EQ(e, elevationAngletoIndex(path_candidates.cells[n_free].x,
+                                               resolution_alpha));
+            EXPECT_EQ(z, azimuthAngletoIndex(path_candidates.cells[n_free].y,
+                                             resolution_alpha));
+            n_free++;
+          }
+        }
+      }
+      EXPECT_EQ(n_free, path_candidates.cells.size());
+      EXPECT_EQ(e_dim * z_dim, path_candidates.cells.size() +
+                                   path_rejected.cells.size() +
+                                   path_blocked.cells.size());
+    }
+  }
+}
+
+TEST(PlannerFunctionsTests, calculateCostMapOrdersByCost) {
+  // GIVEN: candidates with random costs, including ties
+  std::vector<candidateDirection> candidates;
+  std::srand(1);
+  for (int i = 0; i < 200; i++) {
+    candidates.emplace_back(std::rand() % 50, i, -i);
+  }
+  std::vector<int> expected(candidates.size());
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+    return candidates[a].cost < candidates[b].cost;
+  });
+
+  // WHEN: we order them and read the best few, then all of them
+  CandidateOrder cost_order;
+  ASSERT_FALSE(calculateCostMap(candidates, cost_order));
+  ASSERT_EQ(candidates.size(), cost_order.size());
+  EXPECT_EQ(expected[0], cost_order.at(0));
+  EXPECT_EQ(expected[5], cost_order.at(5));
+
+  // THEN: the order is by increasing cost and by index for equal costs
+  for (size_t i = 0; i < candidates.size(); i++) {
+    EXPECT_EQ(expected[i], cost_order.at(i));
+  }
+
+  // WHEN: there are no candidates THEN: there is no cost map
+  EXPECT_TRUE(calculateCostMap(std::vector<candidateDirection>(), cost_order));
+}
+
+TEST(PlannerFunctionsTests, compressHistogramMasksAndQuantizes) {
+  // GIVEN: a histogram with three occupied cells
+  Histogram histogram(ALPHA_RES);
+  histogram.setZero();
+  histogram.set_bin(0, 0, 1);
+  histogram.set_dist(0, 0, 10.0);
+  histogram.set_bin(0, 9, 1);
+  histogram.set_dist(0, 9, 30.0);
+  histogram.set_bin(GRID_LENGTH_E - 1, GRID_LENGTH_Z - 1, 1);
+  histogram.set_dist(GRID_LENGTH_E - 1, GRID_LENGTH_Z - 1, 0.0);
+
+  // WHEN: we encode it
+  std::vector<uint8_t> data;
+  compressHistogram(histogram, 20.f, data);
+
+  // THEN: the bitmask is followed by the quantized distances in cell order
+  const size_t mask_bytes = (GRID_LENGTH_E * GRID_LENGTH_Z + 7) / 8;
+  ASSERT_EQ(mask_bytes + 3, data.size());
+  EXPECT_EQ(0x01, data[0]);
+  EXPECT_EQ(0x02, data[1]);
+  const int last = GRID_LENGTH_E * GRID_LENGTH_Z - 1;
+  EXPECT_EQ(1 << (last % 8), data[last / 8]);
+  EXPECT_EQ(128, data[mask_bytes]);
+  EXPECT_EQ(255, data[mask_bytes + 1]);
+  EXPECT_EQ(0, data[mask_bytes + 2]);
+
+  // WHEN: the histogram is empty THEN: only the empty bitmask is left
+  histogram.setZero();
+  compressHistogram(histogram, 20.f, data);
+  ASSERT_EQ(mask_bytes, data.size());
+  for (uint8_t byte : data) {
+    EXPECT_EQ(0, byte);
+  }
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/planner_log.h"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace avoidance;
+
+namespace {
+// path of a new temporary file, removed when the test ends
+class TemporaryFile {
+ public:
+  TemporaryFile() {
+    char path[] = "/tmp/planner_log_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    path_ = path;
+  }
+  ~TemporaryFile() { std::remove(path_.c_str()); }
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+}
+
+TEST(PlannerLog, recordsAreReadBackInOrder) {
+  // GIVEN: a config, an input with two clouds and an output
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  config.box_radius_ = 9.5;
+  config.childs_per_node_ = 17;
+  config.use_obstacle_memory_ = !config.use_obstacle_memory_;
+
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(2);
+  for (int i = 0; i < 100; i++) {
+    complete_cloud[0].push_back(pcl::PointXYZ(0.1f * i, 2.f, -1.f));
+  }
+  complete_cloud[0].header.stamp = 1234567;
+  complete_cloud[0].header.frame_id = "/local_origin";
+  complete_cloud[1].push_back(pcl::PointXYZ(1.f, 2.f, 3.f));
+  std::vector<CameraFrustum> camera_frustums(1);
+  camera_frustums[0].origin = Eigen::Vector3f(1.f, 2.f, 3.f);
+  camera_frustums[0].rotation(0, 1) = 0.5f;
+  camera_frustums[0].tan_half_h_fov = 0.6f;
+  camera_frustums[0].has_pose = true;
+  plannerLogState state;
+  state.pose.header.stamp = ros::Time(1000.5);
+  state.pose.pose.position = toPoint(Eigen::Vector3f(1.f, 2.f, 3.f));
+  state.pose.pose.orientation.w = 1.0;
+  state.vel.twist.linear.x = 0.7;
+  state.armed = true;
+  state.set_goal = true;
+  state.goal = toPoint(Eigen::Vector3f(10.f, 0.f, 3.f));
+  state.ground_distance = 1.25;
+  state.disable_rise_to_goal_altitude = true;
+
+  avoidanceOutput output;
+  output.waypoint_type = tryPath;
+  output.pose = state.pose;
+  output.obstacle_ahead = true;
+  output.reach_altitude = false;
+  output.min_speed = 1.0;
+  output.max_speed = 3.0;
+  output.velocity_sigmoid_slope = 2.0;
+  output.last_path_time = ros::Time(999.0);
+  output.min_dist_backoff = 1.5;
+  output.costmap_direction_e = 12.0;
+  output.costmap_direction_z = -30.0;
+  output.path_node_positions.resize(3);
+  output.path_node_positions[1].x = 4.0;
+
+  // WHEN: they are logged and read back
+  TemporaryFile file;
+  PlannerLogWriter writer;
+  ASSERT_TRUE(writer.open(file.path()));
+  writer.writeConfig(config, 7);
+  writer.writeInput(ros::Time(1000.75), complete_cloud, camera_frustums,
+                    state);
+  writer.writeOutput(output);
+  writer.close();
+
+  PlannerLogReader reader;
+  ASSERT_TRUE(reader.open(file.path()));
+
+  // THEN: the records come back in order with the same content
+  ASSERT_EQ(plannerLogRecord::config, reader.next());
+  EXPECT_EQ(7u, reader.configLevel());
+  EXPECT_DOUBLE_EQ(9.5, reader.config().box_radius_);
+  EXPECT_EQ(17, reader.config().childs_per_node_);
+  EXPECT_EQ(config.use_obstacle_memory_, reader.config().use_obstacle_memory_);
+
+  ASSERT_EQ(plannerLogRecord::input, reader.next());
+  const plannerLogInput& input = reader.input();
+  EXPECT_EQ(ros::Time(1000.75), input.time);
+  ASSERT_EQ(2u, input.complete_cloud.size());
+  ASSERT_EQ(100u, input.complete_cloud[0].points.size());
+  EXPECT_EQ(100u, input.complete_cloud[0].width);
+  EXPECT_FLOAT_EQ(9.9f, input.complete_cloud[0].points[99].x);
+  EXPECT_EQ(1234567u, input.complete_cloud[0].header.stamp);
+  EXPECT_EQ("/local_origin", input.complete_cloud[0].header.frame_id);
+  ASSERT_EQ(1u, input.complete_cloud[1].points.size());
+  EXPECT_FLOAT_EQ(3.f, input.complete_cloud[1].points[0].z);
+  ASSERT_EQ(1u, input.camera_frustums.size());
+  EXPECT_TRUE(input.camera_frustums[0].origin.isApprox(
+      camera_frustums[0].origin));
+  EXPECT_TRUE(input.camera_frustums[0].rotation.isApprox(
+      camera_frustums[0].rotation));
+  EXPECT_TRUE(input.camera_frustums[0].has_pose);
+  EXPECT_FLOAT_EQ(0.6f, input.camera_frustums[0].tan_half_h_fov);
+  EXPECT_EQ(state.pose.header.stamp, input.state.pose.header.stamp);
+  EXPECT_DOUBLE_EQ(3.0, input.state.pose.pose.position.z);
+  EXPECT_DOUBLE_EQ(0.7, input.state.vel.twist.linear.x);
+  EXPECT_TRUE(input.state.armed);
+  EXPECT_FALSE(input.state.offboard);
+  EXPECT_TRUE(input.state.set_goal);
+  EXPECT_DOUBLE_EQ(10.0, input.state.goal.x);
+  EXPECT_DOUBLE_EQ(1.25, input.state.ground_distance);
+  EXPECT_TRUE(input.state.disable_rise_to_goal_altitude);
+
+  ASSERT_EQ(plannerLogRecord::output, reader.next());
+  EXPECT_TRUE(sameAvoidanceOutput(output, reader.output()));
+  output.path_node_positions[1].x = 4.5;
+  EXPECT_FALSE(sameAvoidanceOutput(output, reader.output()));
+
+  EXPECT_EQ(plannerLogRecord::none, reader.next());
+}
+
+TEST(PlannerLog, rejectsOtherFilesAndTruncatedRecords) {
+  // GIVEN: a file which is not a log
+  TemporaryFile file;
+  std::FILE* f = std::fopen(file.path().c_str(), "wb");
+  ASSERT_NE(nullptr, f);
+  std::fputs("some text which is not a planner log", f);
+  std::fclose(f);
+
+  // WHEN: we open it THEN: it is rejected
+  PlannerLogReader reader;
+  EXPECT_FALSE(reader.open(file.path()));
+
+  // GIVEN: a log of which the last record is cut off
+  PlannerLogWriter writer;
+  ASSERT_TRUE(writer.open(file.path()));
+  writer.writeConfig(LocalPlannerNodeConfig::__getDefault__(), 0);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  complete_cloud[0].push_back(pcl::PointXYZ(1.f, 2.f, 3.f));
+  writer.writeInput(ros::Time(1.0), complete_cloud,
+                    std::vector<CameraFrustum>(), plannerLogState());
+  writer.close();
+  f = std::fopen(file.path().c_str(), "rb+");
+  ASSERT_NE(nullptr, f);
+  std::fseek(f, 0, SEEK_END);
+  long size = std::ftell(f);
+  std::fclose(f);
+  ASSERT_EQ(0, truncate(file.path().c_str(), size - 4));
+
+  // WHEN: we read it THEN: the complete records are read and the log ends at
+  // the cut off one
+  ASSERT_TRUE(reader.open(file.path()));
+  EXPECT_EQ(plannerLogRecord::config, reader.next());
+  EXPECT_EQ(plannerLogRecord::none, reader.next());
+}
+
+TEST(PlannerLog, rejectsCountsLargerThanTheRecord) {
+  // GIVEN: a log of which the number of clouds of the input is corrupt
+  TemporaryFile file;
+  PlannerLogWriter writer;
+  ASSERT_TRUE(writer.open(file.path()));
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  complete_cloud[0].push_back(pcl::PointXYZ(1.f, 2.f, 3.f));
+  writer.writeInput(ros::Time(1.0), complete_cloud,
+                    std::vector<CameraFrustum>(), plannerLogState());
+  writer.close();
+  std::string bytes;
+  {
+    std::ifstream in(file.path(), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  }
+  // the time of the input is followed by the number of clouds
+  const uint64_t nsec = ros::Time(1.0).toNSec();
+  const uint32_t n_clouds = 1;
+  std::string pattern(sizeof(nsec) + sizeof(n_clouds), '\0');
+  std::memcpy(&pattern[0], &nsec, sizeof(nsec));
+  std::memcpy(&pattern[sizeof(nsec)], &n_clouds, sizeof(n_clouds));
+  const size_t offset = bytes.find(pattern);
+  ASSERT_NE(std::string::npos, offset);
+  const uint32_t corrupt = 0xffffffff;
+  std::memcpy(&bytes[offset + sizeof(nsec)], &corrupt, sizeof(corrupt));
+  {
+    std::ofstream out(file.path(), std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  }
+
+  // WHEN: we read it THEN: the record is rejected without allocating the
+  // clouds
+  PlannerLogReader reader;
+  ASSERT_TRUE(reader.open(file.path()));
+  EXPECT_EQ(plannerLogRecord::none, reader.next());
+  EXPECT_TRUE(reader.input().complete_cloud.empty());
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/stage_timer.h"
+
+using namespace avoidance;
+
+TEST(StageTimers, statisticsOfWindow) {
+  // GIVEN: timers keeping the last 100 samples
+  StageTimers timers(100);
+
+  // WHEN: nothing was recorded
+  // THEN: the statistics are empty
+  EXPECT_EQ(0u, timers.getStatistics(Stage::treeBuild).n_samples);
+
+  // WHEN: we record more than 100 samples of a stage
+  timers.record(Stage::treeBuild, 1000.0);
+  for (int i = 1; i <= 100; i++) {
+    timers.record(Stage::treeBuild, i);
+  }
+
+  // THEN: the oldest sample is dropped and the percentiles are computed over
+  // the remaining ones
+  stageStatistics statistics = timers.getStatistics(Stage::treeBuild);
+  EXPECT_EQ(100u, statistics.n_samples);
+  EXPECT_DOUBLE_EQ(50.0, statistics.p50_ms);
+  EXPECT_DOUBLE_EQ(99.0, statistics.p99_ms);
+  EXPECT_DOUBLE_EQ(100.0, statistics.max_ms);
+
+  // THEN: other stages are not affected
+  EXPECT_EQ(0u, timers.getStatistics(Stage::publish).n_samples);
+}
+
+TEST(StageTimers, scopedTimerRecords) {
+  // GIVEN: timers
+  StageTimers timers;
+
+  // WHEN: a scope is timed
+  { ScopedStageTimer timer(&timers, Stage::publish); }
+
+  // THEN: one non negative duration is recorded
+  stageStatistics statistics = timers.getStatistics(Stage::publish);
+  EXPECT_EQ(1u, statistics.n_samples);
+  EXPECT_GE(statistics.max_ms, 0.0);
+
+  // WHEN: a scope is timed without timers
+  // THEN: nothing happens
+  { ScopedStageTimer timer(nullptr, Stage::publish); }
+  EXPECT_EQ(1u, timers.getStatistics(Stage::publish).n_samples);
+}
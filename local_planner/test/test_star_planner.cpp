@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/common.h"
+#include "../src/nodes/star_planner.h"
+#include "../src/nodes/tree_node.h"
+
+using namespace avoidance;
+
+TEST(StarPlanner, batchedScoresMatchTheCostFunctions) {
+  // GIVEN: a star planner in front of a wall
+  StarPlanner star_planner;
+  LocalPlannerNodeConfig config = LocalPlannerNodeConfig::__getDefault__();
+  config.childs_per_node_ = 3;
+  config.n_expanded_nodes_ = 20;
+  star_planner.dynamicReconfigureSetStarParams(config, 1);
+  star_planner.setCostParams(config.goal_cost_param_,
+                             config.smooth_cost_param_, 4.0, 4.0);
+  geometry_msgs::PoseStamped pose;
+  pose.pose.position.z = 2.5;
+  pose.pose.orientation.w = 1.0;
+  star_planner.setParams(0.0, 1.0, nav_msgs::GridCells(), 0.0, 0.2);
+  star_planner.setPose(pose);
+  Box histogram_box(config.box_radius_);
+  star_planner.setBoxSize(histogram_box, 2.0);
+  geometry_msgs::Point goal;
+  goal.x = 15.0;
+  goal.z = 2.5;
+  star_planner.setGoal(goal);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (float y = -2.f; y <= 2.f; y += 0.05f) {
+    for (float z = 0.f; z <= 5.f; z += 0.05f) {
+      cloud.push_back(pcl::PointXYZ(4.f, y, z));
+    }
+  }
+  star_planner.setCloud({cloud});
+
+  // WHEN: the tree is built, the children of every origin scored together
+  star_planner.buildLookAheadTree();
+
+  // THEN: every node has the cost and heuristic of the cost functions of a
+  // single node, the tree was built without the last path as after setGoal
+  star_planner.tree_age_ = 1000;
+  const std::vector<TreeNode>& tree = star_planner.tree_;
+  ASSERT_GT(tree.size(), 20);
+  for (size_t i = 1; i < tree.size(); i++) {
+    const TreeNode& origin = tree[tree[i].origin_];
+    double h = star_planner.treeHeuristicFunction(i);
+    double c = star_planner.treeCostFunction(i);
+    EXPECT_DOUBLE_EQ(h, tree[i].heuristic_);
+    if (c < HUGE_VAL) {
+      EXPECT_DOUBLE_EQ(origin.total_cost_ - origin.heuristic_ + c + h,
+                       tree[i].total_cost_);
+    }
+  }
+}
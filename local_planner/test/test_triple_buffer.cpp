@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/triple_buffer.h"
+
+#include <thread>
+
+using namespace avoidance;
+
+TEST(TripleBuffer, updateReturnsLatestValue) {
+  // GIVEN: an empty buffer
+  TripleBuffer<int> buffer;
+
+  // WHEN: nothing was published
+  // THEN: there is no update
+  EXPECT_FALSE(buffer.update());
+
+  // WHEN: two values are published before the consumer updates
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+
+  // THEN: the consumer only gets the latest one
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(2, buffer.front());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(2, buffer.front());
+
+  // WHEN: another value is published
+  buffer.back() = 3;
+  buffer.publish();
+
+  // THEN: the consumer picks it up
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(3, buffer.front());
+}
+
+TEST(TripleBuffer, concurrentValuesAreConsistent) {
+  // GIVEN: a buffer of values which are consistent if both fields are equal
+  struct Pair {
+    int a = 0;
+    int b = 0;
+  };
+  TripleBuffer<Pair> buffer;
+  const int n_values = 100000;
+
+  // WHEN: a producer thread keeps publishing new values
+  std::thread producer([&buffer, n_values] {
+    for (int i = 1; i <= n_values; i++) {
+      buffer.back().a = i;
+      buffer.back().b = i;
+      buffer.publish();
+    }
+  });
+
+  // THEN: the consumer sees consistent and increasing values
+  int last = 0;
+  while (last < n_values) {
+    if (buffer.update()) {
+      const Pair& value = buffer.front();
+      ASSERT_EQ(value.a, value.b);
+      ASSERT_GT(value.a, last);
+      last = value.a;
+    }
+  }
+  producer.join();
+}
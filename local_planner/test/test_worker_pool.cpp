@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "../src/nodes/worker_pool.h"
+
+#include <atomic>
+
+using namespace avoidance;
+
+TEST(WorkerPool, runsEveryTaskOfEachBatchOnce) {
+  // GIVEN: a pool with three threads
+  WorkerPool pool(3);
+
+  for (int n_tasks : {0, 1, 2, 4, 10}) {
+    // WHEN: a batch of tasks runs
+    std::vector<std::atomic<int>> runs(n_tasks);
+    for (auto& n : runs) {
+      n = 0;
+    }
+    const std::thread::id caller = std::this_thread::get_id();
+    bool first_on_caller = false;
+    pool.run(n_tasks, [&](int i) {
+      runs[i]++;
+      if (i == 0) {
+        first_on_caller = std::this_thread::get_id() == caller;
+      }
+    });
+
+    // THEN: every task ran once before run returned, the first one on the
+    // calling thread
+    for (int i = 0; i < n_tasks; i++) {
+      EXPECT_EQ(1, runs[i]) << "task " << i << " of " << n_tasks;
+    }
+    EXPECT_EQ(n_tasks > 0, first_on_caller);
+  }
+}
+
+TEST(WorkerPool, runsOnTheCallerWithoutThreads) {
+  // GIVEN: a pool without threads
+  WorkerPool pool(0);
+
+  // WHEN: a batch runs
+  int sum = 0;
+  pool.run(5, [&](int i) { sum += i; });
+
+  // THEN: all tasks ran
+  EXPECT_EQ(10, sum);
+}